@@ -0,0 +1,446 @@
+// art.c - cover art lookup, worker-thread decoding and content-addressed thumbnail cache
+// - thumbnails are keyed by a hash of the encoded image, not the track path, so
+//   an album's tracks (and a folder cover) share one entry and retagging a file
+//   with new art is picked up without invalidation logic
+// - cache entries are raw RGBA behind a 16-byte header: a hit costs one read
+//   and no decoding; the UI uploads it as-is
+// - one decode produces every standard size, so scrolling a list (64) and then
+//   opening the track (256) decodes the cover once
+// - a small path -> key memo (checked against mtime/size) skips re-reading
+//   embedded art on repeated requests, including "this track has no art"
+
+#define _POSIX_C_SOURCE 200809L
+#include "art.h"
+#include "library.h"
+#include "meta.h"
+#include "util.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define THUMB_MAGIC "OXTH"
+#define THUMB_HEADER 16
+#define MAX_QUEUE 256
+#define MAX_THREADS 8
+#define MEMO_SLOTS 1024
+
+const int ox_art_sizes[OX_ART_NUM_SIZES] = { 64, 128, 256 };
+
+static int snap_size(int size)
+{
+    for (int i = 0; i < OX_ART_NUM_SIZES; ++i)
+        if (size <= ox_art_sizes[i]) return ox_art_sizes[i];
+    return ox_art_sizes[OX_ART_NUM_SIZES - 1];
+}
+
+char *ox_art_default_dir(void)
+{
+    char *lib = ox_library_default_path(); /* creates the cache directory */
+    if (!lib) return NULL;
+    char *slash = strrchr(lib, '/');
+    size_t dir = slash ? (size_t)(slash - lib) + 1 : 0;
+    size_t n = dir + strlen("art") + 1;
+    char *out = malloc(n);
+    if (out) {
+        snprintf(out, n, "%.*sart", (int)dir, lib);
+        if (ox_mkdir_p(out) != 0) {
+            free(out);
+            out = NULL;
+        }
+    }
+    free(lib);
+    return out;
+}
+
+/* ---- source bytes ---- */
+
+static unsigned char *read_file(const char *path, size_t *len)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    unsigned char *buf = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && (uint64_t)st.st_size <= OX_META_PICTURE_MAX &&
+        (buf = malloc((size_t)st.st_size))) {
+        size_t got = 0;
+        while (got < (size_t)st.st_size) {
+            ssize_t r = pread(fd, buf + got, (size_t)st.st_size - got, (off_t)got);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) break;
+            got += (size_t)r;
+        }
+        if (got == (size_t)st.st_size) {
+            *len = got;
+        } else {
+            free(buf);
+            buf = NULL;
+        }
+    }
+    close(fd);
+    return buf;
+}
+
+/* cover.jpg, Folder.png, AlbumArt.jpeg ... in the track's directory, best name first. */
+static unsigned char *folder_image(const char *track_path, size_t *len)
+{
+    static const char *const names[] = { "cover", "folder", "front", "album", "albumart" };
+    const char *slash = strrchr(track_path, '/');
+    char dir[1024];
+    if (!slash) {
+        strcpy(dir, ".");
+    } else {
+        size_t n = (size_t)(slash - track_path);
+        if (n >= sizeof(dir)) return NULL;
+        memcpy(dir, track_path, n);
+        dir[n ? n : 1] = '\0';
+        if (!n) dir[0] = '/';
+    }
+    DIR *d = opendir(dir);
+    if (!d) return NULL;
+    char best[256] = "";
+    int best_rank = (int)(sizeof(names) / sizeof(names[0]));
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        const char *dot = strrchr(e->d_name, '.');
+        if (!dot || (strcasecmp(dot, ".jpg") && strcasecmp(dot, ".jpeg") && strcasecmp(dot, ".png"))) continue;
+        size_t stem = (size_t)(dot - e->d_name);
+        for (int i = 0; i < best_rank; ++i) {
+            if (strlen(names[i]) == stem && strncasecmp(e->d_name, names[i], stem) == 0 && strlen(e->d_name) < sizeof(best)) {
+                best_rank = i;
+                strcpy(best, e->d_name);
+                break;
+            }
+        }
+    }
+    closedir(d);
+    if (!best[0]) return NULL;
+    char path[1300];
+    snprintf(path, sizeof(path), "%s/%s", dir, best);
+    return read_file(path, len);
+}
+
+unsigned char *ox_art_source(const char *track_path, size_t *len)
+{
+    if (!track_path || !len) return NULL;
+    unsigned char *data = ox_meta_picture_file(track_path, len);
+    return data ? data : folder_image(track_path, len);
+}
+
+/* ---- thumbnail files ---- */
+
+static void thumb_path(char *out, size_t cap, const char *dir, uint64_t key, int size)
+{
+    snprintf(out, cap, "%s/%016llx-%d.thumb", dir, (unsigned long long)key, size);
+}
+
+static int thumb_read(const char *dir, uint64_t key, int size, struct ox_image *out)
+{
+    char path[1100];
+    thumb_path(path, sizeof(path), dir, key, size);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    size_t px = (size_t)size * size * 4;
+    unsigned char hdr[THUMB_HEADER];
+    int rc = -1;
+    uint32_t w, h;
+    if (pread(fd, hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) && memcmp(hdr, THUMB_MAGIC, 4) == 0) {
+        memcpy(&w, hdr + 4, 4);
+        memcpy(&h, hdr + 8, 4);
+        if (w == (uint32_t)size && h == (uint32_t)size && (out->rgba = malloc(px))) {
+            if (pread(fd, out->rgba, px, THUMB_HEADER) == (ssize_t)px) {
+                out->w = out->h = size;
+                rc = 0;
+            } else {
+                free(out->rgba);
+                out->rgba = NULL;
+            }
+        }
+    }
+    close(fd);
+    return rc;
+}
+
+/* Best effort (a cache): temp file + rename so readers never see a torn entry. */
+static void thumb_write(const char *dir, uint64_t key, const struct ox_image *img)
+{
+    char path[1100];
+    thumb_path(path, sizeof(path), dir, key, img->w);
+    struct ox_atomic a;
+    if (ox_atomic_begin(&a, path, 0600, 0) != 0) return;
+    unsigned char hdr[THUMB_HEADER] = THUMB_MAGIC;
+    uint32_t w = (uint32_t)img->w, h = (uint32_t)img->h;
+    memcpy(hdr + 4, &w, 4);
+    memcpy(hdr + 8, &h, 4);
+    int rc = ox_write_all(a.fd, hdr, sizeof(hdr));
+    if (rc == 0) rc = ox_write_all(a.fd, img->rgba, (size_t)img->w * img->h * 4);
+    ox_atomic_finish(&a, path, rc);
+}
+
+/* ---- loading ---- */
+
+struct memo {
+    uint64_t path_hash;
+    int64_t mtime_ns;
+    int64_t size;
+    uint64_t key;
+    int has_art;
+};
+
+static int load(const char *dir, const char *track_path, int size, struct ox_image *out, struct memo *memo,
+                pthread_mutex_t *memo_lock)
+{
+    memset(out, 0, sizeof(*out));
+    size = snap_size(size);
+    struct stat st;
+    if (stat(track_path, &st) != 0) return -1;
+    struct memo m = { ox_fnv1a_str(track_path),
+                      (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec, (int64_t)st.st_size, 0, 0 };
+    struct memo *slot = memo ? &memo[m.path_hash % MEMO_SLOTS] : NULL;
+    if (slot) {
+        pthread_mutex_lock(memo_lock);
+        struct memo seen = *slot;
+        pthread_mutex_unlock(memo_lock);
+        if (seen.path_hash == m.path_hash && seen.mtime_ns == m.mtime_ns && seen.size == m.size) {
+            if (!seen.has_art) return -1;
+            if (dir && thumb_read(dir, seen.key, size, out) == 0) return 0;
+        }
+    }
+
+    size_t len = 0;
+    unsigned char *data = ox_art_source(track_path, &len);
+    int rc = -1;
+    if (data) {
+        m.key = ox_fnv1a(data, len);
+        if (dir && thumb_read(dir, m.key, size, out) == 0) {
+            rc = 0;
+        } else {
+            struct ox_image full;
+            if (ox_image_decode(data, len, ox_art_sizes[OX_ART_NUM_SIZES - 1], &full) == 0) {
+                for (int i = 0; i < OX_ART_NUM_SIZES; ++i) {
+                    struct ox_image t;
+                    if (ox_image_thumbnail(&full, ox_art_sizes[i], &t) != 0) continue;
+                    if (dir) thumb_write(dir, m.key, &t);
+                    if (t.w == size && !out->rgba) *out = t;
+                    else ox_image_free(&t);
+                }
+                ox_image_free(&full);
+                rc = out->rgba ? 0 : -1;
+            }
+        }
+        free(data);
+    }
+    /* "no (decodable) art" is remembered too: list views ask for it every frame */
+    m.has_art = rc == 0;
+    if (slot) {
+        pthread_mutex_lock(memo_lock);
+        *slot = m;
+        pthread_mutex_unlock(memo_lock);
+    }
+    return rc;
+}
+
+int ox_art_load(const char *cache_dir, const char *track_path, int size, struct ox_image *out)
+{
+    if (!track_path || !out) return -1;
+    return load(cache_dir, track_path, size, out, NULL, NULL);
+}
+
+/* ---- worker pool ---- */
+
+struct job {
+    char *path;
+    int size;
+    void *user;
+};
+
+struct ox_art_cache {
+    char *dir;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+    /* pending requests; workers take from the end (newest first) */
+    struct job *queue;
+    size_t nqueue;
+    /* jobs being decoded, for deduplication */
+    struct job running[MAX_THREADS];
+    /* finished, waiting for ox_art_poll */
+    struct ox_art_thumb *done;
+    size_t ndone, done_cap;
+    int nthreads;
+    pthread_t threads[MAX_THREADS];
+    pthread_mutex_t memo_lock;
+    struct memo memo[MEMO_SLOTS];
+};
+
+static int same_job(const struct job *j, const char *path, int size)
+{
+    return j->path && j->size == size && strcmp(j->path, path) == 0;
+}
+
+static void *worker(void *arg)
+{
+    struct ox_art_cache *c = arg;
+    pthread_mutex_lock(&c->lock);
+    int self = 0;
+    while (self < c->nthreads && !pthread_equal(c->threads[self], pthread_self())) self++;
+    for (;;) {
+        while (!c->stop && c->nqueue == 0) pthread_cond_wait(&c->cond, &c->lock);
+        if (c->stop) break;
+        struct job j = c->queue[--c->nqueue];
+        c->running[self] = j;
+        pthread_mutex_unlock(&c->lock);
+
+        struct ox_art_thumb t = { j.path, j.size, j.user, { 0, 0, NULL } };
+        load(c->dir, j.path, j.size, &t.img, c->memo, &c->memo_lock);
+
+        pthread_mutex_lock(&c->lock);
+        c->running[self].path = NULL;
+        if (c->ndone == c->done_cap) {
+            size_t cap = c->done_cap ? c->done_cap * 2 : 16;
+            struct ox_art_thumb *nd = realloc(c->done, cap * sizeof(*nd));
+            if (!nd) {
+                ox_art_thumb_free(&t);
+                continue;
+            }
+            c->done = nd;
+            c->done_cap = cap;
+        }
+        c->done[c->ndone++] = t;
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+struct ox_art_cache *ox_art_cache_create(const char *cache_dir, int threads)
+{
+    struct ox_art_cache *c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->dir = cache_dir ? strdup(cache_dir) : ox_art_default_dir();
+    c->queue = malloc(MAX_QUEUE * sizeof(*c->queue));
+    if (!c->queue) {
+        free(c->dir);
+        free(c);
+        return NULL;
+    }
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_mutex_init(&c->memo_lock, NULL);
+    pthread_cond_init(&c->cond, NULL);
+    if (threads <= 0) threads = 2;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    /* workers look up their own slot in threads[], so hold the lock until all are recorded */
+    pthread_mutex_lock(&c->lock);
+    for (int i = 0; i < threads; ++i) {
+        if (pthread_create(&c->threads[c->nthreads], NULL, worker, c) == 0) c->nthreads++;
+    }
+    pthread_mutex_unlock(&c->lock);
+    if (c->nthreads == 0) {
+        ox_art_cache_destroy(c);
+        return NULL;
+    }
+    return c;
+}
+
+void ox_art_cache_destroy(struct ox_art_cache *c)
+{
+    if (!c) return;
+    pthread_mutex_lock(&c->lock);
+    c->stop = 1;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+    for (int i = 0; i < c->nthreads; ++i) pthread_join(c->threads[i], NULL);
+    for (size_t i = 0; i < c->nqueue; ++i) free(c->queue[i].path);
+    for (size_t i = 0; i < c->ndone; ++i) ox_art_thumb_free(&c->done[i]);
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->memo_lock);
+    pthread_mutex_destroy(&c->lock);
+    free(c->queue);
+    free(c->done);
+    free(c->dir);
+    free(c);
+}
+
+int ox_art_request(struct ox_art_cache *c, const char *track_path, int size, void *user)
+{
+    if (!c || !track_path) return -1;
+    size = snap_size(size);
+    pthread_mutex_lock(&c->lock);
+    for (int i = 0; i < c->nthreads; ++i) {
+        if (same_job(&c->running[i], track_path, size)) {
+            pthread_mutex_unlock(&c->lock);
+            return 0;
+        }
+    }
+    /* finished but not polled yet: the answer is already on its way */
+    for (size_t i = 0; i < c->ndone; ++i) {
+        if (c->done[i].size == size && strcmp(c->done[i].path, track_path) == 0) {
+            pthread_mutex_unlock(&c->lock);
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < c->nqueue; ++i) {
+        if (same_job(&c->queue[i], track_path, size)) {
+            /* move to the top: it was asked for again, so it is probably still visible */
+            struct job j = c->queue[i];
+            memmove(c->queue + i, c->queue + i + 1, (c->nqueue - i - 1) * sizeof(*c->queue));
+            j.user = user;
+            c->queue[c->nqueue - 1] = j;
+            pthread_mutex_unlock(&c->lock);
+            return 0;
+        }
+    }
+    char *p = strdup(track_path);
+    if (!p) {
+        pthread_mutex_unlock(&c->lock);
+        return -1;
+    }
+    if (c->nqueue == MAX_QUEUE) {
+        free(c->queue[0].path);
+        memmove(c->queue, c->queue + 1, (MAX_QUEUE - 1) * sizeof(*c->queue));
+        c->nqueue--;
+    }
+    c->queue[c->nqueue++] = (struct job){ p, size, user };
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+    return 0;
+}
+
+size_t ox_art_poll(struct ox_art_cache *c, struct ox_art_thumb *out, size_t max)
+{
+    if (!c || !out || !max) return 0;
+    if (pthread_mutex_trylock(&c->lock) != 0) return 0; /* never stall a frame on a worker */
+    size_t n = c->ndone < max ? c->ndone : max;
+    if (!n) {
+        pthread_mutex_unlock(&c->lock);
+        return 0;
+    }
+    memcpy(out, c->done, n * sizeof(*out));
+    memmove(c->done, c->done + n, (c->ndone - n) * sizeof(*c->done));
+    c->ndone -= n;
+    pthread_mutex_unlock(&c->lock);
+    return n;
+}
+
+void ox_art_thumb_free(struct ox_art_thumb *t)
+{
+    if (!t) return;
+    free(t->path);
+    t->path = NULL;
+    ox_image_free(&t->img);
+}
+
+size_t ox_art_pending(struct ox_art_cache *c)
+{
+    if (!c) return 0;
+    pthread_mutex_lock(&c->lock);
+    size_t n = c->nqueue;
+    for (int i = 0; i < c->nthreads; ++i) n += c->running[i].path != NULL;
+    pthread_mutex_unlock(&c->lock);
+    return n;
+}
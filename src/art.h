@@ -0,0 +1,50 @@
+// art.h - cover art lookup, worker-thread decoding and content-addressed thumbnail cache
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "image.h"
+
+/* Thumbnails are produced in these sizes (square, RGBA); requests are rounded up. */
+#define OX_ART_NUM_SIZES 3
+extern const int ox_art_sizes[OX_ART_NUM_SIZES]; /* 64, 128, 256 */
+
+/* $XDG_CACHE_HOME/oxxy/art (created). Returns malloc'd path or NULL. */
+char *ox_art_default_dir(void);
+
+/* Encoded cover bytes for a track: embedded art first (ID3 APIC, FLAC PICTURE,
+ * MP4 covr), then cover/folder/front/album(art).{jpg,jpeg,png} next to it.
+ * Returns malloc'd bytes or NULL. */
+unsigned char *ox_art_source(const char *track_path, size_t *len);
+
+/* Synchronous lookup: cached thumbnail if present (keyed by a hash of the encoded
+ * image), otherwise decode once, write all sizes to cache_dir and return the
+ * requested one. Returns 0 on success, -1 if the track has no usable art.
+ */
+int ox_art_load(const char *cache_dir, const char *track_path, int size, struct ox_image *out);
+
+struct ox_art_thumb {
+    char *path;           /* track path as requested */
+    int size;             /* requested size (rounded up to a standard size) */
+    void *user;
+    struct ox_image img;  /* rgba == NULL: no art for this track */
+};
+
+struct ox_art_cache;
+
+/* threads <= 0: 2. cache_dir NULL: ox_art_default_dir(). */
+struct ox_art_cache *ox_art_cache_create(const char *cache_dir, int threads);
+void ox_art_cache_destroy(struct ox_art_cache *c);
+
+/* Queue a thumbnail; never blocks on I/O or decoding. The most recent requests
+ * are served first (what is on screen now), duplicates are ignored and the
+ * oldest pending requests are dropped beyond a fixed backlog.
+ */
+int ox_art_request(struct ox_art_cache *c, const char *track_path, int size, void *user);
+
+/* Take up to max finished thumbnails (non-blocking). Release each with ox_art_thumb_free. */
+size_t ox_art_poll(struct ox_art_cache *c, struct ox_art_thumb *out, size_t max);
+void ox_art_thumb_free(struct ox_art_thumb *t);
+
+/* Number of requests queued or in progress. */
+size_t ox_art_pending(struct ox_art_cache *c);
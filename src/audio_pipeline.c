@@ -2,16 +2,32 @@
 // - uses pcm_ring for inter-thread communication
 // - runtime selection for PipeWire (dlopen stub) or ALSA backend
 // - dummy backend available when ALSA not requested
+// - the device is opened before anything optional: the PipeWire probe runs on
+//   its own thread, and "audio-open" / "first-sound" are startup phases
+// - both audio threads trace their work (decode and write spans, an
+//   "underrun" instant when playback finds the ring empty); $OXXY_TRACE=path
+//   writes the trace at exit
+// - --daemon keeps the engine running headless and serves frontends through
+//   engine_ipc.c: peaks, a spectrum and the playback state go to shared
+//   memory, commands come in on the control socket; --ctl sends one command
+//   to a running engine (the CLI client)
 
 #define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <dlfcn.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdatomic.h>
+#include <time.h>
 #include <unistd.h>
 #include <math.h>
+#include "engine_ipc.h"
 #include "pcm_ring.h"
+#include "playlist_share.h"
+#include "startup.h"
+#include "trace.h"
 #include "ui_bridge.h"
 
 #ifdef USE_ALSA
@@ -24,6 +40,11 @@
 
 static struct pcm_ring *g_ring = NULL;
 static atomic_int g_running = 0;
+static atomic_int g_playing = 1;
+static atomic_int g_volume_milli = 1000;
+static _Atomic uint64_t g_frames_played;   /* position in the current entry */
+static struct ox_engine_server *g_server;  /* daemon mode only */
+static volatile sig_atomic_t g_signalled;
 
 static int try_init_pipewire(void)
 {
@@ -63,6 +84,24 @@ static void alsa_close(struct alsa_ctx *c)
 }
 #endif
 
+/* Band magnitudes of one chunk (left channel), Goertzel at log-spaced
+ * centres from 40 Hz to 16 kHz: a few dozen bands need no FFT. */
+static void spectrum(const float *frames, size_t n, float bands[OX_ENGINE_BANDS])
+{
+    for (int b = 0; b < OX_ENGINE_BANDS; ++b) {
+        double f = 40.0 * pow(16000.0 / 40.0, (double)b / (OX_ENGINE_BANDS - 1));
+        double coeff = 2.0 * cos(6.283185307179586 * f / SAMPLE_RATE);
+        double s1 = 0.0, s2 = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            double s0 = frames[i * CHANNELS] + coeff * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        double power = s1 * s1 + s2 * s2 - coeff * s1 * s2;
+        bands[b] = (float)(2.0 * sqrt(power > 0.0 ? power : 0.0) / (double)n);
+    }
+}
+
 static void *decoder_thread(void *arg)
 {
     (void)arg;
@@ -73,9 +112,16 @@ static void *decoder_thread(void *arg)
     const double inc = two_pi * freq / SAMPLE_RATE;
     const size_t frames_per_chunk = 512;
     float buf[frames_per_chunk * CHANNELS];
+    OX_TRACE_THREAD("decoder");
     while (atomic_load(&g_running)) {
+        if (!atomic_load(&g_playing)) {
+            usleep(5000);
+            continue;
+        }
+        OX_TRACE_BEGIN("decode");
+        const double gain = 0.2 * atomic_load(&g_volume_milli) / 1000.0;
         for (size_t i = 0; i < frames_per_chunk; ++i) {
-            float v = (float)(sin(phase) * 0.2);
+            float v = (float)(sin(phase) * gain);
             phase += inc; if (phase >= two_pi) phase -= two_pi;
             buf[i*CHANNELS + 0] = v;
             buf[i*CHANNELS + 1] = v;
@@ -86,6 +132,13 @@ static void *decoder_thread(void *arg)
                 float absv = fabsf(buf[i*CHANNELS]); if (absv > peak) peak = absv;
             }
             ox_ui_push_peak(peak);
+        if (g_server) {
+            float bands[OX_ENGINE_BANDS];
+            spectrum(buf, frames_per_chunk, bands);
+            ox_engine_publish_peaks(g_server, &peak, 1);
+            ox_engine_publish_spectrum(g_server, bands);
+        }
+        OX_TRACE_END("decode");
         size_t pushed = 0;
         while (pushed < frames_per_chunk && atomic_load(&g_running)) {
             size_t n = pcm_ring_push(g_ring, buf + pushed * CHANNELS, frames_per_chunk - pushed);
@@ -103,59 +156,328 @@ static void *decoder_thread(void *arg)
 static void *playback_thread(void *arg)
 {
     (void)arg;
+    OX_TRACE_THREAD("playback");
+    int marked = 0; /* "first-sound" is marked once, not on every write */
 #ifdef USE_ALSA
     struct alsa_ctx ctx = {0};
     if (alsa_open(&ctx, SAMPLE_RATE, CHANNELS) < 0) {
         fprintf(stderr, "ALSA open failed\n");
         return NULL;
     }
+    ox_startup_mark("audio-open");
     float local[1024 * CHANNELS];
+    int fed = 0;
     while (atomic_load(&g_running)) {
+        if (!atomic_load(&g_playing)) {
+            usleep(5000);
+            continue;
+        }
         size_t got = pcm_ring_pop(g_ring, local, 1024);
-        if (got == 0) { sleep(0); continue; }
+        if (got == 0) {
+            if (fed) OX_TRACE_INSTANT("underrun");
+            fed = 0;
+            sleep(0);
+            continue;
+        }
+        fed = 1;
+        OX_TRACE_BEGIN("write");
         snd_pcm_sframes_t w = snd_pcm_writei(ctx.pcm, local, got);
-        if (w < 0) w = snd_pcm_recover(ctx.pcm, (int)w, 0);
+        if (w < 0) {
+            OX_TRACE_INSTANT("xrun");
+            w = snd_pcm_recover(ctx.pcm, (int)w, 0);
+        }
+        OX_TRACE_END("write");
         if (w < 0) { fprintf(stderr, "ALSA write failed\n"); break; }
+        atomic_fetch_add(&g_frames_played, (uint64_t)w);
+        if (!marked) {
+            ox_startup_mark("first-sound");
+            marked = 1;
+        }
     }
     alsa_close(&ctx);
 #else
     /* Dummy backend: consume from ring and discard (allows running without ALSA) */
+    ox_startup_mark("audio-open");
     float local[1024 * CHANNELS];
+    int fed = 0;
     while (atomic_load(&g_running)) {
+        if (!atomic_load(&g_playing)) {
+            usleep(5000);
+            continue;
+        }
         size_t got = pcm_ring_pop(g_ring, local, 1024);
-        if (got == 0) { sleep(0); continue; }
+        if (got == 0) {
+            if (fed) OX_TRACE_INSTANT("underrun");
+            fed = 0;
+            sleep(0);
+            continue;
+        }
+        fed = 1;
+        if (!marked) {
+            ox_startup_mark("first-sound");
+            marked = 1;
+        }
         /* simulate writing latency */
+        OX_TRACE_BEGIN("write");
         usleep((unsigned int)(1000000 * (double)got / SAMPLE_RATE));
+        OX_TRACE_END("write");
+        atomic_fetch_add(&g_frames_played, got);
     }
 #endif
     return NULL;
 }
 
+/* dlopen of libpipewire pulls in a dozen libraries: not on the way to sound */
+static void *probe_thread(void *arg)
+{
+    (void)arg;
+    if (try_init_pipewire()) {
+        fprintf(stderr, "PipeWire initialized (not implemented)\n");
+    } else {
+        fprintf(stderr, "PipeWire not available, using backend as built\n");
+    }
+    ox_startup_mark("pipewire-probe");
+    return NULL;
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    g_signalled = 1;
+}
+
+/* Move the engine's playlist: op is "jump" (arg: index), "next" or "prev". */
+static int move(struct ox_plshare *pls, const char *op, const char *arg)
+{
+    struct playlist *w = ox_plshare_edit(pls);
+    int rc;
+    if (strcmp(op, "jump") == 0) {
+        char *end;
+        unsigned long long i = strtoull(arg, &end, 10);
+        rc = end != arg ? playlist_jump(w, (size_t)i) : -1;
+    } else {
+        rc = (strcmp(op, "next") == 0 ? playlist_skip(w) : playlist_prev(w)) == PLAYLIST_END ? -1 : 0;
+    }
+    if (rc != 0) {
+        ox_plshare_abandon(pls);
+        return -1;
+    }
+    ox_plshare_publish(pls);
+    atomic_store(&g_frames_played, 0);
+    return 0;
+}
+
+/* "play <uri>": the entry with that URI in the engine's own playlist, added
+ * at the end if missing. Frontends name entries by URI because their copy of
+ * the playlist need not have the engine's order. */
+static int play_uri(struct ox_plshare *pls, const char *uri)
+{
+    struct playlist *w = ox_plshare_edit(pls);
+    size_t len = strlen(uri);
+    size_t i = playlist_find(w, uri, len);
+    if (i == PLAYLIST_END && playlist_add_n(w, uri, len) == 0) i = w->count - 1;
+    if (i == PLAYLIST_END || playlist_jump(w, i) != 0) {
+        ox_plshare_abandon(pls);
+        return -1;
+    }
+    ox_plshare_publish(pls);
+    atomic_store(&g_frames_played, 0);
+    atomic_store(&g_playing, 1);
+    return 0;
+}
+
+/* Control socket commands (engine_ipc.c's thread). */
+static int on_command(void *user, const char *cmd, const char *arg, char *reply, size_t reply_len)
+{
+    struct ox_plshare *pls = user;
+    if (strcmp(cmd, "play") == 0) {
+        if (!*arg) atomic_store(&g_playing, 1);
+        else if (play_uri(pls, arg) != 0) {
+            snprintf(reply, reply_len, "cannot play '%s'", arg);
+            return -1;
+        }
+    } else if (strcmp(cmd, "pause") == 0) {
+        atomic_store(&g_playing, 0);
+    } else if (strcmp(cmd, "toggle") == 0) {
+        atomic_fetch_xor(&g_playing, 1);
+    } else if (strcmp(cmd, "seek") == 0 || strcmp(cmd, "volume") == 0) {
+        /* seek stops at the end of the track, or where the frame count would overflow */
+        double len = cmd[0] == 's' ? ox_ui_get_track_length() : 0.0;
+        double max = cmd[0] != 's' ? 1.0 : len > 0.0 ? len : (double)(UINT64_MAX / SAMPLE_RATE);
+        double v;
+        if (ox_engine_parse_number(arg, max, &v) != 0) {
+            snprintf(reply, reply_len, "%s needs a number", cmd);
+            return -1;
+        }
+        if (cmd[0] == 's') atomic_store(&g_frames_played, (uint64_t)(v * SAMPLE_RATE));
+        else atomic_store(&g_volume_milli, (int)(v * 1000.0 + 0.5));
+    } else if (strcmp(cmd, "add") == 0) {
+        struct playlist *w = *arg ? ox_plshare_edit(pls) : NULL;
+        if (!w || playlist_add(w, arg) != 0) {
+            if (w) ox_plshare_abandon(pls);
+            snprintf(reply, reply_len, "cannot add '%s'", arg);
+            return -1;
+        }
+        ox_plshare_publish(pls);
+    } else if (strcmp(cmd, "jump") == 0 || strcmp(cmd, "next") == 0 || strcmp(cmd, "prev") == 0) {
+        if (move(pls, cmd, arg) != 0) {
+            snprintf(reply, reply_len, "no such entry");
+            return -1;
+        }
+    } else if (strcmp(cmd, "state") == 0) {
+        const char *uri = ox_ui_get_current_uri();
+        snprintf(reply, reply_len, "%s %.3f %s", atomic_load(&g_playing) ? "playing" : "paused",
+                 (double)atomic_load(&g_frames_played) / SAMPLE_RATE, uri ? uri : "-");
+    } else if (strcmp(cmd, "quit") == 0) {
+        g_signalled = 1;
+    } else {
+        snprintf(reply, reply_len, "unknown command '%s'", cmd);
+        return -1;
+    }
+    return 0;
+}
+
+/* The snapshot frontends read; published only when something changed. */
+static void publish_state(struct ox_plshare *pls, struct ox_engine_state *last)
+{
+    struct ox_engine_state st;
+    memset(&st, 0, sizeof(st));
+    st.position = (double)atomic_load(&g_frames_played) / SAMPLE_RATE;
+    st.volume = atomic_load(&g_volume_milli) / 1000.0f;
+    st.playing = atomic_load(&g_playing);
+    struct ox_plread r;
+    const struct playlist *p = ox_plshare_read_begin(pls, &r);
+    st.count = p->count;
+    st.index = p->pos;
+    if (p->pos < p->count) snprintf(st.uri, sizeof(st.uri), "%s", playlist_uri(p, p->pos));
+    ox_plshare_read_end(pls, &r);
+    st.length = st.uri[0] ? ox_ui_get_track_length() : 0.0;
+    if (memcmp(&st, last, sizeof(st)) == 0) return;
+    *last = st;
+    ox_engine_publish_state(g_server, &st);
+}
+
+/* --ctl: one command to a running engine, its answer on stdout. */
+static int control(const char *path, int argc, char **argv)
+{
+    char line[OX_ENGINE_LINE_MAX] = "";
+    size_t len = 0;
+    for (int i = 0; i < argc; ++i) {
+        int n = snprintf(line + len, sizeof(line) - len, "%s%s", i ? " " : "", argv[i]);
+        if (n < 0 || (size_t)n >= sizeof(line) - len) {
+            fprintf(stderr, "command too long\n");
+            return 2;
+        }
+        len += (size_t)n;
+    }
+    if (!len) snprintf(line, sizeof(line), "state");
+    struct ox_engine_client *c = ox_engine_connect(path);
+    if (!c) {
+        fprintf(stderr, "no engine at %s\n", path);
+        return 1;
+    }
+    char reply[OX_ENGINE_LINE_MAX];
+    int rc = ox_engine_command(c, line, reply, sizeof(reply));
+    ox_engine_disconnect(c);
+    if (rc == 0) {
+        if (reply[0]) printf("%s\n", reply);
+        return 0;
+    }
+    fprintf(stderr, "%s\n", reply[0] ? reply : "engine did not answer");
+    return 1;
+}
+
 int main(int argc, char **argv)
 {
-    (void)argc; (void)argv;
+    int daemon = 0, first_uri = argc;
+    const char *socket_arg = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--daemon") == 0) {
+            daemon = 1;
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_arg = argv[++i];
+        } else if (strcmp(argv[i], "--ctl") == 0) {
+            char *path = socket_arg ? strdup(socket_arg) : ox_engine_default_socket();
+            int rc = path ? control(path, argc - i - 1, argv + i + 1) : 1;
+            free(path);
+            return rc;
+        } else if (daemon && argv[i][0] != '-') {
+            first_uri = i;
+            break;
+        } else {
+            fprintf(stderr, "usage: %s [--socket PATH] [--daemon [URI...] | --ctl COMMAND...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    ox_startup_begin();
     fprintf(stderr, "OXXY test: starting audio pipeline...\n");
     g_ring = pcm_ring_create(SAMPLE_RATE * RING_SECONDS);
     if (!g_ring) { fprintf(stderr, "failed to create ring\n"); return 1; }
 
-    if (try_init_pipewire()) {
-        fprintf(stderr, "PipeWire initialized (not implemented)\n");
-    } else {
-        fprintf(stderr, "PipeWire not available, using backend as built\n");
+    struct ox_plshare *pls = NULL;
+    char *path = NULL;
+    if (daemon) {
+        pls = ox_plshare_create(NULL);
+        path = socket_arg ? strdup(socket_arg) : ox_engine_default_socket();
+        if (pls) {
+            struct playlist *w = ox_plshare_edit(pls);
+            for (int i = first_uri; i < argc; ++i) playlist_add(w, argv[i]);
+            ox_plshare_publish(pls);
+            ox_ui_set_playlist(pls);
+        }
+        g_server = pls && path ? ox_engine_server_create(path, on_command, pls) : NULL;
+        if (!g_server) {
+            fprintf(stderr, "cannot listen on %s (is an engine running?)\n", path ? path : "?");
+            ox_ui_set_playlist(NULL);
+            ox_plshare_destroy(pls);
+            free(path);
+            pcm_ring_destroy(g_ring);
+            return 1;
+        }
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_signal;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        signal(SIGPIPE, SIG_IGN);
     }
 
     atomic_store(&g_running, 1);
-    pthread_t dec, play;
+    pthread_t dec, play, probe;
     pthread_create(&dec, NULL, decoder_thread, NULL);
     pthread_create(&play, NULL, playback_thread, NULL);
+    int probing = pthread_create(&probe, NULL, probe_thread, NULL) == 0;
 
-    fprintf(stderr, "Running for 5 seconds...\n");
-    sleep(5);
+    if (daemon) {
+        fprintf(stderr, "Engine listening on %s\n", path);
+        struct ox_engine_state last;
+        memset(&last, 0, sizeof(last));
+        last.volume = -1.0f; /* publish the first state whatever it is */
+        while (!g_signalled) {
+            publish_state(pls, &last);
+            struct timespec ts = {0, 50 * 1000000L};
+            nanosleep(&ts, NULL);
+        }
+    } else {
+        fprintf(stderr, "Running for 5 seconds...\n");
+        sleep(5);
+    }
 
     atomic_store(&g_running, 0);
     pthread_join(dec, NULL);
     pthread_join(play, NULL);
+    if (probing) pthread_join(probe, NULL);
+    if (g_server) {
+        ox_engine_server_destroy(g_server);
+        g_server = NULL;
+        ox_ui_set_playlist(NULL);
+        ox_plshare_destroy(pls);
+    }
+    free(path);
     pcm_ring_destroy(g_ring);
+    if (ox_trace_path() && ox_trace_write(ox_trace_path()) == 0)
+        fprintf(stderr, "OXXY test: trace written to %s\n", ox_trace_path());
     fprintf(stderr, "OXXY test: shutdown\n");
     return 0;
 }
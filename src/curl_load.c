@@ -0,0 +1,68 @@
+// curl_load.c - dlopen libcurl once for every module that talks HTTP
+// - one pthread_once guards the dlopen and curl_global_init, so a VK request
+//   and a stream worker starting together cannot both initialise libcurl
+// - the table is only complete or all NULL: a library missing any symbol is
+//   closed again and treated as absent
+#define _POSIX_C_SOURCE 200809L
+#include "curl_load.h"
+#include <dlfcn.h>
+#include <pthread.h>
+#include <string.h>
+
+struct ox_curl ox_curl;
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static void *lib;
+
+typedef int (*curl_global_init_t)(long);
+
+static void load(void)
+{
+    lib = dlopen("libcurl.so.4", RTLD_NOW | RTLD_LOCAL);
+    if (!lib) lib = dlopen("libcurl.so", RTLD_NOW | RTLD_LOCAL);
+    if (!lib) return;
+    struct ox_curl c;
+    c.easy_init = (curl_easy_init_t)dlsym(lib, "curl_easy_init");
+    c.easy_setopt = (curl_easy_setopt_t)dlsym(lib, "curl_easy_setopt");
+    c.easy_perform = (curl_easy_perform_t)dlsym(lib, "curl_easy_perform");
+    c.easy_cleanup = (curl_easy_cleanup_t)dlsym(lib, "curl_easy_cleanup");
+    c.easy_getinfo = (curl_easy_getinfo_t)dlsym(lib, "curl_easy_getinfo");
+    c.slist_append = (curl_slist_append_t)dlsym(lib, "curl_slist_append");
+    c.slist_free_all = (curl_slist_free_all_t)dlsym(lib, "curl_slist_free_all");
+    c.multi_init = (curl_multi_init_t)dlsym(lib, "curl_multi_init");
+    c.multi_setopt = (curl_multi_setopt_t)dlsym(lib, "curl_multi_setopt");
+    c.multi_add_handle = (curl_multi_add_handle_t)dlsym(lib, "curl_multi_add_handle");
+    c.multi_remove_handle = (curl_multi_remove_handle_t)dlsym(lib, "curl_multi_remove_handle");
+    c.multi_perform = (curl_multi_perform_t)dlsym(lib, "curl_multi_perform");
+    c.multi_wait = (curl_multi_wait_t)dlsym(lib, "curl_multi_wait");
+    c.multi_info_read = (curl_multi_info_read_t)dlsym(lib, "curl_multi_info_read");
+    c.multi_cleanup = (curl_multi_cleanup_t)dlsym(lib, "curl_multi_cleanup");
+    curl_global_init_t global_init = (curl_global_init_t)dlsym(lib, "curl_global_init");
+    if (!c.easy_init || !c.easy_setopt || !c.easy_perform || !c.easy_cleanup ||
+        !c.easy_getinfo || !c.multi_init || !c.multi_setopt || !c.multi_add_handle ||
+        !c.multi_remove_handle || !c.multi_perform || !c.multi_wait || !c.multi_info_read ||
+        !c.multi_cleanup || !c.slist_append || !c.slist_free_all) {
+        dlclose(lib);
+        lib = NULL;
+        return;
+    }
+    if (global_init) global_init(3); // CURL_GLOBAL_ALL
+    ox_curl = c;
+}
+
+int ox_curl_load(void)
+{
+    pthread_once(&once, load);
+    return lib ? 0 : -1;
+}
+
+void ox_curl_unload(void)
+{
+    /* waits for a load in progress */
+    pthread_once(&once, load);
+    if (lib) {
+        memset(&ox_curl, 0, sizeof(ox_curl));
+        dlclose(lib);
+        lib = NULL;
+    }
+}
@@ -0,0 +1,70 @@
+// curl_load.h - the one runtime-loaded libcurl shared by vk.c and stream.c
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* libcurl is dlopen'ed on first use so the player starts (and runs, minus the
+ * network) without it. Every module goes through ox_curl_load, so there is
+ * one handle and curl_global_init runs once, before any easy handle exists:
+ * curl_easy_init would do it lazily, but not thread-safely. */
+typedef void CURL;
+typedef void CURLM;
+typedef size_t (*ox_curl_data_cb)(char *, size_t, size_t, void *);
+
+struct ox_curl_msg {
+    int msg;            /* 1: CURLMSG_DONE */
+    CURL *easy_handle;
+    union { void *whatever; int result; } data;
+};
+
+typedef CURL *(*curl_easy_init_t)(void);
+typedef int (*curl_easy_setopt_t)(CURL *, int, ...);
+typedef int (*curl_easy_perform_t)(CURL *);
+typedef void (*curl_easy_cleanup_t)(CURL *);
+typedef int (*curl_easy_getinfo_t)(CURL *, int, ...);
+typedef void *(*curl_slist_append_t)(void *, const char *);
+typedef void (*curl_slist_free_all_t)(void *);
+typedef CURLM *(*curl_multi_init_t)(void);
+typedef int (*curl_multi_setopt_t)(CURLM *, int, ...);
+typedef int (*curl_multi_add_handle_t)(CURLM *, CURL *);
+typedef int (*curl_multi_remove_handle_t)(CURLM *, CURL *);
+typedef int (*curl_multi_perform_t)(CURLM *, int *);
+typedef int (*curl_multi_wait_t)(CURLM *, void *, unsigned, int, int *);
+typedef struct ox_curl_msg *(*curl_multi_info_read_t)(CURLM *, int *);
+typedef int (*curl_multi_cleanup_t)(CURLM *);
+
+struct ox_curl {
+    curl_easy_init_t easy_init;
+    curl_easy_setopt_t easy_setopt;
+    curl_easy_perform_t easy_perform;
+    curl_easy_cleanup_t easy_cleanup;
+    curl_easy_getinfo_t easy_getinfo;
+    curl_slist_append_t slist_append;
+    curl_slist_free_all_t slist_free_all;
+    /* multi interface, for the paged VK import */
+    curl_multi_init_t multi_init;
+    curl_multi_setopt_t multi_setopt;
+    curl_multi_add_handle_t multi_add_handle;
+    curl_multi_remove_handle_t multi_remove_handle;
+    curl_multi_perform_t multi_perform;
+    curl_multi_wait_t multi_wait;
+    curl_multi_info_read_t multi_info_read;
+    curl_multi_cleanup_t multi_cleanup;
+};
+
+/* Filled in by the first ox_curl_load that finds libcurl; all NULL otherwise. */
+extern struct ox_curl ox_curl;
+
+/* Load libcurl the first time any thread asks (the others wait for that
+ * load). 0, or -1 if it is missing, lacks a symbol or was unloaded. */
+int ox_curl_load(void);
+/* Unload at exit, once no request is running in any module; later loads fail. */
+void ox_curl_unload(void);
+
+#ifdef __cplusplus
+}
+#endif
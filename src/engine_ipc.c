@@ -0,0 +1,517 @@
+// engine_ipc.c - engine daemon <-> frontend IPC (see engine_ipc.h)
+// - one memfd, sealed against resizing before it is handed out, so a client
+//   can trust the size it maps; clients map it PROT_READ and cannot disturb
+//   the engine or each other
+// - the peak ring is multi-reader: the engine only publishes a count, each
+//   reader copies from its cursor and re-reads the count afterwards to drop
+//   what the engine may have overwritten meanwhile (as in trace.c)
+// - spectrum and state are whole-record snapshots under a sequence counter
+//   (odd while being written); readers retry on a torn copy
+// - the wakeup counter doubles as a shared futex word, so waiting costs no
+//   file descriptor and the engine needs no per-client bookkeeping for it
+// - memfd_create and futex through syscall(2): both are older than the
+//   libc wrappers, and the constants are declared here like font.c does
+// - the socket thread only parses lines and calls back; it never touches
+//   the shared memory
+
+#define _POSIX_C_SOURCE 200809L
+#include "engine_ipc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+#define SHM_MAGIC 0x4f58454eu /* "OXEN" */
+#define SHM_VERSION 1
+#define HELLO "oxxy-engine 1\n"
+
+struct shm {
+    uint32_t magic, version;
+    uint64_t size;
+    _Atomic uint32_t tick;          /* bumped on every publish; futex word */
+    _Atomic uint32_t spectrum_seq;  /* odd while written, 0: never */
+    _Atomic uint32_t state_seq;
+    _Atomic uint64_t peak_count;    /* peaks ever published */
+    float spectrum[OX_ENGINE_BANDS];
+    struct ox_engine_state state;
+    float peaks[OX_ENGINE_PEAKS];
+};
+
+struct conn {
+    int fd;
+    size_t len;
+    char buf[OX_ENGINE_LINE_MAX];
+};
+
+struct ox_engine_server {
+    struct shm *shm;
+    int memfd, listen_fd;
+    int wake[2];
+    char *path;
+    ox_engine_command_cb cb;
+    void *user;
+    pthread_t thread;
+    atomic_int stop;
+    atomic_size_t nclients;
+    struct conn conns[OX_ENGINE_MAX_CLIENTS];
+};
+
+struct ox_engine_client {
+    int fd;
+    const struct shm *shm;
+    size_t size;
+};
+
+char *ox_engine_default_socket(void)
+{
+    const char *env = getenv("OXXY_ENGINE");
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    char buf[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    if (env && *env && strcmp(env, "1") != 0) snprintf(buf, sizeof(buf), "%s", env);
+    else if (dir && *dir) snprintf(buf, sizeof(buf), "%s/oxxy-engine.sock", dir);
+    else snprintf(buf, sizeof(buf), "/tmp/oxxy-engine-%ld.sock", (long)getuid());
+    return strdup(buf);
+}
+
+static int unix_addr(const char *path, struct sockaddr_un *a)
+{
+    memset(a, 0, sizeof(*a));
+    a->sun_family = AF_UNIX;
+    if (!path || strlen(path) >= sizeof(a->sun_path)) return -1;
+    memcpy(a->sun_path, path, strlen(path) + 1);
+    return 0;
+}
+
+static void futex_wake_all(_Atomic uint32_t *word)
+{
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, 0x7fffffff, NULL, NULL, 0);
+}
+
+/* ---- engine side ---- */
+
+static void publish_tick(struct shm *m)
+{
+    atomic_fetch_add_explicit(&m->tick, 1, memory_order_release);
+    futex_wake_all(&m->tick);
+}
+
+void ox_engine_publish_peaks(struct ox_engine_server *s, const float *peaks, size_t n)
+{
+    struct shm *m = s->shm;
+    uint64_t count = atomic_load_explicit(&m->peak_count, memory_order_relaxed);
+    if (n > OX_ENGINE_PEAKS) {
+        peaks += n - OX_ENGINE_PEAKS;
+        count += n - OX_ENGINE_PEAKS;
+        n = OX_ENGINE_PEAKS;
+    }
+    for (size_t i = 0; i < n; ++i) m->peaks[(count + i) % OX_ENGINE_PEAKS] = peaks[i];
+    atomic_store_explicit(&m->peak_count, count + n, memory_order_release);
+    publish_tick(m);
+}
+
+static void seq_write(_Atomic uint32_t *seq, void *dst, const void *src, size_t len)
+{
+    uint32_t v = atomic_load_explicit(seq, memory_order_relaxed);
+    atomic_store_explicit(seq, v | 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(dst, src, len);
+    atomic_store_explicit(seq, (v | 1) + 1, memory_order_release);
+}
+
+void ox_engine_publish_spectrum(struct ox_engine_server *s, const float bands[OX_ENGINE_BANDS])
+{
+    seq_write(&s->shm->spectrum_seq, s->shm->spectrum, bands, sizeof(s->shm->spectrum));
+    publish_tick(s->shm);
+}
+
+void ox_engine_publish_state(struct ox_engine_server *s, const struct ox_engine_state *st)
+{
+    seq_write(&s->shm->state_seq, &s->shm->state, st, sizeof(*st));
+    publish_tick(s->shm);
+}
+
+static void drop_conn(struct ox_engine_server *s, struct conn *c)
+{
+    close(c->fd);
+    c->fd = -1;
+    c->len = 0;
+    atomic_fetch_sub(&s->nclients, 1);
+}
+
+static void send_hello(struct ox_engine_server *s, int fd)
+{
+    char ctl[CMSG_SPACE(sizeof(int))];
+    memset(ctl, 0, sizeof(ctl));
+    struct iovec iov = { (void *)HELLO, strlen(HELLO) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl;
+    msg.msg_controllen = sizeof(ctl);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cm), &s->memfd, sizeof(int));
+    sendmsg(fd, &msg, MSG_NOSIGNAL);
+}
+
+static void accept_conn(struct ox_engine_server *s)
+{
+    int fd = accept(s->listen_fd, NULL, NULL);
+    if (fd < 0) return;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    for (int i = 0; i < OX_ENGINE_MAX_CLIENTS; ++i) {
+        if (s->conns[i].fd < 0) {
+            s->conns[i].fd = fd;
+            s->conns[i].len = 0;
+            atomic_fetch_add(&s->nclients, 1);
+            send_hello(s, fd);
+            return;
+        }
+    }
+    close(fd); /* full */
+}
+
+int ox_engine_parse_number(const char *arg, double max, double *out)
+{
+    char *end;
+    double v = strtod(arg, &end);
+    while (*end == ' ') ++end;
+    if (end == arg || *end || !isfinite(v) || v < 0.0) return -1;
+    *out = v > max ? max : v;
+    return 0;
+}
+
+static int reply(int fd, const char *status, const char *text)
+{
+    char line[OX_ENGINE_LINE_MAX + 8];
+    int n = snprintf(line, sizeof(line), "%s%s%s\n", status, *text ? " " : "", text);
+    if (n < 0) return -1;
+    if ((size_t)n >= sizeof(line)) {
+        n = (int)sizeof(line) - 1;
+        line[n - 1] = '\n';
+    }
+    return send(fd, line, (size_t)n, MSG_NOSIGNAL) == n ? 0 : -1;
+}
+
+/* Run every complete line in c's buffer; -1 drops the client. */
+static int run_lines(struct ox_engine_server *s, struct conn *c)
+{
+    char *start = c->buf, *nl;
+    while ((nl = memchr(start, '\n', c->len - (size_t)(start - c->buf)))) {
+        *nl = '\0';
+        if (nl > start && nl[-1] == '\r') nl[-1] = '\0';
+        char *arg = strchr(start, ' ');
+        if (arg) *arg++ = '\0';
+        else arg = nl;
+        char text[OX_ENGINE_LINE_MAX] = "";
+        int rc = *start ? s->cb(s->user, start, arg, text, sizeof(text)) : -1;
+        if (!*start) snprintf(text, sizeof(text), "empty command");
+        if (reply(c->fd, rc == 0 ? "ok" : "err", text) != 0) return -1;
+        start = nl + 1;
+    }
+    c->len -= (size_t)(start - c->buf);
+    memmove(c->buf, start, c->len);
+    if (c->len == sizeof(c->buf)) {
+        reply(c->fd, "err", "line too long");
+        return -1;
+    }
+    return 0;
+}
+
+static void *server_main(void *arg)
+{
+    struct ox_engine_server *s = arg;
+    struct pollfd fds[OX_ENGINE_MAX_CLIENTS + 2];
+    while (!atomic_load(&s->stop)) {
+        fds[0] = (struct pollfd){ s->wake[0], POLLIN, 0 };
+        fds[1] = (struct pollfd){ s->listen_fd, POLLIN, 0 };
+        for (int i = 0; i < OX_ENGINE_MAX_CLIENTS; ++i) fds[i + 2] = (struct pollfd){ s->conns[i].fd, POLLIN, 0 };
+        if (poll(fds, OX_ENGINE_MAX_CLIENTS + 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN) accept_conn(s);
+        for (int i = 0; i < OX_ENGINE_MAX_CLIENTS; ++i) {
+            struct conn *c = &s->conns[i];
+            if (c->fd < 0 || fds[i + 2].fd != c->fd || !fds[i + 2].revents) continue;
+            ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                drop_conn(s, c);
+                continue;
+            }
+            c->len += (size_t)n;
+            if (run_lines(s, c) != 0) drop_conn(s, c);
+        }
+    }
+    return NULL;
+}
+
+/* An engine already answering at path? Else the file (if any) is stale. */
+static int path_in_use(const char *path)
+{
+    struct sockaddr_un a;
+    if (unix_addr(path, &a) != 0) return 0;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+    int live = connect(fd, (struct sockaddr *)&a, sizeof(a)) == 0;
+    close(fd);
+    return live;
+}
+
+struct ox_engine_server *ox_engine_server_create(const char *path, ox_engine_command_cb cb, void *user)
+{
+    struct sockaddr_un a;
+    if (!cb || unix_addr(path, &a) != 0 || path_in_use(path)) return NULL;
+    struct ox_engine_server *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->cb = cb;
+    s->user = user;
+    s->memfd = s->listen_fd = s->wake[0] = s->wake[1] = -1;
+    for (int i = 0; i < OX_ENGINE_MAX_CLIENTS; ++i) s->conns[i].fd = -1;
+    s->path = strdup(path);
+
+    s->memfd = (int)syscall(SYS_memfd_create, "oxxy-engine", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (!s->path || s->memfd < 0 || ftruncate(s->memfd, sizeof(struct shm)) != 0) goto fail;
+    fcntl(s->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+    s->shm = mmap(NULL, sizeof(struct shm), PROT_READ | PROT_WRITE, MAP_SHARED, s->memfd, 0);
+    if (s->shm == MAP_FAILED) {
+        s->shm = NULL;
+        goto fail;
+    }
+    s->shm->magic = SHM_MAGIC;
+    s->shm->version = SHM_VERSION;
+    s->shm->size = sizeof(struct shm);
+
+    unlink(path);
+    s->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s->listen_fd < 0) goto fail;
+    fcntl(s->listen_fd, F_SETFD, FD_CLOEXEC);
+    mode_t old = umask(077);
+    int bound = bind(s->listen_fd, (struct sockaddr *)&a, sizeof(a)) == 0;
+    umask(old);
+    if (!bound || listen(s->listen_fd, 8) != 0) goto fail;
+    if (pipe(s->wake) != 0) {
+        s->wake[0] = s->wake[1] = -1;
+        goto fail;
+    }
+    for (int i = 0; i < 2; ++i) fcntl(s->wake[i], F_SETFD, FD_CLOEXEC);
+    if (pthread_create(&s->thread, NULL, server_main, s) != 0) goto fail;
+    return s;
+
+fail:
+    if (s->listen_fd >= 0) {
+        close(s->listen_fd);
+        unlink(path);
+    }
+    if (s->wake[0] >= 0) close(s->wake[0]);
+    if (s->wake[1] >= 0) close(s->wake[1]);
+    if (s->shm) munmap(s->shm, sizeof(struct shm));
+    if (s->memfd >= 0) close(s->memfd);
+    free(s->path);
+    free(s);
+    return NULL;
+}
+
+void ox_engine_server_destroy(struct ox_engine_server *s)
+{
+    if (!s) return;
+    atomic_store(&s->stop, 1);
+    ssize_t r = write(s->wake[1], "", 1);
+    (void)r;
+    pthread_join(s->thread, NULL);
+    for (int i = 0; i < OX_ENGINE_MAX_CLIENTS; ++i)
+        if (s->conns[i].fd >= 0) drop_conn(s, &s->conns[i]);
+    close(s->listen_fd);
+    unlink(s->path);
+    close(s->wake[0]);
+    close(s->wake[1]);
+    munmap(s->shm, sizeof(struct shm));
+    close(s->memfd);
+    free(s->path);
+    free(s);
+}
+
+size_t ox_engine_server_clients(struct ox_engine_server *s)
+{
+    return atomic_load(&s->nclients);
+}
+
+/* ---- client side ---- */
+
+struct ox_engine_client *ox_engine_connect(const char *path)
+{
+    struct sockaddr_un a;
+    if (unix_addr(path, &a) != 0) return NULL;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return NULL;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (connect(fd, (struct sockaddr *)&a, sizeof(a)) != 0) {
+        close(fd);
+        return NULL;
+    }
+    char hello[sizeof(HELLO)] = "";
+    char ctl[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { hello, strlen(HELLO) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl;
+    msg.msg_controllen = sizeof(ctl);
+    int memfd = -1;
+    ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    for (struct cmsghdr *cm = n > 0 ? CMSG_FIRSTHDR(&msg) : NULL; cm; cm = CMSG_NXTHDR(&msg, cm))
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) memcpy(&memfd, CMSG_DATA(cm), sizeof(int));
+    struct stat st;
+    const struct shm *m = MAP_FAILED;
+    if (n == (ssize_t)strlen(HELLO) && memcmp(hello, HELLO, strlen(HELLO)) == 0 && memfd >= 0 &&
+        fstat(memfd, &st) == 0 && (size_t)st.st_size == sizeof(struct shm))
+        m = mmap(NULL, sizeof(struct shm), PROT_READ, MAP_SHARED, memfd, 0);
+    if (memfd >= 0) close(memfd);
+    if (m == MAP_FAILED || m->magic != SHM_MAGIC || m->version != SHM_VERSION) {
+        if (m != MAP_FAILED) munmap((void *)m, sizeof(struct shm));
+        close(fd);
+        return NULL;
+    }
+    struct ox_engine_client *c = calloc(1, sizeof(*c));
+    if (!c) {
+        munmap((void *)m, sizeof(struct shm));
+        close(fd);
+        return NULL;
+    }
+    c->fd = fd;
+    c->shm = m;
+    c->size = sizeof(struct shm);
+    return c;
+}
+
+void ox_engine_disconnect(struct ox_engine_client *c)
+{
+    if (!c) return;
+    munmap((void *)c->shm, c->size);
+    close(c->fd);
+    free(c);
+}
+
+int ox_engine_command(struct ox_engine_client *c, const char *line, char *reply_text, size_t reply_len)
+{
+    if (reply_text && reply_len) reply_text[0] = '\0';
+    size_t len = strlen(line);
+    if (len == 0 || len >= OX_ENGINE_LINE_MAX || memchr(line, '\n', len)) return -1;
+    char out[OX_ENGINE_LINE_MAX + 1];
+    memcpy(out, line, len);
+    out[len] = '\n';
+    if (send(c->fd, out, len + 1, MSG_NOSIGNAL) != (ssize_t)(len + 1)) return -1;
+    /* the engine sends nothing unasked, so everything up to '\n' is the answer */
+    char in[OX_ENGINE_LINE_MAX + 8];
+    size_t got = 0;
+    while (got == 0 || in[got - 1] != '\n') {
+        if (got == sizeof(in)) return -1;
+        ssize_t n = recv(c->fd, in + got, sizeof(in) - got, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        got += (size_t)n;
+    }
+    in[got - 1] = '\0';
+    int ok = strncmp(in, "ok", 2) == 0 && (in[2] == '\0' || in[2] == ' ');
+    const char *text = in + (ok ? 2 : strncmp(in, "err", 3) == 0 ? 3 : 0);
+    if (*text == ' ') ++text;
+    if (reply_text && reply_len) snprintf(reply_text, reply_len, "%s", text);
+    return ok ? 0 : -1;
+}
+
+size_t ox_engine_read_peaks(struct ox_engine_client *c, uint64_t *cursor, float *dest, size_t max)
+{
+    const struct shm *m = c->shm;
+    uint64_t count = atomic_load_explicit(&m->peak_count, memory_order_acquire);
+    uint64_t from = *cursor;
+    if (from > count) from = count; /* a cursor from another engine */
+    if (count - from > OX_ENGINE_PEAKS) from = count - OX_ENGINE_PEAKS;
+    size_t n = count - from < max ? (size_t)(count - from) : max;
+    for (size_t i = 0; i < n; ++i) dest[i] = m->peaks[(from + i) % OX_ENGINE_PEAKS];
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t after = atomic_load_explicit(&m->peak_count, memory_order_relaxed);
+    /* slots below after - N may have been rewritten while we copied */
+    uint64_t safe = after > OX_ENGINE_PEAKS ? after - OX_ENGINE_PEAKS : 0;
+    if (from < safe) {
+        size_t lost = safe - from < n ? (size_t)(safe - from) : n;
+        memmove(dest, dest + lost, (n - lost) * sizeof(float));
+        n -= lost;
+        from += lost;
+        if (n == 0) from = safe;
+    }
+    *cursor = from + n;
+    return n;
+}
+
+static int seq_read(const _Atomic uint32_t *seq, void *dst, const void *src, size_t len)
+{
+    for (int tries = 0; tries < 1000; ++tries) {
+        uint32_t before = atomic_load_explicit(seq, memory_order_acquire);
+        if (before == 0) return -1;
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(dst, src, len);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(seq, memory_order_relaxed) == before) return 0;
+    }
+    return -1;
+}
+
+int ox_engine_read_spectrum(struct ox_engine_client *c, float bands[OX_ENGINE_BANDS])
+{
+    return seq_read(&c->shm->spectrum_seq, bands, c->shm->spectrum, sizeof(c->shm->spectrum));
+}
+
+int ox_engine_read_state(struct ox_engine_client *c, struct ox_engine_state *out)
+{
+    if (seq_read(&c->shm->state_seq, out, &c->shm->state, sizeof(*out)) != 0) return -1;
+    out->uri[OX_ENGINE_URI_MAX - 1] = '\0';
+    return 0;
+}
+
+int ox_engine_wait(struct ox_engine_client *c, uint32_t *seen, int timeout_ms)
+{
+    _Atomic uint32_t *word = (_Atomic uint32_t *)&c->shm->tick;
+    uint32_t now = atomic_load_explicit(word, memory_order_acquire);
+    if (now == *seen) {
+        struct timespec ts = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L };
+        syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, *seen, timeout_ms < 0 ? NULL : &ts, NULL, 0);
+        now = atomic_load_explicit(word, memory_order_acquire);
+        if (now == *seen) return 0;
+    }
+    *seen = now;
+    return 1;
+}
@@ -0,0 +1,96 @@
+// engine_ipc.h - engine daemon <-> frontend IPC: shared memory plus a control socket
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The engine runs as a daemon (oxxy-test --daemon); UIs and the CLI attach
+ * to it and may come and go. Two channels:
+ *
+ * - bulk data lives in one memfd the engine writes and every client maps
+ *   read-only: a ring of the last OX_ENGINE_PEAKS waveform peaks (each
+ *   reader keeps its own cursor, the writer never waits for readers), the
+ *   latest spectrum and a state snapshot (both seqlocked). Nothing is copied
+ *   through the kernel per frame, however many clients are attached.
+ * - commands go over a unix stream socket, one text line each ("play",
+ *   "seek 12.5", "add /music/a.flac", ...), answered by a line starting
+ *   with "ok" or "err". The memfd is passed on connect (SCM_RIGHTS).
+ *
+ * Every publish bumps a counter in the shared memory that clients can block
+ * on (a futex), so an idle UI sleeps until the engine has something new.
+ */
+#define OX_ENGINE_PEAKS 65536
+#define OX_ENGINE_BANDS 32
+#define OX_ENGINE_URI_MAX 1024
+#define OX_ENGINE_MAX_CLIENTS 16
+#define OX_ENGINE_LINE_MAX (OX_ENGINE_URI_MAX + 64) /* a command or reply */
+
+struct ox_engine_state {
+    double position;  /* seconds into the current entry */
+    double length;    /* seconds, 0 if unknown */
+    float volume;     /* 0..1 */
+    int playing;
+    uint64_t index;   /* current playlist entry */
+    uint64_t count;   /* playlist entries */
+    char uri[OX_ENGINE_URI_MAX]; /* current entry, "" if none */
+};
+
+/* $OXXY_ENGINE when it is a path, else $XDG_RUNTIME_DIR/oxxy-engine.sock,
+ * else /tmp/oxxy-engine-<uid>.sock. malloc'd. */
+char *ox_engine_default_socket(void);
+
+/* ---- engine side ---- */
+
+/* Handle one command on the server thread. arg is "" when there is none.
+ * Write an optional reply text into reply; return 0 for "ok", -1 for "err". */
+typedef int (*ox_engine_command_cb)(void *user, const char *cmd, const char *arg, char *reply, size_t reply_len);
+
+/* The number argument of "seek" and "volume", clamped to max: 0, or -1 for
+ * anything but one finite, non-negative number (nan, inf, trailing text). */
+int ox_engine_parse_number(const char *arg, double max, double *out);
+
+struct ox_engine_server;
+
+/* Create the shared memory and listen on path (a stale socket file is
+ * replaced; a live engine there makes this fail). NULL on error. */
+struct ox_engine_server *ox_engine_server_create(const char *path, ox_engine_command_cb cb, void *user);
+/* Disconnects the clients and removes the socket file. Mappings the clients
+ * hold stay readable (frozen) until they detach. */
+void ox_engine_server_destroy(struct ox_engine_server *s);
+size_t ox_engine_server_clients(struct ox_engine_server *s);
+
+/* Publishers: peaks from one thread at a time; the others from any thread. */
+void ox_engine_publish_peaks(struct ox_engine_server *s, const float *peaks, size_t n);
+void ox_engine_publish_spectrum(struct ox_engine_server *s, const float bands[OX_ENGINE_BANDS]);
+void ox_engine_publish_state(struct ox_engine_server *s, const struct ox_engine_state *st);
+
+/* ---- client side ---- */
+
+struct ox_engine_client;
+
+/* NULL if no engine listens at path (or it speaks another version). */
+struct ox_engine_client *ox_engine_connect(const char *path);
+void ox_engine_disconnect(struct ox_engine_client *c);
+
+/* Send one command line and wait for the answer: 0 for "ok", -1 for "err"
+ * or a lost engine. reply (may be NULL) gets the text after ok / err. */
+int ox_engine_command(struct ox_engine_client *c, const char *line, char *reply, size_t reply_len);
+
+/* Peaks after *cursor (0: the oldest still kept), up to max; advances the
+ * cursor. A reader that fell more than OX_ENGINE_PEAKS behind skips ahead. */
+size_t ox_engine_read_peaks(struct ox_engine_client *c, uint64_t *cursor, float *dest, size_t max);
+/* Consistent copies of the latest snapshots: 0, or -1 if none yet. */
+int ox_engine_read_spectrum(struct ox_engine_client *c, float bands[OX_ENGINE_BANDS]);
+int ox_engine_read_state(struct ox_engine_client *c, struct ox_engine_state *out);
+
+/* Block until something is published after *seen (start from 0), at most
+ * timeout_ms (-1: no limit). 1 and *seen updated, or 0 on timeout. */
+int ox_engine_wait(struct ox_engine_client *c, uint32_t *seen, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
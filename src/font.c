@@ -0,0 +1,252 @@
+// font.c - glyph rasterization through dlopen'd FreeType, font lookup via fontconfig
+// - like image.c, the libraries are optional at runtime: without them the UI
+//   draws no text but otherwise works
+// - FreeType's handles point at public records whose leading members have
+//   kept their layout since 2.0; only those prefixes are declared here, so the
+//   development headers are not needed
+// - fontconfig is only asked for a file name, through opaque handles
+
+#define _POSIX_C_SOURCE 200809L
+#include "font.h"
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* FreeType */
+typedef struct { void *data; void (*finalizer)(void *); } ft_generic;
+typedef struct { long x, y; } ft_vector;
+typedef struct {
+    unsigned int rows, width;
+    int pitch;
+    unsigned char *buffer;
+    unsigned short num_grays;
+    unsigned char pixel_mode, palette_mode;
+    void *palette;
+} ft_bitmap;
+typedef struct { /* FT_GlyphSlotRec, up to bitmap_top */
+    void *library, *face, *next;
+    unsigned int glyph_index;
+    ft_generic generic;
+    long metrics[8];
+    long linear_hori_advance, linear_vert_advance;
+    ft_vector advance; /* 26.6 */
+    int format;
+    ft_bitmap bitmap;
+    int bitmap_left, bitmap_top;
+} ft_glyph_slot;
+typedef struct { /* FT_SizeRec, up to metrics */
+    void *face;
+    ft_generic generic;
+    unsigned short x_ppem, y_ppem;
+    long x_scale, y_scale;
+    long ascender, descender, height, max_advance; /* 26.6 */
+} ft_size;
+typedef struct { /* FT_FaceRec, up to size */
+    long num_faces, face_index, face_flags, style_flags, num_glyphs;
+    char *family_name, *style_name;
+    int num_fixed_sizes;
+    void *available_sizes;
+    int num_charmaps;
+    void *charmaps;
+    ft_generic generic;
+    long bbox[4];
+    unsigned short units_per_em;
+    short ascender, descender, height;
+    short max_advance_width, max_advance_height, underline_position, underline_thickness;
+    ft_glyph_slot *glyph;
+    ft_size *size;
+} ft_face_rec;
+typedef ft_face_rec *ft_face;
+typedef void *ft_library;
+#define FT_LOAD_RENDER 4
+#define FT_LOAD_NO_BITMAP 8
+#define FT_LOAD_TARGET_LIGHT 0x10000
+#define FT_PIXEL_MODE_GRAY 2
+typedef int (*ft_init_t)(ft_library *);
+typedef int (*ft_done_t)(ft_library);
+typedef int (*ft_new_face_t)(ft_library, const char *, long, ft_face *);
+typedef int (*ft_done_face_t)(ft_face);
+typedef int (*ft_set_pixel_sizes_t)(ft_face, unsigned int, unsigned int);
+typedef unsigned int (*ft_char_index_t)(ft_face, unsigned long);
+typedef int (*ft_load_glyph_t)(ft_face, unsigned int, int32_t);
+
+/* fontconfig */
+typedef void fc_config;
+typedef void fc_pattern;
+#define FC_MATCH_PATTERN 0
+#define FC_RESULT_MATCH 0
+typedef fc_config *(*fc_init_t)(void);
+typedef fc_pattern *(*fc_name_parse_t)(const unsigned char *);
+typedef int (*fc_substitute_t)(fc_config *, fc_pattern *, int);
+typedef void (*fc_default_substitute_t)(fc_pattern *);
+typedef fc_pattern *(*fc_match_t)(fc_config *, fc_pattern *, int *);
+typedef int (*fc_get_string_t)(const fc_pattern *, const char *, int, unsigned char **);
+typedef void (*fc_pattern_destroy_t)(fc_pattern *);
+typedef void (*fc_config_destroy_t)(fc_config *);
+
+static pthread_once_t libs_once = PTHREAD_ONCE_INIT;
+static ft_init_t p_ft_init;
+static ft_done_t p_ft_done;
+static ft_new_face_t p_ft_new_face;
+static ft_done_face_t p_ft_done_face;
+static ft_set_pixel_sizes_t p_ft_set_pixel_sizes;
+static ft_char_index_t p_ft_char_index;
+static ft_load_glyph_t p_ft_load_glyph;
+static fc_init_t p_fc_init;
+static fc_name_parse_t p_fc_name_parse;
+static fc_substitute_t p_fc_substitute;
+static fc_default_substitute_t p_fc_default_substitute;
+static fc_match_t p_fc_match;
+static fc_get_string_t p_fc_get_string;
+static fc_pattern_destroy_t p_fc_pattern_destroy;
+static fc_config_destroy_t p_fc_config_destroy;
+
+static void load_libs(void)
+{
+    void *ft = dlopen("libfreetype.so.6", RTLD_NOW | RTLD_LOCAL);
+    if (!ft) ft = dlopen("libfreetype.so", RTLD_NOW | RTLD_LOCAL);
+    if (ft) {
+        p_ft_init = (ft_init_t)dlsym(ft, "FT_Init_FreeType");
+        p_ft_done = (ft_done_t)dlsym(ft, "FT_Done_FreeType");
+        p_ft_new_face = (ft_new_face_t)dlsym(ft, "FT_New_Face");
+        p_ft_done_face = (ft_done_face_t)dlsym(ft, "FT_Done_Face");
+        p_ft_set_pixel_sizes = (ft_set_pixel_sizes_t)dlsym(ft, "FT_Set_Pixel_Sizes");
+        p_ft_char_index = (ft_char_index_t)dlsym(ft, "FT_Get_Char_Index");
+        p_ft_load_glyph = (ft_load_glyph_t)dlsym(ft, "FT_Load_Glyph");
+        if (!p_ft_init || !p_ft_done || !p_ft_new_face || !p_ft_done_face || !p_ft_set_pixel_sizes ||
+            !p_ft_char_index || !p_ft_load_glyph) {
+            p_ft_init = NULL;
+            dlclose(ft);
+        }
+    }
+    void *fc = dlopen("libfontconfig.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (!fc) fc = dlopen("libfontconfig.so", RTLD_NOW | RTLD_LOCAL);
+    if (fc) {
+        p_fc_init = (fc_init_t)dlsym(fc, "FcInitLoadConfigAndFonts");
+        p_fc_name_parse = (fc_name_parse_t)dlsym(fc, "FcNameParse");
+        p_fc_substitute = (fc_substitute_t)dlsym(fc, "FcConfigSubstitute");
+        p_fc_default_substitute = (fc_default_substitute_t)dlsym(fc, "FcDefaultSubstitute");
+        p_fc_match = (fc_match_t)dlsym(fc, "FcFontMatch");
+        p_fc_get_string = (fc_get_string_t)dlsym(fc, "FcPatternGetString");
+        p_fc_pattern_destroy = (fc_pattern_destroy_t)dlsym(fc, "FcPatternDestroy");
+        p_fc_config_destroy = (fc_config_destroy_t)dlsym(fc, "FcConfigDestroy");
+        if (!p_fc_init || !p_fc_name_parse || !p_fc_substitute || !p_fc_default_substitute || !p_fc_match ||
+            !p_fc_get_string || !p_fc_pattern_destroy || !p_fc_config_destroy) {
+            p_fc_init = NULL;
+            dlclose(fc);
+        }
+    }
+}
+
+static const char *const known_fonts[] = {
+    "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/TTF/DejaVuSans.ttf",
+    "/usr/share/fonts/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/truetype/noto/NotoSans-Regular.ttf",
+    "/usr/share/fonts/noto/NotoSans-Regular.ttf",
+    "/usr/share/fonts/truetype/liberation/LiberationSans-Regular.ttf",
+    "/usr/share/fonts/liberation/LiberationSans-Regular.ttf",
+};
+
+static char *fontconfig_match(const char *name)
+{
+    char *path = NULL;
+    fc_config *cfg = p_fc_init();
+    if (!cfg) return NULL;
+    fc_pattern *pat = p_fc_name_parse((const unsigned char *)name);
+    if (pat) {
+        p_fc_substitute(cfg, pat, FC_MATCH_PATTERN);
+        p_fc_default_substitute(pat);
+        int result = -1;
+        fc_pattern *m = p_fc_match(cfg, pat, &result);
+        unsigned char *file = NULL;
+        if (m && result == FC_RESULT_MATCH && p_fc_get_string(m, "file", 0, &file) == FC_RESULT_MATCH && file)
+            path = strdup((const char *)file);
+        if (m) p_fc_pattern_destroy(m);
+        p_fc_pattern_destroy(pat);
+    }
+    p_fc_config_destroy(cfg);
+    return path;
+}
+
+char *ox_font_default_path(void)
+{
+    const char *env = getenv("OXXY_FONT");
+    if (env && *env) return strdup(env);
+    pthread_once(&libs_once, load_libs);
+    if (p_fc_init) {
+        char *path = fontconfig_match("sans-serif");
+        if (path) return path;
+    }
+    for (size_t i = 0; i < sizeof(known_fonts) / sizeof(known_fonts[0]); ++i)
+        if (access(known_fonts[i], R_OK) == 0) return strdup(known_fonts[i]);
+    return NULL;
+}
+
+struct ox_font {
+    ft_library lib;
+    ft_face face;
+    struct ox_font_metrics metrics;
+};
+
+struct ox_font *ox_font_open(const char *path, int px)
+{
+    pthread_once(&libs_once, load_libs);
+    if (!p_ft_init || !path || px <= 0) return NULL;
+    struct ox_font *f = calloc(1, sizeof(*f));
+    if (!f) return NULL;
+    if (p_ft_init(&f->lib) != 0) {
+        free(f);
+        return NULL;
+    }
+    if (p_ft_new_face(f->lib, path, 0, &f->face) != 0) {
+        p_ft_done(f->lib);
+        free(f);
+        return NULL;
+    }
+    if (p_ft_set_pixel_sizes(f->face, 0, (unsigned)px) != 0 || !f->face->size) {
+        ox_font_close(f);
+        return NULL;
+    }
+    const ft_size *s = f->face->size;
+    f->metrics.ascent = (int)((s->ascender + 63) >> 6);
+    f->metrics.descent = (int)((-s->descender + 63) >> 6);
+    f->metrics.line_height = (int)((s->height + 63) >> 6);
+    if (f->metrics.line_height < f->metrics.ascent + f->metrics.descent)
+        f->metrics.line_height = f->metrics.ascent + f->metrics.descent;
+    return f;
+}
+
+void ox_font_close(struct ox_font *f)
+{
+    if (!f) return;
+    if (f->face) p_ft_done_face(f->face);
+    p_ft_done(f->lib);
+    free(f);
+}
+
+void ox_font_metrics(const struct ox_font *f, struct ox_font_metrics *out)
+{
+    *out = f->metrics;
+}
+
+int ox_font_glyph(struct ox_font *f, uint32_t cp, struct ox_glyph *out)
+{
+    memset(out, 0, sizeof(*out));
+    unsigned int idx = p_ft_char_index(f->face, cp);
+    if (idx == 0) return -1;
+    if (p_ft_load_glyph(f->face, idx, FT_LOAD_RENDER | FT_LOAD_NO_BITMAP | FT_LOAD_TARGET_LIGHT) != 0) return -1;
+    const ft_glyph_slot *g = f->face->glyph;
+    out->advance = (int)((g->advance.x + 32) >> 6);
+    if (g->bitmap.buffer && g->bitmap.pixel_mode == FT_PIXEL_MODE_GRAY && g->bitmap.pitch > 0) {
+        out->w = (int)g->bitmap.width;
+        out->h = (int)g->bitmap.rows;
+        out->pitch = g->bitmap.pitch;
+        out->coverage = g->bitmap.buffer;
+        out->left = g->bitmap_left;
+        out->top = g->bitmap_top;
+    }
+    return 0;
+}
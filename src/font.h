@@ -0,0 +1,36 @@
+// font.h - glyph rasterization through a runtime-loaded FreeType
+#pragma once
+
+#include <stdint.h>
+
+/* A font file at one pixel size. Glyphs are rendered as 8-bit coverage with
+ * light hinting. Each font has its own FreeType instance, so different fonts
+ * may be used from different threads; one font is not thread-safe.
+ */
+struct ox_font;
+
+/* $OXXY_FONT, else fontconfig's match for "sans-serif", else the first of a
+ * few well-known sans-serif paths that exists. malloc'd path or NULL. */
+char *ox_font_default_path(void);
+
+/* NULL if libfreetype cannot be loaded or path is not a usable font. */
+struct ox_font *ox_font_open(const char *path, int px);
+void ox_font_close(struct ox_font *f);
+
+struct ox_font_metrics {
+    int ascent;      /* pixels above the baseline */
+    int descent;     /* pixels below it (positive) */
+    int line_height; /* baseline to baseline */
+};
+void ox_font_metrics(const struct ox_font *f, struct ox_font_metrics *out);
+
+struct ox_glyph {
+    int w, h;            /* bitmap size; 0 x 0 for blank glyphs (space) */
+    int left, top;       /* bitmap origin relative to the pen: right, up */
+    int advance;         /* pen advance in pixels */
+    int pitch;           /* bytes per bitmap row */
+    const unsigned char *coverage; /* valid until the next ox_font_glyph call */
+};
+
+/* Render code point cp. Returns 0, or -1 if the font has no glyph for it. */
+int ox_font_glyph(struct ox_font *f, uint32_t cp, struct ox_glyph *out);
@@ -0,0 +1,194 @@
+// image.c - JPEG/PNG decoding through dlopen'd libturbojpeg and libpng16
+// - like vk.c, the libraries are optional at runtime: without them covers are
+//   simply not decoded and the UI keeps its placeholder
+// - both APIs used here (TurboJPEG handles, libpng's "simplified" png_image)
+//   are small and ABI-stable, so they are declared locally instead of
+//   depending on the development headers
+
+#define _POSIX_C_SOURCE 200809L
+#include "image.h"
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_MAX_DIM 8192
+
+/* TurboJPEG */
+typedef void *tjhandle;
+typedef struct { int num, denom; } tjscalingfactor;
+#define TJPF_RGBA 7
+#define TJFLAG_FASTUPSAMPLE 256
+#define TJFLAG_FASTDCT 2048
+typedef tjhandle (*tj_init_t)(void);
+typedef int (*tj_header_t)(tjhandle, const unsigned char *, unsigned long, int *, int *, int *, int *);
+typedef int (*tj_decompress_t)(tjhandle, const unsigned char *, unsigned long, unsigned char *, int, int, int, int, int);
+typedef tjscalingfactor *(*tj_factors_t)(int *);
+typedef int (*tj_destroy_t)(tjhandle);
+
+/* libpng simplified API */
+typedef struct {
+    void *opaque;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t flags;
+    uint32_t colormap_entries;
+    uint32_t warning_or_error;
+    char message[64];
+} png_image;
+#define PNG_IMAGE_VERSION 1
+#define PNG_FORMAT_RGBA 3
+typedef int (*png_begin_t)(png_image *, const void *, size_t);
+typedef int (*png_finish_t)(png_image *, const void *, void *, int32_t, void *);
+typedef void (*png_free_t)(png_image *);
+
+static pthread_once_t libs_once = PTHREAD_ONCE_INIT;
+static tj_init_t p_tj_init;
+static tj_header_t p_tj_header;
+static tj_decompress_t p_tj_decompress;
+static tj_factors_t p_tj_factors;
+static tj_destroy_t p_tj_destroy;
+static png_begin_t p_png_begin;
+static png_finish_t p_png_finish;
+static png_free_t p_png_free;
+
+static void load_libs(void)
+{
+    void *tj = dlopen("libturbojpeg.so.0", RTLD_NOW | RTLD_LOCAL);
+    if (!tj) tj = dlopen("libturbojpeg.so", RTLD_NOW | RTLD_LOCAL);
+    if (tj) {
+        p_tj_init = (tj_init_t)dlsym(tj, "tjInitDecompress");
+        p_tj_header = (tj_header_t)dlsym(tj, "tjDecompressHeader3");
+        p_tj_decompress = (tj_decompress_t)dlsym(tj, "tjDecompress2");
+        p_tj_factors = (tj_factors_t)dlsym(tj, "tjGetScalingFactors");
+        p_tj_destroy = (tj_destroy_t)dlsym(tj, "tjDestroy");
+        if (!p_tj_init || !p_tj_header || !p_tj_decompress || !p_tj_factors || !p_tj_destroy) {
+            p_tj_init = NULL;
+            dlclose(tj);
+        }
+    }
+    void *png = dlopen("libpng16.so.16", RTLD_NOW | RTLD_LOCAL);
+    if (!png) png = dlopen("libpng16.so", RTLD_NOW | RTLD_LOCAL);
+    if (png) {
+        p_png_begin = (png_begin_t)dlsym(png, "png_image_begin_read_from_memory");
+        p_png_finish = (png_finish_t)dlsym(png, "png_image_finish_read");
+        p_png_free = (png_free_t)dlsym(png, "png_image_free");
+        if (!p_png_begin || !p_png_finish || !p_png_free) {
+            p_png_begin = NULL;
+            dlclose(png);
+        }
+    }
+}
+
+static int is_jpeg(const unsigned char *d, size_t n) { return n >= 3 && d[0] == 0xFF && d[1] == 0xD8 && d[2] == 0xFF; }
+static int is_png(const unsigned char *d, size_t n) { return n >= 8 && memcmp(d, "\x89PNG\r\n\x1a\n", 8) == 0; }
+
+int ox_image_can_decode(const unsigned char *data, size_t len)
+{
+    pthread_once(&libs_once, load_libs);
+    if (is_jpeg(data, len)) return p_tj_init != NULL;
+    if (is_png(data, len)) return p_png_begin != NULL;
+    return 0;
+}
+
+static int decode_jpeg(const unsigned char *data, size_t len, int min_dim, struct ox_image *out)
+{
+    tjhandle tj = p_tj_init();
+    if (!tj) return -1;
+    int w, h, sub, cs, rc = -1;
+    if (p_tj_header(tj, data, (unsigned long)len, &w, &h, &sub, &cs) == 0 && w > 0 && h > 0 &&
+        w <= IMAGE_MAX_DIM && h <= IMAGE_MAX_DIM) {
+        /* smallest DCT scaling factor that keeps both sides >= min_dim */
+        int nf = 0, sw = w, sh = h;
+        tjscalingfactor *f = min_dim > 0 ? p_tj_factors(&nf) : NULL;
+        for (int i = 0; f && i < nf; ++i) {
+            int fw = (w * f[i].num + f[i].denom - 1) / f[i].denom;
+            int fh = (h * f[i].num + f[i].denom - 1) / f[i].denom;
+            if (fw >= min_dim && fh >= min_dim && (long)fw * fh < (long)sw * sh) { sw = fw; sh = fh; }
+        }
+        out->rgba = malloc((size_t)sw * sh * 4);
+        if (out->rgba && p_tj_decompress(tj, data, (unsigned long)len, out->rgba, sw, sw * 4, sh, TJPF_RGBA,
+                                         TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) == 0) {
+            out->w = sw;
+            out->h = sh;
+            rc = 0;
+        } else {
+            free(out->rgba);
+            out->rgba = NULL;
+        }
+    }
+    p_tj_destroy(tj);
+    return rc;
+}
+
+static int decode_png(const unsigned char *data, size_t len, struct ox_image *out)
+{
+    png_image img;
+    memset(&img, 0, sizeof(img));
+    img.version = PNG_IMAGE_VERSION;
+    if (!p_png_begin(&img, data, len)) return -1;
+    if (img.width == 0 || img.height == 0 || img.width > IMAGE_MAX_DIM || img.height > IMAGE_MAX_DIM) {
+        p_png_free(&img);
+        return -1;
+    }
+    img.format = PNG_FORMAT_RGBA;
+    out->rgba = malloc((size_t)img.width * img.height * 4);
+    if (!out->rgba || !p_png_finish(&img, NULL, out->rgba, 0, NULL)) {
+        p_png_free(&img);
+        free(out->rgba);
+        out->rgba = NULL;
+        return -1;
+    }
+    out->w = (int)img.width;
+    out->h = (int)img.height;
+    p_png_free(&img);
+    return 0;
+}
+
+int ox_image_decode(const unsigned char *data, size_t len, int min_dim, struct ox_image *out)
+{
+    if (!data || !out) return -1;
+    memset(out, 0, sizeof(*out));
+    if (!ox_image_can_decode(data, len)) return -1;
+    return is_jpeg(data, len) ? decode_jpeg(data, len, min_dim, out) : decode_png(data, len, out);
+}
+
+int ox_image_thumbnail(const struct ox_image *src, int size, struct ox_image *out)
+{
+    if (!src || !src->rgba || !out || size <= 0) return -1;
+    int side = src->w < src->h ? src->w : src->h;
+    int x0 = (src->w - side) / 2, y0 = (src->h - side) / 2;
+    out->rgba = malloc((size_t)size * size * 4);
+    if (!out->rgba) return -1;
+    out->w = out->h = size;
+    /* each output pixel averages the source rectangle it covers (nearest when upscaling) */
+    for (int y = 0; y < size; ++y) {
+        int sy0 = y0 + (int)((long)y * side / size), sy1 = y0 + (int)((long)(y + 1) * side / size);
+        if (sy1 <= sy0) sy1 = sy0 + 1;
+        for (int x = 0; x < size; ++x) {
+            int sx0 = x0 + (int)((long)x * side / size), sx1 = x0 + (int)((long)(x + 1) * side / size);
+            if (sx1 <= sx0) sx1 = sx0 + 1;
+            uint32_t acc[4] = { 0, 0, 0, 0 };
+            for (int sy = sy0; sy < sy1; ++sy) {
+                const unsigned char *p = src->rgba + ((size_t)sy * src->w + sx0) * 4;
+                for (int sx = sx0; sx < sx1; ++sx, p += 4) {
+                    acc[0] += p[0]; acc[1] += p[1]; acc[2] += p[2]; acc[3] += p[3];
+                }
+            }
+            uint32_t n = (uint32_t)((sy1 - sy0) * (sx1 - sx0));
+            unsigned char *d = out->rgba + ((size_t)y * size + x) * 4;
+            for (int c = 0; c < 4; ++c) d[c] = (unsigned char)((acc[c] + n / 2) / n);
+        }
+    }
+    return 0;
+}
+
+void ox_image_free(struct ox_image *img)
+{
+    if (!img) return;
+    free(img->rgba);
+    img->rgba = NULL;
+    img->w = img->h = 0;
+}
@@ -0,0 +1,24 @@
+// image.h - cover image decoding (JPEG/PNG via runtime-detected libraries) and downscaling
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ox_image {
+    int w, h;
+    unsigned char *rgba; /* w * h * 4, malloc'd */
+};
+
+/* 1 if a decoder for this kind of data could be loaded (libturbojpeg / libpng16). */
+int ox_image_can_decode(const unsigned char *data, size_t len);
+
+/* Decode JPEG or PNG into RGBA. JPEGs are decoded with DCT scaling to the
+ * smallest size that still covers min_dim x min_dim (0: full size), which is
+ * much cheaper than decoding at full resolution. Returns 0 on success.
+ */
+int ox_image_decode(const unsigned char *data, size_t len, int min_dim, struct ox_image *out);
+
+/* Area-average downscale of the centred square crop of src to size x size. */
+int ox_image_thumbnail(const struct ox_image *src, int size, struct ox_image *out);
+
+void ox_image_free(struct ox_image *img);
@@ -0,0 +1,214 @@
+// io_batch.c - batched file reads
+// - io_uring is driven through raw syscalls (no liburing dependency)
+// - any setup failure or per-request -EINVAL (pre-5.6 kernels lack IORING_OP_READ)
+//   falls back to pread, so callers never need to care which path ran
+
+#define _POSIX_C_SOURCE 200809L
+#include "io_batch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define OX_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef OX_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+struct ox_io_batch {
+    unsigned depth;
+    int ring_fd; /* -1: pread path */
+#ifdef OX_HAVE_IO_URING
+    void *sq_ptr, *cq_ptr;
+    size_t sq_sz, cq_sz;
+    struct io_uring_sqe *sqes;
+    size_t sqes_sz;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+#endif
+};
+
+static void read_sync(struct ox_read_req *r)
+{
+    size_t done = 0;
+    while (done < r->len) {
+        ssize_t n = pread(r->fd, (char *)r->buf + done, r->len - done, (off_t)(r->off + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            r->res = done ? (ssize_t)done : -errno;
+            return;
+        }
+        if (n == 0) break;
+        done += (size_t)n;
+    }
+    r->res = (ssize_t)done;
+}
+
+#ifdef OX_HAVE_IO_URING
+static int uring_setup(struct ox_io_batch *b)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, b->depth, &p);
+    if (fd < 0) return -1;
+    b->sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    b->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) { if (b->cq_sz > b->sq_sz) b->sq_sz = b->cq_sz; b->cq_sz = b->sq_sz; }
+    b->sq_ptr = mmap(NULL, b->sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQ_RING);
+    if (b->sq_ptr == MAP_FAILED) { close(fd); return -1; }
+    if (single) {
+        b->cq_ptr = b->sq_ptr;
+    } else {
+        b->cq_ptr = mmap(NULL, b->cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_CQ_RING);
+        if (b->cq_ptr == MAP_FAILED) { munmap(b->sq_ptr, b->sq_sz); close(fd); return -1; }
+    }
+    b->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    b->sqes = mmap(NULL, b->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQES);
+    if (b->sqes == MAP_FAILED) {
+        if (!single) munmap(b->cq_ptr, b->cq_sz);
+        munmap(b->sq_ptr, b->sq_sz);
+        close(fd);
+        return -1;
+    }
+    char *sq = b->sq_ptr, *cq = b->cq_ptr;
+    b->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    b->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    b->sq_array = (unsigned *)(sq + p.sq_off.array);
+    b->cq_head = (unsigned *)(cq + p.cq_off.head);
+    b->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    b->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    b->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    if (p.sq_entries < b->depth) b->depth = p.sq_entries;
+    b->ring_fd = fd;
+    return 0;
+}
+
+static void uring_teardown(struct ox_io_batch *b)
+{
+    munmap(b->sqes, b->sqes_sz);
+    if (b->cq_ptr != b->sq_ptr) munmap(b->cq_ptr, b->cq_sz);
+    munmap(b->sq_ptr, b->sq_sz);
+    close(b->ring_fd);
+    b->ring_fd = -1;
+}
+
+static unsigned uring_reap(struct ox_io_batch *b, struct ox_read_req *reqs, unsigned n)
+{
+    unsigned head = *b->cq_head, reaped = 0;
+    unsigned ctail = __atomic_load_n(b->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != ctail) {
+        struct io_uring_cqe *cqe = &b->cqes[head & *b->cq_mask];
+        if (cqe->user_data < n) reqs[cqe->user_data].res = cqe->res;
+        head++; reaped++;
+    }
+    __atomic_store_n(b->cq_head, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+static int uring_read(struct ox_io_batch *b, struct ox_read_req *reqs, unsigned n)
+{
+    unsigned tail = *b->sq_tail;
+    unsigned mask = *b->sq_mask;
+    for (unsigned i = 0; i < n; ++i) {
+        unsigned idx = tail & mask;
+        struct io_uring_sqe *sqe = &b->sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = reqs[i].fd;
+        sqe->addr = (uint64_t)(uintptr_t)reqs[i].buf;
+        sqe->len = (uint32_t)reqs[i].len;
+        sqe->off = reqs[i].off;
+        sqe->user_data = i;
+        b->sq_array[idx] = idx;
+        reqs[i].res = -EINPROGRESS;
+        tail++;
+    }
+    __atomic_store_n(b->sq_tail, tail, __ATOMIC_RELEASE);
+
+    /* A failed enter leaves whatever was already submitted in flight, still
+     * writing into the callers' buffers: those are reaped (sleeping between
+     * tries, completions land in the CQ ring regardless) before the ring goes
+     * and the rest is read synchronously. */
+    unsigned to_submit = n, reaped = 0;
+    int broken = 0;
+    while (broken ? reaped < n - to_submit : reaped < n) {
+        unsigned submit = broken ? 0 : to_submit;
+        unsigned wait = broken ? n - to_submit - reaped : n - reaped;
+        int rc = (int)syscall(__NR_io_uring_enter, b->ring_fd, submit, wait, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (rc < 0 && errno != EINTR) {
+            if (broken) nanosleep(&(struct timespec){ 0, 1000000 }, NULL);
+            broken = 1;
+        } else if (rc > 0) {
+            to_submit -= (unsigned)rc < to_submit ? (unsigned)rc : to_submit;
+        }
+        reaped += uring_reap(b, reqs, n);
+    }
+    if (broken) {
+        uring_teardown(b);
+        if (to_submit == n) return -1;
+    }
+    /* unsupported opcode (pre-5.6 kernel) or anything left pending: redo synchronously */
+    unsigned einval = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        if (reqs[i].res == -EINVAL) einval++;
+        if (reqs[i].res == -EINVAL || reqs[i].res == -EINPROGRESS || reqs[i].res == -EAGAIN) read_sync(&reqs[i]);
+    }
+    if (einval == n && b->ring_fd >= 0) uring_teardown(b); /* kernel has no IORING_OP_READ */
+    return 0;
+}
+#endif
+
+struct ox_io_batch *ox_io_batch_create(unsigned depth, int allow_uring)
+{
+    struct ox_io_batch *b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+    b->depth = depth ? depth : 1;
+    b->ring_fd = -1;
+#ifdef OX_HAVE_IO_URING
+    if (allow_uring) uring_setup(b);
+#else
+    (void)allow_uring;
+#endif
+    return b;
+}
+
+void ox_io_batch_destroy(struct ox_io_batch *b)
+{
+    if (!b) return;
+#ifdef OX_HAVE_IO_URING
+    if (b->ring_fd >= 0) uring_teardown(b);
+#endif
+    free(b);
+}
+
+int ox_io_batch_is_async(const struct ox_io_batch *b)
+{
+    return b && b->ring_fd >= 0;
+}
+
+int ox_io_batch_read(struct ox_io_batch *b, struct ox_read_req *reqs, unsigned n)
+{
+    if (!b || (!reqs && n)) return -1;
+    while (n > 0) {
+        unsigned chunk = n < b->depth ? n : b->depth;
+#ifdef OX_HAVE_IO_URING
+        if (b->ring_fd >= 0 && uring_read(b, reqs, chunk) == 0) {
+            reqs += chunk; n -= chunk;
+            continue;
+        }
+#endif
+        for (unsigned i = 0; i < chunk; ++i) read_sync(&reqs[i]);
+        reqs += chunk; n -= chunk;
+    }
+    return 0;
+}
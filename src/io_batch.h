@@ -0,0 +1,31 @@
+// io_batch.h - batched file reads: io_uring when the kernel allows it, pread otherwise
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct ox_read_req {
+    int fd;
+    void *buf;
+    size_t len;
+    uint64_t off;
+    ssize_t res; /* out: bytes read or -errno */
+};
+
+struct ox_io_batch;
+
+/* Create a reader for batches of up to `depth` requests. Never returns NULL on
+ * allocation success: if io_uring is unavailable (old kernel, seccomp, disabled)
+ * the reader silently uses pread. Returns NULL only on allocation failure.
+ */
+struct ox_io_batch *ox_io_batch_create(unsigned depth, int allow_uring);
+void ox_io_batch_destroy(struct ox_io_batch *b);
+
+/* 1 if requests go through io_uring. */
+int ox_io_batch_is_async(const struct ox_io_batch *b);
+
+/* Issue all n requests (n <= depth) and wait for every completion. Returns 0,
+ * or -1 if the batch could not be submitted at all (each req->res is set either way).
+ */
+int ox_io_batch_read(struct ox_io_batch *b, struct ox_read_req *reqs, unsigned n);
@@ -0,0 +1,688 @@
+// json.c - push tokenizer (SAX) and a small DOM built on it
+// - one state machine over arbitrary chunks: a token cut by a chunk boundary
+//   continues in the next feed, so network bodies parse as they arrive and
+//   memory stays bounded by the longest single string, not the document
+// - string bodies, the bulk of VK responses, are copied in runs found 16
+//   bytes at a time (quote, backslash or control byte); whitespace between
+//   tokens is skipped the same way
+// - escapes are decoded on the fly, \u pairs to UTF-8; a lone surrogate
+//   becomes U+FFFD rather than failing a whole import on one bad title
+// - the DOM is for kilobyte-sized config blobs only: malloc per node, member
+//   lists in document order, compact writer with full escaping
+
+#define _POSIX_C_SOURCE 200809L
+#include "json.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum state {
+    ST_VALUE,          /* a value must follow */
+    ST_VALUE_OR_END,   /* after '[' */
+    ST_KEY_OR_END,     /* after '{' */
+    ST_KEY,            /* after ',' in an object */
+    ST_COLON,
+    ST_AFTER_VALUE,    /* ',' or the container's close */
+    ST_STRING,
+    ST_ESCAPE,
+    ST_UNICODE,
+    ST_NUMBER,
+    ST_LITERAL,
+    ST_DONE,
+    ST_ERROR
+};
+
+struct ox_json_parser {
+    ox_json_cb cb;
+    void *user;
+    enum state state;
+    int in_key;
+    int depth;
+    char stack[OX_JSON_MAX_DEPTH];  /* '{' or '[' */
+    char *buf;                      /* current string or number */
+    size_t len, cap;
+    unsigned hex, nhex;             /* \uXXXX in progress */
+    unsigned high;                  /* pending high surrogate */
+    const char *lit;                /* literal being matched and its event */
+    unsigned lit_pos;
+    enum ox_json_event lit_ev;
+    size_t offset;                  /* bytes consumed before this feed */
+    size_t err_at;
+};
+
+struct ox_json_parser *ox_json_parser_create(ox_json_cb cb, void *user)
+{
+    struct ox_json_parser *p = calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    p->cb = cb;
+    p->user = user;
+    p->state = ST_VALUE;
+    return p;
+}
+
+void ox_json_parser_destroy(struct ox_json_parser *p)
+{
+    if (!p) return;
+    free(p->buf);
+    free(p);
+}
+
+size_t ox_json_offset(const struct ox_json_parser *p)
+{
+    return p->err_at;
+}
+
+static int reserve(struct ox_json_parser *p, size_t more)
+{
+    if (p->len + more < p->cap) return 0;
+    size_t cap = p->cap ? p->cap : 256;
+    while (cap <= p->len + more) cap *= 2;
+    char *b = realloc(p->buf, cap);
+    if (!b) return -1;
+    p->buf = b;
+    p->cap = cap;
+    return 0;
+}
+
+static int append(struct ox_json_parser *p, const char *s, size_t n)
+{
+    if (reserve(p, n) != 0) return -1;
+    memcpy(p->buf + p->len, s, n);
+    p->len += n;
+    return 0;
+}
+
+static int put_utf8(struct ox_json_parser *p, unsigned cp)
+{
+    char u[4];
+    size_t n;
+    if (cp < 0x80) {
+        u[0] = (char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        u[0] = (char)(0xC0 | cp >> 6);
+        u[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        u[0] = (char)(0xE0 | cp >> 12);
+        u[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+        u[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        u[0] = (char)(0xF0 | cp >> 18);
+        u[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+        u[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+        u[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    return append(p, u, n);
+}
+
+/* a high surrogate not followed by its low half */
+static int flush_high(struct ox_json_parser *p)
+{
+    if (!p->high) return 0;
+    p->high = 0;
+    return put_utf8(p, 0xFFFD);
+}
+
+/* first quote, backslash or control byte in [s, e), or e */
+static const char *scan_string(const char *s, const char *e)
+{
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"'), bslash = _mm_set1_epi8('\\'), ctl = _mm_set1_epi8(0x1F);
+    for (; e - s >= 16; s += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)s);
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+                                 _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v)); /* v <= 0x1F unsigned */
+        unsigned mask = (unsigned)_mm_movemask_epi8(m);
+        if (mask) return s + __builtin_ctz(mask);
+    }
+#endif
+    for (; s < e; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\' || c < 0x20) break;
+    }
+    return s;
+}
+
+static int is_ws(unsigned char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/* first non-whitespace byte in [s, e), or e */
+static const char *skip_ws(const char *s, const char *e)
+{
+    /* compact JSON: usually no whitespace at all */
+    if (s < e && !is_ws((unsigned char)*s)) return s;
+#if defined(__SSE2__)
+    const __m128i sp = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r'), tab = _mm_set1_epi8('\t');
+    for (; e - s >= 16; s += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)s);
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, nl)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tab)));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(m) & 0xFFFF;
+        if (mask) return s + __builtin_ctz(mask);
+    }
+#endif
+    while (s < e && is_ws((unsigned char)*s)) ++s;
+    return s;
+}
+
+/* byte for a one-character escape, 0 if there is none */
+static char unescape(char c)
+{
+    switch (c) {
+    case '"': return '"';
+    case '\\': return '\\';
+    case '/': return '/';
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 't': return '\t';
+    default: return 0;
+    }
+}
+
+/* -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? */
+static int valid_number(const char *s, size_t n)
+{
+    const char *e = s + n;
+    if (s < e && *s == '-') ++s;
+    if (s == e) return 0;
+    if (*s == '0') {
+        ++s;
+    } else if (*s >= '1' && *s <= '9') {
+        while (s < e && *s >= '0' && *s <= '9') ++s;
+    } else {
+        return 0;
+    }
+    if (s < e && *s == '.') {
+        const char *d = ++s;
+        while (s < e && *s >= '0' && *s <= '9') ++s;
+        if (s == d) return 0;
+    }
+    if (s < e && (*s == 'e' || *s == 'E')) {
+        ++s;
+        if (s < e && (*s == '+' || *s == '-')) ++s;
+        const char *d = s;
+        while (s < e && *s >= '0' && *s <= '9') ++s;
+        if (s == d) return 0;
+    }
+    return s == e;
+}
+
+/* deliver buf as ev; 0, 1 (stopped) or -1 */
+static int emit_buf(struct ox_json_parser *p, enum ox_json_event ev)
+{
+    if (reserve(p, 1) != 0) return -1;
+    p->buf[p->len] = '\0';
+    int stop = p->cb(p->user, ev, p->buf, p->len, p->depth);
+    p->len = 0;
+    return stop ? 1 : 0;
+}
+
+static void value_done(struct ox_json_parser *p)
+{
+    p->state = p->depth ? ST_AFTER_VALUE : ST_DONE;
+}
+
+static int open_container(struct ox_json_parser *p, char c)
+{
+    if (p->depth == OX_JSON_MAX_DEPTH) return -1;
+    int stop = p->cb(p->user, c == '{' ? OX_JSON_OBJECT_BEGIN : OX_JSON_ARRAY_BEGIN, NULL, 0, p->depth);
+    p->stack[p->depth++] = c;
+    p->state = c == '{' ? ST_KEY_OR_END : ST_VALUE_OR_END;
+    return stop ? 1 : 0;
+}
+
+static int close_container(struct ox_json_parser *p)
+{
+    char c = p->stack[--p->depth];
+    value_done(p);
+    return p->cb(p->user, c == '{' ? OX_JSON_OBJECT_END : OX_JSON_ARRAY_END, NULL, 0, p->depth) ? 1 : 0;
+}
+
+/* start of any value at *s */
+static int begin_value(struct ox_json_parser *p, char c)
+{
+    switch (c) {
+    case '{':
+    case '[':
+        return open_container(p, c);
+    case '"':
+        p->in_key = 0;
+        p->state = ST_STRING;
+        return 0;
+    case 't':
+        p->lit = "true";
+        p->lit_ev = OX_JSON_TRUE;
+        break;
+    case 'f':
+        p->lit = "false";
+        p->lit_ev = OX_JSON_FALSE;
+        break;
+    case 'n':
+        p->lit = "null";
+        p->lit_ev = OX_JSON_NULL;
+        break;
+    default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            p->state = ST_NUMBER;
+            return append(p, &c, 1);
+        }
+        return -1;
+    }
+    p->lit_pos = 1;
+    p->state = ST_LITERAL;
+    return 0;
+}
+
+static int step(struct ox_json_parser *p, const char **sp, const char *e)
+{
+    const char *s = *sp;
+    int r = 0;
+    switch (p->state) {
+    case ST_STRING: {
+        const char *run = s;
+        s = scan_string(s, e);
+        if (s > run && (flush_high(p) != 0 || append(p, run, (size_t)(s - run)) != 0)) return -1;
+        /* short escapes ("\/" in every VK URL) are decoded without leaving
+         * the string state */
+        while (s + 1 < e && *s == '\\' && s[1] != 'u') {
+            char out = unescape(s[1]);
+            if (!out || flush_high(p) != 0 || append(p, &out, 1) != 0) return -1;
+            run = s += 2;
+            s = scan_string(s, e);
+            if (s > run && append(p, run, (size_t)(s - run)) != 0) return -1;
+        }
+        if (s == e) break;
+        if (*s == '"') {
+            ++s;
+            if (flush_high(p) != 0) return -1;
+            if (p->in_key) {
+                r = emit_buf(p, OX_JSON_KEY);
+                p->state = ST_COLON;
+            } else {
+                value_done(p);
+                r = emit_buf(p, OX_JSON_STRING);
+            }
+        } else if (*s == '\\') {
+            ++s;
+            p->state = ST_ESCAPE;
+        } else {
+            return -1; /* raw control byte */
+        }
+        break;
+    }
+    case ST_ESCAPE: {
+        char c = *s++, out = unescape(c);
+        if (c == 'u') {
+            p->hex = p->nhex = 0;
+            p->state = ST_UNICODE;
+            break;
+        }
+        if (!out || flush_high(p) != 0 || append(p, &out, 1) != 0) return -1;
+        p->state = ST_STRING;
+        break;
+    }
+    case ST_UNICODE: {
+        char c = *s++;
+        unsigned d;
+        if (c >= '0' && c <= '9') d = (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') d = (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') d = (unsigned)(c - 'A' + 10);
+        else return -1;
+        p->hex = p->hex << 4 | d;
+        if (++p->nhex < 4) break;
+        p->state = ST_STRING;
+        unsigned cp = p->hex;
+        if (cp >= 0xDC00 && cp <= 0xDFFF && p->high) {
+            cp = 0x10000 + ((p->high - 0xD800) << 10) + (cp - 0xDC00);
+            p->high = 0;
+        } else {
+            if (flush_high(p) != 0) return -1;
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                p->high = cp;
+                break;
+            }
+            if (cp >= 0xDC00 && cp <= 0xDFFF) cp = 0xFFFD;
+        }
+        if (put_utf8(p, cp) != 0) return -1;
+        break;
+    }
+    case ST_NUMBER: {
+        const char *run = s;
+        while (s < e && ((*s >= '0' && *s <= '9') || *s == '.' || *s == 'e' || *s == 'E' || *s == '+' || *s == '-'))
+            ++s;
+        if (s > run && append(p, run, (size_t)(s - run)) != 0) return -1;
+        if (s == e) break;
+        if (!valid_number(p->buf, p->len)) return -1;
+        value_done(p);
+        r = emit_buf(p, OX_JSON_NUMBER);
+        break;
+    }
+    case ST_LITERAL:
+        if (*s++ != p->lit[p->lit_pos++]) return -1;
+        if (p->lit[p->lit_pos]) break;
+        value_done(p);
+        r = p->cb(p->user, p->lit_ev, NULL, 0, p->depth) ? 1 : 0;
+        break;
+    case ST_ERROR:
+        return -1;
+    default: {
+        s = skip_ws(s, e);
+        if (s == e) break;
+        char c = *s++;
+        switch (p->state) {
+        case ST_VALUE_OR_END:
+            if (c == ']') {
+                r = close_container(p);
+                break;
+            }
+            /* fall through */
+        case ST_VALUE:
+            r = begin_value(p, c);
+            break;
+        case ST_KEY_OR_END:
+            if (c == '}') {
+                r = close_container(p);
+                break;
+            }
+            /* fall through */
+        case ST_KEY:
+            if (c != '"') return -1;
+            p->in_key = 1;
+            p->state = ST_STRING;
+            break;
+        case ST_COLON:
+            if (c != ':') return -1;
+            p->state = ST_VALUE;
+            break;
+        case ST_AFTER_VALUE: {
+            char top = p->stack[p->depth - 1];
+            if (c == ',') p->state = top == '{' ? ST_KEY : ST_VALUE;
+            else if (c == (top == '{' ? '}' : ']')) r = close_container(p);
+            else return -1;
+            break;
+        }
+        default: /* ST_DONE: one document per parser */
+            return -1;
+        }
+        break;
+    }
+    }
+    *sp = s;
+    return r;
+}
+
+int ox_json_feed(struct ox_json_parser *p, const char *data, size_t len)
+{
+    if (p->state == ST_ERROR) return -1;
+    const char *s = data, *e = data + len;
+    while (s < e) {
+        int r = step(p, &s, e);
+        if (r != 0) {
+            p->err_at = p->offset + (size_t)(s - data);
+            if (r < 0) p->state = ST_ERROR;
+            p->offset += (size_t)(s - data);
+            return r;
+        }
+    }
+    p->offset += len;
+    return 0;
+}
+
+int ox_json_finish(struct ox_json_parser *p)
+{
+    if (p->state == ST_NUMBER && p->depth == 0) {
+        if (!valid_number(p->buf, p->len)) {
+            p->state = ST_ERROR;
+            return -1;
+        }
+        p->state = ST_DONE;
+        return emit_buf(p, OX_JSON_NUMBER) < 0 ? -1 : 0;
+    }
+    if (p->state == ST_DONE) return 0;
+    p->err_at = p->offset;
+    p->state = ST_ERROR;
+    return -1;
+}
+
+/* ---- DOM ---- */
+
+struct builder {
+    struct ox_json *root;
+    struct ox_json *open[OX_JSON_MAX_DEPTH]; /* containers being filled */
+    struct ox_json *last[OX_JSON_MAX_DEPTH]; /* their last member */
+    char *key;
+    int failed;
+};
+
+static char *dup_bytes(const char *s, size_t n)
+{
+    char *d = malloc(n + 1);
+    if (!d) return NULL;
+    memcpy(d, s, n);
+    d[n] = '\0';
+    return d;
+}
+
+static void attach(struct builder *b, struct ox_json *v, int depth)
+{
+    if (depth == 0) {
+        b->root = v;
+        return;
+    }
+    v->key = b->key; /* NULL inside arrays */
+    b->key = NULL;
+    if (b->last[depth - 1]) b->last[depth - 1]->next = v;
+    else b->open[depth - 1]->child = v;
+    b->last[depth - 1] = v;
+}
+
+static int build(void *user, enum ox_json_event ev, const char *s, size_t len, int depth)
+{
+    struct builder *b = user;
+    if (ev == OX_JSON_OBJECT_END || ev == OX_JSON_ARRAY_END) return 0;
+    if (ev == OX_JSON_KEY) {
+        b->key = dup_bytes(s, len);
+        return b->key ? 0 : (b->failed = 1);
+    }
+    struct ox_json *v = calloc(1, sizeof(*v));
+    if (!v) return b->failed = 1;
+    switch (ev) {
+    case OX_JSON_OBJECT_BEGIN: v->type = OX_JSON_T_OBJECT; break;
+    case OX_JSON_ARRAY_BEGIN: v->type = OX_JSON_T_ARRAY; break;
+    case OX_JSON_STRING: v->type = OX_JSON_T_STRING; break;
+    case OX_JSON_NUMBER: v->type = OX_JSON_T_NUMBER; break;
+    case OX_JSON_TRUE: v->type = OX_JSON_T_BOOL; v->boolean = 1; break;
+    case OX_JSON_FALSE: v->type = OX_JSON_T_BOOL; break;
+    default: v->type = OX_JSON_T_NULL; break;
+    }
+    if (s && !(v->str = dup_bytes(s, len))) {
+        free(v);
+        return b->failed = 1;
+    }
+    v->len = len;
+    attach(b, v, depth);
+    if (v->type == OX_JSON_T_OBJECT || v->type == OX_JSON_T_ARRAY) {
+        b->open[depth] = v;
+        b->last[depth] = NULL;
+    }
+    return 0;
+}
+
+struct ox_json *ox_json_parse(const char *text, size_t len)
+{
+    struct builder b = { 0 };
+    struct ox_json_parser *p = text ? ox_json_parser_create(build, &b) : NULL;
+    if (!p) return NULL;
+    int ok = ox_json_feed(p, text, len) == 0 && ox_json_finish(p) == 0 && !b.failed;
+    ox_json_parser_destroy(p);
+    free(b.key);
+    if (!ok) {
+        ox_json_free(b.root);
+        return NULL;
+    }
+    return b.root;
+}
+
+void ox_json_free(struct ox_json *v)
+{
+    while (v) {
+        struct ox_json *next = v->next;
+        ox_json_free(v->child);
+        free(v->key);
+        free(v->str);
+        free(v);
+        v = next;
+    }
+}
+
+const struct ox_json *ox_json_get(const struct ox_json *obj, const char *key)
+{
+    if (!obj || obj->type != OX_JSON_T_OBJECT || !key) return NULL;
+    const struct ox_json *found = NULL;
+    for (const struct ox_json *m = obj->child; m; m = m->next)
+        if (strcmp(m->key, key) == 0) found = m;
+    return found;
+}
+
+const char *ox_json_string(const struct ox_json *v)
+{
+    return v && v->type == OX_JSON_T_STRING ? v->str : NULL;
+}
+
+double ox_json_number(const struct ox_json *v, double fallback)
+{
+    return v && v->type == OX_JSON_T_NUMBER ? strtod(v->str, NULL) : fallback;
+}
+
+int ox_json_set_string(struct ox_json *obj, const char *key, const char *value)
+{
+    if (!obj || obj->type != OX_JSON_T_OBJECT || !key || !value) return -1;
+    char *str = strdup(value);
+    if (!str) return -1;
+    struct ox_json *m = (struct ox_json *)ox_json_get(obj, key);
+    if (m) {
+        ox_json_free(m->child);
+        m->child = NULL;
+        free(m->str);
+    } else {
+        m = calloc(1, sizeof(*m));
+        if (!m || !(m->key = strdup(key))) {
+            free(m);
+            free(str);
+            return -1;
+        }
+        struct ox_json **tail = &obj->child;
+        while (*tail) tail = &(*tail)->next;
+        *tail = m;
+    }
+    m->type = OX_JSON_T_STRING;
+    m->str = str;
+    m->len = strlen(str);
+    return 0;
+}
+
+struct out {
+    char *buf;
+    size_t len, cap;
+    int failed;
+};
+
+static void put(struct out *o, const char *s, size_t n)
+{
+    if (o->failed) return;
+    if (o->len + n + 1 > o->cap) {
+        size_t cap = o->cap ? o->cap : 256;
+        while (cap < o->len + n + 1) cap *= 2;
+        char *b = realloc(o->buf, cap);
+        if (!b) {
+            o->failed = 1;
+            return;
+        }
+        o->buf = b;
+        o->cap = cap;
+    }
+    memcpy(o->buf + o->len, s, n);
+    o->len += n;
+}
+
+static void put_string(struct out *o, const char *s, size_t n)
+{
+    static const char hex[] = "0123456789abcdef";
+    put(o, "\"", 1);
+    const char *run = s, *e = s + n;
+    while (run < e) {
+        const char *q = scan_string(run, e);
+        put(o, run, (size_t)(q - run));
+        if (q == e) break;
+        unsigned char c = (unsigned char)*q;
+        char esc[6] = { '\\', (char)c };
+        size_t len = 2;
+        switch (c) {
+        case '"': case '\\': break;
+        case '\b': esc[1] = 'b'; break;
+        case '\f': esc[1] = 'f'; break;
+        case '\n': esc[1] = 'n'; break;
+        case '\r': esc[1] = 'r'; break;
+        case '\t': esc[1] = 't'; break;
+        default:
+            memcpy(esc + 1, "u00", 3);
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 15];
+            len = 6;
+        }
+        put(o, esc, len);
+        run = q + 1;
+    }
+    put(o, "\"", 1);
+}
+
+static void write_value(struct out *o, const struct ox_json *v)
+{
+    switch (v->type) {
+    case OX_JSON_T_NULL: put(o, "null", 4); break;
+    case OX_JSON_T_BOOL: v->boolean ? put(o, "true", 4) : put(o, "false", 5); break;
+    case OX_JSON_T_NUMBER: put(o, v->str, v->len); break;
+    case OX_JSON_T_STRING: put_string(o, v->str, v->len); break;
+    case OX_JSON_T_ARRAY:
+    case OX_JSON_T_OBJECT: {
+        int obj = v->type == OX_JSON_T_OBJECT;
+        put(o, obj ? "{" : "[", 1);
+        for (const struct ox_json *m = v->child; m; m = m->next) {
+            if (m != v->child) put(o, ",", 1);
+            if (obj) {
+                put_string(o, m->key, strlen(m->key));
+                put(o, ":", 1);
+            }
+            write_value(o, m);
+        }
+        put(o, obj ? "}" : "]", 1);
+        break;
+    }
+    }
+}
+
+char *ox_json_write(const struct ox_json *v, size_t *len)
+{
+    if (!v) return NULL;
+    struct out o = { 0 };
+    write_value(&o, v);
+    put(&o, "", 0);
+    if (o.failed || !o.buf) {
+        free(o.buf);
+        return NULL;
+    }
+    o.buf[o.len] = '\0';
+    if (len) *len = o.len;
+    return o.buf;
+}
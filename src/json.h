@@ -0,0 +1,67 @@
+// json.h - streaming (SAX) JSON tokenizer and a small DOM for config blobs
+#pragma once
+
+#include <stddef.h>
+
+/* ---- streaming ---- */
+
+enum ox_json_event {
+    OX_JSON_OBJECT_BEGIN,
+    OX_JSON_OBJECT_END,
+    OX_JSON_ARRAY_BEGIN,
+    OX_JSON_ARRAY_END,
+    OX_JSON_KEY,    /* s: member name, unescaped */
+    OX_JSON_STRING, /* s: value, unescaped (UTF-8, may contain NUL from \u0000) */
+    OX_JSON_NUMBER, /* s: the number as written */
+    OX_JSON_TRUE,
+    OX_JSON_FALSE,
+    OX_JSON_NULL
+};
+
+/* s is NUL-terminated and valid only during the call (NULL for structural
+ * events). depth counts the containers around the event: a top-level value
+ * is at 0, members of the top-level object at 1, and a container's BEGIN and
+ * END share the depth of the value they form. Return non-zero to stop. */
+typedef int (*ox_json_cb)(void *user, enum ox_json_event ev, const char *s, size_t len, int depth);
+
+struct ox_json_parser;
+
+#define OX_JSON_MAX_DEPTH 256
+
+struct ox_json_parser *ox_json_parser_create(ox_json_cb cb, void *user);
+void ox_json_parser_destroy(struct ox_json_parser *p);
+/* Feed the next bytes of one document; chunks may split tokens anywhere.
+ * Returns 0 to continue, 1 if the callback stopped the parse, -1 on a syntax
+ * error (sticky). */
+int ox_json_feed(struct ox_json_parser *p, const char *data, size_t len);
+/* End of input: 0 if exactly one complete document was seen, else -1. */
+int ox_json_finish(struct ox_json_parser *p);
+/* Byte offset of the first error (or of the stop), counted over all feeds. */
+size_t ox_json_offset(const struct ox_json_parser *p);
+
+/* ---- DOM ---- */
+
+enum ox_json_type { OX_JSON_T_NULL, OX_JSON_T_BOOL, OX_JSON_T_NUMBER, OX_JSON_T_STRING, OX_JSON_T_ARRAY, OX_JSON_T_OBJECT };
+
+struct ox_json {
+    enum ox_json_type type;
+    char *key;              /* member name inside an object, else NULL */
+    char *str;              /* STRING value, or NUMBER as written */
+    size_t len;
+    int boolean;
+    struct ox_json *child;  /* ARRAY / OBJECT members in order */
+    struct ox_json *next;
+};
+
+/* Parse a whole document; NULL if it is not valid JSON. */
+struct ox_json *ox_json_parse(const char *text, size_t len);
+void ox_json_free(struct ox_json *v);
+/* Member of an object by name (the last one if repeated), or NULL. */
+const struct ox_json *ox_json_get(const struct ox_json *obj, const char *key);
+/* String value or NULL; number value or fallback. */
+const char *ox_json_string(const struct ox_json *v);
+double ox_json_number(const struct ox_json *v, double fallback);
+/* Add or replace a string member. Returns 0, or -1 if obj is not an object. */
+int ox_json_set_string(struct ox_json *obj, const char *key, const char *value);
+/* Compact serialisation, malloc'd; *len (optional) gets its length. */
+char *ox_json_write(const struct ox_json *v, size_t *len);
@@ -0,0 +1,406 @@
+// library.c - persistent library index
+// Layout (native endian, written once, mapped read-only):
+//   header | string pool (NUL-terminated, interned) | track records | order arrays
+// Opening costs one mmap; a rescan only opens files whose stat data changed and
+// rewrites the whole index through a temp file + rename.
+
+#define _POSIX_C_SOURCE 200809L
+#include "library.h"
+#include "util.h"
+#include "xdg.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LIB_MAGIC "OXLIBIDX"
+#define LIB_VERSION 1
+
+_Static_assert(sizeof(struct ox_lib_track) == 72, "ox_lib_track is an on-disk format");
+
+struct lib_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    uint64_t strings_off;
+    uint64_t strings_len;
+    uint64_t records_off;
+    uint64_t order_off[OX_LIB_ORDER_COUNT];
+    uint64_t file_size;
+};
+
+struct ox_library {
+    void *map;
+    size_t map_len;
+    size_t count;
+    const char *strings;
+    size_t strings_len;
+    const struct ox_lib_track *recs;
+    const uint32_t *order[OX_LIB_ORDER_COUNT];
+};
+
+char *ox_library_default_path(void)
+{
+    char *cache = ox_get_xdg_cache_home();
+    if (!cache) return NULL;
+    ox_mkdir_p(cache);
+    size_t n = strlen(cache) + strlen("/library.idx") + 1;
+    char *out = malloc(n);
+    if (out) snprintf(out, n, "%s/library.idx", cache);
+    free(cache);
+    return out;
+}
+
+struct ox_library *ox_library_open(const char *path)
+{
+    if (!path) return NULL;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct lib_header)) { close(fd); return NULL; }
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const struct lib_header *h = map;
+    uint64_t recs_len = h->count * sizeof(struct ox_lib_track);
+    int ok = memcmp(h->magic, LIB_MAGIC, 8) == 0 && h->version == LIB_VERSION &&
+             h->record_size == sizeof(struct ox_lib_track) && h->file_size == len &&
+             h->count < (1ull << 32) &&
+             h->strings_len >= 1 && h->strings_off <= len && h->strings_len <= len - h->strings_off &&
+             h->records_off % 8 == 0 && h->records_off <= len && recs_len <= len - h->records_off;
+    for (int i = 0; ok && i < OX_LIB_ORDER_COUNT; ++i)
+        ok = h->order_off[i] % 4 == 0 && h->order_off[i] <= len && h->count * 4 <= len - h->order_off[i];
+    if (ok) ok = ((const char *)map)[h->strings_off + h->strings_len - 1] == '\0';
+    struct ox_library *lib = ok ? calloc(1, sizeof(*lib)) : NULL;
+    if (!lib) { munmap(map, len); return NULL; }
+    lib->map = map;
+    lib->map_len = len;
+    lib->count = (size_t)h->count;
+    lib->strings = (const char *)map + h->strings_off;
+    lib->strings_len = (size_t)h->strings_len;
+    lib->recs = (const struct ox_lib_track *)((const char *)map + h->records_off);
+    for (int i = 0; i < OX_LIB_ORDER_COUNT; ++i)
+        lib->order[i] = (const uint32_t *)((const char *)map + h->order_off[i]);
+    return lib;
+}
+
+void ox_library_close(struct ox_library *lib)
+{
+    if (!lib) return;
+    munmap(lib->map, lib->map_len);
+    free(lib);
+}
+
+size_t ox_library_count(const struct ox_library *lib)
+{
+    return lib ? lib->count : 0;
+}
+
+const struct ox_lib_track *ox_library_track(const struct ox_library *lib, size_t i)
+{
+    if (!lib || i >= lib->count) return NULL;
+    return &lib->recs[i];
+}
+
+const char *ox_library_str(const struct ox_library *lib, uint32_t off)
+{
+    if (!lib || off >= lib->strings_len) return "";
+    return lib->strings + off;
+}
+
+const uint32_t *ox_library_order(const struct ox_library *lib, enum ox_lib_order order)
+{
+    if (!lib || order < 0 || order >= OX_LIB_ORDER_COUNT) return NULL;
+    return lib->order[order];
+}
+
+long ox_library_find_path(const struct ox_library *lib, const char *path)
+{
+    if (!lib || !path) return -1;
+    const uint32_t *ord = lib->order[OX_LIB_BY_PATH];
+    size_t lo = 0, hi = lib->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t idx = ord[mid];
+        if (idx >= lib->count) return -1;
+        int c = strcmp(ox_library_str(lib, lib->recs[idx].path), path);
+        if (c == 0) return (long)idx;
+        if (c < 0) lo = mid + 1; else hi = mid;
+    }
+    return -1;
+}
+
+/* ---- index builder ---- */
+
+struct builder {
+    struct ox_lib_track *recs;
+    size_t n, cap;
+    char *pool;
+    size_t pool_len, pool_cap;
+    uint32_t *slots; /* open addressing over pool offsets; 0 = empty */
+    size_t nslots, used;
+    int oom;
+};
+
+static int builder_rehash(struct builder *b, size_t nslots)
+{
+    uint32_t *slots = calloc(nslots, sizeof(*slots));
+    if (!slots) return -1;
+    for (size_t i = 0; i < b->nslots; ++i) {
+        uint32_t off = b->slots[i];
+        if (!off) continue;
+        size_t j = ox_fnv1a_str(b->pool + off) & (nslots - 1);
+        while (slots[j]) j = (j + 1) & (nslots - 1);
+        slots[j] = off;
+    }
+    free(b->slots);
+    b->slots = slots;
+    b->nslots = nslots;
+    return 0;
+}
+
+static uint32_t intern(struct builder *b, const char *s)
+{
+    if (!s || !*s || b->oom) return 0;
+    if ((b->used + 1) * 2 > b->nslots && builder_rehash(b, b->nslots ? b->nslots * 2 : 1024) != 0) { b->oom = 1; return 0; }
+    size_t j = ox_fnv1a_str(s) & (b->nslots - 1);
+    while (b->slots[j]) {
+        if (strcmp(b->pool + b->slots[j], s) == 0) return b->slots[j];
+        j = (j + 1) & (b->nslots - 1);
+    }
+    size_t n = strlen(s) + 1;
+    if (b->pool_len + n > b->pool_cap) {
+        size_t ncap = b->pool_cap ? b->pool_cap : 4096;
+        while (b->pool_len + n > ncap) ncap *= 2;
+        if (ncap > UINT32_MAX) { b->oom = 1; return 0; }
+        char *np = realloc(b->pool, ncap);
+        if (!np) { b->oom = 1; return 0; }
+        b->pool = np; b->pool_cap = ncap;
+    }
+    uint32_t off = (uint32_t)b->pool_len;
+    memcpy(b->pool + off, s, n);
+    b->pool_len += n;
+    b->slots[j] = off;
+    b->used++;
+    return off;
+}
+
+static struct ox_lib_track *builder_add(struct builder *b)
+{
+    if (b->oom) return NULL;
+    if (b->n == b->cap) {
+        size_t ncap = b->cap ? b->cap * 2 : 1024;
+        struct ox_lib_track *n = realloc(b->recs, ncap * sizeof(*n));
+        if (!n) { b->oom = 1; return NULL; }
+        b->recs = n; b->cap = ncap;
+    }
+    struct ox_lib_track *t = &b->recs[b->n++];
+    memset(t, 0, sizeof(*t));
+    return t;
+}
+
+static int builder_init(struct builder *b)
+{
+    memset(b, 0, sizeof(*b));
+    b->pool_cap = 4096;
+    b->pool = malloc(b->pool_cap);
+    if (!b->pool) return -1;
+    b->pool[0] = '\0'; /* offset 0 is the empty string */
+    b->pool_len = 1;
+    return 0;
+}
+
+static void builder_free(struct builder *b)
+{
+    free(b->recs);
+    free(b->pool);
+    free(b->slots);
+}
+
+struct sort_key {
+    const char *a;
+    const char *b;
+    const char *c;
+    int32_t n;
+    uint32_t idx;
+};
+
+static int cmp_path(const void *x, const void *y)
+{
+    const struct sort_key *p = x, *q = y;
+    return strcmp(p->a, q->a);
+}
+
+static int cmp_meta(const void *x, const void *y)
+{
+    const struct sort_key *p = x, *q = y;
+    int c = strcasecmp(p->a, q->a);
+    if (!c) c = strcasecmp(p->b, q->b);
+    if (!c) c = (p->n > q->n) - (p->n < q->n);
+    if (!c) c = strcasecmp(p->c, q->c);
+    if (!c) c = (p->idx > q->idx) - (p->idx < q->idx);
+    return c;
+}
+
+static int build_order(const struct builder *b, enum ox_lib_order order, uint32_t *out)
+{
+    struct sort_key *keys = malloc((b->n ? b->n : 1) * sizeof(*keys));
+    if (!keys) return -1;
+    for (size_t i = 0; i < b->n; ++i) {
+        const struct ox_lib_track *t = &b->recs[i];
+        struct sort_key *k = &keys[i];
+        k->idx = (uint32_t)i;
+        k->n = t->track;
+        switch (order) {
+        case OX_LIB_BY_ARTIST:
+            k->a = b->pool + t->artist; k->b = b->pool + t->album; k->c = b->pool + t->title; break;
+        case OX_LIB_BY_ALBUM:
+            k->a = b->pool + t->album; k->b = b->pool + t->artist; k->c = b->pool + t->title; break;
+        default:
+            k->a = b->pool + t->path; k->b = k->c = ""; break;
+        }
+    }
+    qsort(keys, b->n, sizeof(*keys), order == OX_LIB_BY_PATH ? cmp_path : cmp_meta);
+    for (size_t i = 0; i < b->n; ++i) out[i] = keys[i].idx;
+    free(keys);
+    return 0;
+}
+
+static int builder_write(const struct builder *b, const char *path)
+{
+    struct lib_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LIB_MAGIC, 8);
+    h.version = LIB_VERSION;
+    h.record_size = sizeof(struct ox_lib_track);
+    h.count = b->n;
+    h.strings_off = sizeof(h);
+    h.strings_len = b->pool_len;
+    h.records_off = (h.strings_off + h.strings_len + 7) & ~(uint64_t)7;
+    uint64_t pos = h.records_off + b->n * sizeof(struct ox_lib_track);
+    for (int i = 0; i < OX_LIB_ORDER_COUNT; ++i) { h.order_off[i] = pos; pos += b->n * 4; }
+    h.file_size = pos;
+
+    uint32_t *orders = malloc((b->n ? b->n : 1) * 4 * OX_LIB_ORDER_COUNT);
+    if (!orders) return -1;
+    for (int i = 0; i < OX_LIB_ORDER_COUNT; ++i)
+        if (build_order(b, (enum ox_lib_order)i, orders + (size_t)i * b->n) != 0) { free(orders); return -1; }
+
+    struct ox_atomic a;
+    int rc = -1;
+    if (ox_atomic_begin(&a, path, 0600, 1) == 0) {
+        static const char pad[8];
+        size_t padn = (size_t)(h.records_off - h.strings_off - h.strings_len);
+        rc = ox_write_all(a.fd, &h, sizeof(h));
+        if (!rc) rc = ox_write_all(a.fd, b->pool, b->pool_len);
+        if (!rc) rc = ox_write_all(a.fd, pad, padn);
+        if (!rc) rc = ox_write_all(a.fd, b->recs, b->n * sizeof(struct ox_lib_track));
+        if (!rc) rc = ox_write_all(a.fd, orders, b->n * 4 * OX_LIB_ORDER_COUNT);
+        rc = ox_atomic_finish(&a, path, rc);
+    }
+    free(orders);
+    return rc;
+}
+
+/* ---- incremental rescan ---- */
+
+struct rescan_ctx {
+    struct ox_library *old;
+    unsigned char *seen; /* per old record: reused as-is */
+    struct builder b;
+    uint64_t replaced;
+    ox_scan_progress_cb on_progress;
+    void *user;
+};
+
+static int rescan_filter(const char *path, const struct ox_scan_stat *st, void *user)
+{
+    struct rescan_ctx *c = user;
+    long i = ox_library_find_path(c->old, path);
+    if (i < 0) return 1;
+    const struct ox_lib_track *t = &c->old->recs[i];
+    if (t->dev != st->dev || t->inode != st->inode || t->size != st->size || t->mtime_ns != st->mtime_ns) return 1;
+    __atomic_store_n(&c->seen[i], 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static void rescan_result(const struct ox_scan_result *r, void *user)
+{
+    struct rescan_ctx *c = user; /* the scanner serialises result callbacks */
+    struct ox_lib_track *t = builder_add(&c->b);
+    if (!t) return;
+    t->dev = r->dev; t->inode = r->inode; t->size = r->size; t->mtime_ns = r->mtime_ns;
+    t->path = intern(&c->b, r->path);
+    t->title = intern(&c->b, r->meta.title);
+    t->artist = intern(&c->b, r->meta.artist);
+    t->album = intern(&c->b, r->meta.album);
+    t->year = r->meta.year; t->track = r->meta.track; t->duration_sec = r->meta.duration_sec;
+    t->rg_track_gain = r->meta.rg_track_gain; t->rg_album_gain = r->meta.rg_album_gain;
+    t->format = (uint8_t)r->format;
+    if (c->old && ox_library_find_path(c->old, r->path) >= 0) c->replaced++;
+}
+
+static void rescan_progress(const struct ox_scan_progress *p, void *user)
+{
+    struct rescan_ctx *c = user;
+    if (c->on_progress) c->on_progress(p, c->user);
+}
+
+int ox_library_rescan(const char *path, const char *const *roots, size_t nroots,
+                      const struct ox_scan_opts *scan_opts, struct ox_library_rescan_stats *stats)
+{
+    if (!path || !roots) return -1;
+    struct rescan_ctx c;
+    memset(&c, 0, sizeof(c));
+    if (builder_init(&c.b) != 0) return -1;
+    c.old = ox_library_open(path);
+    if (c.old) {
+        c.seen = calloc(c.old->count ? c.old->count : 1, 1);
+        if (!c.seen) { ox_library_close(c.old); builder_free(&c.b); return -1; }
+    }
+    struct ox_scan_opts o;
+    memset(&o, 0, sizeof(o));
+    if (scan_opts) o = *scan_opts;
+    c.on_progress = o.on_progress;
+    c.user = o.user;
+    o.on_filter = c.old ? rescan_filter : NULL;
+    o.on_result = rescan_result;
+    o.on_progress = rescan_progress;
+    o.user = &c;
+
+    int rc = -1;
+    struct ox_scanner *s = ox_scanner_start(roots, nroots, &o);
+    if (s && ox_scanner_wait(s) == 0) {
+        uint64_t kept = 0;
+        for (size_t i = 0; c.old && i < c.old->count; ++i) {
+            if (!c.seen[i]) continue;
+            const struct ox_lib_track *src = &c.old->recs[i];
+            struct ox_lib_track *t = builder_add(&c.b);
+            if (!t) break;
+            *t = *src;
+            t->path = intern(&c.b, ox_library_str(c.old, src->path));
+            t->title = intern(&c.b, ox_library_str(c.old, src->title));
+            t->artist = intern(&c.b, ox_library_str(c.old, src->artist));
+            t->album = intern(&c.b, ox_library_str(c.old, src->album));
+            kept++;
+        }
+        uint64_t updated = c.b.n - kept;
+        if (!c.b.oom) rc = builder_write(&c.b, path);
+        if (rc == 0 && stats) {
+            stats->kept = kept;
+            stats->updated = updated;
+            stats->removed = c.old ? c.old->count - kept - c.replaced : 0;
+        }
+    }
+    free(c.seen);
+    ox_library_close(c.old);
+    builder_free(&c.b);
+    return rc;
+}
@@ -0,0 +1,69 @@
+// library.h - persistent, memory-mapped library index
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "scanner.h"
+
+/* Fixed-width track record as stored on disk. String fields are offsets into
+ * the index's interned string pool (0 is the empty string).
+ */
+struct ox_lib_track {
+    uint64_t dev;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtime_ns;
+    uint32_t path;
+    uint32_t title;
+    uint32_t artist;
+    uint32_t album;
+    int32_t year;
+    int32_t track;
+    int32_t duration_sec;
+    float rg_track_gain;
+    float rg_album_gain;
+    uint8_t format; /* enum ox_meta_format */
+    uint8_t reserved[3];
+};
+
+enum ox_lib_order {
+    OX_LIB_BY_PATH = 0,   /* strcmp on path */
+    OX_LIB_BY_ARTIST,     /* artist, album, track, title (case-insensitive) */
+    OX_LIB_BY_ALBUM,      /* album, track (case-insensitive) */
+    OX_LIB_ORDER_COUNT
+};
+
+struct ox_library;
+
+/* Default index location: $XDG_CACHE_HOME/oxxy/library.idx (directory is created).
+ * Returns malloc'd path or NULL. */
+char *ox_library_default_path(void);
+
+/* Map an index read-only. Costs one mmap regardless of library size; pages are
+ * faulted in as records are touched. Returns NULL if missing or invalid.
+ */
+struct ox_library *ox_library_open(const char *path);
+void ox_library_close(struct ox_library *lib);
+
+size_t ox_library_count(const struct ox_library *lib);
+const struct ox_lib_track *ox_library_track(const struct ox_library *lib, size_t i);
+/* Resolve a string pool offset; returns "" for out-of-range offsets. */
+const char *ox_library_str(const struct ox_library *lib, uint32_t off);
+/* Record indices in the given order (count entries). */
+const uint32_t *ox_library_order(const struct ox_library *lib, enum ox_lib_order order);
+/* Binary search by path; returns record index or -1. */
+long ox_library_find_path(const struct ox_library *lib, const char *path);
+
+struct ox_library_rescan_stats {
+    uint64_t kept;    /* unchanged files reused from the previous index */
+    uint64_t updated; /* new or changed files that were read */
+    uint64_t removed; /* records dropped (file gone or unreadable) */
+};
+
+/* Rescan roots and rewrite the index at path atomically (temp file + rename).
+ * Files whose dev/inode/size/mtime match the previous index are not opened.
+ * scan_opts may be NULL; its callbacks other than on_progress are ignored.
+ * Returns 0 on success.
+ */
+int ox_library_rescan(const char *path, const char *const *roots, size_t nroots,
+                      const struct ox_scan_opts *scan_opts, struct ox_library_rescan_stats *stats);
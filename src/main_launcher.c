@@ -1,37 +1,75 @@
 // main_launcher.c - launcher for OXXY, starts UI directly
+// - only what the first frame needs runs before the UI: the shared playlist.
+//   Profiles and libcurl (VK) are brought up on a startup thread in the
+//   meantime; both also initialise themselves on first use, so the UI never
+//   waits for that thread, and a missing libcurl only disables VK
+// - startup phases are timed (startup.h); OXXY_STARTUP_TIMING=1 prints them
+// - frontends link in ox_ui_main; without one (oxxy-launcher) the core is set
+//   up and torn down
+// - --attach (or $OXXY_ENGINE) makes the UI a client of an engine daemon
+//   (oxxy-test --daemon) instead of a standalone player; without an engine
+//   it says so and runs standalone
 #define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "profiles.h"
+#include "startup.h"
 #include "vk.h"
-#include "playlist.h"
+#include "playlist_share.h"
 #include "ui_bridge.h"
-#include <stdlib.h>
-// No header for audio_pipeline, use extern
 
-int main(int argc, char **argv)
+__attribute__((weak)) int ox_ui_main(int argc, char **argv)
 {
     (void)argc; (void)argv;
-    if (ox_profiles_init() != 0) {
-        fprintf(stderr, "Failed to init profiles\n");
-        return 1;
-    }
-    if (ox_vk_init() != 0) {
-        fprintf(stderr, "Failed to init VK\n");
-        return 1;
-    }
+    fprintf(stderr, "oxxy-launcher: built without a UI (see make ui)\n");
+    return 0;
+}
+
+static void *startup_thread(void *arg)
+{
+    (void)arg;
+    if (ox_profiles_init() == 0) ox_startup_mark("profiles");
+    else fprintf(stderr, "Failed to init profiles\n");
+    if (ox_vk_init() == 0) ox_startup_mark("vk");
+    else ox_startup_mark("vk-unavailable");
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    ox_startup_begin();
     // Create empty playlist for initial UI state
-    struct playlist *p = playlist_create();
+    struct ox_plshare *p = ox_plshare_create(NULL);
     if (!p) {
         return 1;
     }
     ox_ui_set_playlist(p);
+    ox_startup_mark("playlist");
+
+    const char *env = getenv("OXXY_ENGINE");
+    int attach = env && *env && strcmp(env, "0") != 0;
+    for (int i = 1; i < argc; ++i)
+        if (strcmp(argv[i], "--attach") == 0) attach = 1;
+    if (attach) {
+        if (ox_ui_attach(NULL) == 0) ox_startup_mark("engine");
+        else fprintf(stderr, "No engine to attach to, running standalone\n");
+    }
+
+    pthread_t th;
+    int have_thread = pthread_create(&th, NULL, startup_thread, NULL) == 0;
+    if (!have_thread) startup_thread(NULL);
+
     // Launch the UI directly - profile selection will happen in UI
-    extern int main(int, char**);
-    char *args[1] = {NULL};
-    main(0, args);
-    playlist_destroy(p);
+    int rc = ox_ui_main(argc, argv);
+
+    if (have_thread) pthread_join(th, NULL);
+    ox_ui_detach();
+    ox_ui_vk_shutdown();
+    ox_ui_set_playlist(NULL);
+    ox_plshare_destroy(p);
     ox_vk_shutdown();
-    return 0;
+    ox_profiles_shutdown();
+    return rc;
 }
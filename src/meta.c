@@ -0,0 +1,204 @@
+// meta.c - container sniffing and dispatch to the per-format metadata readers
+
+#define _POSIX_C_SOURCE 200809L
+#include "meta.h"
+#include "utf8.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define PREFIX_BYTES (64 * 1024)
+
+const unsigned char *ox_meta_src_get(const struct ox_meta_src *src, uint64_t off, size_t n, unsigned char *scratch)
+{
+    if (!src) return NULL;
+    if (off + n <= src->buf_len && src->buf) return src->buf + off;
+    if (src->fd < 0 || n > OX_META_SCRATCH || !scratch) return NULL;
+    if (off + n > src->size) return NULL;
+    ssize_t r = pread(src->fd, scratch, n, (off_t)off);
+    return r == (ssize_t)n ? scratch : NULL;
+}
+
+size_t ox_meta_src_read(const struct ox_meta_src *src, uint64_t off, void *dst, size_t n)
+{
+    if (!src || !dst || off >= src->size) return 0;
+    if (n > src->size - off) n = (size_t)(src->size - off);
+    size_t done = 0;
+    if (src->buf && off < src->buf_len) {
+        done = src->buf_len - off < n ? (size_t)(src->buf_len - off) : n;
+        memcpy(dst, src->buf + off, done);
+    }
+    while (done < n && src->fd >= 0) {
+        ssize_t r = pread(src->fd, (unsigned char *)dst + done, n - done, (off_t)(off + done));
+        if (r <= 0) break;
+        done += (size_t)r;
+    }
+    return done;
+}
+
+enum ox_meta_format ox_meta_sniff(const unsigned char *buf, size_t len)
+{
+    if (!buf || len < 4) return OX_META_UNKNOWN;
+    if (memcmp(buf, "ID3", 3) == 0) return OX_META_MP3;
+    if (memcmp(buf, "fLaC", 4) == 0) return OX_META_FLAC;
+    if (len >= 12 && memcmp(buf + 4, "ftyp", 4) == 0) return OX_META_MP4;
+    if (memcmp(buf, "OggS", 4) == 0 && len >= 28) {
+        size_t data = 27 + (size_t)buf[26];
+        if (data + 8 <= len && memcmp(buf + data, "OpusHead", 8) == 0) return OX_META_OPUS;
+        if (data + 7 <= len && memcmp(buf + data, "\x01vorbis", 7) == 0) return OX_META_VORBIS;
+        return OX_META_UNKNOWN;
+    }
+    if (buf[0] == 0xFF && (buf[1] & 0xE0) == 0xE0) return OX_META_MP3; /* untagged frame sync */
+    return OX_META_UNKNOWN;
+}
+
+const char *ox_meta_format_name(enum ox_meta_format f)
+{
+    switch (f) {
+    case OX_META_MP3: return "mp3";
+    case OX_META_FLAC: return "flac";
+    case OX_META_VORBIS: return "vorbis";
+    case OX_META_OPUS: return "opus";
+    case OX_META_MP4: return "mp4";
+    default: return "unknown";
+    }
+}
+
+static int name_is(const char *name, size_t n, const char *key)
+{
+    return strlen(key) == n && strncasecmp(name, key, n) == 0;
+}
+
+static void set_text_field(char *dst, size_t cap, const char *value, size_t len)
+{
+    if (dst[0] != '\0') return; /* first value wins */
+    ox_utf8_copy((const unsigned char *)value, len, dst, cap);
+}
+
+void ox_meta_set_field(struct ox_metadata *out, const char *name, size_t name_len, const char *value, size_t value_len)
+{
+    if (!out || !name || !value) return;
+    char num[32];
+    size_t nl = value_len < sizeof(num) - 1 ? value_len : sizeof(num) - 1;
+    if (name_is(name, name_len, "TITLE")) set_text_field(out->title, sizeof(out->title), value, value_len);
+    else if (name_is(name, name_len, "ARTIST")) set_text_field(out->artist, sizeof(out->artist), value, value_len);
+    else if (name_is(name, name_len, "ALBUM")) set_text_field(out->album, sizeof(out->album), value, value_len);
+    else if (name_is(name, name_len, "COMMENT") || name_is(name, name_len, "DESCRIPTION"))
+        set_text_field(out->comment, sizeof(out->comment), value, value_len);
+    else {
+        memcpy(num, value, nl); num[nl] = '\0';
+        if ((name_is(name, name_len, "DATE") || name_is(name, name_len, "YEAR")) && !out->year) out->year = atoi(num);
+        else if (name_is(name, name_len, "TRACKNUMBER") && !out->track) out->track = atoi(num);
+        else if (name_is(name, name_len, "REPLAYGAIN_TRACK_GAIN")) out->rg_track_gain = strtof(num, NULL);
+        else if (name_is(name, name_len, "REPLAYGAIN_TRACK_PEAK")) out->rg_track_peak = strtof(num, NULL);
+        else if (name_is(name, name_len, "REPLAYGAIN_ALBUM_GAIN")) out->rg_album_gain = strtof(num, NULL);
+        else if (name_is(name, name_len, "REPLAYGAIN_ALBUM_PEAK")) out->rg_album_peak = strtof(num, NULL);
+    }
+}
+
+static int read_id3(const struct ox_meta_src *src, struct ox_metadata *out)
+{
+    size_t tag_size = ox_meta_id3_tag_size(src->buf, src->buf_len);
+    if (tag_size <= src->buf_len || src->fd < 0) return ox_meta_id3_parse(src->buf, src->buf_len, out);
+    return ox_meta_id3_parse_fd(src->fd, out); /* tag outgrew the prefix: map just the tag */
+}
+
+int ox_meta_read(const struct ox_meta_src *src, struct ox_metadata *out, enum ox_meta_format *fmt)
+{
+    if (fmt) *fmt = OX_META_UNKNOWN;
+    if (!src || !src->buf || !out) return -1;
+    memset(out, 0, sizeof(*out));
+    enum ox_meta_format f = ox_meta_sniff(src->buf, src->buf_len);
+    int rc = -1;
+    switch (f) {
+    case OX_META_MP3: {
+        /* some encoders put an ID3v2 tag in front of a FLAC stream */
+        size_t tag_size = ox_meta_id3_tag_size(src->buf, src->buf_len);
+        unsigned char scratch[4];
+        const unsigned char *p = tag_size ? ox_meta_src_get(src, tag_size, 4, scratch) : NULL;
+        if (p && memcmp(p, "fLaC", 4) == 0) {
+            f = OX_META_FLAC;
+            rc = ox_meta_flac_read(src, tag_size, out);
+        } else {
+            rc = tag_size ? read_id3(src, out) : 0; /* no tag: bare MPEG stream */
+            /* a damaged tag in front of good frames still makes a playable track */
+            if (ox_meta_mpeg_read(src, tag_size, out) == 0) rc = 0;
+        }
+        break;
+    }
+    case OX_META_FLAC: rc = ox_meta_flac_read(src, 0, out); break;
+    case OX_META_VORBIS:
+    case OX_META_OPUS: rc = ox_meta_ogg_read(src, 0, out, &f); break;
+    case OX_META_MP4: rc = ox_meta_mp4_read(src, 0, out); break;
+    default: break;
+    }
+    if (rc == 0 && out->duration_ms > 0) out->duration_sec = (out->duration_ms + 500) / 1000;
+    if (fmt) *fmt = rc == 0 ? f : OX_META_UNKNOWN;
+    return rc;
+}
+
+int ox_meta_parse(const unsigned char *buf, size_t len, struct ox_metadata *out)
+{
+    struct ox_meta_src src = { buf, len, -1, len };
+    return ox_meta_read(&src, out, NULL);
+}
+
+int ox_meta_parse_file(const char *path, struct ox_metadata *out)
+{
+    if (!path || !out) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+    size_t want = (uint64_t)st.st_size < PREFIX_BYTES ? (size_t)st.st_size : PREFIX_BYTES;
+    unsigned char *buf = malloc(want ? want : 1);
+    if (!buf) { close(fd); return -1; }
+    ssize_t got = pread(fd, buf, want, 0);
+    int rc = -1;
+    if (got > 0) {
+        struct ox_meta_src src = { buf, (size_t)got, fd, (uint64_t)st.st_size };
+        rc = ox_meta_read(&src, out, NULL);
+    }
+    free(buf);
+    close(fd);
+    return rc;
+}
+
+unsigned char *ox_meta_picture_file(const char *path, size_t *len)
+{
+    if (!path || !len) return NULL;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    unsigned char head[OX_META_SCRATCH];
+    ssize_t got = fstat(fd, &st) == 0 ? pread(fd, head, sizeof(head), 0) : -1;
+    unsigned char *out = NULL;
+    if (got > 0) {
+        struct ox_meta_src src = { head, (size_t)got, fd, (uint64_t)st.st_size };
+        struct ox_meta_picture pic;
+        int found = -1;
+        switch (ox_meta_sniff(head, (size_t)got)) {
+        case OX_META_MP3: {
+            size_t tag = ox_meta_id3_tag_size(head, (size_t)got);
+            unsigned char scratch[4];
+            const unsigned char *p = tag ? ox_meta_src_get(&src, tag, 4, scratch) : NULL;
+            if (p && memcmp(p, "fLaC", 4) == 0) found = ox_meta_flac_picture(&src, tag, &pic);
+            else if (tag && (out = ox_meta_id3_picture_fd(fd, len)) != NULL && *len > OX_META_PICTURE_MAX) { free(out); out = NULL; }
+            break;
+        }
+        case OX_META_FLAC: found = ox_meta_flac_picture(&src, 0, &pic); break;
+        case OX_META_MP4: found = ox_meta_mp4_picture(&src, 0, &pic); break;
+        default: break; /* Ogg METADATA_BLOCK_PICTURE (base64) is not supported */
+        }
+        if (found == 0 && pic.len > 0 && pic.len <= OX_META_PICTURE_MAX && (out = malloc((size_t)pic.len)) != NULL) {
+            if (ox_meta_src_read(&src, pic.off, out, (size_t)pic.len) == pic.len) *len = (size_t)pic.len;
+            else { free(out); out = NULL; }
+        }
+    }
+    close(fd);
+    return out;
+}
@@ -0,0 +1,78 @@
+// meta.h - format-sniffing metadata layer (ID3v2, FLAC, Ogg Vorbis/Opus, MP4)
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "meta_id3.h"
+
+enum ox_meta_format {
+    OX_META_UNKNOWN = 0,
+    OX_META_MP3,
+    OX_META_FLAC,
+    OX_META_VORBIS,
+    OX_META_OPUS,
+    OX_META_MP4
+};
+
+/* Where a metadata reader gets its bytes: a prefix already in memory (e.g. from
+ * a batched read) and, optionally, the open file for anything beyond it.
+ */
+struct ox_meta_src {
+    const unsigned char *buf;
+    size_t buf_len;
+    int fd;        /* -1 for buffer-only sources */
+    uint64_t size; /* file size (buf_len for buffer-only sources) */
+};
+
+#define OX_META_SCRATCH 4096
+
+/* Return n bytes at off: a pointer into src->buf when the prefix covers them,
+ * otherwise they are pread into scratch (n <= OX_META_SCRATCH). NULL if unavailable.
+ */
+const unsigned char *ox_meta_src_get(const struct ox_meta_src *src, uint64_t off, size_t n, unsigned char *scratch);
+
+/* Copy up to n bytes at off into dst (prefix first, then pread). Returns bytes copied. */
+size_t ox_meta_src_read(const struct ox_meta_src *src, uint64_t off, void *dst, size_t n);
+
+/* Identify the container from the first bytes of a file. */
+enum ox_meta_format ox_meta_sniff(const unsigned char *buf, size_t len);
+const char *ox_meta_format_name(enum ox_meta_format f);
+
+/* Fill out from src. Returns 0 if the format was recognised, -1 otherwise.
+ * fmt (optional) receives the detected container.
+ */
+int ox_meta_read(const struct ox_meta_src *src, struct ox_metadata *out, enum ox_meta_format *fmt);
+
+/* Convenience wrappers: buffer only, or a path (reads a 64 KiB prefix, then pread on demand). */
+int ox_meta_parse(const unsigned char *buf, size_t len, struct ox_metadata *out);
+int ox_meta_parse_file(const char *path, struct ox_metadata *out);
+
+/* Apply one NAME=value comment (Vorbis comments, MP4 freeform atoms). First value wins. */
+void ox_meta_set_field(struct ox_metadata *out, const char *name, size_t name_len, const char *value, size_t value_len);
+
+/* Container readers; offset is where the container starts (e.g. after an ID3 prefix).
+ * Besides tags they fill duration_ms, bitrate_kbps, sample_rate and channels from
+ * stream headers only: STREAMINFO, the last Ogg granule position, mvhd/mdhd, and for
+ * MPEG audio a Xing/Info/VBRI header or a sampled frame scan. */
+int ox_meta_flac_read(const struct ox_meta_src *src, uint64_t offset, struct ox_metadata *out);
+int ox_meta_ogg_read(const struct ox_meta_src *src, uint64_t offset, struct ox_metadata *out, enum ox_meta_format *fmt);
+int ox_meta_mp4_read(const struct ox_meta_src *src, uint64_t offset, struct ox_metadata *out);
+int ox_meta_mpeg_read(const struct ox_meta_src *src, uint64_t offset, struct ox_metadata *out);
+
+/* Where an embedded picture's encoded bytes (JPEG/PNG) sit in the file. */
+struct ox_meta_picture {
+    uint64_t off;
+    uint64_t len;
+    int type;      /* APIC/FLAC picture type; 3 = front cover */
+    char mime[32];
+};
+
+#define OX_META_PICTURE_MAX (16u << 20)
+
+/* Locate the front cover (else the first picture): FLAC PICTURE block, MP4 covr. */
+int ox_meta_flac_picture(const struct ox_meta_src *src, uint64_t offset, struct ox_meta_picture *pic);
+int ox_meta_mp4_picture(const struct ox_meta_src *src, uint64_t offset, struct ox_meta_picture *pic);
+
+/* Malloc'd copy of the embedded cover of the file at path (ID3 APIC/PIC, FLAC
+ * PICTURE, MP4 covr), at most OX_META_PICTURE_MAX bytes. NULL if there is none. */
+unsigned char *ox_meta_picture_file(const char *path, size_t *len);
@@ -1,60 +1,428 @@
-// meta_id3.c - minimal safe ID3v2 parser (supports TIT2, TPE1, TALB basic frames)
+// meta_id3.c - zero-copy ID3v2.2/2.3/2.4 parser
+// - frames are walked in place; only spans (offset/length) are recorded
+// - unsynchronised data is the one exception and is resynchronised into tag->owned
+// - text is converted to UTF-8 only when ox_meta_id3_parse fills struct ox_metadata
 
 #define _POSIX_C_SOURCE 200809L
 #include "meta_id3.h"
+#include "utf8.h"
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 static unsigned int syncsafe_to_size(const unsigned char s[4])
 {
     /* ID3v2 syncsafe integer: 4 * 7 bits */
-    return (s[0] << 21) | (s[1] << 14) | (s[2] << 7) | (s[3]);
+    return ((unsigned int)(s[0] & 0x7F) << 21) | ((unsigned int)(s[1] & 0x7F) << 14) |
+           ((unsigned int)(s[2] & 0x7F) << 7) | (unsigned int)(s[3] & 0x7F);
+}
+
+static unsigned int be32(const unsigned char *p)
+{
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+static unsigned int be24(const unsigned char *p)
+{
+    return ((unsigned int)p[0] << 16) | ((unsigned int)p[1] << 8) | p[2];
+}
+
+#define FID(a, b, c, d) (((unsigned int)(a) << 24) | ((unsigned int)(b) << 16) | ((unsigned int)(c) << 8) | (unsigned int)(d))
+
+enum frame_kind { F_OTHER, F_TITLE, F_ARTIST, F_ALBUM, F_YEAR, F_TRACK, F_LENGTH, F_COMM, F_TXXX, F_PIC };
+
+static enum frame_kind frame_kind(const unsigned char *id, int version)
+{
+    if (version == 2) {
+        switch (be24(id)) {
+        case FID(0, 'T', 'T', '2'): return F_TITLE;
+        case FID(0, 'T', 'P', '1'): return F_ARTIST;
+        case FID(0, 'T', 'A', 'L'): return F_ALBUM;
+        case FID(0, 'T', 'Y', 'E'): return F_YEAR;
+        case FID(0, 'T', 'R', 'K'): return F_TRACK;
+        case FID(0, 'T', 'L', 'E'): return F_LENGTH;
+        case FID(0, 'C', 'O', 'M'): return F_COMM;
+        case FID(0, 'T', 'X', 'X'): return F_TXXX;
+        case FID(0, 'P', 'I', 'C'): return F_PIC;
+        default: return F_OTHER;
+        }
+    }
+    switch (be32(id)) {
+    case FID('T', 'I', 'T', '2'): return F_TITLE;
+    case FID('T', 'P', 'E', '1'): return F_ARTIST;
+    case FID('T', 'A', 'L', 'B'): return F_ALBUM;
+    case FID('T', 'Y', 'E', 'R'):
+    case FID('T', 'D', 'R', 'C'): return F_YEAR;
+    case FID('T', 'R', 'C', 'K'): return F_TRACK;
+    case FID('T', 'L', 'E', 'N'): return F_LENGTH;
+    case FID('C', 'O', 'M', 'M'): return F_COMM;
+    case FID('T', 'X', 'X', 'X'): return F_TXXX;
+    case FID('A', 'P', 'I', 'C'): return F_PIC;
+    default: return F_OTHER;
+    }
+}
+
+static int frame_id_ok(const unsigned char *id, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = id[i];
+        if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))) return 0;
+    }
+    return 1;
+}
+
+/* Drop the 0x00 inserted after every 0xFF. dst may not overlap src. */
+static size_t resync(const unsigned char *src, size_t len, unsigned char *dst)
+{
+    size_t o = 0, i = 0;
+    while (i < len) {
+        const unsigned char *ff = memchr(src + i, 0xFF, len - i);
+        size_t run = ff ? (size_t)(ff - (src + i)) + 1 : len - i;
+        memcpy(dst + o, src + i, run);
+        o += run; i += run;
+        if (ff && i < len && src[i] == 0x00) i++;
+    }
+    return o;
+}
+
+/* Offset just past the string terminator starting at p, or len if unterminated. */
+static size_t skip_string(const unsigned char *p, size_t len, int enc)
+{
+    if (enc == 1 || enc == 2) {
+        for (size_t i = 0; i + 1 < len; i += 2)
+            if (p[i] == 0 && p[i+1] == 0) return i + 2;
+        return len;
+    }
+    const unsigned char *z = memchr(p, 0, len);
+    return z ? (size_t)(z - p) + 1 : len;
+}
+
+static size_t text_to_utf8(const unsigned char *p, size_t len, int enc, char *dst, size_t cap)
+{
+    switch (enc) {
+    case 0: return ox_latin1_to_utf8(p, len, dst, cap);
+    case 1:
+        if (len >= 2 && p[0] == 0xFE && p[1] == 0xFF) return ox_utf16_to_utf8(p + 2, len - 2, 1, dst, cap);
+        if (len >= 2 && p[0] == 0xFF && p[1] == 0xFE) return ox_utf16_to_utf8(p + 2, len - 2, 0, dst, cap);
+        return ox_utf16_to_utf8(p, len, 0, dst, cap);
+    case 2: return ox_utf16_to_utf8(p, len, 1, dst, cap);
+    case 3: return ox_utf8_copy(p, len, dst, cap);
+    default:
+        if (cap) dst[0] = '\0';
+        return 0;
+    }
+}
+
+size_t ox_meta_id3_tag_size(const unsigned char *buf, size_t len)
+{
+    if (!buf || len < 10 || memcmp(buf, "ID3", 3) != 0) return 0;
+    if (buf[3] < 2 || buf[3] > 4) return 0;
+    if ((buf[6] | buf[7] | buf[8] | buf[9]) & 0x80) return 0;
+    size_t sz = 10 + (size_t)syncsafe_to_size(&buf[6]);
+    if (buf[3] == 4 && (buf[5] & 0x10)) sz += 10; /* footer */
+    return sz;
+}
+
+/* Body of one frame after flag handling; p points into tag->base or tag->owned. */
+struct frame_view {
+    const unsigned char *p;
+    size_t len;
+    uint8_t flags;
+};
+
+static struct ox_id3_span make_span(const struct ox_id3_tag *tag, const struct frame_view *v,
+                                    const unsigned char *p, size_t len, int enc)
+{
+    struct ox_id3_span s;
+    const unsigned char *origin = (v->flags & OX_ID3_SPAN_OWNED) ? tag->owned : tag->base;
+    s.off = (uint32_t)(p - origin);
+    s.len = (uint32_t)len;
+    s.enc = (uint8_t)enc;
+    s.flags = v->flags;
+    return s;
+}
+
+static void set_text(struct ox_id3_tag *tag, struct ox_id3_span *dst, const struct frame_view *v)
+{
+    if (dst->len || v->len < 2) return; /* first frame wins */
+    *dst = make_span(tag, v, v->p + 1, v->len - 1, v->p[0]);
+}
+
+static void handle_txxx(struct ox_id3_tag *tag, const struct frame_view *v)
+{
+    if (v->len < 2) return;
+    int enc = v->p[0];
+    size_t d = skip_string(v->p + 1, v->len - 1, enc);
+    char desc[32];
+    text_to_utf8(v->p + 1, d, enc, desc, sizeof(desc));
+    struct ox_id3_span *dst = NULL;
+    if (strcasecmp(desc, "REPLAYGAIN_TRACK_GAIN") == 0) dst = &tag->rg_track_gain;
+    else if (strcasecmp(desc, "REPLAYGAIN_TRACK_PEAK") == 0) dst = &tag->rg_track_peak;
+    else if (strcasecmp(desc, "REPLAYGAIN_ALBUM_GAIN") == 0) dst = &tag->rg_album_gain;
+    else if (strcasecmp(desc, "REPLAYGAIN_ALBUM_PEAK") == 0) dst = &tag->rg_album_peak;
+    if (!dst || dst->len) return;
+    *dst = make_span(tag, v, v->p + 1 + d, v->len - 1 - d, enc);
+}
+
+static void handle_comm(struct ox_id3_tag *tag, const struct frame_view *v)
+{
+    if (v->len < 5) return;
+    int enc = v->p[0];
+    const unsigned char *desc = v->p + 4;
+    size_t d = skip_string(desc, v->len - 4, enc);
+    /* prefer the plain comment; skip iTunes' iTunNORM/iTunSMPB blobs */
+    char dtxt[8];
+    text_to_utf8(desc, d, enc, dtxt, sizeof(dtxt));
+    if (strncmp(dtxt, "iTun", 4) == 0) return;
+    if (tag->comment.len && dtxt[0] != '\0') return;
+    tag->comment = make_span(tag, v, desc + d, v->len - 4 - d, enc);
+}
+
+static void handle_pic(struct ox_id3_tag *tag, const struct frame_view *v)
+{
+    if (v->len < 4) return;
+    if (tag->picture.len && tag->picture_type == 3) return; /* already have the front cover */
+    int enc = v->p[0];
+    size_t pos = 1;
+    struct ox_id3_span mime;
+    if (tag->version == 2) {
+        mime = make_span(tag, v, v->p + 1, 3, 0);
+        pos = 4;
+    } else {
+        size_t m = skip_string(v->p + 1, v->len - 1, 0);
+        mime = make_span(tag, v, v->p + 1, m ? m - 1 : 0, 0);
+        pos = 1 + m;
+    }
+    if (pos >= v->len) return;
+    int type = v->p[pos++];
+    pos += skip_string(v->p + pos, v->len - pos, enc);
+    if (pos >= v->len) return;
+    if (tag->picture.len && type != 3) return;
+    tag->picture = make_span(tag, v, v->p + pos, v->len - pos, 0);
+    tag->picture_mime = mime;
+    tag->picture_type = type;
+}
+
+/* Resynchronise a v2.4 frame body into tag->owned. */
+static int resync_frame(struct ox_id3_tag *tag, struct frame_view *v)
+{
+    if (!tag->owned) {
+        tag->owned = malloc(tag->tag_size);
+        if (!tag->owned) return -1;
+        tag->owned_len = 0;
+    }
+    if (tag->owned_len + v->len > tag->tag_size) return -1;
+    unsigned char *dst = tag->owned + tag->owned_len;
+    size_t n = resync(v->p, v->len, dst);
+    tag->owned_len += n;
+    v->p = dst;
+    v->len = n;
+    v->flags |= OX_ID3_SPAN_OWNED;
+    return 0;
+}
+
+/* v2.4 sizes are syncsafe, but iTunes wrote plain big-endian ones for years.
+ * Accept the syncsafe reading unless it lands on garbage and the plain one does not. */
+static size_t v24_frame_size(const unsigned char *base, size_t pos, size_t end)
+{
+    const unsigned char *f = base + pos;
+    unsigned int plain = be32(f + 4);
+    if ((f[4] | f[5] | f[6] | f[7]) & 0x80) return plain;
+    unsigned int ss = syncsafe_to_size(f + 4);
+    if (ss < 0x80) return ss;
+    size_t next_ss = pos + 10 + ss, next_plain = pos + 10 + (size_t)plain;
+    int ss_ok = next_ss == end || (next_ss + 10 <= end && (base[next_ss] == 0 || frame_id_ok(base + next_ss, 4)));
+    if (ss_ok) return ss;
+    int plain_ok = next_plain == end || (next_plain + 10 <= end && (base[next_plain] == 0 || frame_id_ok(base + next_plain, 4)));
+    return plain_ok ? plain : ss;
+}
+
+int ox_meta_id3_scan(const unsigned char *buf, size_t len, struct ox_id3_tag *tag)
+{
+    if (!buf || !tag) return -1;
+    memset(tag, 0, sizeof(*tag));
+    tag->picture_type = -1;
+    size_t tag_size = ox_meta_id3_tag_size(buf, len);
+    if (tag_size == 0) return -1;
+
+    int version = buf[3];
+    int hflags = buf[5];
+    tag->version = version;
+    tag->tag_size = tag_size;
+    tag->base = buf;
+
+    size_t end = 10 + (size_t)syncsafe_to_size(&buf[6]);
+    if (end > len) end = len;
+    if (version == 2 && (hflags & 0x40)) return -1; /* v2.2 compression: no defined scheme */
+
+    if (version < 4 && (hflags & 0x80)) {
+        /* v2.2/2.3 unsynchronisation covers frame headers too: resync the whole tag */
+        tag->owned = malloc(end);
+        if (!tag->owned) return -1;
+        memcpy(tag->owned, buf, 10);
+        end = 10 + resync(buf + 10, end - 10, tag->owned + 10);
+        tag->owned_len = end;
+        tag->base = tag->owned;
+    }
+    const unsigned char *base = tag->base;
+
+    size_t pos = 10;
+    if (version >= 3 && (hflags & 0x40)) {
+        if (pos + 4 > end) return 0;
+        size_t ext = version == 3 ? 4 + (size_t)be32(base + pos) : syncsafe_to_size(base + pos);
+        if (ext > end - pos) return 0;
+        pos += ext;
+    }
+
+    const size_t hdr = version == 2 ? 6 : 10;
+    const size_t idlen = version == 2 ? 3 : 4;
+    while (pos + hdr <= end) {
+        const unsigned char *f = base + pos;
+        if (f[0] == 0) break; /* padding */
+        if (!frame_id_ok(f, idlen)) break;
+        size_t fsize;
+        if (version == 2) fsize = be24(f + 3);
+        else if (version == 3) fsize = be32(f + 4);
+        else fsize = v24_frame_size(base, pos, end);
+        if (fsize > end - pos - hdr) break; /* malformed */
+
+        struct frame_view v = { f + hdr, fsize, 0 };
+        enum frame_kind kind = frame_kind(f, version);
+        int skip = (kind == F_OTHER);
+        if (!skip && version == 3) {
+            if (f[9] & 0xC0) skip = 1;          /* compressed / encrypted */
+            else if (f[9] & 0x20) { v.p++; v.len = v.len ? v.len - 1 : 0; } /* group id */
+        } else if (!skip && version == 4) {
+            unsigned char fl = f[9];
+            if (fl & 0x0C) skip = 1;            /* compressed / encrypted */
+            if (!skip && (fl & 0x40)) { if (v.len < 1) skip = 1; else { v.p += 1; v.len -= 1; } }
+            if (!skip && (fl & 0x01)) { if (v.len < 4) skip = 1; else { v.p += 4; v.len -= 4; } }
+            if (!skip && ((fl & 0x02) || (hflags & 0x80)) && resync_frame(tag, &v) != 0) skip = 1;
+        }
+        if (!skip && v.len > 0) {
+            switch (kind) {
+            case F_TITLE: set_text(tag, &tag->title, &v); break;
+            case F_ARTIST: set_text(tag, &tag->artist, &v); break;
+            case F_ALBUM: set_text(tag, &tag->album, &v); break;
+            case F_YEAR: set_text(tag, &tag->year, &v); break;
+            case F_TRACK: set_text(tag, &tag->track, &v); break;
+            case F_LENGTH: set_text(tag, &tag->length, &v); break;
+            case F_COMM: handle_comm(tag, &v); break;
+            case F_TXXX: handle_txxx(tag, &v); break;
+            case F_PIC: handle_pic(tag, &v); break;
+            default: break;
+            }
+        }
+        pos += hdr + fsize;
+    }
+    return 0;
+}
+
+void ox_meta_id3_release(struct ox_id3_tag *tag)
+{
+    if (!tag) return;
+    free(tag->owned);
+    tag->owned = NULL;
+    tag->owned_len = 0;
+}
+
+size_t ox_meta_id3_text(const struct ox_id3_tag *tag, const struct ox_id3_span *s, char *dst, size_t cap)
+{
+    if (!dst || cap == 0) return 0;
+    if (!tag || !s || s->len == 0) { dst[0] = '\0'; return 0; }
+    return text_to_utf8(ox_meta_id3_span_ptr(tag, s), s->len, s->enc, dst, cap);
+}
+
+static int leading_int(const char *s)
+{
+    while (*s == ' ') s++;
+    return atoi(s);
+}
+
+static float span_float(const struct ox_id3_tag *tag, const struct ox_id3_span *s)
+{
+    char tmp[32];
+    if (ox_meta_id3_text(tag, s, tmp, sizeof(tmp)) == 0) return 0.0f;
+    return strtof(tmp, NULL); /* "-6.48 dB" -> -6.48 */
 }
 
 int ox_meta_id3_parse(const unsigned char *buf, size_t len, struct ox_metadata *out)
 {
     if (!buf || !out || len < 10) return -1;
-    if (memcmp(buf, "ID3", 3) != 0) return -1;
-
-    unsigned int tag_size = syncsafe_to_size(&buf[6]);
-    if (tag_size + 10 > len) tag_size = (unsigned int)(len - 10);
+    struct ox_id3_tag tag;
+    if (ox_meta_id3_scan(buf, len, &tag) != 0) { ox_meta_id3_release(&tag); return -1; }
 
     memset(out, 0, sizeof(*out));
+    char tmp[32];
+    ox_meta_id3_text(&tag, &tag.title, out->title, sizeof(out->title));
+    ox_meta_id3_text(&tag, &tag.artist, out->artist, sizeof(out->artist));
+    ox_meta_id3_text(&tag, &tag.album, out->album, sizeof(out->album));
+    ox_meta_id3_text(&tag, &tag.comment, out->comment, sizeof(out->comment));
+    if (ox_meta_id3_text(&tag, &tag.year, tmp, sizeof(tmp))) out->year = leading_int(tmp); /* "2004-05-01" -> 2004 */
+    if (ox_meta_id3_text(&tag, &tag.track, tmp, sizeof(tmp))) out->track = leading_int(tmp); /* "3/12" -> 3 */
+    if (ox_meta_id3_text(&tag, &tag.length, tmp, sizeof(tmp))) out->duration_sec = (int)((atol(tmp) + 500) / 1000);
+    out->rg_track_gain = span_float(&tag, &tag.rg_track_gain);
+    out->rg_track_peak = span_float(&tag, &tag.rg_track_peak);
+    out->rg_album_gain = span_float(&tag, &tag.rg_album_gain);
+    out->rg_album_peak = span_float(&tag, &tag.rg_album_peak);
+    ox_meta_id3_release(&tag);
+    return 0;
+}
 
-    size_t pos = 10; /* start of frames */
-    while (pos + 10 <= 10 + tag_size) {
-        const unsigned char *f = buf + pos;
-        char frame_id[5] = {0};
-        memcpy(frame_id, f, 4);
-        unsigned int frame_size = (f[4] << 24) | (f[5] << 16) | (f[6] << 8) | (f[7]);
-
-        if (frame_size == 0) break;
-        if (pos + 10 + frame_size > 10 + tag_size) break; /* malformed */
-        const unsigned char *pdata = f + 10;
-        if (strcmp(frame_id, "TIT2") == 0) {
-            /* text encoding byte then utf-8/iso-8859-1 text */
-            if (frame_size >= 1) {
-                size_t sl = frame_size - 1;
-                size_t copy = sl < sizeof(out->title)-1 ? sl : sizeof(out->title)-1;
-                memcpy(out->title, pdata+1, copy);
-                out->title[copy] = '\0';
-            }
-        } else if (strcmp(frame_id, "TPE1") == 0) {
-            if (frame_size >= 1) {
-                size_t sl = frame_size - 1;
-                size_t copy = sl < sizeof(out->artist)-1 ? sl : sizeof(out->artist)-1;
-                memcpy(out->artist, pdata+1, copy);
-                out->artist[copy] = '\0';
-            }
-        } else if (strcmp(frame_id, "TALB") == 0) {
-            if (frame_size >= 1) {
-                size_t sl = frame_size - 1;
-                size_t copy = sl < sizeof(out->album)-1 ? sl : sizeof(out->album)-1;
-                memcpy(out->album, pdata+1, copy);
-                out->album[copy] = '\0';
+int ox_meta_id3_parse_fd(int fd, struct ox_metadata *out)
+{
+    if (fd < 0 || !out) return -1;
+    unsigned char hdr[10];
+    struct stat st;
+    if (pread(fd, hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) || fstat(fd, &st) != 0) return -1;
+    size_t want = ox_meta_id3_tag_size(hdr, sizeof(hdr));
+    if (want == 0) return -1;
+    if ((off_t)want > st.st_size) want = (size_t)st.st_size;
+    /* only the tag prefix is mapped; frames we skip (e.g. large APIC bodies) are never faulted in */
+    void *m = mmap(NULL, want, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED) return -1;
+    int rc = ox_meta_id3_parse(m, want, out);
+    munmap(m, want);
+    return rc;
+}
+
+unsigned char *ox_meta_id3_picture_fd(int fd, size_t *len)
+{
+    unsigned char hdr[10];
+    struct stat st;
+    if (fd < 0 || !len || pread(fd, hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) || fstat(fd, &st) != 0) return NULL;
+    size_t want = ox_meta_id3_tag_size(hdr, sizeof(hdr));
+    if (want == 0) return NULL;
+    if ((off_t)want > st.st_size) want = (size_t)st.st_size;
+    void *m = mmap(NULL, want, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED) return NULL;
+    unsigned char *out = NULL;
+    struct ox_id3_tag tag;
+    if (ox_meta_id3_scan(m, want, &tag) == 0) {
+        if (tag.picture.len) {
+            out = malloc(tag.picture.len);
+            if (out) {
+                memcpy(out, ox_meta_id3_span_ptr(&tag, &tag.picture), tag.picture.len);
+                *len = tag.picture.len;
             }
         }
-        pos += 10 + frame_size;
+        ox_meta_id3_release(&tag);
     }
-    return 0;
+    munmap(m, want);
+    return out;
+}
+
+int ox_meta_id3_parse_file(const char *path, struct ox_metadata *out)
+{
+    if (!path || !out) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int rc = ox_meta_id3_parse_fd(fd, out);
+    close(fd);
+    return rc;
 }
@@ -1,18 +1,80 @@
-// meta_id3.h - minimal ID3v2 tag parser (subset) for OXXY
+// meta_id3.h - zero-copy ID3v2.2/2.3/2.4 tag parser for OXXY
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 struct ox_metadata {
     char title[256];
     char artist[256];
     char album[256];
+    char comment[256];
     int year;
     int track;
-    int duration_sec; /* optional */
+    int duration_sec; /* rounded duration_ms, else ID3 TLEN; 0 if unknown */
+    int duration_ms;  /* from stream headers (no decoding), 0 if unknown */
+    int bitrate_kbps; /* average over the audio data */
+    int sample_rate;
+    int channels;
+    float rg_track_gain; /* ReplayGain in dB, 0 if absent */
+    float rg_album_gain;
+    float rg_track_peak;
+    float rg_album_peak;
 };
 
+/* Location of a frame payload inside the scanned tag. Nothing is copied:
+ * resolve with ox_meta_id3_span_ptr(). len == 0 means "frame not present".
+ */
+struct ox_id3_span {
+    uint32_t off;
+    uint32_t len;
+    uint8_t enc;   /* ID3 text encoding: 0 latin1, 1 UTF-16+BOM, 2 UTF-16BE, 3 UTF-8 */
+    uint8_t flags; /* OX_ID3_SPAN_* */
+};
+
+#define OX_ID3_SPAN_OWNED 0x01 /* offset refers to tag->owned (resynchronised frame) */
+
+struct ox_id3_tag {
+    const unsigned char *base; /* buffer spans index into (caller's buffer, or owned) */
+    unsigned char *owned;      /* only allocated for unsynchronised tags/frames */
+    size_t owned_len;
+    int version;               /* 2, 3 or 4 */
+    size_t tag_size;           /* total bytes incl. header and footer */
+    struct ox_id3_span title, artist, album, year, track, length, comment;
+    struct ox_id3_span rg_track_gain, rg_track_peak, rg_album_gain, rg_album_peak;
+    struct ox_id3_span picture;      /* raw image bytes of the preferred APIC/PIC */
+    struct ox_id3_span picture_mime; /* latin1 MIME type (or v2.2 "JPG"/"PNG") */
+    int picture_type;                /* APIC picture type, -1 if no picture */
+};
+
+/* Total size of the tag starting at buf (header + body + footer), or 0 if buf
+ * does not start with an ID3v2 header. Needs only the first 10 bytes. */
+size_t ox_meta_id3_tag_size(const unsigned char *buf, size_t len);
+
+/* Walk all frames of the tag at buf and record spans of the interesting ones.
+ * Returns 0 on success, -1 on error. The tag references buf: keep buf alive
+ * while using it and call ox_meta_id3_release() afterwards.
+ */
+int ox_meta_id3_scan(const unsigned char *buf, size_t len, struct ox_id3_tag *tag);
+void ox_meta_id3_release(struct ox_id3_tag *tag);
+
+static inline const unsigned char *ox_meta_id3_span_ptr(const struct ox_id3_tag *tag, const struct ox_id3_span *s)
+{
+    return ((s->flags & OX_ID3_SPAN_OWNED) ? tag->owned : tag->base) + s->off;
+}
+
+/* Convert a text span to NUL-terminated UTF-8 in dst. Returns bytes written. */
+size_t ox_meta_id3_text(const struct ox_id3_tag *tag, const struct ox_id3_span *s, char *dst, size_t cap);
+
 /* Parse ID3v2 tag from memory buffer (buf,len). Returns 0 on success, -1 on error.
- * This is a minimal, robust parser: it stops on malformed data and bounds-checks.
+ * This is a robust parser: it stops on malformed data and bounds-checks.
  */
 int ox_meta_id3_parse(const unsigned char *buf, size_t len, struct ox_metadata *out);
+
+/* Map only the tag prefix of the file (fd or path) and parse it. Returns 0 on success. */
+int ox_meta_id3_parse_fd(int fd, struct ox_metadata *out);
+int ox_meta_id3_parse_file(const char *path, struct ox_metadata *out);
+
+/* Malloc'd copy of the preferred APIC/PIC payload of the tag at the start of fd,
+ * or NULL. Only the tag is mapped. */
+unsigned char *ox_meta_id3_picture_fd(int fd, size_t *len);
@@ -0,0 +1,235 @@
+// meta_mp4.c - MP4/M4A metadata reader (moov/udta/meta/ilst)
+// - walks box headers only; mdat and other large boxes are skipped by size,
+//   so a moov placed after the media data costs a handful of small reads
+// - duration from the first audio track's mdhd (mvhd as fallback), channels and
+//   rate from its stsd sample entry, bitrate from the mdat size
+
+#define _POSIX_C_SOURCE 200809L
+#include "meta.h"
+#include <string.h>
+#include <stdio.h>
+
+#define MP4_MAX_BOXES 4096
+#define MP4_VALUE_MAX 512
+
+#define BOX(a, b, c, d) (((uint32_t)(unsigned char)(a) << 24) | ((uint32_t)(unsigned char)(b) << 16) | \
+                         ((uint32_t)(unsigned char)(c) << 8) | (uint32_t)(unsigned char)(d))
+
+struct mp4_box {
+    uint32_t type;
+    uint64_t start; /* offset of the payload */
+    uint64_t end;   /* offset just past the box */
+};
+
+static uint32_t be32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int box_at(const struct ox_meta_src *src, uint64_t off, uint64_t limit, struct mp4_box *b)
+{
+    unsigned char scratch[16];
+    if (off + 8 > limit) return -1;
+    const unsigned char *p = ox_meta_src_get(src, off, 8, scratch);
+    if (!p) return -1;
+    uint64_t size = be32(p);
+    uint32_t type = be32(p + 4);
+    uint64_t hdr = 8;
+    if (size == 1) {
+        if (off + 16 > limit) return -1;
+        p = ox_meta_src_get(src, off + 8, 8, scratch);
+        if (!p) return -1;
+        size = ((uint64_t)be32(p) << 32) | be32(p + 4);
+        hdr = 16;
+    } else if (size == 0) {
+        size = limit - off; /* extends to the end of the enclosing box/file */
+    }
+    if (size < hdr || size > limit - off) return -1;
+    b->type = type;
+    b->start = off + hdr;
+    b->end = off + size;
+    return 0;
+}
+
+static int find_child(const struct ox_meta_src *src, uint64_t start, uint64_t end, uint32_t type, struct mp4_box *out)
+{
+    uint64_t pos = start;
+    for (int i = 0; i < MP4_MAX_BOXES && pos < end; ++i) {
+        if (box_at(src, pos, end, out) != 0) return -1;
+        if (out->type == type) return 0;
+        pos = out->end;
+    }
+    return -1;
+}
+
+/* Payload of the 'data' child of an ilst item (after type + locale), truncated to cap. */
+static const unsigned char *item_data(const struct ox_meta_src *src, const struct mp4_box *item,
+                                      unsigned char *scratch, size_t *len)
+{
+    struct mp4_box d;
+    if (find_child(src, item->start, item->end, BOX('d', 'a', 't', 'a'), &d) != 0) return NULL;
+    if (d.end - d.start < 8) return NULL;
+    uint64_t n = d.end - d.start - 8;
+    if (n > MP4_VALUE_MAX) n = MP4_VALUE_MAX;
+    *len = (size_t)n;
+    return ox_meta_src_get(src, d.start + 8, (size_t)n, scratch);
+}
+
+static void read_freeform(const struct ox_meta_src *src, const struct mp4_box *item, struct ox_metadata *out)
+{
+    /* ----: mean ("com.apple.iTunes"), name ("replaygain_track_gain"), data */
+    struct mp4_box nb;
+    if (find_child(src, item->start, item->end, BOX('n', 'a', 'm', 'e'), &nb) != 0) return;
+    if (nb.end - nb.start < 4 || nb.end - nb.start > 64 + 4) return;
+    unsigned char nscratch[72], vscratch[MP4_VALUE_MAX];
+    size_t nlen = (size_t)(nb.end - nb.start - 4);
+    const unsigned char *name = ox_meta_src_get(src, nb.start + 4, nlen, nscratch);
+    if (!name) return;
+    size_t vlen = 0;
+    const unsigned char *v = item_data(src, item, vscratch, &vlen);
+    if (v) ox_meta_set_field(out, (const char *)name, nlen, (const char *)v, vlen);
+}
+
+static void read_item(const struct ox_meta_src *src, const struct mp4_box *item, struct ox_metadata *out)
+{
+    unsigned char scratch[MP4_VALUE_MAX];
+    size_t len = 0;
+    const unsigned char *v;
+    const char *field = NULL;
+    switch (item->type) {
+    case BOX(0xA9, 'n', 'a', 'm'): field = "TITLE"; break;
+    case BOX(0xA9, 'A', 'R', 'T'): field = "ARTIST"; break;
+    case BOX(0xA9, 'a', 'l', 'b'): field = "ALBUM"; break;
+    case BOX(0xA9, 'd', 'a', 'y'): field = "DATE"; break;
+    case BOX(0xA9, 'c', 'm', 't'): field = "COMMENT"; break;
+    case BOX('t', 'r', 'k', 'n'):
+        /* binary: 2 pad bytes, 16-bit track, 16-bit total */
+        v = item_data(src, item, scratch, &len);
+        if (v && len >= 4 && !out->track) out->track = (v[2] << 8) | v[3];
+        return;
+    case BOX('-', '-', '-', '-'):
+        read_freeform(src, item, out);
+        return;
+    default:
+        return;
+    }
+    v = item_data(src, item, scratch, &len);
+    if (v) ox_meta_set_field(out, field, strlen(field), (const char *)v, len);
+}
+
+/* mvhd/mdhd: version 0 has 32-bit times and duration, version 1 64-bit. */
+static int read_timing(const struct ox_meta_src *src, const struct mp4_box *b, uint32_t *scale, uint64_t *duration)
+{
+    unsigned char scratch[32];
+    const unsigned char *p = ox_meta_src_get(src, b->start, 4, scratch);
+    if (!p) return -1;
+    if (p[0] == 1) {
+        if (b->end - b->start < 32 || !(p = ox_meta_src_get(src, b->start, 32, scratch))) return -1;
+        *scale = be32(p + 20);
+        *duration = ((uint64_t)be32(p + 24) << 32) | be32(p + 28);
+    } else {
+        if (b->end - b->start < 20 || !(p = ox_meta_src_get(src, b->start, 20, scratch))) return -1;
+        *scale = be32(p + 12);
+        *duration = be32(p + 16);
+        if (*duration == UINT32_MAX) return -1; /* unknown */
+    }
+    return *scale ? 0 : -1;
+}
+
+/* First trak whose handler is 'soun': fills its mdia box. */
+static int audio_track(const struct ox_meta_src *src, const struct mp4_box *moov, struct mp4_box *mdia)
+{
+    unsigned char scratch[12];
+    uint64_t pos = moov->start;
+    struct mp4_box trak, hdlr;
+    for (int i = 0; i < MP4_MAX_BOXES && pos < moov->end; ++i) {
+        if (box_at(src, pos, moov->end, &trak) != 0) return -1;
+        pos = trak.end;
+        if (trak.type != BOX('t', 'r', 'a', 'k')) continue;
+        if (find_child(src, trak.start, trak.end, BOX('m', 'd', 'i', 'a'), mdia) != 0) continue;
+        if (find_child(src, mdia->start, mdia->end, BOX('h', 'd', 'l', 'r'), &hdlr) != 0 || hdlr.end - hdlr.start < 12) continue;
+        const unsigned char *p = ox_meta_src_get(src, hdlr.start, 12, scratch);
+        if (p && be32(p + 8) == BOX('s', 'o', 'u', 'n')) return 0;
+    }
+    return -1;
+}
+
+static void read_stream_info(const struct ox_meta_src *src, uint64_t offset, const struct mp4_box *moov, struct ox_metadata *out)
+{
+    uint32_t scale = 0;
+    uint64_t duration = 0;
+    struct mp4_box mdia, b, minf, stbl, stsd;
+    int have = 0;
+    if (audio_track(src, moov, &mdia) == 0) {
+        if (find_child(src, mdia.start, mdia.end, BOX('m', 'd', 'h', 'd'), &b) == 0)
+            have = read_timing(src, &b, &scale, &duration) == 0;
+        /* stsd: full box, entry count, then the sample entry (mp4a, alac...):
+         * 8 reserved/index bytes, 8 version/vendor bytes, channels, size, 4 bytes, 16.16 rate */
+        unsigned char scratch[28];
+        const unsigned char *p;
+        if (find_child(src, mdia.start, mdia.end, BOX('m', 'i', 'n', 'f'), &minf) == 0 &&
+            find_child(src, minf.start, minf.end, BOX('s', 't', 'b', 'l'), &stbl) == 0 &&
+            find_child(src, stbl.start, stbl.end, BOX('s', 't', 's', 'd'), &stsd) == 0 &&
+            stsd.end - stsd.start >= 8 + 8 + 28 && (p = ox_meta_src_get(src, stsd.start + 16, 28, scratch)) != NULL) {
+            out->channels = (p[16] << 8) | p[17];
+            out->sample_rate = (int)(be32(p + 24) >> 16);
+        }
+    }
+    if (!have && find_child(src, moov->start, moov->end, BOX('m', 'v', 'h', 'd'), &b) == 0)
+        have = read_timing(src, &b, &scale, &duration) == 0;
+    if (!have) return;
+    if (!out->sample_rate) out->sample_rate = (int)scale;
+    double secs = (double)duration / scale;
+    if (secs <= 0 || secs > 1e6) return;
+    out->duration_ms = (int)(secs * 1000.0 + 0.5);
+    uint64_t bytes = src->size - offset;
+    if (find_child(src, offset, src->size, BOX('m', 'd', 'a', 't'), &b) == 0) bytes = b.end - b.start;
+    out->bitrate_kbps = (int)(bytes * 8 / secs / 1000.0 + 0.5);
+}
+
+static int find_ilst(const struct ox_meta_src *src, const struct mp4_box *moov, struct mp4_box *ilst)
+{
+    struct mp4_box udta, meta, probe;
+    if (find_child(src, moov->start, moov->end, BOX('u', 'd', 't', 'a'), &udta) != 0) return -1;
+    if (find_child(src, udta.start, udta.end, BOX('m', 'e', 't', 'a'), &meta) != 0) return -1;
+    /* ISO 'meta' is a full box (4 bytes version/flags); QuickTime's is not */
+    uint64_t mstart = meta.start;
+    if (box_at(src, mstart, meta.end, &probe) != 0 || probe.type != BOX('h', 'd', 'l', 'r')) mstart += 4;
+    return find_child(src, mstart, meta.end, BOX('i', 'l', 's', 't'), ilst);
+}
+
+int ox_meta_mp4_read(const struct ox_meta_src *src, uint64_t offset, struct ox_metadata *out)
+{
+    struct mp4_box moov, ilst;
+    if (find_child(src, offset, src->size, BOX('m', 'o', 'o', 'v'), &moov) != 0) return -1;
+    read_stream_info(src, offset, &moov, out);
+    if (find_ilst(src, &moov, &ilst) != 0) return 0;
+
+    uint64_t pos = ilst.start;
+    struct mp4_box item;
+    for (int i = 0; i < MP4_MAX_BOXES && pos < ilst.end; ++i) {
+        if (box_at(src, pos, ilst.end, &item) != 0) break;
+        read_item(src, &item, out);
+        pos = item.end;
+    }
+    return 0;
+}
+
+int ox_meta_mp4_picture(const struct ox_meta_src *src, uint64_t offset, struct ox_meta_picture *pic)
+{
+    struct mp4_box moov, ilst, covr, data;
+    unsigned char scratch[8];
+    if (find_child(src, offset, src->size, BOX('m', 'o', 'o', 'v'), &moov) != 0) return -1;
+    if (find_ilst(src, &moov, &ilst) != 0) return -1;
+    if (find_child(src, ilst.start, ilst.end, BOX('c', 'o', 'v', 'r'), &covr) != 0) return -1;
+    if (find_child(src, covr.start, covr.end, BOX('d', 'a', 't', 'a'), &data) != 0 || data.end - data.start <= 8) return -1;
+    const unsigned char *p = ox_meta_src_get(src, data.start, 8, scratch);
+    if (!p) return -1;
+    uint32_t kind = be32(p) & 0xFFFFFF; /* 13 JPEG, 14 PNG */
+    memset(pic, 0, sizeof(*pic));
+    pic->off = data.start + 8;
+    pic->len = data.end - data.start - 8;
+    pic->type = 3;
+    snprintf(pic->mime, sizeof(pic->mime), "%s", kind == 14 ? "image/png" : "image/jpeg");
+    return 0;
+}
@@ -0,0 +1,168 @@
+// meta_mpeg.c - MPEG audio (MP1/2/3) duration and bitrate without decoding
+// - VBR files normally carry a Xing/Info or VBRI header in the first frame with
+//   the exact frame count; otherwise a few short windows across the stream are
+//   sampled and the average frame size is extrapolated (exact for CBR)
+
+#define _POSIX_C_SOURCE 200809L
+#include "meta.h"
+#include <string.h>
+
+#define SYNC_SEARCH (64 * 1024) /* junk tolerated between the tag and the first frame */
+#define SAMPLE_WINDOWS 4
+
+struct mpeg_frame {
+    int lsf;          /* MPEG-2/2.5 (low sampling frequency) */
+    int layer;        /* 1..3 */
+    int kbps;
+    int rate;
+    int mono;
+    uint32_t len;     /* bytes including header */
+    uint32_t samples; /* per frame */
+};
+
+static const unsigned short kbps_table[2][3][15] = {
+    { /* MPEG-1 */
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+    },
+    { /* MPEG-2 / 2.5 */
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+    },
+};
+
+static const int rate_table[3][3] = {
+    { 44100, 48000, 32000 }, /* MPEG-1 */
+    { 22050, 24000, 16000 }, /* MPEG-2 */
+    { 11025, 12000, 8000 },  /* MPEG-2.5 */
+};
+
+static uint32_t be32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* Decode a 4-byte frame header; free-format and reserved values are rejected. */
+static int parse_frame(const unsigned char *p, struct mpeg_frame *f)
+{
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) return -1;
+    int ver = (p[1] >> 3) & 3, layer_bits = (p[1] >> 1) & 3;
+    int br = p[2] >> 4, sr = (p[2] >> 2) & 3, pad = (p[2] >> 1) & 1;
+    if (ver == 1 || layer_bits == 0 || br == 0 || br == 15 || sr == 3) return -1;
+    f->lsf = ver != 3;
+    f->layer = 4 - layer_bits;
+    f->kbps = kbps_table[f->lsf][f->layer - 1][br];
+    f->rate = rate_table[ver == 3 ? 0 : ver == 2 ? 1 : 2][sr];
+    f->mono = (p[3] >> 6) == 3;
+    if (f->layer == 1) {
+        f->samples = 384;
+        f->len = (uint32_t)((12 * f->kbps * 1000 / f->rate + pad) * 4);
+    } else {
+        f->samples = f->layer == 3 && f->lsf ? 576 : 1152;
+        f->len = (uint32_t)(f->samples / 8 * f->kbps * 1000 / f->rate + pad);
+    }
+    return f->len >= 4 ? 0 : -1;
+}
+
+static int same_stream(const struct mpeg_frame *a, const struct mpeg_frame *b)
+{
+    return a->lsf == b->lsf && a->layer == b->layer && a->rate == b->rate;
+}
+
+/* First offset in [from, limit) holding a frame whose successor header also
+ * parses: two chained headers make a false sync in tag or audio data unlikely. */
+static int find_sync(const struct ox_meta_src *src, uint64_t from, uint64_t limit, uint64_t *at, struct mpeg_frame *f)
+{
+    unsigned char scratch[OX_META_SCRATCH], next[4];
+    uint64_t pos = from;
+    while (pos + 4 <= limit) {
+        size_t n = limit - pos < sizeof(scratch) ? (size_t)(limit - pos) : sizeof(scratch);
+        const unsigned char *p = ox_meta_src_get(src, pos, n, scratch);
+        if (!p) return -1;
+        for (size_t i = 0; i + 4 <= n; ++i) {
+            if (p[i] != 0xFF || parse_frame(p + i, f) != 0) continue;
+            struct mpeg_frame g;
+            uint64_t nx = pos + i + f->len;
+            const unsigned char *q = nx + 4 <= src->size ? ox_meta_src_get(src, nx, 4, next) : NULL;
+            if (nx + 4 > src->size || (q && parse_frame(q, &g) == 0 && same_stream(f, &g))) {
+                *at = pos + i;
+                return 0;
+            }
+        }
+        if (n < 4) break;
+        pos += n - 3;
+    }
+    return -1;
+}
+
+/* Xing/Info (LAME, most VBR encoders) or VBRI (Fraunhofer) in the first frame. */
+static int vbr_header(const unsigned char *p, size_t n, const struct mpeg_frame *f, uint32_t *frames, uint32_t *bytes)
+{
+    size_t side = f->lsf ? (f->mono ? 9 : 17) : (f->mono ? 17 : 32);
+    size_t x = 4 + side;
+    if (x + 16 <= n && (memcmp(p + x, "Xing", 4) == 0 || memcmp(p + x, "Info", 4) == 0)) {
+        uint32_t flags = be32(p + x + 4);
+        size_t q = x + 8;
+        *frames = *bytes = 0;
+        if (flags & 1) { *frames = be32(p + q); q += 4; }
+        if ((flags & 2) && q + 4 <= n) *bytes = be32(p + q);
+        return *frames ? 0 : -1;
+    }
+    if (36 + 18 <= n && memcmp(p + 36, "VBRI", 4) == 0) {
+        *bytes = be32(p + 36 + 10);
+        *frames = be32(p + 36 + 14);
+        return *frames ? 0 : -1;
+    }
+    return -1;
+}
+
+int ox_meta_mpeg_read(const struct ox_meta_src *src, uint64_t offset, struct ox_metadata *out)
+{
+    if (!src || !out || offset >= src->size) return -1;
+    uint64_t end = src->size;
+    unsigned char scratch[OX_META_SCRATCH];
+    const unsigned char *t = end >= offset + 128 ? ox_meta_src_get(src, end - 128, 3, scratch) : NULL;
+    if (t && memcmp(t, "TAG", 3) == 0) end -= 128; /* ID3v1 */
+
+    uint64_t first;
+    struct mpeg_frame f;
+    uint64_t search_end = end - offset > SYNC_SEARCH ? offset + SYNC_SEARCH : end;
+    if (find_sync(src, offset, search_end, &first, &f) != 0) return -1;
+    out->sample_rate = f.rate;
+    out->channels = f.mono ? 1 : 2;
+
+    uint64_t audio = end - first;
+    double frames = 0;
+    size_t n = audio < sizeof(scratch) ? (size_t)audio : sizeof(scratch);
+    const unsigned char *p = ox_meta_src_get(src, first, n, scratch);
+    uint32_t vbr_frames = 0, vbr_bytes = 0;
+    if (p && vbr_header(p, n, &f, &vbr_frames, &vbr_bytes) == 0) {
+        frames = vbr_frames;
+        if (vbr_bytes && vbr_bytes <= audio) audio = vbr_bytes;
+    } else {
+        /* walk the frames inside a few windows spread over the stream */
+        uint64_t sampled_bytes = 0, sampled_frames = 0;
+        for (int w = 0; w < SAMPLE_WINDOWS; ++w) {
+            uint64_t at = first + audio * (uint64_t)w / SAMPLE_WINDOWS, pos;
+            struct mpeg_frame g;
+            uint64_t lim = end - at > sizeof(scratch) ? at + sizeof(scratch) : end;
+            if (w > 0 && find_sync(src, at, lim, &at, &g) != 0) continue;
+            n = end - at < sizeof(scratch) ? (size_t)(end - at) : sizeof(scratch);
+            p = ox_meta_src_get(src, at, n, scratch);
+            if (!p) continue;
+            for (pos = 0; pos + 4 <= n && parse_frame(p + pos, &g) == 0 && same_stream(&f, &g) && pos + g.len <= n; pos += g.len) {
+                sampled_bytes += g.len;
+                sampled_frames++;
+            }
+        }
+        if (!sampled_frames) return -1;
+        frames = (double)audio * (double)sampled_frames / (double)sampled_bytes;
+    }
+    double secs = frames * f.samples / f.rate;
+    if (secs <= 0 || secs > 1e6) return -1;
+    out->duration_ms = (int)(secs * 1000.0 + 0.5);
+    out->bitrate_kbps = (int)(audio * 8 / secs / 1000.0 + 0.5);
+    return 0;
+}
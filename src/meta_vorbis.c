@@ -0,0 +1,269 @@
+// meta_vorbis.c - Vorbis comment reader for FLAC METADATA_BLOCKs and Ogg Vorbis/Opus
+// - comments are read through a cursor that only touches the bytes it needs:
+//   uninteresting or oversized fields (e.g. embedded pictures) are skipped, and
+//   for Ogg only page headers are read while skipping across pages
+// - duration comes from STREAMINFO (FLAC) or the granule position of the last
+//   Ogg page, found with a single read of the file tail
+
+#define _POSIX_C_SOURCE 200809L
+#include "meta.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define VC_MAX_COMMENTS 4096
+#define OGG_TAIL (65536 + 27 + 255) /* one maximum-size page */
+#define VC_HEAD 600 /* enough for any field name we care about plus a 256-byte value */
+
+struct vc_cursor {
+    const struct ox_meta_src *src;
+    uint64_t pos;       /* file offset of the next packet byte */
+    uint64_t run;       /* packet bytes readable at pos before a page/block boundary */
+    int ogg;
+    int last;           /* ogg: the packet ends inside the current page */
+    uint64_t next_page; /* ogg: offset of the following page */
+    uint32_t serial;
+};
+
+static uint32_t le32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Parse the Ogg page header at off and set up the cursor for the packet data
+ * starting at the first segment. Requires `continued` to match the page flag. */
+static int ogg_page(struct vc_cursor *c, uint64_t off, int continued)
+{
+    unsigned char scratch[27 + 255];
+    const unsigned char *h = ox_meta_src_get(c->src, off, 27, scratch);
+    if (!h || memcmp(h, "OggS", 4) != 0 || h[4] != 0) return -1;
+    if (((h[5] & 0x01) != 0) != (continued != 0)) return -1;
+    uint32_t serial = le32(h + 14);
+    if (c->serial && serial != c->serial) return -1;
+    c->serial = serial;
+    size_t nseg = h[26];
+    const unsigned char *lace = ox_meta_src_get(c->src, off + 27, nseg, scratch);
+    if (!lace && nseg) return -1;
+    uint64_t run = 0, total = 0;
+    int ended = 0;
+    for (size_t i = 0; i < nseg; ++i) {
+        if (!ended) {
+            run += lace[i];
+            if (lace[i] < 255) ended = 1;
+        }
+        total += lace[i];
+    }
+    c->pos = off + 27 + nseg;
+    c->run = run;
+    c->last = ended;
+    c->next_page = c->pos + total;
+    return 0;
+}
+
+static int cursor_advance(struct vc_cursor *c)
+{
+    if (!c->ogg || c->last) return -1;
+    return ogg_page(c, c->next_page, 1);
+}
+
+static int cursor_read(struct vc_cursor *c, unsigned char *dst, size_t n)
+{
+    unsigned char scratch[OX_META_SCRATCH];
+    while (n) {
+        if (c->run == 0 && cursor_advance(c) != 0) return -1;
+        size_t take = c->run < n ? (size_t)c->run : n;
+        if (take > sizeof(scratch)) take = sizeof(scratch);
+        const unsigned char *p = ox_meta_src_get(c->src, c->pos, take, scratch);
+        if (!p) return -1;
+        memcpy(dst, p, take);
+        dst += take; n -= take;
+        c->pos += take; c->run -= take;
+    }
+    return 0;
+}
+
+static int cursor_skip(struct vc_cursor *c, uint64_t n)
+{
+    while (n) {
+        if (c->run == 0 && cursor_advance(c) != 0) return -1;
+        uint64_t take = c->run < n ? c->run : n;
+        c->pos += take; c->run -= take; n -= take;
+    }
+    return 0;
+}
+
+static uint64_t le64(const unsigned char *p)
+{
+    return (uint64_t)le32(p) | ((uint64_t)le32(p + 4) << 32);
+}
+
+static void set_duration(struct ox_metadata *out, uint64_t samples, uint32_t rate, uint64_t audio_bytes)
+{
+    if (!rate || !samples) return;
+    double secs = (double)samples / rate;
+    if (secs > 1e6) return;
+    out->duration_ms = (int)(secs * 1000.0 + 0.5);
+    if (secs > 0) out->bitrate_kbps = (int)(audio_bytes * 8 / secs / 1000.0 + 0.5);
+}
+
+static int read_le32(struct vc_cursor *c, uint32_t *v)
+{
+    unsigned char b[4];
+    if (cursor_read(c, b, 4) != 0) return -1;
+    *v = le32(b);
+    return 0;
+}
+
+/* Vendor string, comment count, then length-prefixed NAME=value fields. */
+static int vc_parse(struct vc_cursor *c, struct ox_metadata *out)
+{
+    uint32_t vendor, count;
+    if (read_le32(c, &vendor) != 0 || cursor_skip(c, vendor) != 0) return -1;
+    if (read_le32(c, &count) != 0) return -1;
+    if (count > VC_MAX_COMMENTS) count = VC_MAX_COMMENTS;
+    unsigned char head[VC_HEAD];
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t len;
+        if (read_le32(c, &len) != 0) return 0; /* truncated: keep what we have */
+        size_t h = len < sizeof(head) ? len : sizeof(head);
+        if (cursor_read(c, head, h) != 0) return 0;
+        const unsigned char *eq = memchr(head, '=', h);
+        if (eq) {
+            size_t nlen = (size_t)(eq - head);
+            ox_meta_set_field(out, (const char *)head, nlen, (const char *)eq + 1, h - nlen - 1);
+        }
+        if (len > h && cursor_skip(c, len - h) != 0) return 0;
+    }
+    return 0;
+}
+
+int ox_meta_flac_read(const struct ox_meta_src *src, uint64_t offset, struct ox_metadata *out)
+{
+    unsigned char scratch[34];
+    const unsigned char *p = ox_meta_src_get(src, offset, 4, scratch);
+    if (!p || memcmp(p, "fLaC", 4) != 0) return -1;
+    uint64_t pos = offset + 4, vc_pos = 0, audio = 0;
+    uint32_t vc_len = 0, rate = 0;
+    uint64_t samples = 0;
+    for (int guard = 0; guard < 128; ++guard) {
+        const unsigned char *h = ox_meta_src_get(src, pos, 4, scratch);
+        if (!h) break;
+        int last = h[0] & 0x80;
+        int type = h[0] & 0x7F;
+        uint32_t len = ((uint32_t)h[1] << 16) | ((uint32_t)h[2] << 8) | h[3];
+        if (type == 0 && len >= 34 && (h = ox_meta_src_get(src, pos + 4, 34, scratch)) != NULL) { /* STREAMINFO */
+            rate = ((uint32_t)h[10] << 12) | ((uint32_t)h[11] << 4) | (h[12] >> 4);
+            out->sample_rate = (int)rate;
+            out->channels = ((h[12] >> 1) & 7) + 1;
+            samples = ((uint64_t)(h[13] & 0x0F) << 32) | ((uint64_t)h[14] << 24) | ((uint64_t)h[15] << 16) | ((uint64_t)h[16] << 8) | h[17];
+        } else if (type == 4 && !vc_pos) { /* VORBIS_COMMENT */
+            vc_pos = pos + 4;
+            vc_len = len;
+        }
+        if (type == 127) break;
+        pos += 4 + (uint64_t)len; /* skip without reading (PICTURE, SEEKTABLE, PADDING...) */
+        if (last) { audio = pos; break; }
+    }
+    set_duration(out, samples, rate, audio && audio < src->size ? src->size - audio : 0);
+    if (vc_pos) {
+        struct vc_cursor c = { src, vc_pos, vc_len, 0, 1, 0, 0 };
+        return vc_parse(&c, out);
+    }
+    return 0; /* valid FLAC, just no comments */
+}
+
+static uint32_t be32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+int ox_meta_flac_picture(const struct ox_meta_src *src, uint64_t offset, struct ox_meta_picture *pic)
+{
+    unsigned char scratch[OX_META_SCRATCH];
+    const unsigned char *p = ox_meta_src_get(src, offset, 4, scratch);
+    if (!p || memcmp(p, "fLaC", 4) != 0) return -1;
+    uint64_t pos = offset + 4;
+    int found = 0;
+    for (int guard = 0; guard < 128; ++guard) {
+        const unsigned char *h = ox_meta_src_get(src, pos, 4, scratch);
+        if (!h) break;
+        int last = h[0] & 0x80, type = h[0] & 0x7F;
+        uint32_t len = ((uint32_t)h[1] << 16) | ((uint32_t)h[2] << 8) | h[3];
+        if (type == 6 && len >= 32) { /* PICTURE: type, mime, description, 4 x u32, data */
+            uint64_t q = pos + 4, end = q + len;
+            const unsigned char *v = ox_meta_src_get(src, q, 8, scratch);
+            uint32_t ptype = v ? be32(v) : 0, mlen = v ? be32(v + 4) : 0;
+            char mime[sizeof(pic->mime)] = "";
+            const unsigned char *m = v && mlen < sizeof(mime) ? ox_meta_src_get(src, q + 8, mlen, scratch + 8) : NULL;
+            if (m) { memcpy(mime, m, mlen); mime[mlen] = '\0'; }
+            q += 8 + (uint64_t)mlen;
+            v = q + 4 <= end ? ox_meta_src_get(src, q, 4, scratch) : NULL;
+            if (v) q += 4 + (uint64_t)be32(v) + 16;
+            v = v && q + 4 <= end ? ox_meta_src_get(src, q, 4, scratch) : NULL;
+            if (v && be32(v) <= end - q - 4 && (!found || ptype == 3)) {
+                memset(pic, 0, sizeof(*pic));
+                pic->off = q + 4;
+                pic->len = be32(v);
+                pic->type = (int)ptype;
+                memcpy(pic->mime, mime, sizeof(mime));
+                found = 1;
+                if (ptype == 3) break; /* front cover */
+            }
+        }
+        if (type == 127 || last) break;
+        pos += 4 + (uint64_t)len;
+    }
+    return found ? 0 : -1;
+}
+
+/* Granule position of the last page of this stream, from one read of the tail. */
+static int ogg_last_granule(const struct ox_meta_src *src, uint64_t offset, uint32_t serial, uint64_t *granule)
+{
+    uint64_t from = src->size - offset > OGG_TAIL ? src->size - OGG_TAIL : offset;
+    size_t n = (size_t)(src->size - from);
+    unsigned char *tail = malloc(n ? n : 1);
+    if (!tail) return -1;
+    int rc = -1;
+    n = ox_meta_src_read(src, from, tail, n);
+    for (size_t i = n >= 27 ? n - 27 + 1 : 0; i-- > 0; ) {
+        if (tail[i] != 'O' || memcmp(tail + i, "OggS", 4) != 0 || tail[i+4] != 0) continue;
+        uint64_t g = le64(tail + i + 6);
+        if (le32(tail + i + 14) != serial || g == UINT64_MAX) continue;
+        *granule = g;
+        rc = 0;
+        break;
+    }
+    free(tail);
+    return rc;
+}
+
+int ox_meta_ogg_read(const struct ox_meta_src *src, uint64_t offset, struct ox_metadata *out, enum ox_meta_format *fmt)
+{
+    struct vc_cursor c = { src, 0, 0, 1, 0, 0, 0 };
+    if (ogg_page(&c, offset, 0) != 0) return -1;
+    unsigned char id[19];
+    if (cursor_read(&c, id, 8) != 0) return -1;
+    int opus = memcmp(id, "OpusHead", 8) == 0;
+    if (!opus && memcmp(id, "\x01vorbis", 7) != 0) return -1;
+    if (fmt) *fmt = opus ? OX_META_OPUS : OX_META_VORBIS;
+
+    /* Opus: version, channels, pre-skip, input rate; granules always count 48 kHz.
+     * Vorbis: version (4), channels, rate. */
+    uint64_t granule;
+    if (cursor_read(&c, id + 8, opus ? 8 : 9) == 0) {
+        uint32_t rate = opus ? 48000 : le32(id + 12);
+        uint32_t preskip = opus ? (uint32_t)(id[10] | id[11] << 8) : 0;
+        out->channels = opus ? id[9] : id[11];
+        out->sample_rate = (int)(opus ? (le32(id + 12) ? le32(id + 12) : 48000) : rate);
+        if (ogg_last_granule(src, offset, c.serial, &granule) == 0 && granule > preskip)
+            set_duration(out, granule - preskip, rate, src->size - offset);
+    }
+
+    /* the comment header always starts on the second page of the stream */
+    if (ogg_page(&c, c.next_page, 0) != 0) return -1;
+    if (opus) {
+        if (cursor_read(&c, id, 8) != 0 || memcmp(id, "OpusTags", 8) != 0) return -1;
+    } else {
+        if (cursor_read(&c, id, 7) != 0 || memcmp(id, "\x03vorbis", 7) != 0) return -1;
+    }
+    return vc_parse(&c, out);
+}
@@ -1,7 +1,10 @@
 // pcm_ring.c - simple SPSC ring using C11 atomics
+// - the fill level after every push and pop goes to the trace as a counter:
+//   a ring draining towards zero is the run-up to a dropout
 
 #define _POSIX_C_SOURCE 200809L
 #include "pcm_ring.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <stdatomic.h>
 #include <string.h>
@@ -62,6 +65,7 @@ size_t pcm_ring_push(struct pcm_ring *r, const float *frames, size_t frames_coun
         memcpy(&r->data[0], frames + first * OXXY_CHANNELS, (to_write - first) * OXXY_CHANNELS * sizeof(float));
     }
     atomic_store_explicit(&r->head, head + to_write, memory_order_release);
+    OX_TRACE_COUNTER("ring_frames", head + to_write - tail);
     return to_write;
 }
 
@@ -81,5 +85,6 @@ size_t pcm_ring_pop(struct pcm_ring *r, float *out_frames, size_t frames_count)
         memcpy(out_frames + first * OXXY_CHANNELS, &r->data[0], (to_read - first) * OXXY_CHANNELS * sizeof(float));
     }
     atomic_store_explicit(&r->tail, tail + to_read, memory_order_release);
+    OX_TRACE_COUNTER("ring_frames", head - tail - to_read);
     return to_read;
 }
@@ -1,82 +1,509 @@
-// playlist.c - minimal playlist implementation (.m3u)
+// playlist.c - playlist core: entry arena, URI dedup index and play order
+// - URIs are packed NUL-terminated into large arena chunks (growing
+//   geometrically), entries hold chunk/offset/length; destroy frees a few
+//   chunks instead of one block per entry
+// - a URI hash set (open addressing, hash bits + entry index per slot) makes
+//   playlist_add_unique O(1); it is updated lazily, so plain adds stay cheap
+// - shuffle is a keyed Feistel permutation over the smallest 4^k domain >= n,
+//   cycle-walked back into [0, n): position -> entry and entry -> position are
+//   both a few hash rounds, so there is no order array to build or keep in sync
 
 #define _POSIX_C_SOURCE 200809L
 #include "playlist.h"
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
+#include <strings.h>
 #include <time.h>
 
+#define CHUNK_MIN (64 * 1024)
+#define CHUNK_MAX ((size_t)1 << 30) /* offsets are 32-bit */
+
 struct playlist *playlist_create(void)
 {
     struct playlist *p = calloc(1, sizeof(*p));
     if (!p) return NULL;
     p->capacity = 16;
     p->items = calloc(p->capacity, sizeof(*p->items));
+    if (!p->items) {
+        free(p);
+        return NULL;
+    }
     return p;
 }
 
 void playlist_destroy(struct playlist *p)
 {
     if (!p) return;
-    for (size_t i = 0; i < p->count; ++i) free(p->items[i].uri);
+    for (size_t i = 0; i < p->nchunks; ++i) free(p->chunks[i].base);
+    free(p->chunks);
     free(p->items);
+    free(p->dedup);
     free(p);
 }
 
+/* realloc, or copy and hand the old array to p->retire */
+static void *grow(struct playlist *p, void *old, size_t used, size_t size)
+{
+    if (!p->retire || !old) return realloc(old, size);
+    void *n = malloc(size);
+    if (!n) return NULL;
+    memcpy(n, old, used);
+    if (p->retire(p->retire_ctx, old) != 0) {
+        free(n);
+        return NULL;
+    }
+    return n;
+}
+
+static int new_chunk(struct playlist *p, size_t size)
+{
+    if (p->nchunks == p->chunk_cap) {
+        size_t ncap = p->chunk_cap ? p->chunk_cap * 2 : 8;
+        struct playlist_chunk *n = grow(p, p->chunks, p->nchunks * sizeof(*n), ncap * sizeof(*n));
+        if (!n) return -1;
+        p->chunks = n;
+        p->chunk_cap = ncap;
+    }
+    char *base = malloc(size);
+    if (!base) return -1;
+    p->chunks[p->nchunks++] = (struct playlist_chunk){ base, size, 0 };
+    return 0;
+}
+
+/* Make sure the current chunk has n free bytes (n <= CHUNK_MAX). */
+static int reserve_bytes(struct playlist *p, size_t n)
+{
+    struct playlist_chunk *c = p->nchunks ? &p->chunks[p->nchunks - 1] : NULL;
+    if (c && c->size - c->used >= n) return 0;
+    size_t size = c ? c->size * 2 : CHUNK_MIN;
+    if (size > CHUNK_MAX) size = CHUNK_MAX;
+    if (size < n) size = n;
+    return new_chunk(p, size);
+}
+
+static int reserve_items(struct playlist *p, size_t extra)
+{
+    if (p->capacity - p->count >= extra) return 0;
+    size_t ncap = p->capacity ? p->capacity : 16;
+    while (ncap - p->count < extra) ncap *= 2;
+    struct playlist_entry *n = grow(p, p->items, p->count * sizeof(*n), ncap * sizeof(*n));
+    if (!n) return -1;
+    p->items = n;
+    p->capacity = ncap;
+    return 0;
+}
+
+int playlist_add_info(struct playlist *p, const char *uri, size_t len, const char *title, size_t title_len,
+                      int32_t duration_ms)
+{
+    if (!title) title_len = 0;
+    if (!p || !uri || len + title_len + 2 >= CHUNK_MAX) return -1;
+    if (reserve_items(p, 1) != 0 || reserve_bytes(p, len + title_len + 2) != 0) return -1;
+    struct playlist_chunk *c = &p->chunks[p->nchunks - 1];
+    char *d = c->base + c->used;
+    memcpy(d, uri, len);
+    d[len] = '\0';
+    if (title_len) memcpy(d + len + 1, title, title_len);
+    d[len + 1 + title_len] = '\0';
+    p->items[p->count++] = (struct playlist_entry){ (uint32_t)(p->nchunks - 1), (uint32_t)c->used, (uint32_t)len,
+                                                    (uint32_t)title_len, duration_ms };
+    c->used += len + title_len + 2;
+    return 0;
+}
+
+int playlist_add_n(struct playlist *p, const char *uri, size_t len)
+{
+    return playlist_add_info(p, uri, len, NULL, 0, -1);
+}
+
 int playlist_add(struct playlist *p, const char *uri)
 {
     if (!p || !uri) return -1;
-    if (p->count == p->capacity) {
-        size_t ncap = p->capacity * 2;
-        struct playlist_entry *n = realloc(p->items, ncap * sizeof(*n));
+    return playlist_add_n(p, uri, strlen(uri));
+}
+
+/* ---- URI dedup ---- */
+
+static int is_scheme_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '+' || c == '-' ||
+           c == '.';
+}
+
+/* length of "scheme://", 0 if uri has none */
+static size_t scheme_len(const char *uri, size_t len)
+{
+    size_t i = 0;
+    while (i < len && is_scheme_char(uri[i])) ++i;
+    return i > 1 && i + 3 <= len && memcmp(uri + i, "://", 3) == 0 ? i + 3 : 0;
+}
+
+static int hexval(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static char lower(char c)
+{
+    return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+}
+
+size_t playlist_normalize(const char *uri, size_t len, char *out, size_t cap)
+{
+    size_t sl = scheme_len(uri, len), o = 0;
+    if (sl == 7 && strncasecmp(uri, "file://", 7) == 0) {
+        /* file://[host]/path: keep the path, percent-decoded */
+        const char *path = memchr(uri + 7, '/', len - 7);
+        if (!path) return (size_t)-1;
+        size_t at = (size_t)(path - uri);
+        char *tmp = out;
+        for (size_t i = at; i < len; ++i) {
+            int hi, lo;
+            if (o == cap) return (size_t)-1;
+            if (uri[i] == '%' && i + 2 < len && (hi = hexval(uri[i + 1])) >= 0 && (lo = hexval(uri[i + 2])) >= 0) {
+                tmp[o++] = (char)(hi * 16 + lo);
+                i += 2;
+            } else {
+                tmp[o++] = uri[i];
+            }
+        }
+        return playlist_normalize_path(tmp, o);
+    }
+    if (len > cap) return (size_t)-1;
+    if (sl) {
+        /* scheme://host are case-insensitive, the rest is not */
+        size_t host_end = sl;
+        while (host_end < len && uri[host_end] != '/' && uri[host_end] != '?' && uri[host_end] != '#') ++host_end;
+        for (size_t i = 0; i < host_end; ++i) out[i] = lower(uri[i]);
+        memcpy(out + host_end, uri + host_end, len - host_end);
+        return len;
+    }
+    memcpy(out, uri, len);
+    return playlist_normalize_path(out, len);
+}
+
+size_t playlist_normalize_path(char *path, size_t len)
+{
+    /* the output never gets ahead of the input, so this works in place */
+    size_t abs = len && path[0] == '/', o = abs, i = abs;
+    while (i < len) {
+        size_t e = i;
+        while (e < len && path[e] != '/') ++e;
+        size_t n = e - i;
+        if (n == 2 && path[i] == '.' && path[i + 1] == '.') {
+            size_t last = o;
+            while (last > abs && path[last - 1] != '/') --last;
+            if (o > abs && !(o - last == 2 && path[last] == '.' && path[last + 1] == '.')) {
+                o = last > abs ? last - 1 : last; /* drop the previous segment */
+            } else if (!abs) {
+                if (o > 0) path[o++] = '/';
+                path[o++] = '.';
+                path[o++] = '.';
+            } /* "/.." is "/" */
+        } else if (n > 0 && !(n == 1 && path[i] == '.')) {
+            if (o > abs) path[o++] = '/';
+            memmove(path + o, path + i, n);
+            o += n;
+        }
+        i = e + 1;
+    }
+    if (o == 0 && len) path[o++] = '.';
+    return o;
+}
+
+/* 8 bytes per multiply; only needs to spread keys over the table */
+static uint64_t hash_key(const char *s, size_t n)
+{
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ n;
+    for (; n >= 8; s += 8, n -= 8) {
+        uint64_t w;
+        memcpy(&w, s, 8);
+        h = (h ^ w) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+    }
+    uint64_t w = 0;
+    memcpy(&w, s, n);
+    h = (h ^ w) * 0x94D049BB133111EBull;
+    return h ^ (h >> 29);
+}
+
+/* Already in normal form? True for nearly every path and URL in practice,
+ * which saves the copy: absolute path without "//", "/." or a trailing "/",
+ * or a URL whose scheme and host have no upper case. */
+static int is_normal(const char *uri, size_t len)
+{
+    size_t sl = scheme_len(uri, len);
+    if (sl) {
+        if (sl == 7 && strncasecmp(uri, "file://", 7) == 0) return 0;
+        for (size_t i = 0; i < len; ++i) {
+            if (i >= sl && (uri[i] == '/' || uri[i] == '?' || uri[i] == '#')) break;
+            if (uri[i] >= 'A' && uri[i] <= 'Z') return 0;
+        }
+        return 1;
+    }
+    if (len == 0 || uri[0] != '/' || (len > 1 && uri[len - 1] == '/')) return 0;
+    for (const char *s = uri, *e = uri + len; (s = memchr(s, '/', (size_t)(e - s))) && s + 1 < e; ++s)
+        if (s[1] == '/' || s[1] == '.') return 0;
+    return 1;
+}
+
+/* normalized key, or the raw bytes when it does not fit */
+static const char *dedup_key(const char *uri, size_t len, char *buf, size_t *klen)
+{
+    if (is_normal(uri, len)) {
+        *klen = len;
+        return uri;
+    }
+    size_t n = playlist_normalize(uri, len, buf, PLAYLIST_URI_MAX);
+    if (n == (size_t)-1) {
+        *klen = len;
+        return uri;
+    }
+    *klen = n;
+    return buf;
+}
+
+/* slot: high 32 bits of the key hash, low 32 bits entry index + 1 (0 = empty) */
+static int dedup_insert(struct playlist *p, uint64_t h, size_t index)
+{
+    if ((p->dedup_used + 1) * 2 > p->dedup_cap) {
+        size_t ncap = p->dedup_cap ? p->dedup_cap * 2 : 1024;
+        uint64_t *n = calloc(ncap, sizeof(*n));
         if (!n) return -1;
-        p->items = n; p->capacity = ncap;
+        for (size_t i = 0; i < p->dedup_cap; ++i) {
+            uint64_t v = p->dedup[i];
+            if (!v) continue;
+            size_t j = (size_t)(v >> 32) & (ncap - 1);
+            while (n[j]) j = (j + 1) & (ncap - 1);
+            n[j] = v;
+        }
+        free(p->dedup);
+        p->dedup = n;
+        p->dedup_cap = ncap;
     }
-    p->items[p->count].uri = strdup(uri);
-    if (!p->items[p->count].uri) return -1;
-    p->count++;
+    size_t j = (size_t)(h >> 32) & (p->dedup_cap - 1);
+    while (p->dedup[j]) j = (j + 1) & (p->dedup_cap - 1);
+    p->dedup[j] = (h & 0xFFFFFFFF00000000ull) | (uint64_t)(index + 1);
+    p->dedup_used++;
     return 0;
 }
 
-int playlist_load_m3u(struct playlist *p, const char *path)
+/* index + 1 of the entry with this key, 0 if none */
+static size_t dedup_find(const struct playlist *p, uint64_t h, const char *key, size_t klen, char *buf)
 {
-    if (!p || !path) return -1;
-    FILE *f = fopen(path, "r");
-    if (!f) return -1;
-    char *line = NULL; size_t len = 0;
-    while (getline(&line, &len, f) != -1) {
-        // strip newline
-        size_t l = strlen(line);
-        while (l && (line[l-1] == '\n' || line[l-1] == '\r')) { line[--l] = '\0'; }
-        if (l == 0) continue;
-        if (line[0] == '#') continue;
-        playlist_add(p, line);
+    if (!p->dedup_cap) return 0;
+    for (size_t j = (size_t)(h >> 32) & (p->dedup_cap - 1); p->dedup[j]; j = (j + 1) & (p->dedup_cap - 1)) {
+        uint64_t v = p->dedup[j];
+        if ((v ^ h) >> 32) continue;
+        size_t idx = (size_t)(v & 0xFFFFFFFFu) - 1, elen;
+        const char *e = dedup_key(playlist_uri(p, idx), p->items[idx].len, buf, &elen);
+        if (elen == klen && memcmp(e, key, klen) == 0) return idx + 1;
     }
-    free(line); fclose(f);
     return 0;
 }
 
-int playlist_save_m3u(struct playlist *p, const char *path)
+/* index entries added since the last call (or rebuild if entries went away) */
+static int dedup_sync(struct playlist *p, char *buf)
 {
-    if (!p || !path) return -1;
-    FILE *f = fopen(path, "w");
-    if (!f) return -1;
-    fprintf(f, "#EXTM3U\n");
-    for (size_t i = 0; i < p->count; ++i) fprintf(f, "%s\n", p->items[i].uri);
-    fclose(f);
+    if (p->dedup_count > p->count) {
+        free(p->dedup);
+        p->dedup = NULL;
+        p->dedup_cap = p->dedup_used = p->dedup_count = 0;
+    }
+    for (; p->dedup_count < p->count; p->dedup_count++) {
+        size_t klen;
+        const char *k = dedup_key(playlist_uri(p, p->dedup_count), p->items[p->dedup_count].len, buf, &klen);
+        if (dedup_insert(p, hash_key(k, klen), p->dedup_count) != 0) return -1;
+    }
     return 0;
 }
 
-/* Fisher-Yates shuffle */
-void playlist_shuffle(struct playlist *p)
+int playlist_add_unique(struct playlist *p, const char *uri, size_t len, const char *title, size_t title_len,
+                        int32_t duration_ms)
+{
+    if (!p || !uri || p->count >= UINT32_MAX) return -1;
+    char key_buf[PLAYLIST_URI_MAX], cmp_buf[PLAYLIST_URI_MAX];
+    if (dedup_sync(p, cmp_buf) != 0) return -1;
+    size_t klen;
+    const char *key = dedup_key(uri, len, key_buf, &klen);
+    uint64_t h = hash_key(key, klen);
+    if (dedup_find(p, h, key, klen, cmp_buf)) return 0;
+    if (playlist_add_info(p, uri, len, title, title_len, duration_ms) != 0) return -1;
+    if (dedup_insert(p, h, p->count - 1) != 0) return -1;
+    p->dedup_count = p->count;
+    return 1;
+}
+
+size_t playlist_find(struct playlist *p, const char *uri, size_t len)
+{
+    if (!p || !uri) return PLAYLIST_END;
+    char key_buf[PLAYLIST_URI_MAX], cmp_buf[PLAYLIST_URI_MAX];
+    if (dedup_sync(p, cmp_buf) != 0) return PLAYLIST_END;
+    size_t klen;
+    const char *key = dedup_key(uri, len, key_buf, &klen);
+    size_t i = dedup_find(p, hash_key(key, klen), key, klen, cmp_buf);
+    return i ? i - 1 : PLAYLIST_END;
+}
+
+/* ---- play order ---- */
+
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+struct order {
+    uint64_t n, key, mask;
+    unsigned half;
+};
+
+static void order_init(struct order *o, size_t n, uint64_t seed, uint64_t cycle)
+{
+    o->n = n;
+    o->key = mix64(seed ^ mix64(cycle + 0x9E3779B97F4A7C15ull));
+    o->half = 1;
+    while (o->half < 32 && ((uint64_t)1 << (2 * o->half)) < n) o->half++;
+    o->mask = ((uint64_t)1 << o->half) - 1;
+}
+
+static uint64_t feistel(const struct order *o, uint64_t x, int inverse)
+{
+    uint64_t l = x >> o->half, r = x & o->mask;
+    for (int i = 0; i < 4; ++i) {
+        uint64_t round = o->key + (uint64_t)(inverse ? 3 - i : i) * 0xD1B54A32D192ED03ull;
+        if (!inverse) {
+            uint64_t t = l ^ (mix64(r ^ round) & o->mask);
+            l = r;
+            r = t;
+        } else {
+            uint64_t t = r ^ (mix64(l ^ round) & o->mask);
+            r = l;
+            l = t;
+        }
+    }
+    return (l << o->half) | r;
+}
+
+/* cycle-walking keeps the bijection on [0, n); the domain is < 4n, so few steps */
+static size_t permute(const struct order *o, size_t k, int inverse)
+{
+    uint64_t x = k;
+    do x = feistel(o, x, inverse); while (x >= o->n);
+    return (size_t)x;
+}
+
+static size_t order_at(const struct playlist *p, uint64_t cycle, size_t step)
+{
+    if (!p->shuffle) return step;
+    struct order o;
+    order_init(&o, p->count, p->shuffle_seed, cycle);
+    size_t k = cycle == 0 ? (p->order_base + step) % p->count : step;
+    return permute(&o, k, 0);
+}
+
+/* Restart the order at the current entry (cycle 0, step 0 when shuffled). */
+static void anchor(struct playlist *p)
+{
+    if (p->pos >= p->count) p->pos = 0;
+    p->order_cycle = 0;
+    p->order_count = p->count;
+    if (!p->shuffle || p->count == 0) {
+        p->order_base = 0;
+        p->order_step = p->pos;
+        return;
+    }
+    struct order o;
+    order_init(&o, p->count, p->shuffle_seed, 0);
+    p->order_base = permute(&o, p->pos, 1);
+    p->order_step = 0;
+}
+
+void playlist_set_shuffle(struct playlist *p, int on, uint64_t seed)
+{
+    if (!p) return;
+    p->shuffle = on != 0;
+    if (on) {
+        if (!seed) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            seed = mix64(((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec) ^ (uint64_t)(uintptr_t)p);
+        }
+        p->shuffle_seed = seed;
+    }
+    anchor(p);
+}
+
+void playlist_set_repeat(struct playlist *p, enum playlist_repeat mode)
+{
+    if (p) p->repeat = (int)mode;
+}
+
+static size_t advance(struct playlist *p, int manual)
 {
-    if (!p || p->count <= 1) return;
-    srand(time(NULL));
-    for (size_t i = p->count - 1; i > 0; --i) {
-        size_t j = (size_t)rand() % (i + 1);
-        char *tmp = p->items[i].uri;
-        p->items[i].uri = p->items[j].uri;
-        p->items[j].uri = tmp;
+    if (p->count == 0) return PLAYLIST_END;
+    if (p->order_count != p->count) anchor(p);
+    if (p->repeat == PLAYLIST_REPEAT_ONE && !manual) return p->pos;
+    if (p->order_step + 1 < p->count) {
+        p->order_step++;
+    } else if (p->repeat == PLAYLIST_REPEAT_NONE) {
+        return PLAYLIST_END;
+    } else {
+        p->order_step = 0;
+        p->order_cycle++;
     }
+    p->pos = order_at(p, p->order_cycle, p->order_step);
+    return p->pos;
+}
+
+size_t playlist_next(struct playlist *p)
+{
+    return p ? advance(p, 0) : PLAYLIST_END;
+}
+
+size_t playlist_skip(struct playlist *p)
+{
+    return p ? advance(p, 1) : PLAYLIST_END;
+}
+
+size_t playlist_peek_next(const struct playlist *p)
+{
+    if (!p) return PLAYLIST_END;
+    struct playlist tmp = *p; /* the cursor is a few scalars: advance a copy */
+    return advance(&tmp, 0);
+}
+
+size_t playlist_prev(struct playlist *p)
+{
+    if (!p || p->count == 0) return PLAYLIST_END;
+    if (p->order_count != p->count) anchor(p);
+    if (p->order_step > 0) {
+        p->order_step--;
+    } else if (p->repeat == PLAYLIST_REPEAT_NONE) {
+        return PLAYLIST_END;
+    } else {
+        p->order_cycle--;
+        p->order_step = p->count - 1;
+    }
+    p->pos = order_at(p, p->order_cycle, p->order_step);
+    return p->pos;
+}
+
+int playlist_jump(struct playlist *p, size_t index)
+{
+    if (!p || index >= p->count) return -1;
+    p->pos = index;
+    anchor(p);
+    return 0;
+}
+
+void playlist_shuffle(struct playlist *p)
+{
+    playlist_set_shuffle(p, 1, 0);
 }
@@ -1,7 +1,24 @@
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 
-struct playlist_entry { char *uri; };
+/* URIs live in a chunked string arena owned by the playlist; entries are
+ * offsets into it, so a million-entry playlist is a handful of allocations.
+ * Each URI's NUL is followed by the entry's title (possibly empty) and its NUL:
+ * what a playlist file told us about the track, so it needs no probe. */
+struct playlist_entry {
+    uint32_t chunk;
+    uint32_t off;
+    uint32_t len;        /* URI bytes, excluding the terminating NUL */
+    uint32_t title_len;
+    int32_t duration_ms; /* -1: unknown */
+};
+
+struct playlist_chunk {
+    char *base;
+    size_t size;
+    size_t used;
+};
 
 struct playlist {
     struct playlist_entry *items;
@@ -10,11 +27,115 @@ struct playlist {
     size_t pos;
     int shuffle; /* 0/1 */
     int repeat; /* 0: none, 1: all, 2: one */
+    struct playlist_chunk *chunks;
+    size_t nchunks;
+    size_t chunk_cap;
+    /* play-order cursor (playlist_next & co.); order_count == count when valid */
+    uint64_t shuffle_seed;
+    uint64_t order_cycle;
+    size_t order_base;
+    size_t order_step;
+    size_t order_count;
+    /* URI dedup index (playlist_add_unique): open addressing over entries
+     * [0, dedup_count), brought up to date lazily */
+    uint64_t *dedup;
+    size_t dedup_cap;
+    size_t dedup_used;
+    size_t dedup_count;
+    /* When set, arrays that growth replaces (items, chunk descriptors) go to
+     * retire instead of free: ox_plshare's published versions still read
+     * them. A failing retire fails the add. */
+    int (*retire)(void *ctx, void *array);
+    void *retire_ctx;
 };
 
+enum playlist_repeat {
+    PLAYLIST_REPEAT_NONE = 0,
+    PLAYLIST_REPEAT_ALL = 1,
+    PLAYLIST_REPEAT_ONE = 2
+};
+
+#define PLAYLIST_END ((size_t)-1)
+
 struct playlist *playlist_create(void);
 void playlist_destroy(struct playlist *p);
 int playlist_add(struct playlist *p, const char *uri);
+int playlist_add_n(struct playlist *p, const char *uri, size_t len);
+/* title may be NULL; duration_ms -1 when unknown */
+int playlist_add_info(struct playlist *p, const char *uri, size_t len, const char *title, size_t title_len,
+                      int32_t duration_ms);
+/* playlist_add_info unless an entry with the same normalized URI exists
+ * (file:// decoded, "." and ".." and repeated slashes folded, URL scheme and
+ * host case-folded). Returns 1 if added, 0 for a duplicate, -1 on error. */
+int playlist_add_unique(struct playlist *p, const char *uri, size_t len, const char *title, size_t title_len,
+                        int32_t duration_ms);
+/* Index of the entry with the same normalized URI, or PLAYLIST_END. Builds
+ * the dedup index on first use, like playlist_add_unique. */
+size_t playlist_find(struct playlist *p, const char *uri, size_t len);
+
+/* Longest URI playlist_normalize handles (longer ones are compared as is). */
+#define PLAYLIST_URI_MAX 4096
+/* Dedup form of uri into out; (size_t)-1 if it does not fit in cap. */
+size_t playlist_normalize(const char *uri, size_t len, char *out, size_t cap);
+/* Fold "//", "." and ".." lexically, in place; returns the new length. */
+size_t playlist_normalize_path(char *path, size_t len);
+
+/* Playlist files (playlist_io.c). Loading streams through the mapped file,
+ * keeps #EXTINF / Title / Length / XSPF title, creator and duration in the
+ * entries and resolves relative paths against the playlist's directory.
+ * Saving goes to a temporary file renamed over path. */
+enum playlist_format {
+    PLAYLIST_FORMAT_M3U = 0, /* extended M3U (#EXTM3U / #EXTINF) */
+    PLAYLIST_FORMAT_PLS,
+    PLAYLIST_FORMAT_XSPF
+};
+/* From the extension (.pls, .xspf; anything else is M3U). */
+enum playlist_format playlist_format_for_path(const char *path);
+#define PLAYLIST_LOAD_M3U 1u   /* read as M3U whatever the content */
+#define PLAYLIST_LOAD_DEDUP 2u /* skip URIs already present (playlist_add_unique) */
+/* Append entries from path, format sniffed from the content unless
+ * PLAYLIST_LOAD_M3U; returns the number of entries added or -1. */
+int playlist_load_with(struct playlist *p, const char *path, unsigned flags);
+/* Import: playlist_load_with(p, path, PLAYLIST_LOAD_DEDUP). */
+int playlist_load(struct playlist *p, const char *path);
+int playlist_save(const struct playlist *p, const char *path, enum playlist_format fmt);
+/* Bulk M3U load that keeps every entry, and the matching save; both return
+ * 0 on success, -1 on error. */
 int playlist_load_m3u(struct playlist *p, const char *path);
 int playlist_save_m3u(struct playlist *p, const char *path);
+/* Turn shuffle on with a fresh seed (see playlist_set_shuffle). */
 void playlist_shuffle(struct playlist *p);
+
+/* Play order. Shuffle never moves entries: the order is a seeded bijection
+ * over [0, count) evaluated on demand, so toggling is O(1) at any size and the
+ * same seed always replays the same sequence. Turning shuffle on keeps the
+ * current entry and plays the rest of the cycle from there; with repeat-all
+ * every further cycle is a new permutation derived from the seed. Adding
+ * entries re-anchors the order at the current entry.
+ *
+ * next/prev move pos and return it, or PLAYLIST_END (pos unchanged) at the end
+ * of the order with repeat-none. next() is the track-finished advance and
+ * stays on the entry with repeat-one; skip() is the user's "next" and always
+ * moves on. peek_next() is next() without moving.
+ */
+void playlist_set_shuffle(struct playlist *p, int on, uint64_t seed);
+void playlist_set_repeat(struct playlist *p, enum playlist_repeat mode);
+size_t playlist_next(struct playlist *p);
+size_t playlist_skip(struct playlist *p);
+size_t playlist_prev(struct playlist *p);
+size_t playlist_peek_next(const struct playlist *p);
+/* Make entry index current; the order continues from it. */
+int playlist_jump(struct playlist *p, size_t index);
+
+/* NUL-terminated URI of entry i (valid until the playlist is destroyed). */
+static inline const char *playlist_uri(const struct playlist *p, size_t i)
+{
+    const struct playlist_entry *e = &p->items[i];
+    return p->chunks[e->chunk].base + e->off;
+}
+
+/* NUL-terminated title of entry i, "" when the playlist file gave none. */
+static inline const char *playlist_title(const struct playlist *p, size_t i)
+{
+    return playlist_uri(p, i) + p->items[i].len + 1;
+}
@@ -0,0 +1,608 @@
+// playlist_io.c - playlist files: extended M3U, PLS and XSPF, read and written
+// - files are mmap'd and parsed in one pass without building a tree; M3U and
+//   PLS lines come from an SSE2 newline scan that handles every newline in a
+//   16-byte block from one compare mask
+// - #EXTINF, PLS Title/Length and XSPF title/creator/duration go straight into
+//   the entries, so a large imported playlist needs no per-track probe
+// - imports resolve relative paths against the playlist's own directory; with
+//   PLAYLIST_LOAD_DEDUP they go through playlist_add_unique (hash set on
+//   normalized URIs), otherwise straight into the arena so bulk loads keep
+//   their speed
+// - saves stream through one large buffer into a temporary file next to the
+//   target, fsync it and rename it over the target: readers see the old or the
+//   new playlist, never half of one
+
+#define _POSIX_C_SOURCE 200809L
+#include "playlist.h"
+#include "util.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define SAVE_BUF (1 << 20)
+#define TITLE_MAX 1024
+
+/* ---- reading ---- */
+
+struct import {
+    struct playlist *p;
+    const char *dir; /* playlist's directory, "" for the current one */
+    size_t dir_len;
+    int dedup;
+    int added;
+};
+
+static const char *map_file(const char *path, size_t *len)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    *len = (size_t)st.st_size;
+    if (*len == 0) {
+        close(fd);
+        return "";
+    }
+    const char *s = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (s == MAP_FAILED) return NULL;
+    posix_madvise((void *)s, *len, POSIX_MADV_SEQUENTIAL);
+    return s;
+}
+
+static void unmap_file(const char *s, size_t len)
+{
+    if (len) munmap((void *)s, len);
+}
+
+static int has_scheme(const char *s, size_t n)
+{
+    size_t i = 0;
+    while (i < n && ((s[i] >= 'a' && s[i] <= 'z') || (s[i] >= 'A' && s[i] <= 'Z') || (s[i] >= '0' && s[i] <= '9') ||
+                     s[i] == '+' || s[i] == '-' || s[i] == '.'))
+        ++i;
+    return i > 1 && i < n && s[i] == ':';
+}
+
+/* Store one entry: file:// and relative locations become plain absolute-ish
+ * paths (what open() and the metadata readers take), URLs are kept as is. */
+static int import_entry(struct import *im, const char *uri, size_t len, const char *title, size_t title_len,
+                        int32_t duration_ms)
+{
+    char buf[PLAYLIST_URI_MAX];
+    while (len && (uri[len - 1] == ' ' || uri[len - 1] == '\t')) --len;
+    while (len && (*uri == ' ' || *uri == '\t')) ++uri, --len;
+    if (len == 0) return 0;
+    if (len >= 7 && strncasecmp(uri, "file://", 7) == 0) {
+        size_t n = playlist_normalize(uri, len, buf, sizeof(buf));
+        if (n != (size_t)-1) uri = buf, len = n;
+    } else if (!has_scheme(uri, len) && uri[0] != '/' && im->dir_len && im->dir_len + 1 + len <= sizeof(buf)) {
+        memcpy(buf, im->dir, im->dir_len);
+        buf[im->dir_len] = '/';
+        memcpy(buf + im->dir_len + 1, uri, len);
+        len = playlist_normalize_path(buf, im->dir_len + 1 + len);
+        uri = buf;
+    }
+    int rc = im->dedup ? playlist_add_unique(im->p, uri, len, title, title_len, duration_ms)
+                       : playlist_add_info(im->p, uri, len, title, title_len, duration_ms) == 0 ? 1 : -1;
+    if (rc > 0) im->added++;
+    return rc < 0 ? -1 : 0;
+}
+
+typedef int (*line_fn)(void *ctx, const char *line, size_t len);
+
+static int for_each_line(const char *s, size_t n, line_fn fn, void *ctx)
+{
+    size_t start = 0, i = 0;
+    int rc = 0;
+#if defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; rc == 0 && i + 16 <= n; i += 16) {
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(s + i)), nl));
+        while (mask && rc == 0) {
+            size_t at = i + (size_t)__builtin_ctz(mask);
+            rc = fn(ctx, s + start, at - start);
+            start = at + 1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; rc == 0 && i < n; ++i) {
+        if (s[i] != '\n') continue;
+        rc = fn(ctx, s + start, i - start);
+        start = i + 1;
+    }
+    if (rc == 0 && start < n) rc = fn(ctx, s + start, n - start);
+    return rc;
+}
+
+/* integer part of a decimal number; *used is 0 if there is none */
+static long parse_num(const char *s, size_t n, size_t *used)
+{
+    size_t i = 0;
+    int neg = 0;
+    long v = 0;
+    while (i < n && (s[i] == ' ' || s[i] == '\t')) ++i;
+    if (i < n && (s[i] == '-' || s[i] == '+')) neg = s[i++] == '-';
+    size_t digits = i;
+    while (i < n && s[i] >= '0' && s[i] <= '9') {
+        if (v < 100000000) v = v * 10 + (s[i] - '0');
+        ++i;
+    }
+    if (used) *used = i == digits ? 0 : i;
+    return neg ? -v : v;
+}
+
+static int32_t seconds_to_ms(long secs)
+{
+    return secs < 0 || secs > 2000000 ? -1 : (int32_t)(secs * 1000);
+}
+
+/* M3U: #EXTINF:<seconds>[ key="value"...],<title> applies to the next URI line */
+struct m3u_state {
+    struct import *im;
+    const char *title;
+    size_t title_len;
+    int32_t duration_ms;
+};
+
+static int m3u_line(void *ctx, const char *line, size_t len)
+{
+    struct m3u_state *st = ctx;
+    while (len && line[len - 1] == '\r') --len;
+    if (len == 0) return 0;
+    if (line[0] != '#') {
+        int rc = import_entry(st->im, line, len, st->title, st->title_len, st->duration_ms);
+        st->title = NULL;
+        st->title_len = 0;
+        st->duration_ms = -1;
+        return rc;
+    }
+    if (len < 8 || memcmp(line, "#EXTINF:", 8) != 0) return 0;
+    size_t used;
+    long secs = parse_num(line + 8, len - 8, &used);
+    st->duration_ms = used ? seconds_to_ms(secs) : -1;
+    /* the title starts after the first comma outside attribute quotes */
+    int quoted = 0;
+    for (size_t i = 8; i < len; ++i) {
+        if (line[i] == '"') quoted = !quoted;
+        if (line[i] == ',' && !quoted) {
+            st->title = line + i + 1;
+            st->title_len = len - i - 1;
+            while (st->title_len && *st->title == ' ') st->title++, st->title_len--;
+            break;
+        }
+    }
+    return 0;
+}
+
+/* PLS: FileN=, TitleN=, LengthN= in any order; entries come out by N */
+struct pls_rec {
+    const char *file, *title;
+    uint32_t file_len, title_len;
+    int32_t duration_ms;
+};
+
+struct pls_state {
+    struct pls_rec *recs;
+    size_t nrecs, cap, limit;
+};
+
+static int key_is(const char *line, size_t len, const char *key, size_t *after)
+{
+    size_t k = strlen(key);
+    if (len <= k || strncasecmp(line, key, k) != 0 || line[k] < '0' || line[k] > '9') return 0;
+    *after = k;
+    return 1;
+}
+
+static int pls_line(void *ctx, const char *line, size_t len)
+{
+    struct pls_state *st = ctx;
+    while (len && line[len - 1] == '\r') --len;
+    size_t k, used;
+    int field;
+    if (key_is(line, len, "File", &k)) field = 0;
+    else if (key_is(line, len, "Title", &k)) field = 1;
+    else if (key_is(line, len, "Length", &k)) field = 2;
+    else return 0;
+    long n = parse_num(line + k, len - k, &used);
+    if (!used || n < 1 || (size_t)n > st->limit || k + used >= len || line[k + used] != '=') return 0;
+    const char *v = line + k + used + 1;
+    size_t vlen = len - k - used - 1;
+    if ((size_t)n > st->cap) {
+        size_t ncap = st->cap ? st->cap : 64;
+        while (ncap < (size_t)n) ncap *= 2;
+        struct pls_rec *r = realloc(st->recs, ncap * sizeof(*r));
+        if (!r) return -1;
+        memset(r + st->cap, 0, (ncap - st->cap) * sizeof(*r));
+        for (size_t i = st->cap; i < ncap; ++i) r[i].duration_ms = -1;
+        st->recs = r;
+        st->cap = ncap;
+    }
+    struct pls_rec *r = &st->recs[n - 1];
+    if ((size_t)n > st->nrecs) st->nrecs = (size_t)n;
+    if (vlen > UINT32_MAX) return 0;
+    if (field == 0) r->file = v, r->file_len = (uint32_t)vlen;
+    else if (field == 1) r->title = v, r->title_len = (uint32_t)vlen;
+    else r->duration_ms = seconds_to_ms(parse_num(v, vlen, &used));
+    return 0;
+}
+
+static int load_pls(struct import *im, const char *s, size_t n)
+{
+    /* an index can not exceed the number of lines, which bounds the table */
+    struct pls_state st = { NULL, 0, 0, n / 7 + 1 };
+    int rc = for_each_line(s, n, pls_line, &st);
+    for (size_t i = 0; rc == 0 && i < st.nrecs; ++i) {
+        const struct pls_rec *r = &st.recs[i];
+        if (r->file) rc = import_entry(im, r->file, r->file_len, r->title, r->title_len, r->duration_ms);
+    }
+    free(st.recs);
+    return rc;
+}
+
+/* XSPF: each <track> element; text is entity-decoded, CDATA kept verbatim */
+static const char *find(const char *s, const char *e, const char *needle)
+{
+    size_t k = strlen(needle);
+    while ((size_t)(e - s) >= k) {
+        const char *c = memchr(s, needle[0], (size_t)(e - s) - k + 1);
+        if (!c) return NULL;
+        if (memcmp(c, needle, k) == 0) return c;
+        s = c + 1;
+    }
+    return NULL;
+}
+
+/* "<name" followed by '>', '/' or whitespace */
+static const char *find_tag(const char *s, const char *e, const char *open)
+{
+    size_t k = strlen(open);
+    for (const char *t = s; (t = find(t, e, open)); t += k) {
+        char c = t + k < e ? t[k] : '\0';
+        if (c == '>' || c == '/' || c == ' ' || c == '\t' || c == '\r' || c == '\n') return t;
+    }
+    return NULL;
+}
+
+static size_t put_utf8(char *out, unsigned long cp)
+{
+    if (cp < 0x80) { out[0] = (char)cp; return 1; }
+    if (cp < 0x800) { out[0] = (char)(0xC0 | cp >> 6); out[1] = (char)(0x80 | (cp & 0x3F)); return 2; }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | cp >> 12);
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    if (cp > 0x10FFFF) return 0;
+    out[0] = (char)(0xF0 | cp >> 18);
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/* Text of the first <name> element in [s, e) into out; -1 if absent. */
+static long xml_text(const char *s, const char *e, const char *name, char *out, size_t cap)
+{
+    char open[32], close[32];
+    snprintf(open, sizeof(open), "<%s", name);
+    snprintf(close, sizeof(close), "</%s>", name);
+    const char *t = find_tag(s, e, open);
+    if (!t) return -1;
+    const char *gt = memchr(t, '>', (size_t)(e - t));
+    if (!gt || gt[-1] == '/') return gt ? 0 : -1;
+    const char *v = gt + 1, *ve = find(v, e, close);
+    if (!ve) return -1;
+    size_t o = 0;
+    while (v < ve && o + 4 < cap) {
+        if (ve - v >= 9 && memcmp(v, "<![CDATA[", 9) == 0) {
+            const char *ce = find(v + 9, ve, "]]>");
+            if (!ce) break;
+            size_t n = (size_t)(ce - v - 9);
+            if (n > cap - 1 - o) n = cap - 1 - o;
+            memcpy(out + o, v + 9, n);
+            o += n;
+            v = ce + 3;
+        } else if (*v == '&') {
+            const char *semi = memchr(v, ';', (size_t)(ve - v) < 12 ? (size_t)(ve - v) : 12);
+            size_t n = semi ? (size_t)(semi - v) : 0;
+            if (n == 3 && memcmp(v, "&lt", 3) == 0) out[o++] = '<';
+            else if (n == 3 && memcmp(v, "&gt", 3) == 0) out[o++] = '>';
+            else if (n == 4 && memcmp(v, "&amp", 4) == 0) out[o++] = '&';
+            else if (n == 5 && memcmp(v, "&quot", 5) == 0) out[o++] = '"';
+            else if (n == 5 && memcmp(v, "&apos", 5) == 0) out[o++] = '\'';
+            else if (n >= 3 && v[1] == '#') {
+                char num[12];
+                memcpy(num, v + 2, n - 2);
+                num[n - 2] = '\0';
+                o += put_utf8(out + o, num[0] == 'x' || num[0] == 'X' ? strtoul(num + 1, NULL, 16) : strtoul(num, NULL, 10));
+            } else {
+                out[o++] = '&';
+                v++;
+                continue;
+            }
+            v = semi + 1;
+        } else {
+            out[o++] = *v++;
+        }
+    }
+    /* trim the whitespace pretty-printers put around values */
+    size_t b = 0;
+    while (b < o && (out[b] == ' ' || out[b] == '\t' || out[b] == '\r' || out[b] == '\n')) ++b;
+    while (o > b && (out[o - 1] == ' ' || out[o - 1] == '\t' || out[o - 1] == '\r' || out[o - 1] == '\n')) --o;
+    memmove(out, out + b, o - b);
+    out[o - b] = '\0';
+    return (long)(o - b);
+}
+
+static int load_xspf(struct import *im, const char *s, size_t n)
+{
+    char loc[PLAYLIST_URI_MAX], title[TITLE_MAX], creator[TITLE_MAX], dur[24], full[2 * TITLE_MAX + 4];
+    const char *e = s + n, *t = s;
+    while ((t = find_tag(t, e, "<track"))) {
+        const char *te = find(t, e, "</track>");
+        if (!te) break;
+        long ll = xml_text(t, te, "location", loc, sizeof(loc));
+        if (ll > 0) {
+            long tl = xml_text(t, te, "title", title, sizeof(title));
+            long cl = xml_text(t, te, "creator", creator, sizeof(creator));
+            long dl = xml_text(t, te, "duration", dur, sizeof(dur));
+            size_t used = 0;
+            long ms = dl > 0 ? parse_num(dur, (size_t)dl, &used) : 0;
+            /* "Creator - Title", the same display form as #EXTINF */
+            int fl = cl > 0 && tl > 0 ? snprintf(full, sizeof(full), "%s - %s", creator, title)
+                   : tl > 0            ? snprintf(full, sizeof(full), "%s", title)
+                   : cl > 0            ? snprintf(full, sizeof(full), "%s", creator)
+                                       : 0;
+            if (fl >= (int)sizeof(full)) fl = (int)sizeof(full) - 1;
+            if (import_entry(im, loc, (size_t)ll, full, (size_t)fl, used && ms >= 0 && ms <= INT32_MAX ? (int32_t)ms : -1) != 0)
+                return -1;
+        }
+        t = te + 8;
+    }
+    return 0;
+}
+
+static enum playlist_format sniff(const char *s, size_t n)
+{
+    size_t i = n >= 3 && memcmp(s, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    while (i < n && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) ++i;
+    if (i < n && s[i] == '<') return PLAYLIST_FORMAT_XSPF;
+    if (n - i >= 10 && strncasecmp(s + i, "[playlist]", 10) == 0) return PLAYLIST_FORMAT_PLS;
+    return PLAYLIST_FORMAT_M3U;
+}
+
+int playlist_load_with(struct playlist *p, const char *path, unsigned flags)
+{
+    if (!p || !path) return -1;
+    size_t n;
+    const char *s = map_file(path, &n);
+    if (!s) return -1;
+    const char *slash = strrchr(path, '/');
+    struct import im = { p, path, slash ? (size_t)(slash - path) : 0, (flags & PLAYLIST_LOAD_DEDUP) != 0, 0 };
+    if (slash == path) im.dir = "/", im.dir_len = 1;
+    size_t bom = n >= 3 && memcmp(s, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    int rc;
+    switch (flags & PLAYLIST_LOAD_M3U ? PLAYLIST_FORMAT_M3U : sniff(s, n)) {
+    case PLAYLIST_FORMAT_PLS: rc = load_pls(&im, s + bom, n - bom); break;
+    case PLAYLIST_FORMAT_XSPF: rc = load_xspf(&im, s, n); break;
+    default: {
+        struct m3u_state st = { &im, NULL, 0, -1 };
+        rc = for_each_line(s + bom, n - bom, m3u_line, &st);
+    }
+    }
+    unmap_file(s, n);
+    return rc == 0 ? im.added : -1;
+}
+
+int playlist_load(struct playlist *p, const char *path)
+{
+    return playlist_load_with(p, path, PLAYLIST_LOAD_DEDUP);
+}
+
+int playlist_load_m3u(struct playlist *p, const char *path)
+{
+    return playlist_load_with(p, path, PLAYLIST_LOAD_M3U) < 0 ? -1 : 0;
+}
+
+enum playlist_format playlist_format_for_path(const char *path)
+{
+    const char *dot = path ? strrchr(path, '.') : NULL;
+    if (dot && strcasecmp(dot, ".pls") == 0) return PLAYLIST_FORMAT_PLS;
+    if (dot && strcasecmp(dot, ".xspf") == 0) return PLAYLIST_FORMAT_XSPF;
+    return PLAYLIST_FORMAT_M3U;
+}
+
+/* ---- writing ---- */
+
+struct out {
+    int fd;
+    int rc;
+    char *buf;
+    size_t used;
+};
+
+static void put(struct out *o, const char *s, size_t n)
+{
+    if (o->rc) return;
+    if (o->used + n > SAVE_BUF) {
+        o->rc = ox_write_all(o->fd, o->buf, o->used);
+        o->used = 0;
+        if (n > SAVE_BUF) { /* longer than the whole buffer: write it directly */
+            if (o->rc == 0) o->rc = ox_write_all(o->fd, s, n);
+            return;
+        }
+    }
+    memcpy(o->buf + o->used, s, n);
+    o->used += n;
+}
+
+static void puts_(struct out *o, const char *s)
+{
+    put(o, s, strlen(s));
+}
+
+static void put_num(struct out *o, long v)
+{
+    char num[24];
+    put(o, num, (size_t)snprintf(num, sizeof(num), "%ld", v));
+}
+
+/* titles are single-line in M3U and PLS */
+static void put_line_text(struct out *o, const char *s, size_t n)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (s[i] != '\n' && s[i] != '\r') continue;
+        put(o, s + start, i - start);
+        put(o, " ", 1);
+        start = i + 1;
+    }
+    put(o, s + start, n - start);
+}
+
+static void put_xml(struct out *o, const char *s, size_t n)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const char *esc = s[i] == '&' ? "&amp;" : s[i] == '<' ? "&lt;" : s[i] == '>' ? "&gt;" : s[i] == '"' ? "&quot;" : NULL;
+        if (!esc) continue;
+        put(o, s + start, i - start);
+        puts_(o, esc);
+        start = i + 1;
+    }
+    put(o, s + start, n - start);
+}
+
+/* local paths become file:// URIs; bytes outside RFC 3986 unreserved and '/' are escaped */
+static void put_location(struct out *o, const char *uri, size_t len)
+{
+    if (has_scheme(uri, len)) {
+        put_xml(o, uri, len);
+        return;
+    }
+    static const char hex[] = "0123456789ABCDEF";
+    puts_(o, "file://");
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)uri[i];
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '.' ||
+            c == '_' || c == '~' || c == '/') {
+            put(o, uri + i, 1);
+        } else {
+            char esc[3] = { '%', hex[c >> 4], hex[c & 15] };
+            put(o, esc, 3);
+        }
+    }
+}
+
+static long secs(int32_t ms)
+{
+    return ms < 0 ? -1 : (ms + 500) / 1000;
+}
+
+static void write_m3u(struct out *o, const struct playlist *p)
+{
+    puts_(o, "#EXTM3U\n");
+    for (size_t i = 0; i < p->count && o->rc == 0; ++i) {
+        const struct playlist_entry *e = &p->items[i];
+        if (e->title_len || e->duration_ms >= 0) {
+            puts_(o, "#EXTINF:");
+            put_num(o, secs(e->duration_ms));
+            put(o, ",", 1);
+            put_line_text(o, playlist_title(p, i), e->title_len);
+            put(o, "\n", 1);
+        }
+        put(o, playlist_uri(p, i), e->len);
+        put(o, "\n", 1);
+    }
+}
+
+static void write_pls(struct out *o, const struct playlist *p)
+{
+    puts_(o, "[playlist]\n");
+    for (size_t i = 0; i < p->count && o->rc == 0; ++i) {
+        const struct playlist_entry *e = &p->items[i];
+        puts_(o, "File");
+        put_num(o, (long)(i + 1));
+        put(o, "=", 1);
+        put(o, playlist_uri(p, i), e->len);
+        if (e->title_len) {
+            puts_(o, "\nTitle");
+            put_num(o, (long)(i + 1));
+            put(o, "=", 1);
+            put_line_text(o, playlist_title(p, i), e->title_len);
+        }
+        puts_(o, "\nLength");
+        put_num(o, (long)(i + 1));
+        put(o, "=", 1);
+        put_num(o, secs(e->duration_ms));
+        put(o, "\n", 1);
+    }
+    puts_(o, "NumberOfEntries=");
+    put_num(o, (long)p->count);
+    puts_(o, "\nVersion=2\n");
+}
+
+static void write_xspf(struct out *o, const struct playlist *p)
+{
+    puts_(o, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n"
+             "  <trackList>\n");
+    for (size_t i = 0; i < p->count && o->rc == 0; ++i) {
+        const struct playlist_entry *e = &p->items[i];
+        puts_(o, "    <track><location>");
+        put_location(o, playlist_uri(p, i), e->len);
+        puts_(o, "</location>");
+        if (e->title_len) {
+            puts_(o, "<title>");
+            put_xml(o, playlist_title(p, i), e->title_len);
+            puts_(o, "</title>");
+        }
+        if (e->duration_ms >= 0) {
+            puts_(o, "<duration>");
+            put_num(o, e->duration_ms);
+            puts_(o, "</duration>");
+        }
+        puts_(o, "</track>\n");
+    }
+    puts_(o, "  </trackList>\n</playlist>\n");
+}
+
+int playlist_save(const struct playlist *p, const char *path, enum playlist_format fmt)
+{
+    if (!p || !path) return -1;
+    struct ox_atomic a;
+    if (ox_atomic_begin(&a, path, 0644, 1) != 0) return -1;
+    struct out o = { a.fd, 0, malloc(SAVE_BUF), 0 };
+    if (!o.buf) {
+        ox_atomic_finish(&a, path, -1);
+        return -1;
+    }
+    switch (fmt) {
+    case PLAYLIST_FORMAT_PLS: write_pls(&o, p); break;
+    case PLAYLIST_FORMAT_XSPF: write_xspf(&o, p); break;
+    default: write_m3u(&o, p); break;
+    }
+    if (o.rc == 0 && o.used) o.rc = ox_write_all(o.fd, o.buf, o.used);
+    free(o.buf);
+    return ox_atomic_finish(&a, path, o.rc);
+}
+
+int playlist_save_m3u(struct playlist *p, const char *path)
+{
+    return playlist_save(p, path, PLAYLIST_FORMAT_M3U);
+}
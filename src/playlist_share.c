@@ -0,0 +1,223 @@
+// playlist_share.c - copy-on-write playlist versions with epoch-based reclamation
+// - a version is a struct playlist that shares the working copy's entry and
+//   chunk-descriptor arrays, so publishing copies nothing: edits only append,
+//   past every published count, and the scalars (count, pos, play order) are
+//   the version's own. When growth moves an array, playlist.c hands the old
+//   one to us (playlist->retire); it is freed with the last version that can
+//   read it. URI bytes live in chunks that are freed only with the share
+// - readers claim one of a fixed set of slots with a CAS holding the global
+//   epoch, then load the current version: no locks, no reference counting on
+//   the hot path
+// - publish swaps the version pointer, bumps the epoch and retires the old
+//   version with the new epoch; it is freed once every occupied slot holds a
+//   later epoch (a reader that entered after the swap cannot have seen it)
+
+#define _POSIX_C_SOURCE 200809L
+#include "playlist_share.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+struct garbage {
+    struct garbage *next;
+    void *array;
+};
+
+struct snap {
+    struct playlist pl;
+    struct snap *next;        /* retired list */
+    uint64_t epoch;           /* global epoch right after it was replaced */
+    struct garbage *garbage;  /* arrays outgrown while this was current */
+};
+
+struct ox_plshare {
+    _Atomic(struct snap *) cur;
+    _Atomic uint64_t epoch;   /* starts at 1: 0 marks a free slot */
+    _Atomic uint64_t version;
+    _Atomic uint64_t slots[OX_PLSHARE_READERS];
+    pthread_mutex_t wlock;
+    struct playlist *work;
+    struct snap *retired;
+    struct garbage *garbage; /* outgrown since the last publish */
+};
+
+static struct snap *snapshot(const struct playlist *w)
+{
+    struct snap *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->pl = *w;
+    s->pl.capacity = w->count;
+    s->pl.chunk_cap = w->nchunks;
+    s->pl.dedup = NULL; /* writer-side index */
+    s->pl.dedup_cap = s->pl.dedup_used = s->pl.dedup_count = 0;
+    s->pl.retire = NULL;
+    s->pl.retire_ctx = NULL;
+    return s;
+}
+
+static void free_garbage(struct garbage *g)
+{
+    while (g) {
+        struct garbage *next = g->next;
+        free(g->array);
+        free(g);
+        g = next;
+    }
+}
+
+/* the arrays and the arena belong to the working playlist */
+static void free_snap(struct snap *s)
+{
+    free_garbage(s->garbage);
+    free(s);
+}
+
+/* playlist->retire of the working copy; caller holds wlock */
+static int retire_array(void *ctx, void *array)
+{
+    struct ox_plshare *s = ctx;
+    struct garbage *g = malloc(sizeof(*g));
+    if (!g) return -1;
+    g->array = array;
+    g->next = s->garbage;
+    s->garbage = g;
+    return 0;
+}
+
+/* caller holds wlock */
+static void reclaim(struct ox_plshare *s)
+{
+    uint64_t oldest = UINT64_MAX;
+    for (unsigned i = 0; i < OX_PLSHARE_READERS; ++i) {
+        uint64_t e = atomic_load(&s->slots[i]);
+        if (e && e < oldest) oldest = e;
+    }
+    struct snap **link = &s->retired;
+    while (*link) {
+        struct snap *r = *link;
+        if (r->epoch <= oldest) {
+            *link = r->next;
+            free_snap(r);
+        } else {
+            link = &r->next;
+        }
+    }
+}
+
+struct ox_plshare *ox_plshare_create(struct playlist *initial)
+{
+    struct ox_plshare *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->work = initial ? initial : playlist_create();
+    if (s->work) {
+        s->work->retire = retire_array;
+        s->work->retire_ctx = s;
+    }
+    struct snap *first = s->work ? snapshot(s->work) : NULL;
+    if (!first || pthread_mutex_init(&s->wlock, NULL) != 0) {
+        if (first) free_snap(first);
+        playlist_destroy(s->work);
+        free(s);
+        return NULL;
+    }
+    atomic_init(&s->cur, first);
+    atomic_init(&s->epoch, 1);
+    atomic_init(&s->version, 1);
+    for (unsigned i = 0; i < OX_PLSHARE_READERS; ++i) atomic_init(&s->slots[i], 0);
+    return s;
+}
+
+void ox_plshare_destroy(struct ox_plshare *s)
+{
+    if (!s) return;
+    while (s->retired) {
+        struct snap *r = s->retired;
+        s->retired = r->next;
+        free_snap(r);
+    }
+    free_snap(atomic_load(&s->cur));
+    free_garbage(s->garbage);
+    playlist_destroy(s->work);
+    pthread_mutex_destroy(&s->wlock);
+    free(s);
+}
+
+const struct playlist *ox_plshare_read_begin(struct ox_plshare *s, struct ox_plread *r)
+{
+    /* threads start probing at different slots so they rarely contend */
+    static _Thread_local char probe;
+    unsigned i = (unsigned)(((uintptr_t)&probe >> 6) % OX_PLSHARE_READERS);
+    for (;; i = (i + 1) % OX_PLSHARE_READERS) {
+        uint64_t idle = 0, e = atomic_load(&s->epoch);
+        if (atomic_compare_exchange_strong(&s->slots[i], &idle, e)) break;
+    }
+    r->slot = i;
+    /* seq_cst: the slot is visible before the version is read, so a writer
+     * that replaced this version afterwards sees the slot when reclaiming */
+    r->pl = &atomic_load(&s->cur)->pl;
+    return r->pl;
+}
+
+void ox_plshare_read_end(struct ox_plshare *s, struct ox_plread *r)
+{
+    atomic_store_explicit(&s->slots[r->slot], 0, memory_order_release);
+    r->pl = NULL;
+}
+
+uint64_t ox_plshare_version(const struct ox_plshare *s)
+{
+    return atomic_load_explicit(&((struct ox_plshare *)s)->version, memory_order_acquire);
+}
+
+struct playlist *ox_plshare_edit(struct ox_plshare *s)
+{
+    pthread_mutex_lock(&s->wlock);
+    return s->work;
+}
+
+void ox_plshare_abandon(struct ox_plshare *s)
+{
+    pthread_mutex_unlock(&s->wlock);
+}
+
+int ox_plshare_publish(struct ox_plshare *s)
+{
+    struct snap *n = snapshot(s->work);
+    if (!n) {
+        pthread_mutex_unlock(&s->wlock);
+        return -1;
+    }
+    struct snap *old = atomic_exchange(&s->cur, n);
+    old->epoch = atomic_fetch_add(&s->epoch, 1) + 1;
+    /* whatever outgrew since the last publish is read by old at most (and by
+     * versions retired before it, which are freed no later) */
+    old->garbage = s->garbage;
+    s->garbage = NULL;
+    old->next = s->retired;
+    s->retired = old;
+    atomic_fetch_add_explicit(&s->version, 1, memory_order_release);
+    reclaim(s);
+    pthread_mutex_unlock(&s->wlock);
+    return 0;
+}
+
+int ox_plshare_append(struct ox_plshare *s, const struct playlist *batch)
+{
+    if (!s || !batch) return -1;
+    struct playlist *w = ox_plshare_edit(s);
+    size_t before = w->count;
+    for (size_t i = 0; i < batch->count; ++i) {
+        const struct playlist_entry *e = &batch->items[i];
+        if (playlist_add_unique(w, playlist_uri(batch, i), e->len, playlist_title(batch, i), e->title_len,
+                                e->duration_ms) < 0) {
+            w->count = before; /* the copied bytes stay in the arena, unreferenced */
+            ox_plshare_abandon(s);
+            return -1;
+        }
+    }
+    if (w->count == before) { /* nothing new: no version to publish */
+        ox_plshare_abandon(s);
+        return 0;
+    }
+    return ox_plshare_publish(s);
+}
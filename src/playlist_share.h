@@ -0,0 +1,50 @@
+// playlist_share.h - a playlist shared between threads as immutable snapshots
+#pragma once
+
+#include <stdint.h>
+#include "playlist.h"
+
+/* Readers (audio thread, UI, search) see a published version and never lock or
+ * wait: they pin the current snapshot with an epoch slot and release it when
+ * done. Writers edit a private working copy under a writer-only lock and
+ * publish it as the next version; a replaced snapshot is freed once no reader
+ * that could have seen it is still inside a read section.
+ *
+ * URI strings live in an append-only arena owned by the share, so pointers
+ * from playlist_uri() on any snapshot stay valid until ox_plshare_destroy.
+ */
+struct ox_plshare;
+
+/* Maximum readers inside a read section at the same time. */
+#define OX_PLSHARE_READERS 64
+
+struct ox_plread {
+    const struct playlist *pl;
+    unsigned slot;
+};
+
+/* Takes ownership of initial (may be NULL for an empty playlist). */
+struct ox_plshare *ox_plshare_create(struct playlist *initial);
+/* No reader or writer may be active. */
+void ox_plshare_destroy(struct ox_plshare *s);
+
+/* Pin the current version in r->pl (also returned); never NULL. Read sections
+ * should be short and must not nest on one thread. */
+const struct playlist *ox_plshare_read_begin(struct ox_plshare *s, struct ox_plread *r);
+void ox_plshare_read_end(struct ox_plshare *s, struct ox_plread *r);
+/* Bumped by every publish. */
+uint64_t ox_plshare_version(const struct ox_plshare *s);
+
+/* Lock the writer side and return the working copy (the latest version). Any
+ * number of edits become visible together at ox_plshare_publish, which also
+ * releases the lock; ox_plshare_abandon releases it without publishing (edits
+ * made so far stay in the working copy and go out with the next publish). */
+struct playlist *ox_plshare_edit(struct ox_plshare *s);
+int ox_plshare_publish(struct ox_plshare *s);
+void ox_plshare_abandon(struct ox_plshare *s);
+
+/* Append the entries of batch whose URIs are not in the playlist yet
+ * (playlist_add_unique) as one version; nothing is published if none are new.
+ * Build large imports into a private playlist first: the writer lock is then
+ * held only for the copy. */
+int ox_plshare_append(struct ox_plshare *s, const struct playlist *batch);
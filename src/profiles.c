@@ -1,133 +1,461 @@
-// profiles.c - simple profile storage using JSON blobs in XDG config
+// profiles.c - profile storage: JSON blobs in XDG config, cached in memory
+// - the directory is read once at init; list/load/save work on the in-memory
+//   copy under a mutex, so switching profiles in the UI does no I/O
+// - one background thread owns the disk: it applies inotify events from
+//   external edits (close-after-write, rename into, delete, rename away) and
+//   writes dirty profiles once the last save is OX_PROFILES_FLUSH_MS old
+// - a write goes to a ".name.json.XXXXXX" temporary in the same directory,
+//   is fsync'd and renamed over the profile, then the directory is fsync'd:
+//   a crash leaves the old or the new profile, never a truncated one
+// - our own renames come back as inotify events; the reload sees identical
+//   content (or a newer pending save) and changes nothing
 
 #define _POSIX_C_SOURCE 200809L
 #include "profiles.h"
+#include "json.h"
+#include "util.h"
 #include "xdg.h"
-#include <stdlib.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
-#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+
+struct profile {
+    char *name;   /* without ".json" */
+    char *blob;
+    size_t len;
+    int dirty;    /* saved in memory, not yet written */
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t idle;    /* signalled after each write pass */
+    int ready;
+    char *dir;
+    struct profile *items;
+    size_t n, cap;
+    char *list_json;        /* cached ox_profiles_list_json answer, NULL when stale */
+    int ndirty, writing, write_failed;
+    struct timespec flush_at;
+    int flush_now, stop;
+    int inotify_fd;
+    int wake[2];
+    pthread_t thread;
+} store = { .lock = PTHREAD_MUTEX_INITIALIZER, .idle = PTHREAD_COND_INITIALIZER, .inotify_fd = -1, .wake = { -1, -1 } };
+
+static int valid_name(const char *name)
+{
+    return name && name[0] && name[0] != '.' && !strchr(name, '/') && strlen(name) < 200;
+}
+
+/* "name.json" -> name length, 0 if not a profile file */
+static size_t profile_file(const char *file)
+{
+    size_t n = strlen(file);
+    return n > 5 && file[0] != '.' && strcmp(file + n - 5, ".json") == 0 ? n - 5 : 0;
+}
 
-static char *profiles_dir(void)
+static char *read_file(const char *dir, const char *file, size_t *len)
 {
-    char *xdg = ox_get_xdg_config_home();
-    if (!xdg) return NULL;
-    // ensure directory exists
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
     struct stat st;
-    if (stat(xdg, &st) != 0) {
-        mkdir(xdg, 0700);
+    char *buf = NULL;
+    if (fstat(fd, &st) == 0 && (buf = malloc((size_t)st.st_size + 1))) {
+        size_t got = 0;
+        ssize_t r;
+        while (got < (size_t)st.st_size && (r = read(fd, buf + got, (size_t)st.st_size - got)) != 0) {
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0) break;
+            got += (size_t)r;
+        }
+        buf[got] = '\0';
+        *len = got;
     }
-    return xdg;
+    close(fd);
+    return buf;
 }
 
-int ox_profiles_init(void)
+/* caller holds the lock */
+static struct profile *find(const char *name, size_t name_len)
+{
+    for (size_t i = 0; i < store.n; ++i)
+        if (strncmp(store.items[i].name, name, name_len) == 0 && store.items[i].name[name_len] == '\0')
+            return &store.items[i];
+    return NULL;
+}
+
+/* caller holds the lock; takes ownership of blob */
+static struct profile *put(const char *name, size_t name_len, char *blob, size_t len)
+{
+    struct profile *p = find(name, name_len);
+    if (!p) {
+        if (store.n == store.cap) {
+            size_t ncap = store.cap ? store.cap * 2 : 16;
+            struct profile *ni = realloc(store.items, ncap * sizeof(*ni));
+            if (!ni) return NULL;
+            store.items = ni;
+            store.cap = ncap;
+        }
+        char *nm = malloc(name_len + 1);
+        if (!nm) return NULL;
+        memcpy(nm, name, name_len);
+        nm[name_len] = '\0';
+        p = &store.items[store.n++];
+        *p = (struct profile){ nm, NULL, 0, 0 };
+        free(store.list_json);
+        store.list_json = NULL;
+    }
+    free(p->blob);
+    p->blob = blob;
+    p->len = len;
+    return p;
+}
+
+/* caller holds the lock */
+static void drop(struct profile *p)
+{
+    free(p->name);
+    free(p->blob);
+    *p = store.items[--store.n];
+    free(store.list_json);
+    store.list_json = NULL;
+}
+
+static int write_profile(const char *dir, const char *name, const char *blob, size_t len)
 {
-    char *d = profiles_dir();
-    if (!d) return -1;
-    free(d);
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s.json", dir, name);
+    if (ox_write_file_atomic(path, blob, len, 0600, 1) != 0) return -1;
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
     return 0;
 }
 
-char *ox_profiles_list_json(void)
+/* caller holds the lock; writes every dirty profile with the lock dropped */
+static void write_dirty(void)
+{
+    while (store.ndirty) {
+        struct profile *p = NULL;
+        for (size_t i = 0; i < store.n && !p; ++i)
+            if (store.items[i].dirty) p = &store.items[i];
+        if (!p) {
+            store.ndirty = 0;
+            break;
+        }
+        char *name = strdup(p->name), *blob = malloc(p->len + 1);
+        size_t len = p->len;
+        if (!name || !blob) {
+            free(name);
+            free(blob);
+            store.write_failed = 1;
+            break;
+        }
+        memcpy(blob, p->blob, len);
+        p->dirty = 0;
+        store.ndirty--;
+        store.writing++;
+        pthread_mutex_unlock(&store.lock);
+        int rc = write_profile(store.dir, name, blob, len);
+        pthread_mutex_lock(&store.lock);
+        store.writing--;
+        if (rc != 0) store.write_failed = 1;
+        free(name);
+        free(blob);
+    }
+    pthread_cond_broadcast(&store.idle);
+}
+
+/* the file changed on disk: pick it up unless our own newer save is pending */
+static void reload(const char *file, int removed)
 {
-    char *d = profiles_dir();
-    if (!d) return NULL;
-    // list files ending with .json using opendir/readdir
-    DIR *dir = opendir(d);
-    if (!dir) { free(d); return NULL; }
+    size_t name_len = profile_file(file);
+    if (!name_len) return;
+    size_t len = 0;
+    char *blob = removed ? NULL : read_file(store.dir, file, &len);
+    pthread_mutex_lock(&store.lock);
+    struct profile *p = find(file, name_len);
+    if (p && p->dirty) {
+        free(blob);
+    } else if (!blob) {
+        if (p && removed) drop(p);
+    } else if (p && p->len == len && memcmp(p->blob, blob, len) == 0) {
+        free(blob);
+    } else if (!put(file, name_len, blob, len)) {
+        free(blob);
+    }
+    pthread_mutex_unlock(&store.lock);
+}
+
+/* events were lost: re-read every profile file (deletions are caught later) */
+static void rescan(void)
+{
+    DIR *d = opendir(store.dir);
     struct dirent *ent;
-    size_t cap = 256; size_t len = 0;
-    char *out = malloc(cap);
-    if (!out) { closedir(dir); free(d); return NULL; }
-    out[0] = '['; len = 1;
-    int first = 1;
-    while ((ent = readdir(dir)) != NULL) {
-        size_t n = strlen(ent->d_name);
-        if (n > 5 && strcmp(ent->d_name + n - 5, ".json") == 0) {
-            if (!first) { if (len + 2 >= cap) { cap *= 2; out = realloc(out, cap); } out[len++] = ','; }
-            else first = 0;
-            // append quoted name
-            if (len + n + 4 >= cap) { while (len + n + 4 >= cap) cap *= 2; out = realloc(out, cap); }
-            out[len++] = '"'; memcpy(out + len, ent->d_name, n); len += n; out[len++] = '"';
+    while (d && (ent = readdir(d))) reload(ent->d_name, 0);
+    if (d) closedir(d);
+}
+
+static long ms_until(const struct timespec *t)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ms = (t->tv_sec - now.tv_sec) * 1000 + (t->tv_nsec - now.tv_nsec) / 1000000;
+    return ms < 0 ? 0 : ms + 1;
+}
+
+static void *watcher(void *arg)
+{
+    (void)arg;
+    _Alignas(struct inotify_event) char ev[16 * 1024];
+    pthread_mutex_lock(&store.lock);
+    while (!store.stop) {
+        int timeout = store.ndirty ? (store.flush_now ? 0 : (int)ms_until(&store.flush_at)) : -1;
+        pthread_mutex_unlock(&store.lock);
+        struct pollfd fds[2] = { { store.wake[0], POLLIN, 0 }, { store.inotify_fd, POLLIN, 0 } };
+        int nfds = store.inotify_fd >= 0 ? 2 : 1;
+        if (poll(fds, (nfds_t)nfds, timeout) > 0) {
+            if (fds[0].revents) {
+                char drain[64];
+                while (read(store.wake[0], drain, sizeof(drain)) > 0) {}
+            }
+            ssize_t n;
+            while (nfds == 2 && fds[1].revents && (n = read(store.inotify_fd, ev, sizeof(ev))) > 0) {
+                for (char *e = ev; e < ev + n;) {
+                    const struct inotify_event *ie = (const struct inotify_event *)e;
+                    if (ie->mask & IN_Q_OVERFLOW) rescan();
+                    else if (ie->len) reload(ie->name, (ie->mask & (IN_DELETE | IN_MOVED_FROM)) != 0);
+                    e += sizeof(*ie) + ie->len;
+                }
+            }
+        }
+        pthread_mutex_lock(&store.lock);
+        if (store.ndirty && (store.flush_now || store.stop || ms_until(&store.flush_at) <= 1)) {
+            store.flush_now = 0;
+            write_dirty();
+        } else if (!store.ndirty) {
+            store.flush_now = 0;
+            pthread_cond_broadcast(&store.idle);
         }
     }
-    out[len++] = ']'; out[len] = '\0';
-    closedir(dir);
-    free(d);
-    return out;
+    write_dirty();
+    pthread_mutex_unlock(&store.lock);
+    return NULL;
+}
+
+static void wake_watcher(void)
+{
+    if (store.wake[1] >= 0) {
+        ssize_t r = write(store.wake[1], "", 1);
+        (void)r; /* a full pipe already means "wake up" */
+    }
+}
+
+static void close_fds(void)
+{
+    if (store.inotify_fd >= 0) close(store.inotify_fd);
+    if (store.wake[0] >= 0) close(store.wake[0]);
+    if (store.wake[1] >= 0) close(store.wake[1]);
+    store.inotify_fd = store.wake[0] = store.wake[1] = -1;
+}
+
+static int init_locked(void)
+{
+    if (store.ready) return 0;
+    char *dir = ox_get_xdg_config_home();
+    if (!dir || ox_mkdir_p(dir) != 0) {
+        free(dir);
+        return -1;
+    }
+    store.dir = dir;
+    /* watch before the scan so nothing changed in between is missed */
+    store.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (store.inotify_fd >= 0 &&
+        inotify_add_watch(store.inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        close(store.inotify_fd);
+        store.inotify_fd = -1;
+    }
+    DIR *d = opendir(dir);
+    struct dirent *ent;
+    while (d && (ent = readdir(d))) {
+        size_t name_len = profile_file(ent->d_name), len = 0;
+        char *blob = name_len ? read_file(dir, ent->d_name, &len) : NULL;
+        if (blob && !put(ent->d_name, name_len, blob, len)) free(blob);
+    }
+    if (d) closedir(d);
+    store.stop = store.flush_now = store.ndirty = store.write_failed = 0;
+    if (pipe(store.wake) != 0) {
+        store.wake[0] = store.wake[1] = -1;
+    } else {
+        for (int i = 0; i < 2; ++i) {
+            fcntl(store.wake[i], F_SETFL, O_NONBLOCK);
+            fcntl(store.wake[i], F_SETFD, FD_CLOEXEC);
+        }
+    }
+    if (store.wake[0] < 0 || pthread_create(&store.thread, NULL, watcher, NULL) != 0) {
+        close_fds();
+        return -1;
+    }
+    store.ready = 1;
+    return 0;
+}
+
+int ox_profiles_init(void)
+{
+    pthread_mutex_lock(&store.lock);
+    int rc = init_locked();
+    pthread_mutex_unlock(&store.lock);
+    return rc;
+}
+
+void ox_profiles_shutdown(void)
+{
+    pthread_mutex_lock(&store.lock);
+    if (!store.ready) {
+        pthread_mutex_unlock(&store.lock);
+        return;
+    }
+    store.stop = 1;
+    wake_watcher();
+    pthread_mutex_unlock(&store.lock);
+    pthread_join(store.thread, NULL); /* writes what is still pending */
+    pthread_mutex_lock(&store.lock);
+    close_fds();
+    for (size_t i = 0; i < store.n; ++i) {
+        free(store.items[i].name);
+        free(store.items[i].blob);
+    }
+    free(store.items);
+    free(store.list_json);
+    free(store.dir);
+    store.items = NULL;
+    store.list_json = store.dir = NULL;
+    store.n = store.cap = 0;
+    store.ready = 0;
+    pthread_mutex_unlock(&store.lock);
+}
+
+int ox_profiles_flush(void)
+{
+    pthread_mutex_lock(&store.lock);
+    if (!store.ready) {
+        pthread_mutex_unlock(&store.lock);
+        return 0;
+    }
+    store.flush_now = 1;
+    wake_watcher();
+    while (store.ndirty || store.writing) pthread_cond_wait(&store.idle, &store.lock);
+    int rc = store.write_failed ? -1 : 0;
+    store.write_failed = 0;
+    pthread_mutex_unlock(&store.lock);
+    return rc;
+}
+
+char *ox_profiles_list_json(void)
+{
+    pthread_mutex_lock(&store.lock);
+    if (init_locked() != 0) {
+        pthread_mutex_unlock(&store.lock);
+        return NULL;
+    }
+    if (!store.list_json) {
+        /* ["a.json","b.json"] through json.c's writer: names may hold '"' or '\\' */
+        struct ox_json list = { .type = OX_JSON_T_ARRAY };
+        struct ox_json *items = calloc(store.n ? store.n : 1, sizeof(*items));
+        char *out = NULL;
+        size_t i = 0;
+        for (; items && i < store.n; ++i) {
+            size_t len = strlen(store.items[i].name);
+            items[i].type = OX_JSON_T_STRING;
+            items[i].str = malloc(len + 6);
+            if (!items[i].str) break;
+            memcpy(items[i].str, store.items[i].name, len);
+            memcpy(items[i].str + len, ".json", 6);
+            items[i].len = len + 5;
+            items[i].next = i + 1 < store.n ? &items[i + 1] : NULL;
+        }
+        if (items && i == store.n) {
+            list.child = store.n ? items : NULL;
+            out = ox_json_write(&list, NULL);
+        }
+        for (size_t j = 0; items && j < i; ++j) free(items[j].str);
+        free(items);
+        store.list_json = out;
+    }
+    char *copy = store.list_json ? strdup(store.list_json) : NULL;
+    pthread_mutex_unlock(&store.lock);
+    return copy;
 }
 
 int ox_profiles_save(const char *name, const char *json_blob)
 {
-    if (!name || !json_blob) return -1;
-    char *d = profiles_dir(); if (!d) return -1;
-    char path[1024]; snprintf(path, sizeof(path), "%s/%s.json", d, name);
-    FILE *f = fopen(path, "w");
-    if (!f) { free(d); return -1; }
-    fwrite(json_blob, 1, strlen(json_blob), f);
-    fclose(f);
-    free(d);
+    if (!valid_name(name) || !json_blob) return -1;
+    size_t len = strlen(json_blob);
+    char *blob = malloc(len + 1);
+    if (!blob) return -1;
+    memcpy(blob, json_blob, len + 1);
+    pthread_mutex_lock(&store.lock);
+    struct profile *p = init_locked() == 0 ? put(name, strlen(name), blob, len) : NULL;
+    if (!p) {
+        pthread_mutex_unlock(&store.lock);
+        free(blob);
+        return -1;
+    }
+    int was_idle = store.ndirty == 0;
+    if (!p->dirty) {
+        p->dirty = 1;
+        store.ndirty++;
+    }
+    /* the window restarts with every save: a burst is written once; the
+     * watcher re-reads the deadline when its current one expires */
+    clock_gettime(CLOCK_MONOTONIC, &store.flush_at);
+    store.flush_at.tv_nsec += (long)OX_PROFILES_FLUSH_MS * 1000000L;
+    store.flush_at.tv_sec += store.flush_at.tv_nsec / 1000000000L;
+    store.flush_at.tv_nsec %= 1000000000L;
+    if (was_idle) wake_watcher();
+    pthread_mutex_unlock(&store.lock);
     return 0;
 }
 
 char *ox_profiles_load(const char *name)
 {
-    if (!name) return NULL;
-    char *d = profiles_dir(); if (!d) return NULL;
-    char path[1024]; snprintf(path, sizeof(path), "%s/%s.json", d, name);
-    FILE *f = fopen(path, "r"); if (!f) { free(d); return NULL; }
-    fseek(f, 0, SEEK_END); long sz = ftell(f); fseek(f, 0, SEEK_SET);
-    char *buf = malloc(sz+1);
-    if (!buf) { fclose(f); free(d); return NULL; }
-    fread(buf, 1, sz, f); buf[sz] = '\0';
-    fclose(f); free(d); return buf;
+    if (!valid_name(name)) return NULL;
+    pthread_mutex_lock(&store.lock);
+    struct profile *p = init_locked() == 0 ? find(name, strlen(name)) : NULL;
+    char *copy = p ? malloc(p->len + 1) : NULL;
+    if (copy) memcpy(copy, p->blob, p->len + 1);
+    pthread_mutex_unlock(&store.lock);
+    return copy;
 }
 
 char *ox_profiles_get_vk_token(const char *profile_json)
 {
     if (!profile_json) return NULL;
-    const char *key = "\"vk_token\":";
-    const char *pos = strstr(profile_json, key);
-    if (!pos) return NULL;
-    pos += strlen(key);
-    if (*pos != '"') return NULL;
-    pos++;
-    const char *end = strchr(pos, '"');
-    if (!end) return NULL;
-    size_t len = end - pos;
-    char *token = malloc(len + 1);
-    if (!token) return NULL;
-    memcpy(token, pos, len);
-    token[len] = '\0';
-    return token;
+    struct ox_json *root = ox_json_parse(profile_json, strlen(profile_json));
+    const char *token = ox_json_string(ox_json_get(root, "vk_token"));
+    char *out = token ? strdup(token) : NULL;
+    ox_json_free(root);
+    return out;
 }
 
 char *ox_profiles_set_vk_token(const char *profile_json, const char *token)
 {
-    if (!profile_json) return NULL;
-    char *new_json = NULL;
-    if (strstr(profile_json, "\"vk_token\":")) {
-        // Replace existing
-        const char *start = strstr(profile_json, "\"vk_token\":");
-        const char *end = strchr(start, ',');
-        if (!end) end = strchr(start, '}');
-        if (!end) return NULL;
-        size_t prefix_len = start - profile_json;
-        size_t suffix_len = strlen(end);
-        new_json = malloc(prefix_len + 20 + strlen(token) + suffix_len + 1);
-        if (!new_json) return NULL;
-        memcpy(new_json, profile_json, prefix_len);
-        sprintf(new_json + prefix_len, "\"vk_token\":\"%s\"", token);
-        memcpy(new_json + prefix_len + 13 + strlen(token), end, suffix_len + 1);
-    } else {
-        // Add new
-        size_t len = strlen(profile_json);
-        if (len < 2) return NULL;
-        new_json = malloc(len + 20 + strlen(token) + 1);
-        if (!new_json) return NULL;
-        memcpy(new_json, profile_json, len - 1);
-        sprintf(new_json + len - 1, ",\"vk_token\":\"%s\"}", token);
-    }
-    return new_json;
+    if (!profile_json || !token) return NULL;
+    struct ox_json *root = ox_json_parse(profile_json, strlen(profile_json));
+    char *out = ox_json_set_string(root, "vk_token", token) == 0 ? ox_json_write(root, NULL) : NULL;
+    ox_json_free(root);
+    return out;
 }
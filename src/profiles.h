@@ -1,13 +1,29 @@
 #pragma once
 #include <stddef.h>
 
+/* Profiles are loaded once into memory and served from there; a background
+ * thread watches the config directory with inotify so external edits show up,
+ * and writes saves back coalesced, each through temp file + fsync + rename.
+ * Every call is thread-safe; list/load/save never touch the disk themselves.
+ * Names are file names without ".json" and may not contain '/' or start
+ * with '.'. Calls before ox_profiles_init initialise the store on demand. */
 int ox_profiles_init(void);
+/* Write pending saves and stop the watcher; the store can be initialised again. */
+void ox_profiles_shutdown(void);
+/* Block until every save so far is on disk. Returns 0, or -1 if a write failed. */
+int ox_profiles_flush(void);
 char *ox_profiles_list_json(void); /* returns malloc'd JSON string */
+/* Updates memory at once; the file follows within OX_PROFILES_FLUSH_MS. */
 int ox_profiles_save(const char *name, const char *json_blob);
 char *ox_profiles_load(const char *name); /* returns malloc'd JSON blob */
 
-/* Helper to get VK token from profile JSON */
+/* Saves arriving within this window are written once. */
+#define OX_PROFILES_FLUSH_MS 200
+
+/* VK token of a profile blob (top-level "vk_token"), malloc'd, or NULL if
+ * absent or the blob is not valid JSON. */
 char *ox_profiles_get_vk_token(const char *profile_json);
 
-/* Helper to set VK token in profile JSON */
+/* Copy of the blob with "vk_token" added or replaced, as compact JSON
+ * (malloc'd); NULL if the blob is not a JSON object. */
 char *ox_profiles_set_vk_token(const char *profile_json, const char *token);
@@ -0,0 +1,401 @@
+// scanner.c - parallel library scanner
+// - directory tasks live in per-worker deques: owners pop LIFO (depth-first keeps
+//   the frontier small), idle workers steal FIFO from the others
+// - audio files are collected into per-worker batches whose tag prefixes are read
+//   with one io_uring submission (pread fallback), then handed to ox_meta_read
+
+#define _POSIX_C_SOURCE 200809L
+#include "scanner.h"
+#include "io_batch.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define DEFAULT_PREFIX (64 * 1024)
+#define DEFAULT_BATCH 16
+#define MAX_THREADS 32
+#define PROGRESS_INTERVAL_NS 100000000LL
+
+struct worker {
+    struct ox_scanner *s;
+    pthread_t thread;
+    pthread_mutex_t lock; /* guards the deque */
+    char **dirs;          /* ring buffer of owned directory paths */
+    size_t head, tail, cap;
+    struct ox_io_batch *io;
+    unsigned char *bufs;  /* batch * prefix bytes */
+    char **files;
+    unsigned nfiles;
+    struct ox_read_req *reqs;
+    struct stat *st;      /* batch entries, one per file */
+};
+
+struct ox_scanner {
+    struct ox_scan_opts opts;
+    int nworkers;
+    struct worker *workers;
+    atomic_long pending; /* directories queued or being read */
+    atomic_int cancelled;
+    atomic_uint_fast64_t dirs_done, files_seen, files_done, files_failed, files_skipped, bytes_read;
+    atomic_llong last_progress;
+    int async_io;
+    pthread_mutex_t cb_lock; /* serialises user callbacks */
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+};
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int ox_scanner_is_audio_path(const char *path)
+{
+    static const char *const exts[] = { "mp3", "flac", "ogg", "oga", "opus", "m4a", "m4b", "mp4", "aac", NULL };
+    const char *dot = path ? strrchr(path, '.') : NULL;
+    if (!dot || strchr(dot, '/')) return 0;
+    for (int i = 0; exts[i]; ++i)
+        if (strcasecmp(dot + 1, exts[i]) == 0) return 1;
+    return 0;
+}
+
+static int deque_push(struct worker *w, char *path)
+{
+    pthread_mutex_lock(&w->lock);
+    if (w->tail - w->head == w->cap) {
+        size_t ncap = w->cap ? w->cap * 2 : 64;
+        char **n = malloc(ncap * sizeof(*n));
+        if (!n) { pthread_mutex_unlock(&w->lock); return -1; }
+        for (size_t i = 0; i < w->tail - w->head; ++i) n[i] = w->dirs[(w->head + i) % w->cap];
+        free(w->dirs);
+        w->tail -= w->head; w->head = 0;
+        w->dirs = n; w->cap = ncap;
+    }
+    w->dirs[w->tail % w->cap] = path;
+    w->tail++;
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+static char *deque_pop(struct worker *w)
+{
+    char *p = NULL;
+    pthread_mutex_lock(&w->lock);
+    if (w->tail != w->head) p = w->dirs[--w->tail % w->cap];
+    pthread_mutex_unlock(&w->lock);
+    return p;
+}
+
+static char *deque_steal(struct worker *w)
+{
+    char *p = NULL;
+    if (pthread_mutex_trylock(&w->lock) != 0) return NULL;
+    if (w->tail != w->head) p = w->dirs[w->head++ % w->cap];
+    pthread_mutex_unlock(&w->lock);
+    return p;
+}
+
+static char *next_dir(struct worker *w)
+{
+    char *p = deque_pop(w);
+    if (p) return p;
+    struct ox_scanner *s = w->s;
+    int self = (int)(w - s->workers);
+    for (int i = 1; i < s->nworkers; ++i) {
+        p = deque_steal(&s->workers[(self + i) % s->nworkers]);
+        if (p) return p;
+    }
+    return NULL;
+}
+
+static void push_dir(struct worker *w, char *path)
+{
+    atomic_fetch_add(&w->s->pending, 1);
+    if (deque_push(w, path) != 0) {
+        free(path);
+        atomic_fetch_sub(&w->s->pending, 1);
+        return;
+    }
+    pthread_cond_signal(&w->s->idle_cond);
+}
+
+static void fill_progress(const struct ox_scanner *s, struct ox_scan_progress *p)
+{
+    p->dirs_done = atomic_load(&s->dirs_done);
+    p->files_seen = atomic_load(&s->files_seen);
+    p->files_done = atomic_load(&s->files_done);
+    p->files_failed = atomic_load(&s->files_failed);
+    p->files_skipped = atomic_load(&s->files_skipped);
+    p->bytes_read = atomic_load(&s->bytes_read);
+    p->async_io = s->async_io;
+    p->finished = 0;
+}
+
+static void maybe_report(struct ox_scanner *s)
+{
+    if (!s->opts.on_progress) return;
+    long long now = now_ns();
+    long long last = atomic_load(&s->last_progress);
+    if (now - last < PROGRESS_INTERVAL_NS) return;
+    if (!atomic_compare_exchange_strong(&s->last_progress, &last, now)) return;
+    struct ox_scan_progress p;
+    fill_progress(s, &p);
+    pthread_mutex_lock(&s->cb_lock);
+    s->opts.on_progress(&p, s->opts.user);
+    pthread_mutex_unlock(&s->cb_lock);
+}
+
+static int64_t mtime_ns(const struct stat *st)
+{
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+static void flush_files(struct worker *w)
+{
+    struct ox_scanner *s = w->s;
+    unsigned n = w->nfiles, k = 0;
+    if (n == 0) return;
+    struct stat *st = w->st;
+    for (unsigned i = 0; i < n; ++i) {
+        int fd = open(w->files[i], O_RDONLY | O_CLOEXEC);
+        if (fd >= 0 && fstat(fd, &st[i]) != 0) { close(fd); fd = -1; }
+        if (fd < 0) { atomic_fetch_add(&s->files_failed, 1); free(w->files[i]); w->files[i] = NULL; continue; }
+        size_t want = (uint64_t)st[i].st_size < s->opts.prefix_bytes ? (size_t)st[i].st_size : s->opts.prefix_bytes;
+        w->reqs[k] = (struct ox_read_req){ fd, w->bufs + (size_t)k * s->opts.prefix_bytes, want, 0, 0 };
+        if (k != i) { w->files[k] = w->files[i]; w->files[i] = NULL; st[k] = st[i]; }
+        k++;
+    }
+    ox_io_batch_read(w->io, w->reqs, k);
+    for (unsigned i = 0; i < k; ++i) {
+        struct ox_read_req *r = &w->reqs[i];
+        if (r->res <= 0 && r->len > 0) {
+            atomic_fetch_add(&s->files_failed, 1);
+        } else {
+            struct ox_scan_result res;
+            struct ox_meta_src src = { r->buf, (size_t)r->res, r->fd, (uint64_t)st[i].st_size };
+            if (ox_meta_read(&src, &res.meta, &res.format) != 0) res.format = OX_META_UNKNOWN;
+            res.path = w->files[i];
+            res.dev = (uint64_t)st[i].st_dev;
+            res.inode = (uint64_t)st[i].st_ino;
+            res.size = (uint64_t)st[i].st_size;
+            res.mtime_ns = mtime_ns(&st[i]);
+            atomic_fetch_add(&s->bytes_read, (uint64_t)(r->res > 0 ? r->res : 0));
+            atomic_fetch_add(&s->files_done, 1);
+            if (s->opts.on_result) {
+                pthread_mutex_lock(&s->cb_lock);
+                s->opts.on_result(&res, s->opts.user);
+                pthread_mutex_unlock(&s->cb_lock);
+            }
+        }
+        close(r->fd);
+        free(w->files[i]);
+        w->files[i] = NULL;
+    }
+    w->nfiles = 0;
+    maybe_report(s);
+}
+
+static char *join_path(const char *dir, const char *name)
+{
+    size_t a = strlen(dir), b = strlen(name);
+    int slash = a > 0 && dir[a-1] != '/';
+    char *p = malloc(a + slash + b + 1);
+    if (!p) return NULL;
+    memcpy(p, dir, a);
+    if (slash) p[a] = '/';
+    memcpy(p + a + slash, name, b + 1);
+    return p;
+}
+
+/* Ask on_filter whether the file needs reading; costs one fstatat, no open. */
+static int wanted(struct ox_scanner *s, DIR *d, const char *name, const char *path, struct stat *st, int have_st)
+{
+    if (!s->opts.on_filter) return 1;
+    if (!have_st && fstatat(dirfd(d), name, st, 0) != 0) return 1; /* let the read path report it */
+    struct ox_scan_stat ss = { (uint64_t)st->st_dev, (uint64_t)st->st_ino, (uint64_t)st->st_size, mtime_ns(st) };
+    if (s->opts.on_filter(path, &ss, s->opts.user)) return 1;
+    atomic_fetch_add(&s->files_skipped, 1);
+    return 0;
+}
+
+static void scan_dir(struct worker *w, const char *path)
+{
+    struct ox_scanner *s = w->s;
+    DIR *d = opendir(path);
+    if (!d) return;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL && !atomic_load(&s->cancelled)) {
+        if (ent->d_name[0] == '.') continue; /* ".", ".." and hidden entries */
+        int is_dir = ent->d_type == DT_DIR;
+        int is_reg = ent->d_type == DT_REG;
+        if (!is_dir && !is_reg && ent->d_type != DT_LNK && ent->d_type != DT_UNKNOWN) continue;
+        if (is_reg && !ox_scanner_is_audio_path(ent->d_name)) continue;
+        char *child = join_path(path, ent->d_name);
+        if (!child) continue;
+        struct stat st;
+        int have_st = 0;
+        if (ent->d_type == DT_LNK || ent->d_type == DT_UNKNOWN) {
+            /* symlinked directories are not followed (loops); symlinked files are */
+            int is_lnk = ent->d_type == DT_LNK;
+            if (!is_lnk) {
+                if (fstatat(dirfd(d), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) { free(child); continue; }
+                is_lnk = S_ISLNK(st.st_mode);
+            }
+            if (is_lnk && fstatat(dirfd(d), ent->d_name, &st, 0) != 0) { free(child); continue; }
+            have_st = 1;
+            is_dir = !is_lnk && S_ISDIR(st.st_mode);
+            is_reg = S_ISREG(st.st_mode) && ox_scanner_is_audio_path(ent->d_name);
+        }
+        if (is_dir) {
+            push_dir(w, child);
+        } else if (is_reg) {
+            atomic_fetch_add(&s->files_seen, 1);
+            if (!wanted(s, d, ent->d_name, child, &st, have_st)) { free(child); continue; }
+            w->files[w->nfiles++] = child;
+            if (w->nfiles == s->opts.batch) flush_files(w);
+        } else {
+            free(child);
+        }
+    }
+    closedir(d);
+    atomic_fetch_add(&s->dirs_done, 1);
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    struct ox_scanner *s = w->s;
+    while (!atomic_load(&s->cancelled)) {
+        char *dir = next_dir(w);
+        if (!dir) {
+            /* nothing to walk right now: don't sit on a partial batch */
+            flush_files(w);
+            if (atomic_load(&s->pending) == 0) break;
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 2000000;
+            if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+            pthread_mutex_lock(&s->idle_lock);
+            pthread_cond_timedwait(&s->idle_cond, &s->idle_lock, &ts);
+            pthread_mutex_unlock(&s->idle_lock);
+            continue;
+        }
+        scan_dir(w, dir);
+        free(dir);
+        atomic_fetch_sub(&s->pending, 1);
+    }
+    if (!atomic_load(&s->cancelled)) flush_files(w);
+    pthread_cond_broadcast(&s->idle_cond);
+    return NULL;
+}
+
+static void scanner_free(struct ox_scanner *s)
+{
+    for (int i = 0; i < s->nworkers; ++i) {
+        struct worker *w = &s->workers[i];
+        while (w->tail != w->head) free(w->dirs[w->head++ % w->cap]);
+        for (unsigned j = 0; j < w->nfiles; ++j) free(w->files[j]);
+        free(w->dirs);
+        free(w->files);
+        free(w->reqs);
+        free(w->st);
+        free(w->bufs);
+        ox_io_batch_destroy(w->io);
+        pthread_mutex_destroy(&w->lock);
+    }
+    free(s->workers);
+    pthread_mutex_destroy(&s->cb_lock);
+    pthread_mutex_destroy(&s->idle_lock);
+    pthread_cond_destroy(&s->idle_cond);
+    free(s);
+}
+
+struct ox_scanner *ox_scanner_start(const char *const *roots, size_t nroots, const struct ox_scan_opts *opts)
+{
+    if (!roots || nroots == 0) return NULL;
+    struct ox_scanner *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    if (opts) s->opts = *opts;
+    if (s->opts.threads <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        s->opts.threads = n > 0 ? (int)(n * 2) : 4;
+    }
+    if (s->opts.threads > MAX_THREADS) s->opts.threads = MAX_THREADS;
+    if (s->opts.prefix_bytes == 0) s->opts.prefix_bytes = DEFAULT_PREFIX;
+    if (s->opts.batch == 0) s->opts.batch = DEFAULT_BATCH;
+    pthread_mutex_init(&s->cb_lock, NULL);
+    pthread_mutex_init(&s->idle_lock, NULL);
+    pthread_cond_init(&s->idle_cond, NULL);
+    atomic_init(&s->pending, 0);
+    atomic_init(&s->cancelled, 0);
+    atomic_init(&s->last_progress, 0);
+
+    s->nworkers = s->opts.threads;
+    s->workers = calloc((size_t)s->nworkers, sizeof(*s->workers));
+    if (!s->workers) { s->nworkers = 0; scanner_free(s); return NULL; }
+    s->async_io = 1;
+    for (int i = 0; i < s->nworkers; ++i) {
+        struct worker *w = &s->workers[i];
+        w->s = s;
+        pthread_mutex_init(&w->lock, NULL);
+        w->io = ox_io_batch_create(s->opts.batch, !s->opts.no_io_uring);
+        w->bufs = malloc(s->opts.batch * s->opts.prefix_bytes);
+        w->files = calloc(s->opts.batch, sizeof(*w->files));
+        w->reqs = calloc(s->opts.batch, sizeof(*w->reqs));
+        w->st = calloc(s->opts.batch, sizeof(*w->st));
+        if (!w->io || !w->bufs || !w->files || !w->reqs || !w->st) { scanner_free(s); return NULL; }
+        if (!ox_io_batch_is_async(w->io)) s->async_io = 0;
+    }
+    for (size_t i = 0; i < nroots; ++i) {
+        char *root = strdup(roots[i]);
+        if (root) push_dir(&s->workers[i % (size_t)s->nworkers], root);
+    }
+    for (int i = 0; i < s->nworkers; ++i) {
+        if (pthread_create(&s->workers[i].thread, NULL, worker_main, &s->workers[i]) != 0) {
+            atomic_store(&s->cancelled, 1);
+            for (int j = 0; j < i; ++j) pthread_join(s->workers[j].thread, NULL);
+            scanner_free(s);
+            return NULL;
+        }
+    }
+    return s;
+}
+
+void ox_scanner_cancel(struct ox_scanner *s)
+{
+    if (!s) return;
+    atomic_store(&s->cancelled, 1);
+    pthread_cond_broadcast(&s->idle_cond);
+}
+
+void ox_scanner_progress(const struct ox_scanner *s, struct ox_scan_progress *out)
+{
+    if (!s || !out) return;
+    fill_progress(s, out);
+}
+
+int ox_scanner_wait(struct ox_scanner *s)
+{
+    if (!s) return -1;
+    for (int i = 0; i < s->nworkers; ++i) pthread_join(s->workers[i].thread, NULL);
+    int cancelled = atomic_load(&s->cancelled);
+    if (s->opts.on_progress) {
+        struct ox_scan_progress p;
+        fill_progress(s, &p);
+        p.finished = 1;
+        s->opts.on_progress(&p, s->opts.user);
+    }
+    scanner_free(s);
+    return cancelled ? -1 : 0;
+}
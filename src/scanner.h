@@ -0,0 +1,72 @@
+// scanner.h - parallel library scanner (directory walk + tag header reads)
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "meta.h"
+
+struct ox_scan_result {
+    const char *path; /* valid only for the duration of the callback */
+    enum ox_meta_format format;
+    struct ox_metadata meta;
+    uint64_t dev;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtime_ns;
+};
+
+struct ox_scan_progress {
+    uint64_t dirs_done;
+    uint64_t files_seen;   /* audio files found so far */
+    uint64_t files_done;   /* parsed (with or without tags) */
+    uint64_t files_failed; /* open/read errors */
+    uint64_t files_skipped; /* rejected by on_filter (e.g. unchanged) */
+    uint64_t bytes_read;
+    int async_io;          /* 1 if io_uring is in use */
+    int finished;
+};
+
+struct ox_scan_stat {
+    uint64_t dev;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtime_ns;
+};
+
+/* Results and progress are delivered from worker threads, one call at a time. */
+typedef void (*ox_scan_result_cb)(const struct ox_scan_result *r, void *user);
+/* Called concurrently from worker threads before a file is opened, with only
+ * its stat data; return 0 to skip reading it (e.g. unchanged since the last scan). */
+typedef int (*ox_scan_filter_cb)(const char *path, const struct ox_scan_stat *st, void *user);
+typedef void (*ox_scan_progress_cb)(const struct ox_scan_progress *p, void *user);
+
+struct ox_scan_opts {
+    int threads;          /* 0: 2x online CPUs, capped at 32 */
+    size_t prefix_bytes;  /* bytes read per file up front; 0: 64 KiB */
+    unsigned batch;       /* files per batched read; 0: 16 */
+    int no_io_uring;      /* force the pread path */
+    ox_scan_filter_cb on_filter; /* optional */
+    ox_scan_result_cb on_result;
+    ox_scan_progress_cb on_progress; /* at most every ~100 ms, plus once at the end */
+    void *user;
+};
+
+struct ox_scanner;
+
+/* Start scanning the given directory trees in the background.
+ * Memory is bounded by threads * batch * prefix_bytes plus the directory frontier.
+ * Returns NULL on failure.
+ */
+struct ox_scanner *ox_scanner_start(const char *const *roots, size_t nroots, const struct ox_scan_opts *opts);
+
+/* Ask workers to stop after their current batch. */
+void ox_scanner_cancel(struct ox_scanner *s);
+
+/* Snapshot of the counters (safe from any thread). */
+void ox_scanner_progress(const struct ox_scanner *s, struct ox_scan_progress *out);
+
+/* Wait for the scan to finish and free the scanner. Returns 0, or -1 if cancelled. */
+int ox_scanner_wait(struct ox_scanner *s);
+
+/* 1 if path has an extension the metadata layer understands. */
+int ox_scanner_is_audio_path(const char *path);
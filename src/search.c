@@ -0,0 +1,770 @@
+// search.c - word-prefix search index
+// Layout (native endian; built in memory as one blob, saved and mapped as-is):
+//   header | term pool (sorted, NUL-terminated) | term offsets | posting starts
+//   | postings (doc | field << 30) | doc text offsets | folded doc text
+//   | prefix table | prefix postings
+// A query word resolves to a contiguous range of terms by binary search, and
+// because postings are stored in term order that range is one contiguous slice.
+// The smallest slice drives the search; other words are checked against the
+// folded doc text ("title\x1fartist\x1falbum"). Within a term postings are
+// ordered by (field, doc), so the slice is walked field by field, best field
+// first, and each term's docs in order: score bounds and the doc tie-break cut
+// the walk short once the top hits are settled.
+// A one- or two-byte prefix can span a hundred thousand terms (numbers), too
+// many to walk term by term on a keystroke. For such wide prefixes the build
+// stores the union of their terms' postings, sorted and so ordered by (field,
+// doc) across all of them: the walk then stops at the first doc that cannot
+// make the top hits, however many terms the prefix covers.
+
+#define _POSIX_C_SOURCE 200809L
+#include "search.h"
+#include "utf8.h"
+#include "util.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SEARCH_MAGIC "OXSRCHIX"
+#define SEARCH_VERSION 2
+#define FIELD_SEP '\x1f'
+#define MAX_HITS 256
+#define MAX_WORDS 8
+#define FOLD_CAP 1024
+#define MAX_CHECKS 2048 /* candidates checked against doc text per query */
+#define PREFIX_LEN 2     /* prefixes up to this many bytes may get merged postings */
+#define WIDE_TERMS 256   /* ... when they span more terms than this */
+
+struct search_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t ndocs;
+    uint64_t nterms;
+    uint64_t npost;
+    uint64_t terms_off, terms_len;
+    uint64_t term_idx_off;   /* uint32[nterms] */
+    uint64_t post_start_off; /* uint32[nterms + 1] */
+    uint64_t post_off;       /* uint32[npost] */
+    uint64_t doc_off_off;    /* uint32[ndocs + 1] */
+    uint64_t text_off, text_len;
+    uint64_t nprefix;
+    uint64_t prefix_off;      /* struct prefix[nprefix], by (lo, hi) */
+    uint64_t nprefix_post;
+    uint64_t prefix_post_off; /* uint32[nprefix_post] */
+    uint64_t file_size;
+};
+
+/* Terms [lo, hi) share a prefix; their postings merged at start. */
+struct prefix {
+    uint32_t lo, hi;
+    uint32_t start, count;
+};
+
+struct ox_search {
+    void *base;
+    size_t len;
+    int mapped;
+    size_t ndocs, nterms, npost;
+    const char *terms;
+    size_t terms_len;
+    const uint32_t *term_idx;
+    const uint32_t *post_start;
+    const uint32_t *post;
+    const uint32_t *doc_off;
+    const char *text;
+    size_t text_len;
+    size_t nprefix, nprefix_post;
+    const struct prefix *prefix;
+    const uint32_t *prefix_post;
+};
+
+static const uint32_t field_weight[3] = { 30, 20, 10 }; /* title, artist, album */
+#define EXACT_BONUS 5
+
+/* ---- accessors (clamped so a corrupt file cannot read out of bounds) ---- */
+
+static const char *term_at(const struct ox_search *s, size_t i)
+{
+    uint32_t off = s->term_idx[i];
+    return off < s->terms_len ? s->terms + off : "";
+}
+
+static uint32_t post_start_at(const struct ox_search *s, size_t i)
+{
+    uint32_t v = s->post_start[i];
+    return v <= s->npost ? v : (uint32_t)s->npost;
+}
+
+static void doc_text(const struct ox_search *s, uint32_t doc, const char **p, size_t *n)
+{
+    uint32_t a = s->doc_off[doc], b = s->doc_off[doc + 1];
+    if (b > s->text_len) b = (uint32_t)s->text_len;
+    if (a > b) a = b;
+    *p = s->text + a;
+    *n = b - a;
+}
+
+static void attach(struct ox_search *s)
+{
+    const struct search_header *h = s->base;
+    const char *b = s->base;
+    s->ndocs = (size_t)h->ndocs;
+    s->nterms = (size_t)h->nterms;
+    s->npost = (size_t)h->npost;
+    s->terms = b + h->terms_off;
+    s->terms_len = (size_t)h->terms_len;
+    s->term_idx = (const uint32_t *)(b + h->term_idx_off);
+    s->post_start = (const uint32_t *)(b + h->post_start_off);
+    s->post = (const uint32_t *)(b + h->post_off);
+    s->doc_off = (const uint32_t *)(b + h->doc_off_off);
+    s->text = b + h->text_off;
+    s->text_len = (size_t)h->text_len;
+    s->nprefix = (size_t)h->nprefix;
+    s->prefix = (const struct prefix *)(b + h->prefix_off);
+    s->nprefix_post = (size_t)h->nprefix_post;
+    s->prefix_post = (const uint32_t *)(b + h->prefix_post_off);
+}
+
+/* ---- build ---- */
+
+struct tok {
+    const char *s; /* offset into the part's text until the part is finished */
+    uint32_t len;
+    uint32_t post; /* doc | field << 30 */
+};
+
+struct part {
+    const struct ox_search_doc *docs;
+    size_t first, count;
+    char *text;
+    size_t text_len, text_cap;
+    uint32_t *doc_end; /* per doc, end of its text relative to this part */
+    struct tok *toks;
+    size_t ntoks, tok_cap;
+    int oom;
+};
+
+static int cmp_tok(const void *x, const void *y)
+{
+    const struct tok *a = x, *b = y;
+    int c = memcmp(a->s, b->s, a->len < b->len ? a->len : b->len);
+    if (c) return c;
+    if (a->len != b->len) return a->len < b->len ? -1 : 1;
+    return (a->post > b->post) - (a->post < b->post);
+}
+
+static int cmp_u32(const void *x, const void *y)
+{
+    uint32_t a = *(const uint32_t *)x, b = *(const uint32_t *)y;
+    return (a > b) - (a < b);
+}
+
+static int cmp_prefix(const void *x, const void *y)
+{
+    const struct prefix *a = x, *b = y;
+    if (a->lo != b->lo) return a->lo < b->lo ? -1 : 1;
+    return (a->hi > b->hi) - (a->hi < b->hi);
+}
+
+static int part_reserve(struct part *p, size_t n)
+{
+    if (p->text_len + n <= p->text_cap) return 0;
+    size_t ncap = p->text_cap ? p->text_cap : 65536;
+    while (p->text_len + n > ncap) ncap *= 2;
+    char *t = realloc(p->text, ncap);
+    if (!t) return -1;
+    p->text = t;
+    p->text_cap = ncap;
+    return 0;
+}
+
+static int part_add_tok(struct part *p, size_t off, size_t len, uint32_t post)
+{
+    if (p->ntoks == p->tok_cap) {
+        size_t ncap = p->tok_cap ? p->tok_cap * 2 : 4096;
+        struct tok *t = realloc(p->toks, ncap * sizeof(*t));
+        if (!t) return -1;
+        p->toks = t;
+        p->tok_cap = ncap;
+    }
+    struct tok *t = &p->toks[p->ntoks++];
+    t->s = (const char *)(uintptr_t)off;
+    t->len = (uint32_t)len;
+    t->post = post;
+    return 0;
+}
+
+static void *part_run(void *arg)
+{
+    struct part *p = arg;
+    char buf[FOLD_CAP];
+    for (size_t i = 0; i < p->count && !p->oom; ++i) {
+        const struct ox_search_doc *d = &p->docs[p->first + i];
+        const char *fields[3] = { d->title, d->artist, d->album };
+        uint32_t doc = (uint32_t)(p->first + i);
+        for (uint32_t f = 0; f < 3; ++f) {
+            size_t n = ox_utf8_fold(fields[f], buf, sizeof(buf));
+            if (part_reserve(p, n + 1) != 0) { p->oom = 1; break; }
+            size_t base = p->text_len;
+            memcpy(p->text + base, buf, n);
+            p->text_len += n;
+            if (f < 2) p->text[p->text_len++] = FIELD_SEP;
+            for (size_t j = 0; j < n; ) {
+                if (buf[j] == ' ') { j++; continue; }
+                size_t k = j;
+                while (k < n && buf[k] != ' ') k++;
+                if (part_add_tok(p, base + j, k - j, doc | f << 30) != 0) { p->oom = 1; break; }
+                j = k;
+            }
+        }
+        if (p->text_len > UINT32_MAX) p->oom = 1;
+        p->doc_end[i] = (uint32_t)p->text_len;
+    }
+    if (p->oom) return NULL;
+    for (size_t i = 0; i < p->ntoks; ++i) p->toks[i].s = p->text + (uintptr_t)p->toks[i].s;
+    if (p->ntoks) qsort(p->toks, p->ntoks, sizeof(*p->toks), cmp_tok);
+    return NULL;
+}
+
+static int grow(void **buf, size_t *cap, size_t need, size_t elem)
+{
+    if (need <= *cap) return 0;
+    size_t ncap = *cap ? *cap : 1024;
+    while (ncap < need) ncap *= 2;
+    void *n = realloc(*buf, ncap * elem);
+    if (!n) return -1;
+    *buf = n;
+    *cap = ncap;
+    return 0;
+}
+
+static int online_cpus(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > 16) n = 16;
+    return (int)n;
+}
+
+struct ox_search *ox_search_build(const struct ox_search_doc *docs, size_t n, int threads)
+{
+    if ((!docs && n) || n >= (1u << 30)) return NULL;
+    if (threads <= 0) threads = online_cpus();
+    if ((size_t)threads > n / 4096 + 1) threads = (int)(n / 4096 + 1);
+
+    struct part *parts = calloc((size_t)threads, sizeof(*parts));
+    pthread_t *tids = calloc((size_t)threads, sizeof(*tids));
+    int *started = calloc((size_t)threads, sizeof(*started));
+    struct ox_search *s = NULL;
+    char *terms = NULL;
+    uint32_t *term_idx = NULL, *post_start = NULL, *post = NULL, *ppost = NULL;
+    struct prefix *prefixes = NULL;
+    size_t terms_len = 0, terms_cap = 0, nterms = 0, idx_cap = 0, ps_cap = 0, npost = 0, total = 0;
+    size_t nprefix = 0, prefix_cap = 0, nppost = 0, ppost_cap = 0;
+    size_t *cur = NULL;
+    int ok = parts && tids && started;
+
+    for (int t = 0; ok && t < threads; ++t) {
+        struct part *p = &parts[t];
+        p->docs = docs;
+        p->first = n * (size_t)t / (size_t)threads;
+        p->count = n * (size_t)(t + 1) / (size_t)threads - p->first;
+        p->doc_end = malloc((p->count ? p->count : 1) * sizeof(*p->doc_end));
+        if (!p->doc_end) { ok = 0; break; }
+        if (t > 0) started[t] = pthread_create(&tids[t], NULL, part_run, p) == 0;
+        if (t > 0 && !started[t]) part_run(p);
+    }
+    if (ok) part_run(&parts[0]);
+    for (int t = 1; parts && t < threads; ++t)
+        if (started[t]) pthread_join(tids[t], NULL);
+    for (int t = 0; ok && t < threads; ++t) {
+        if (parts[t].oom) ok = 0;
+        total += parts[t].ntoks;
+    }
+
+    /* k-way merge of the sorted parts into the term dictionary and postings */
+    if (ok) {
+        cur = calloc((size_t)threads, sizeof(*cur));
+        post = malloc((total ? total : 1) * sizeof(*post));
+        ok = cur && post && total < UINT32_MAX;
+    }
+    const struct tok *prev = NULL;
+    while (ok) {
+        int best = -1;
+        for (int t = 0; t < threads; ++t) {
+            if (cur[t] >= parts[t].ntoks) continue;
+            if (best < 0 || cmp_tok(&parts[t].toks[cur[t]], &parts[best].toks[cur[best]]) < 0) best = t;
+        }
+        if (best < 0) break;
+        const struct tok *tk = &parts[best].toks[cur[best]++];
+        int same_term = prev && prev->len == tk->len && memcmp(prev->s, tk->s, tk->len) == 0;
+        if (same_term && post[npost - 1] == tk->post) continue; /* word repeated in one field */
+        if (!same_term) {
+            if (grow((void **)&term_idx, &idx_cap, nterms + 1, sizeof(*term_idx)) != 0 ||
+                grow((void **)&post_start, &ps_cap, nterms + 2, sizeof(*post_start)) != 0) { ok = 0; break; }
+            if (grow((void **)&terms, &terms_cap, terms_len + tk->len + 1, 1) != 0) { ok = 0; break; }
+            post_start[nterms] = (uint32_t)npost;
+            term_idx[nterms++] = (uint32_t)terms_len;
+            memcpy(terms + terms_len, tk->s, tk->len);
+            terms_len += tk->len;
+            terms[terms_len++] = '\0';
+        }
+        post[npost++] = tk->post;
+        prev = tk;
+    }
+    if (ok && !post_start) ok = grow((void **)&post_start, &ps_cap, 1, sizeof(*post_start)) == 0;
+    if (ok) post_start[nterms] = (uint32_t)npost;
+
+    /* merged postings of the wide short prefixes, one sorted run each */
+    for (size_t len = 1; ok && len <= PREFIX_LEN; ++len) {
+        for (size_t t = 0, u; ok && t < nterms; t = u) {
+            const char *a = terms + term_idx[t];
+            u = t + 1;
+            if (strlen(a) < len) continue;
+            while (u < nterms && strncmp(terms + term_idx[u], a, len) == 0) u++;
+            if (u - t <= WIDE_TERMS) continue;
+            size_t from = post_start[t], n = post_start[u] - from;
+            if (nppost + n >= UINT32_MAX || grow((void **)&ppost, &ppost_cap, nppost + n, sizeof(*ppost)) != 0 ||
+                grow((void **)&prefixes, &prefix_cap, nprefix + 1, sizeof(*prefixes)) != 0) { ok = 0; break; }
+            uint32_t *run = ppost + nppost;
+            memcpy(run, post + from, n * sizeof(*run));
+            qsort(run, n, sizeof(*run), cmp_u32);
+            size_t m = 0; /* a doc field holding several of the terms */
+            for (size_t i = 0; i < n; ++i)
+                if (m == 0 || run[m - 1] != run[i]) run[m++] = run[i];
+            prefixes[nprefix++] = (struct prefix){ (uint32_t)t, (uint32_t)u, (uint32_t)nppost, (uint32_t)m };
+            nppost += m;
+        }
+    }
+    if (ok && nprefix) qsort(prefixes, nprefix, sizeof(*prefixes), cmp_prefix);
+
+    if (ok && terms_len < UINT32_MAX) {
+        struct search_header h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, SEARCH_MAGIC, 8);
+        h.version = SEARCH_VERSION;
+        h.ndocs = n;
+        h.nterms = nterms;
+        h.npost = npost;
+        h.terms_off = sizeof(h);
+        h.terms_len = terms_len + 1; /* trailing NUL so an empty pool is valid */
+        h.term_idx_off = (h.terms_off + h.terms_len + 3) & ~(uint64_t)3;
+        h.post_start_off = h.term_idx_off + nterms * 4;
+        h.post_off = h.post_start_off + (nterms + 1) * 4;
+        h.doc_off_off = h.post_off + npost * 4;
+        h.text_off = h.doc_off_off + (n + 1) * 4;
+        for (int t = 0; t < threads; ++t) h.text_len += parts[t].text_len;
+        h.nprefix = nprefix;
+        h.prefix_off = (h.text_off + h.text_len + 3) & ~(uint64_t)3;
+        h.nprefix_post = nppost;
+        h.prefix_post_off = h.prefix_off + nprefix * sizeof(struct prefix);
+        h.file_size = h.prefix_post_off + nppost * 4;
+
+        s = calloc(1, sizeof(*s));
+        char *b = s && h.text_len < UINT32_MAX ? calloc(1, (size_t)h.file_size) : NULL;
+        if (!b) { free(s); s = NULL; }
+        if (s) {
+            memcpy(b, &h, sizeof(h));
+            if (nterms) {
+                memcpy(b + h.terms_off, terms, terms_len);
+                memcpy(b + h.term_idx_off, term_idx, nterms * 4);
+                memcpy(b + h.post_off, post, npost * 4);
+            }
+            memcpy(b + h.post_start_off, post_start, (nterms + 1) * 4);
+            uint32_t *dof = (uint32_t *)(b + h.doc_off_off);
+            size_t text_pos = 0;
+            for (int t = 0; t < threads; ++t) {
+                const struct part *p = &parts[t];
+                for (size_t i = 0; i < p->count; ++i) dof[p->first + i + 1] = (uint32_t)(text_pos + p->doc_end[i]);
+                if (p->text_len) memcpy(b + h.text_off + text_pos, p->text, p->text_len);
+                text_pos += p->text_len;
+            }
+            if (nprefix) {
+                memcpy(b + h.prefix_off, prefixes, nprefix * sizeof(struct prefix));
+                memcpy(b + h.prefix_post_off, ppost, nppost * 4);
+            }
+            s->base = b;
+            s->len = (size_t)h.file_size;
+            attach(s);
+        }
+    }
+
+    free(cur);
+    free(terms);
+    free(term_idx);
+    free(post_start);
+    free(post);
+    free(prefixes);
+    free(ppost);
+    for (int t = 0; parts && t < threads; ++t) {
+        free(parts[t].text);
+        free(parts[t].doc_end);
+        free(parts[t].toks);
+    }
+    free(parts);
+    free(tids);
+    free(started);
+    return s;
+}
+
+struct ox_search *ox_search_build_library(const struct ox_library *lib, int threads)
+{
+    if (!lib) return NULL;
+    size_t n = ox_library_count(lib);
+    struct ox_search_doc *docs = malloc((n ? n : 1) * sizeof(*docs));
+    if (!docs) return NULL;
+    for (size_t i = 0; i < n; ++i) {
+        const struct ox_lib_track *t = ox_library_track(lib, i);
+        docs[i].title = ox_library_str(lib, t->title);
+        docs[i].artist = ox_library_str(lib, t->artist);
+        docs[i].album = ox_library_str(lib, t->album);
+        /* untagged files are still findable by file name */
+        if (!t->title && !t->artist) {
+            const char *p = ox_library_str(lib, t->path);
+            const char *slash = strrchr(p, '/');
+            docs[i].title = slash ? slash + 1 : p;
+        }
+    }
+    struct ox_search *s = ox_search_build(docs, n, threads);
+    free(docs);
+    return s;
+}
+
+/* ---- persistence ---- */
+
+char *ox_search_default_path(void)
+{
+    char *lib = ox_library_default_path();
+    if (!lib) return NULL;
+    char *slash = strrchr(lib, '/');
+    size_t dir = slash ? (size_t)(slash - lib) + 1 : 0;
+    size_t n = dir + strlen("search.idx") + 1;
+    char *out = malloc(n);
+    if (out) snprintf(out, n, "%.*ssearch.idx", (int)dir, lib);
+    free(lib);
+    return out;
+}
+
+int ox_search_save(const struct ox_search *s, const char *path)
+{
+    if (!s || !path) return -1;
+    return ox_write_file_atomic(path, s->base, s->len, 0600, 1);
+}
+
+static int fits(uint64_t off, uint64_t len, uint64_t total)
+{
+    return off <= total && len <= total - off;
+}
+
+struct ox_search *ox_search_open(const char *path)
+{
+    if (!path) return NULL;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct search_header)) { close(fd); return NULL; }
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const struct search_header *h = map;
+    int ok = memcmp(h->magic, SEARCH_MAGIC, 8) == 0 && h->version == SEARCH_VERSION &&
+             h->file_size == len && h->ndocs < (1u << 30) && h->nterms < UINT32_MAX && h->npost < UINT32_MAX &&
+             h->terms_len >= 1 && fits(h->terms_off, h->terms_len, len) &&
+             h->term_idx_off % 4 == 0 && fits(h->term_idx_off, h->nterms * 4, len) &&
+             h->post_start_off % 4 == 0 && fits(h->post_start_off, (h->nterms + 1) * 4, len) &&
+             h->post_off % 4 == 0 && fits(h->post_off, h->npost * 4, len) &&
+             h->doc_off_off % 4 == 0 && fits(h->doc_off_off, (h->ndocs + 1) * 4, len) &&
+             fits(h->text_off, h->text_len, len) && h->nprefix < UINT32_MAX && h->nprefix_post < UINT32_MAX &&
+             h->prefix_off % 4 == 0 && fits(h->prefix_off, h->nprefix * sizeof(struct prefix), len) &&
+             h->prefix_post_off % 4 == 0 && fits(h->prefix_post_off, h->nprefix_post * 4, len);
+    if (ok) ok = ((const char *)map)[h->terms_off + h->terms_len - 1] == '\0';
+    struct ox_search *s = ok ? calloc(1, sizeof(*s)) : NULL;
+    if (!s) { munmap(map, len); return NULL; }
+    s->base = map;
+    s->len = len;
+    s->mapped = 1;
+    attach(s);
+    return s;
+}
+
+void ox_search_close(struct ox_search *s)
+{
+    if (!s) return;
+    if (s->mapped) munmap(s->base, s->len);
+    else free(s->base);
+    free(s);
+}
+
+size_t ox_search_count(const struct ox_search *s)
+{
+    return s ? s->ndocs : 0;
+}
+
+/* ---- query ---- */
+
+struct qword {
+    const char *s;
+    size_t len;
+    size_t lo, hi;   /* terms starting with the word */
+    int exact;       /* term lo equals the word */
+    uint32_t npost;  /* postings across [lo, hi) */
+};
+
+/* First term >= w, or with past_prefix the first term after all terms starting with w. */
+static size_t term_lower(const struct ox_search *s, const char *w, size_t len, int past_prefix)
+{
+    size_t lo = 0, hi = s->nterms;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const char *t = term_at(s, mid);
+        int c = past_prefix ? strncmp(t, w, len) : strcmp(t, w);
+        if (past_prefix ? c <= 0 : c < 0) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+/* Sum of the best scores of every word but words[skip] at word starts in
+ * the doc text, in one pass; 0 if one of them is missing. */
+static uint32_t score_others(const char *text, size_t n, const struct qword *words, size_t nw, size_t skip)
+{
+    uint32_t best[MAX_WORDS] = { 0 }, field = 0;
+    const char *p = text, *end = text + n;
+    while (p < end) {
+        if (*p == ' ') { p++; continue; }
+        if (*p == FIELD_SEP) {
+            if (++field > 2) break;
+            p++;
+            continue;
+        }
+        const char *e = p;
+        while (e < end && *e != ' ' && *e != FIELD_SEP) e++;
+        size_t wl = (size_t)(e - p);
+        for (size_t j = 0; j < nw; ++j) {
+            const struct qword *w = &words[j];
+            if (j == skip || w->len > wl || *p != w->s[0] || memcmp(p, w->s, w->len) != 0) continue;
+            uint32_t sc = field_weight[field] + (w->len == wl ? EXACT_BONUS : 0);
+            if (sc > best[j]) best[j] = sc;
+        }
+        p = e;
+    }
+    uint32_t sum = 0;
+    for (size_t j = 0; j < nw; ++j) {
+        if (j == skip) continue;
+        if (!best[j]) return 0;
+        sum += best[j];
+    }
+    return sum;
+}
+
+struct topk {
+    struct ox_search_hit *h;
+    size_t n, cap;
+};
+
+static int worse(const struct ox_search_hit *a, const struct ox_search_hit *b)
+{
+    return a->score < b->score || (a->score == b->score && a->doc > b->doc);
+}
+
+static void sift_down(struct topk *k, size_t i)
+{
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < k->n && worse(&k->h[l], &k->h[m])) m = l;
+        if (r < k->n && worse(&k->h[r], &k->h[m])) m = r;
+        if (m == i) return;
+        struct ox_search_hit t = k->h[i]; k->h[i] = k->h[m]; k->h[m] = t;
+        i = m;
+    }
+}
+
+static void topk_offer(struct topk *k, uint32_t doc, uint32_t score)
+{
+    struct ox_search_hit c = { doc, score };
+    for (size_t i = 0; i < k->n; ++i) {
+        if (k->h[i].doc != doc) continue;
+        if (k->h[i].score < score) { k->h[i].score = score; sift_down(k, i); }
+        return;
+    }
+    if (k->n < k->cap) {
+        size_t i = k->n++;
+        k->h[i] = c;
+        while (i > 0 && worse(&k->h[i], &k->h[(i - 1) / 2])) {
+            struct ox_search_hit t = k->h[i]; k->h[i] = k->h[(i - 1) / 2]; k->h[(i - 1) / 2] = t;
+            i = (i - 1) / 2;
+        }
+    } else if (worse(&k->h[0], &c)) {
+        k->h[0] = c;
+        sift_down(k, 0);
+    }
+}
+
+static int cmp_hit(const void *x, const void *y)
+{
+    const struct ox_search_hit *a = x, *b = y;
+    return worse(a, b) ? 1 : worse(b, a) ? -1 : 0;
+}
+
+/* First of the sorted postings [p, pe) at or after field f. */
+static const uint32_t *field_lower(const uint32_t *p, const uint32_t *pe, uint32_t f)
+{
+    while (p < pe) {
+        const uint32_t *mid = p + (pe - p) / 2;
+        if (*mid >> 30 < f) p = mid + 1; else pe = mid;
+    }
+    return p;
+}
+
+/* Term t's postings in field f. */
+static void term_field(const struct ox_search *s, size_t t, uint32_t f, const uint32_t **p, const uint32_t **pe)
+{
+    const uint32_t *b = s->post + post_start_at(s, t), *e = s->post + post_start_at(s, t + 1);
+    if (b > e) b = e;
+    *p = field_lower(b, e, f);
+    *pe = field_lower(*p, e, f + 1);
+}
+
+/* The merged postings of terms [lo, hi), if the build stored them. */
+static int prefix_run(const struct ox_search *s, size_t lo, size_t hi, const uint32_t **p, const uint32_t **pe)
+{
+    size_t a = 0, b = s->nprefix;
+    while (a < b) {
+        size_t mid = a + (b - a) / 2;
+        const struct prefix *x = &s->prefix[mid];
+        if (x->lo < lo || (x->lo == lo && x->hi < hi)) a = mid + 1; else b = mid;
+    }
+    if (a == s->nprefix) return 0;
+    const struct prefix *x = &s->prefix[a];
+    if (x->lo != lo || x->hi != hi || x->start > s->nprefix_post || x->count > s->nprefix_post - x->start) return 0;
+    *p = s->prefix_post + x->start;
+    *pe = *p + x->count;
+    return 1;
+}
+
+/* A term's best field is that of its first posting. */
+static uint32_t word_best(const struct ox_search *s, const struct qword *w)
+{
+    uint32_t best = 0;
+    for (size_t t = w->lo; t < w->hi && best < field_weight[0] + EXACT_BONUS; ++t) {
+        uint32_t p = post_start_at(s, t);
+        if (p >= post_start_at(s, t + 1) || s->post[p] >> 30 > 2) continue;
+        uint32_t sc = field_weight[s->post[p] >> 30] + (t == w->lo && w->exact ? EXACT_BONUS : 0);
+        if (sc > best) best = sc;
+    }
+    return best;
+}
+
+struct walk {
+    const struct ox_search *s;
+    const struct qword *words;
+    size_t nw, drv;
+    uint32_t others_best;
+    struct topk k;
+    size_t checks;
+    const uint32_t *skip, *skip_end; /* already offered with the exact bonus */
+};
+
+/* Offer the postings [p, pe) of one field, docs ascending, at driver score
+ * sc0. A full heap ends the run at the first doc that cannot beat it (docs
+ * only grow from there). -1 once MAX_CHECKS doc texts were checked. */
+static int walk_run(struct walk *q, const uint32_t *p, const uint32_t *pe, uint32_t sc0)
+{
+    for (; p < pe; ++p) {
+        uint32_t doc = *p & ((1u << 30) - 1);
+        if (doc >= q->s->ndocs) continue;
+        struct ox_search_hit bound = { doc, sc0 + q->others_best };
+        if (q->k.n == q->k.cap && !worse(&q->k.h[0], &bound)) break;
+        while (q->skip < q->skip_end && *q->skip < *p) q->skip++;
+        if (q->skip < q->skip_end && *q->skip == *p) continue;
+        uint32_t sc = sc0;
+        if (q->nw > 1) {
+            if (q->checks++ == MAX_CHECKS) return -1;
+            const char *text;
+            size_t tn;
+            doc_text(q->s, doc, &text, &tn);
+            uint32_t o = score_others(text, tn, q->words, q->nw, q->drv);
+            if (!o) continue;
+            sc += o;
+        }
+        topk_offer(&q->k, doc, sc);
+    }
+    return 0;
+}
+
+size_t ox_search_query(const struct ox_search *s, const char *query, struct ox_search_hit *hits, size_t max)
+{
+    if (!s || !query || !hits || max == 0 || s->nterms == 0) return 0;
+    if (max > MAX_HITS) max = MAX_HITS;
+    char folded[FOLD_CAP];
+    size_t fl = ox_utf8_fold(query, folded, sizeof(folded));
+
+    struct qword words[MAX_WORDS];
+    size_t nw = 0;
+    for (size_t i = 0; i < fl && nw < MAX_WORDS; ) {
+        if (folded[i] == ' ') { i++; continue; }
+        size_t j = i;
+        while (j < fl && folded[j] != ' ') j++;
+        folded[j] = '\0';
+        struct qword *w = &words[nw++];
+        w->s = folded + i;
+        w->len = j - i;
+        w->lo = term_lower(s, w->s, w->len, 0);
+        w->hi = term_lower(s, w->s, w->len, 1);
+        w->exact = w->lo < w->hi && strcmp(term_at(s, w->lo), w->s) == 0;
+        uint32_t pb = post_start_at(s, w->lo), pe = post_start_at(s, w->hi);
+        if (pb >= pe) return 0;
+        w->npost = pe - pb;
+        i = j + 1;
+    }
+    if (nw == 0) return 0;
+
+    size_t drv = 0;
+    for (size_t i = 1; i < nw; ++i)
+        if (words[i].npost < words[drv].npost) drv = i;
+    const struct qword *d = &words[drv];
+    struct walk q = { s, words, nw, drv, 0, { hits, 0, max }, 0, NULL, NULL };
+    for (size_t i = 0; i < nw; ++i)
+        if (i != drv) q.others_best += word_best(s, &words[i]);
+    const uint32_t *run = NULL, *run_end = NULL;
+    int merged = prefix_run(s, d->lo, d->hi, &run, &run_end);
+
+    /* Fields best first and the exact term first within each, so a doc is
+     * first met at its best score for the driving word; then the other terms,
+     * merged or one after the other. A whole field is skipped once its best
+     * possible score loses. Short prefixes of several words can leave
+     * millions of candidates: past MAX_CHECKS doc text checks the hits found
+     * so far are returned. */
+    for (uint32_t f = 0; f < 3; ++f) {
+        uint32_t top = field_weight[f] + (d->exact ? EXACT_BONUS : 0) + q.others_best;
+        if (q.k.n == q.k.cap && top < q.k.h[0].score) break;
+        const uint32_t *p, *pe;
+        size_t t = d->lo;
+        q.skip = q.skip_end = NULL;
+        if (d->exact) {
+            term_field(s, t++, f, &p, &pe);
+            if (walk_run(&q, p, pe, field_weight[f] + EXACT_BONUS) != 0) goto done;
+            q.skip = p;
+            q.skip_end = pe;
+        }
+        if (merged) {
+            p = field_lower(run, run_end, f);
+            if (walk_run(&q, p, field_lower(p, run_end, f + 1), field_weight[f]) != 0) goto done;
+            continue;
+        }
+        q.skip = q.skip_end = NULL;
+        for (; t < d->hi; ++t) {
+            term_field(s, t, f, &p, &pe);
+            if (walk_run(&q, p, pe, field_weight[f]) != 0) goto done;
+        }
+    }
+done:
+    qsort(hits, q.k.n, sizeof(*hits), cmp_hit);
+    return q.k.n;
+}
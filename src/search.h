@@ -0,0 +1,47 @@
+// search.h - folded prefix search over title/artist/album
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "library.h"
+
+/* One searchable document. NULL fields are treated as empty. */
+struct ox_search_doc {
+    const char *title;
+    const char *artist;
+    const char *album;
+};
+
+struct ox_search_hit {
+    uint32_t doc;   /* document index as passed to the builder (library record index) */
+    uint32_t score; /* higher is better */
+};
+
+struct ox_search;
+
+/* Build an in-memory index. Text is folded with ox_utf8_fold and split into
+ * words; docs are split across threads (0: online CPUs, capped at 16).
+ * Returns NULL on failure or if n exceeds 2^30.
+ */
+struct ox_search *ox_search_build(const struct ox_search_doc *docs, size_t n, int threads);
+struct ox_search *ox_search_build_library(const struct ox_library *lib, int threads);
+
+/* Default location next to the library index: $XDG_CACHE_HOME/oxxy/search.idx.
+ * Returns malloc'd path or NULL. */
+char *ox_search_default_path(void);
+
+/* Persist atomically (temp file + rename); the file is what ox_search_open maps. */
+int ox_search_save(const struct ox_search *s, const char *path);
+struct ox_search *ox_search_open(const char *path);
+void ox_search_close(struct ox_search *s);
+
+size_t ox_search_count(const struct ox_search *s);
+
+/* Ranked search. Every query word must be a prefix of some word in the doc,
+ * so partially typed input works and this can run on each keystroke. Title hits
+ * rank above artist above album, whole words above prefixes. Fills up to max
+ * hits (at most 256) best first and returns the number written. Several very
+ * short words can match most of a large library; such a query checks a
+ * bounded number of candidates and ranks the best of those.
+ */
+size_t ox_search_query(const struct ox_search *s, const char *query, struct ox_search_hit *hits, size_t max);
@@ -0,0 +1,80 @@
+// startup.c - startup phase timing
+// - a handful of marks per process, so a mutex and a linear scan are plenty
+// - CLOCK_MONOTONIC: the phases are compared with each other, not the wall clock
+
+#define _POSIX_C_SOURCE 200809L
+#include "startup.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static double t0 = -1.0;
+static int verbose = -1;
+static struct {
+    const char *name;
+    double ms;
+} phases[OX_STARTUP_MAX_PHASES];
+static int nphases;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void start_locked(double now)
+{
+    if (t0 >= 0.0) return;
+    t0 = now;
+    const char *env = getenv("OXXY_STARTUP_TIMING");
+    verbose = env && *env && strcmp(env, "0") != 0;
+}
+
+void ox_startup_begin(void)
+{
+    double now = now_ms();
+    pthread_mutex_lock(&lock);
+    start_locked(now);
+    pthread_mutex_unlock(&lock);
+}
+
+static int find_locked(const char *phase)
+{
+    for (int i = 0; i < nphases; ++i)
+        if (phases[i].name == phase || strcmp(phases[i].name, phase) == 0) return i;
+    return -1;
+}
+
+void ox_startup_mark(const char *phase)
+{
+    if (!phase) return;
+    double now = now_ms();
+    pthread_mutex_lock(&lock);
+    start_locked(now);
+    if (find_locked(phase) < 0 && nphases < OX_STARTUP_MAX_PHASES) {
+        phases[nphases].name = phase;
+        phases[nphases].ms = now - t0;
+        if (verbose) fprintf(stderr, "startup: %8.2f ms  %s\n", phases[nphases].ms, phase);
+        nphases++;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+double ox_startup_ms(const char *phase)
+{
+    pthread_mutex_lock(&lock);
+    int i = phase ? find_locked(phase) : -1;
+    double ms = i >= 0 ? phases[i].ms : -1.0;
+    pthread_mutex_unlock(&lock);
+    return ms;
+}
+
+void ox_startup_report(FILE *f)
+{
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < nphases; ++i) fprintf(f, "%8.2f %s\n", phases[i].ms, phases[i].name);
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,21 @@
+// startup.h - startup phase timing
+#pragma once
+
+#include <stdio.h>
+
+/* Milestones of process startup (profiles loaded, window up, first frame,
+ * first sound, optional integrations ready) timed from ox_startup_begin, or
+ * from the first mark if it was never called. Each phase counts once, the
+ * first time it is reached, from whichever thread reaches it. With
+ * $OXXY_STARTUP_TIMING set, every phase is also printed to stderr as it
+ * happens.
+ */
+#define OX_STARTUP_MAX_PHASES 32
+
+void ox_startup_begin(void);
+/* phase: a string literal (kept, not copied). Later marks of it are ignored. */
+void ox_startup_mark(const char *phase);
+/* Milliseconds from the start to phase, -1 if it has not been reached. */
+double ox_startup_ms(const char *phase);
+/* One "<ms> <phase>" line per phase, in the order reached. */
+void ox_startup_report(FILE *f);
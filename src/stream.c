@@ -0,0 +1,733 @@
+// stream.c - local and HTTP byte sources; remote chunks cached on disk
+// - one worker thread per remote stream makes the HTTP requests (blocking
+//   curl easy calls), so readers only wait on a condition variable for the
+//   chunk they need and never on the network
+// - the worker fetches runs of missing chunks in the window starting at the
+//   reader's chunk; when the reader jumps to a missing chunk outside the run
+//   being received, the transfer is dropped and the next one starts there
+// - a cache file is "<fnv64(url)>.oxs": header, URL, one 32-bit sum per chunk
+//   (0 while absent), then the stream at its own offsets in a sparse region.
+//   Data is written before its sum, and a chunk found on disk is checked
+//   against its sum on first use, so a torn write costs a refetch, not noise
+// - eviction removes whole files by mtime, which open and writes refresh; an
+//   open stream whose file is evicted keeps reading through its descriptor
+
+#define _POSIX_C_SOURCE 200809L
+#include "stream.h"
+#include "curl_load.h"
+#include "util.h"
+#include "xdg.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ---- cache directory ---- */
+
+struct ox_stream_cache {
+    char *dir;
+    uint64_t max_bytes;
+    pthread_mutex_t lock;
+    uint64_t written;   /* since the last eviction pass */
+};
+
+struct victim {
+    time_t mtime;
+    uint64_t bytes;
+    char name[32];
+};
+
+static int by_mtime(const void *a, const void *b)
+{
+    const struct victim *x = a, *y = b;
+    return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+/* drop least recently used files until the cache is under 90% of its cap */
+static void evict(struct ox_stream_cache *c, const char *keep)
+{
+    pthread_mutex_lock(&c->lock);
+    c->written = 0;
+    DIR *d = opendir(c->dir);
+    struct victim *v = NULL;
+    size_t n = 0, cap = 0;
+    uint64_t total = 0;
+    struct dirent *e;
+    char path[4096];
+    while (d && (e = readdir(d))) {
+        size_t len = strlen(e->d_name);
+        struct stat st;
+        if (len < 5 || len >= sizeof(v->name) || strcmp(e->d_name + len - 4, ".oxs") != 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", c->dir, e->d_name);
+        if (stat(path, &st) != 0) continue;
+        if (n == cap) {
+            struct victim *nv = realloc(v, (cap = cap ? cap * 2 : 64) * sizeof(*v));
+            if (!nv) break;
+            v = nv;
+        }
+        v[n].mtime = st.st_mtime;
+        v[n].bytes = (uint64_t)st.st_blocks * 512;
+        memcpy(v[n].name, e->d_name, len + 1);
+        total += v[n++].bytes;
+    }
+    if (d) closedir(d);
+    if (total > c->max_bytes) {
+        qsort(v, n, sizeof(*v), by_mtime);
+        const char *keep_name = keep ? strrchr(keep, '/') : NULL;
+        keep_name = keep_name ? keep_name + 1 : "";
+        for (size_t i = 0; i < n && total > c->max_bytes / 10 * 9; ++i) {
+            if (strcmp(v[i].name, keep_name) == 0) continue;
+            snprintf(path, sizeof(path), "%s/%s", c->dir, v[i].name);
+            if (unlink(path) == 0) total -= v[i].bytes;
+        }
+    }
+    free(v);
+    pthread_mutex_unlock(&c->lock);
+}
+
+char *ox_stream_default_dir(void)
+{
+    char *cache = ox_get_xdg_cache_home();
+    if (!cache) return NULL;
+    size_t n = strlen(cache) + strlen("/streams") + 1;
+    char *out = malloc(n);
+    if (out) {
+        snprintf(out, n, "%s/streams", cache);
+        if (ox_mkdir_p(out) != 0) {
+            free(out);
+            out = NULL;
+        }
+    }
+    free(cache);
+    return out;
+}
+
+struct ox_stream_cache *ox_stream_cache_create(const char *dir, uint64_t max_bytes)
+{
+    if (!dir) return NULL;
+    struct ox_stream_cache *c = calloc(1, sizeof(*c));
+    if (!c || !(c->dir = strdup(dir)) || pthread_mutex_init(&c->lock, NULL) != 0) {
+        if (c) free(c->dir);
+        free(c);
+        return NULL;
+    }
+    c->max_bytes = max_bytes ? max_bytes : OX_STREAM_CACHE_MAX;
+    evict(c, NULL);
+    return c;
+}
+
+void ox_stream_cache_destroy(struct ox_stream_cache *c)
+{
+    if (!c) return;
+    pthread_mutex_destroy(&c->lock);
+    free(c->dir);
+    free(c);
+}
+
+/* ---- chunk store ---- */
+
+#define CACHE_MAGIC "OXSTRM1"
+#define C OX_STREAM_CHUNK
+
+struct cache_head {
+    char magic[8];
+    uint64_t size;
+    uint32_t chunk;
+    uint32_t nchunks;
+    uint32_t url_len;
+    uint32_t reserved;
+};
+
+enum { ABSENT, ON_DISK, READY };
+
+struct ox_stream {
+    int fd;                 /* the local file, or the chunk store (-1 until known) */
+    int local;
+    struct ox_stream_cache *cache;
+    char *url;
+    char *path;             /* cache file; NULL for a temporary store */
+    pthread_t worker;
+    int has_worker;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* chunk stored, reader moved, stop or failure */
+    int stop, failed;
+    int64_t size;
+    int ranged;             /* server honours Range: -1 until the first response */
+    uint64_t data_off;
+    uint64_t sums_off;
+    uint32_t *sums;
+    unsigned char *state;
+    size_t nchunks, chunk_cap;
+    uint64_t want;          /* chunk the reader is at */
+    struct ox_stream_stats stats;
+
+    /* the worker's current transfer (worker thread only) */
+    unsigned char *cbuf;
+    size_t cfill;
+    uint64_t pos;           /* stream offset of the next body byte */
+    uint64_t run_end;       /* chunks requested: [pos / C, run_end) */
+    int status;
+    int64_t resp_start, resp_total, resp_length;
+    int body_started, aborted;
+    uint64_t body_bytes;    /* received, not yet in stats */
+};
+
+static uint32_t chunk_sum(const unsigned char *p, size_t n)
+{
+    uint64_t h = (uint64_t)n * 0x9E3779B97F4A7C15ull, w;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    for (; i < n; ++i) h = (h ^ p[i]) * 0x100000001B3ull;
+    return (uint32_t)(h ^ h >> 29) | 1;
+}
+
+static size_t chunk_len(const struct ox_stream *s, size_t idx)
+{
+    if (s->size < 0) return C;
+    uint64_t left = (uint64_t)s->size - (uint64_t)idx * C;
+    return left < C ? (size_t)left : C;
+}
+
+/* room for chunk idx in the per-chunk arrays; caller holds lock */
+static int grow(struct ox_stream *s, size_t need)
+{
+    if (need <= s->chunk_cap) return 0;
+    size_t cap = s->chunk_cap ? s->chunk_cap : 64;
+    while (cap < need) cap *= 2;
+    uint32_t *sums = realloc(s->sums, cap * sizeof(*sums));
+    if (sums) s->sums = sums;
+    unsigned char *state = realloc(s->state, cap);
+    if (state) s->state = state;
+    if (!sums || !state) return -1;
+    memset(s->sums + s->chunk_cap, 0, (cap - s->chunk_cap) * sizeof(*sums));
+    memset(s->state + s->chunk_cap, ABSENT, cap - s->chunk_cap);
+    s->chunk_cap = cap;
+    return 0;
+}
+
+static int temp_store(struct ox_stream *s)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/.oxs-XXXXXX", s->cache ? s->cache->dir : "/tmp");
+    int fd = mkstemp(path);
+    if (fd < 0 && s->cache) {
+        snprintf(path, sizeof(path), "/tmp/.oxs-XXXXXX");
+        fd = mkstemp(path);
+    }
+    if (fd < 0) return -1;
+    unlink(path);
+    s->fd = fd;
+    s->data_off = 0;
+    free(s->path);
+    s->path = NULL;
+    return 0;
+}
+
+/* the size is known: create the cache file, or a temporary store; caller
+ * holds lock */
+static int store_init(struct ox_stream *s, int64_t size)
+{
+    s->size = size;
+    s->nchunks = (size_t)(((uint64_t)size + C - 1) / C);
+    if (grow(s, s->nchunks ? s->nchunks : 1) != 0) return -1;
+    if (s->path) {
+        struct cache_head h = { CACHE_MAGIC, (uint64_t)size, C, (uint32_t)s->nchunks, (uint32_t)strlen(s->url), 0 };
+        s->sums_off = sizeof(h) + h.url_len;
+        s->data_off = (s->sums_off + (uint64_t)s->nchunks * 4 + 4095) & ~(uint64_t)4095;
+        int fd = open(s->path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd >= 0 && ftruncate(fd, (off_t)(s->data_off + (uint64_t)size)) == 0 &&
+            pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+            pwrite(fd, s->url, h.url_len, sizeof(h)) == (ssize_t)h.url_len) {
+            s->fd = fd;
+            return 0;
+        }
+        if (fd >= 0) {
+            close(fd);
+            unlink(s->path);
+        }
+    }
+    return temp_store(s);
+}
+
+/* adopt an earlier session's cache file for this URL; caller holds lock */
+static void store_load(struct ox_stream *s)
+{
+    int fd = open(s->path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return;
+    struct cache_head h;
+    struct stat st;
+    size_t url_len = strlen(s->url);
+    char *url = malloc(url_len + 1);
+    int ok = url && fstat(fd, &st) == 0 && pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+             memcmp(h.magic, CACHE_MAGIC, 8) == 0 && h.chunk == C && h.url_len == url_len &&
+             h.size < (1ull << 48) && h.nchunks == (h.size + C - 1) / C &&
+             pread(fd, url, url_len, sizeof(h)) == (ssize_t)url_len && memcmp(url, s->url, url_len) == 0;
+    free(url);
+    if (ok) {
+        s->size = (int64_t)h.size;
+        s->nchunks = h.nchunks;
+        s->sums_off = sizeof(h) + url_len;
+        s->data_off = (s->sums_off + (uint64_t)s->nchunks * 4 + 4095) & ~(uint64_t)4095;
+        ok = (uint64_t)st.st_size == s->data_off + h.size && grow(s, s->nchunks ? s->nchunks : 1) == 0 &&
+             pread(fd, s->sums, s->nchunks * 4, (off_t)s->sums_off) == (ssize_t)(s->nchunks * 4);
+    }
+    if (!ok) {
+        close(fd);
+        s->size = -1;
+        s->nchunks = 0;
+        return;
+    }
+    for (size_t i = 0; i < s->nchunks; ++i) {
+        s->state[i] = s->sums[i] ? ON_DISK : ABSENT;
+        s->stats.cached_chunks += s->sums[i] != 0;
+    }
+    s->fd = fd;
+    futimens(fd, NULL); /* recently used */
+}
+
+/* worker: write one received chunk and publish it */
+static int store_chunk(struct ox_stream *s, size_t idx, const unsigned char *data, size_t len)
+{
+    pthread_mutex_lock(&s->lock);
+    int fresh = (s->size >= 0 || grow(s, idx + 1) == 0) && s->state[idx] == ABSENT;
+    pthread_mutex_unlock(&s->lock);
+    if (!fresh) return 0;
+    uint32_t sum = chunk_sum(data, len);
+    if (pwrite(s->fd, data, len, (off_t)(s->data_off + (uint64_t)idx * C)) != (ssize_t)len) return -1;
+    if (s->path && pwrite(s->fd, &sum, 4, (off_t)(s->sums_off + idx * 4)) != 4) return -1;
+    pthread_mutex_lock(&s->lock);
+    s->sums[idx] = sum;
+    s->state[idx] = READY;
+    if (s->size < 0 && idx >= s->nchunks) s->nchunks = idx + 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    if (s->path && s->cache) {
+        pthread_mutex_lock(&s->cache->lock);
+        s->cache->written += len;
+        int over = s->cache->written > s->cache->max_bytes / 16;
+        pthread_mutex_unlock(&s->cache->lock);
+        if (over) evict(s->cache, s->path);
+    }
+    return 0;
+}
+
+/* reader: check a chunk left by an earlier session */
+static int verify_chunk(struct ox_stream *s, size_t idx, uint32_t sum)
+{
+    size_t len = chunk_len(s, idx);
+    unsigned char *buf = malloc(len ? len : 1);
+    int ok = buf && pread(s->fd, buf, len, (off_t)(s->data_off + (uint64_t)idx * C)) == (ssize_t)len &&
+             chunk_sum(buf, len) == sum;
+    free(buf);
+    return ok;
+}
+
+/* ---- worker ---- */
+
+static size_t on_header(char *p, size_t size, size_t nmemb, void *user)
+{
+    struct ox_stream *s = user;
+    size_t n = size * nmemb;
+    char line[256];
+    size_t k = n < sizeof(line) - 1 ? n : sizeof(line) - 1;
+    memcpy(line, p, k);
+    line[k] = '\0';
+    unsigned long long a, b, t;
+    if (strncmp(line, "HTTP/", 5) == 0) {
+        /* every response of a redirect chain starts over */
+        const char *sp = strchr(line, ' ');
+        s->status = sp ? atoi(sp + 1) : 0;
+        s->resp_start = s->resp_total = s->resp_length = -1;
+    } else if (strncasecmp(line, "content-range:", 14) == 0) {
+        if (sscanf(line + 14, " bytes %llu-%llu/%llu", &a, &b, &t) == 3) {
+            s->resp_start = (int64_t)a;
+            s->resp_total = (int64_t)t;
+        } else if (sscanf(line + 14, " bytes %llu-%llu/*", &a, &b) == 2) {
+            s->resp_start = (int64_t)a;
+        }
+    } else if (strncasecmp(line, "content-length:", 15) == 0) {
+        if (sscanf(line + 15, " %llu", &a) == 1) s->resp_length = (int64_t)a;
+    }
+    return n;
+}
+
+/* first body byte: the headers are complete; 0 to go on, -1 to drop the
+ * transfer (aborted set when that is not an error) */
+static int begin_body(struct ox_stream *s)
+{
+    int64_t total;
+    s->body_started = 1;
+    pthread_mutex_lock(&s->lock);
+    if (s->status == 206 && s->resp_start == (int64_t)s->pos && s->resp_total >= 0) {
+        s->ranged = 1;
+        total = s->resp_total;
+    } else if (s->status == 200) {
+        /* no range support: the whole body from the start */
+        s->ranged = 0;
+        s->pos = 0;
+        total = s->resp_length;
+    } else {
+        /* a range of unknown total: ask again for the plain body */
+        s->ranged = 0;
+        s->aborted = s->status == 206;
+        pthread_mutex_unlock(&s->lock);
+        return -1;
+    }
+    int r = 0;
+    if (s->fd < 0) {
+        r = total >= 0 ? store_init(s, total) : temp_store(s);
+    } else if (total >= 0 && total != s->size) {
+        /* changed upstream since it was cached: the cached chunks are stale */
+        if (s->path) unlink(s->path);
+        s->failed = 1;
+        pthread_cond_broadcast(&s->cond);
+        r = -1;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return r;
+}
+
+static size_t on_body(char *p, size_t size, size_t nmemb, void *user)
+{
+    struct ox_stream *s = user;
+    size_t n = size * nmemb, left = n;
+    if (!s->body_started && begin_body(s) != 0) return 0;
+    while (left) {
+        size_t take = C - s->cfill < left ? C - s->cfill : left;
+        memcpy(s->cbuf + s->cfill, p, take);
+        s->cfill += take;
+        s->pos += take;
+        p += take;
+        left -= take;
+        s->body_bytes += take;
+        if (s->cfill < C && !(s->size >= 0 && s->pos >= (uint64_t)s->size)) continue;
+        pthread_mutex_lock(&s->lock);
+        s->stats.net_bytes += s->body_bytes;
+        s->body_bytes = 0;
+        pthread_mutex_unlock(&s->lock);
+        if (store_chunk(s, (size_t)((s->pos - 1) / C), s->cbuf, s->cfill) != 0) return 0;
+        s->cfill = 0;
+        pthread_mutex_lock(&s->lock);
+        /* the reader moved to a missing chunk this run will not reach */
+        uint64_t at = s->pos / C, w = s->want;
+        int drop = s->stop || (s->ranged == 1 && (w < at || w >= s->run_end) && w < s->nchunks &&
+                               s->state[w] == ABSENT);
+        pthread_mutex_unlock(&s->lock);
+        if (drop) {
+            s->aborted = 1;
+            return 0;
+        }
+    }
+    return n;
+}
+
+/* next run of missing chunks to fetch as [*first, *end); caller holds lock */
+static int next_run(struct ox_stream *s, size_t *first, size_t *end)
+{
+    if (s->fd < 0) {
+        /* nothing known yet: start where the reader is */
+        *first = (size_t)s->want;
+        *end = *first + OX_STREAM_READAHEAD;
+        return 1;
+    }
+    if (s->ranged == 0) {
+        /* sequential server: one plain transfer as long as anything is missing */
+        int missing = s->size < 0;
+        for (size_t i = 0; i < s->nchunks && !missing; ++i) missing = s->state[i] == ABSENT;
+        *first = 0;
+        *end = s->nchunks;
+        return missing;
+    }
+    size_t lo = (size_t)s->want, hi = lo + OX_STREAM_READAHEAD;
+    if (hi > s->nchunks) hi = s->nchunks;
+    for (size_t i = lo; i < hi; ++i) {
+        if (s->state[i] != ABSENT) continue;
+        size_t j = i + 1;
+        while (j < hi && s->state[j] == ABSENT) ++j;
+        *first = i;
+        *end = j;
+        return 1;
+    }
+    return 0;
+}
+
+static void *worker_main(void *arg)
+{
+    struct ox_stream *s = arg;
+    CURL *h = ox_curl.easy_init();
+    int errors = 0;
+    pthread_mutex_lock(&s->lock);
+    if (!h || !s->cbuf) {
+        s->failed = 1;
+        pthread_cond_broadcast(&s->cond);
+    }
+    while (!s->stop && !s->failed) {
+        size_t first, end;
+        if (!next_run(s, &first, &end)) {
+            pthread_cond_wait(&s->cond, &s->lock);
+            continue;
+        }
+        char range[64];
+        int ranged = s->ranged != 0;
+        if (ranged && s->size >= 0 && (uint64_t)end * C > (uint64_t)s->size)
+            snprintf(range, sizeof(range), "%llu-", (unsigned long long)first * C);
+        else
+            snprintf(range, sizeof(range), "%llu-%llu", (unsigned long long)first * C, (unsigned long long)end * C - 1);
+        s->pos = ranged ? (uint64_t)first * C : 0;
+        s->run_end = end;
+        s->cfill = 0;
+        s->body_started = s->aborted = 0;
+        s->body_bytes = 0;
+        s->status = 0;
+        s->stats.requests++;
+        pthread_mutex_unlock(&s->lock);
+
+        ox_curl.easy_setopt(h, 10002, s->url); // CURLOPT_URL
+        ox_curl.easy_setopt(h, 10007, ranged ? range : NULL); // CURLOPT_RANGE
+        ox_curl.easy_setopt(h, 20011, (ox_curl_data_cb)on_body); // CURLOPT_WRITEFUNCTION
+        ox_curl.easy_setopt(h, 10001, s); // CURLOPT_WRITEDATA
+        ox_curl.easy_setopt(h, 20079, (ox_curl_data_cb)on_header); // CURLOPT_HEADERFUNCTION
+        ox_curl.easy_setopt(h, 10029, s); // CURLOPT_HEADERDATA
+        ox_curl.easy_setopt(h, 99, 1L); // CURLOPT_NOSIGNAL
+        ox_curl.easy_setopt(h, 52, 1L); // CURLOPT_FOLLOWLOCATION: CDNs redirect
+        ox_curl.easy_setopt(h, 68, 5L); // CURLOPT_MAXREDIRS
+        ox_curl.easy_setopt(h, 45, 1L); // CURLOPT_FAILONERROR: no error pages in the cache
+        ox_curl.easy_setopt(h, 78, 10L); // CURLOPT_CONNECTTIMEOUT
+        ox_curl.easy_setopt(h, 19, 1L); // CURLOPT_LOW_SPEED_LIMIT
+        ox_curl.easy_setopt(h, 20, 15L); // CURLOPT_LOW_SPEED_TIME
+        int rc = ox_curl.easy_perform(h);
+
+        /* a body without a length ends at the end of the transfer */
+        int eof = rc == 0 && s->size < 0 && s->body_started;
+        if (eof && s->cfill) rc = store_chunk(s, (size_t)(s->pos / C), s->cbuf, s->cfill) == 0 ? 0 : -1;
+        pthread_mutex_lock(&s->lock);
+        s->stats.net_bytes += s->body_bytes;
+        if (eof && rc == 0) {
+            s->size = (int64_t)s->pos;
+            s->nchunks = (size_t)((s->pos + C - 1) / C);
+            pthread_cond_broadcast(&s->cond);
+        }
+        if (rc == 0 || s->aborted) {
+            errors = 0;
+        } else if (!s->stop && !s->failed && ++errors >= 3) {
+            s->failed = 1;
+            pthread_cond_broadcast(&s->cond);
+        } else if (!s->stop && !s->failed) {
+            struct timespec t;
+            clock_gettime(CLOCK_REALTIME, &t);
+            t.tv_nsec += 250000000L * errors;
+            t.tv_sec += t.tv_nsec / 1000000000L;
+            t.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&s->cond, &s->lock, &t);
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    if (h) ox_curl.easy_cleanup(h);
+    return NULL;
+}
+
+/* ---- public ---- */
+
+static int is_url(const char *uri)
+{
+    return strncasecmp(uri, "http://", 7) == 0 || strncasecmp(uri, "https://", 8) == 0;
+}
+
+static int hexval(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static struct ox_stream *open_local(const char *uri)
+{
+    char path[4096];
+    if (strncmp(uri, "file://", 7) == 0) {
+        const char *p = uri + 7;
+        size_t n = 0;
+        if (*p != '/') p = strchr(p, '/'); /* file://host/path */
+        for (; p && *p && n + 1 < sizeof(path); ++p) {
+            int hi, lo;
+            if (*p == '%' && (hi = hexval(p[1])) >= 0 && (lo = hexval(p[2])) >= 0) {
+                path[n++] = (char)(hi << 4 | lo);
+                p += 2;
+            } else {
+                path[n++] = *p;
+            }
+        }
+        path[n] = '\0';
+    } else {
+        snprintf(path, sizeof(path), "%s", uri);
+    }
+    struct ox_stream *s = calloc(1, sizeof(*s));
+    struct stat st;
+    if (!s) return NULL;
+    s->local = 1;
+    s->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (s->fd < 0 || fstat(s->fd, &st) != 0) {
+        if (s->fd >= 0) close(s->fd);
+        free(s);
+        return NULL;
+    }
+    s->size = st.st_size;
+    return s;
+}
+
+struct ox_stream *ox_stream_open(struct ox_stream_cache *cache, const char *uri)
+{
+    if (!uri) return NULL;
+    if (!is_url(uri)) return open_local(uri);
+    if (ox_curl_load() != 0) return NULL;
+    struct ox_stream *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->fd = -1;
+    s->size = -1;
+    s->ranged = -1;
+    s->cache = cache;
+    s->url = strdup(uri);
+    s->cbuf = malloc(C);
+    if (!s->url || pthread_mutex_init(&s->lock, NULL) != 0) {
+        free(s->url);
+        free(s->cbuf);
+        free(s);
+        return NULL;
+    }
+    pthread_cond_init(&s->cond, NULL);
+    if (cache) {
+        uint64_t h = ox_fnv1a_str(uri);
+        size_t n = strlen(cache->dir) + 22;
+        if ((s->path = malloc(n))) {
+            snprintf(s->path, n, "%s/%016llx.oxs", cache->dir, (unsigned long long)h);
+            store_load(s);
+        }
+    }
+    s->has_worker = pthread_create(&s->worker, NULL, worker_main, s) == 0;
+    pthread_mutex_lock(&s->lock);
+    /* playback can start with the first chunk */
+    while (s->has_worker && !s->failed && !(s->size == 0 || (s->nchunks && s->state[0] != ABSENT)))
+        pthread_cond_wait(&s->cond, &s->lock);
+    int ok = s->has_worker && !s->failed;
+    pthread_mutex_unlock(&s->lock);
+    if (!ok) {
+        ox_stream_close(s);
+        return NULL;
+    }
+    return s;
+}
+
+void ox_stream_close(struct ox_stream *s)
+{
+    if (!s) return;
+    if (!s->local) {
+        pthread_mutex_lock(&s->lock);
+        s->stop = 1;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+        if (s->has_worker) pthread_join(s->worker, NULL);
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->lock);
+    }
+    if (s->fd >= 0) close(s->fd);
+    free(s->url);
+    free(s->path);
+    free(s->sums);
+    free(s->state);
+    free(s->cbuf);
+    free(s);
+}
+
+int64_t ox_stream_size(struct ox_stream *s)
+{
+    if (s->local) return s->size;
+    pthread_mutex_lock(&s->lock);
+    int64_t size = s->size;
+    pthread_mutex_unlock(&s->lock);
+    return size;
+}
+
+ssize_t ox_stream_read(struct ox_stream *s, uint64_t off, void *dst, size_t n)
+{
+    if (s->local) {
+        size_t done = 0;
+        while (done < n) {
+            ssize_t r = pread(s->fd, (char *)dst + done, n - done, (off_t)(off + done));
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0) return done ? (ssize_t)done : -1;
+            if (r == 0) break;
+            done += (size_t)r;
+        }
+        return (ssize_t)done;
+    }
+    size_t done = 0;
+    int err = 0;
+    pthread_mutex_lock(&s->lock);
+    while (done < n) {
+        uint64_t at = off + done;
+        if (s->size >= 0 && at >= (uint64_t)s->size) break;
+        size_t idx = (size_t)(at / C);
+        if (s->want != idx) {
+            s->want = idx;
+            pthread_cond_broadcast(&s->cond);
+        }
+        unsigned char st = idx < s->nchunks ? s->state[idx] : ABSENT;
+        if (st == READY) {
+            size_t len = C - (size_t)(at % C);
+            if (len > n - done) len = n - done;
+            if (s->size >= 0 && len > (uint64_t)s->size - at) len = (size_t)((uint64_t)s->size - at);
+            int fd = s->fd;
+            uint64_t base = s->data_off;
+            pthread_mutex_unlock(&s->lock);
+            ssize_t r = pread(fd, (char *)dst + done, len, (off_t)(base + at));
+            pthread_mutex_lock(&s->lock);
+            if (r == 0 && s->size < 0 && !s->failed && !s->stop) {
+                /* past the short tail of a body without a length: the size
+                 * is published just after the tail chunk */
+                pthread_cond_wait(&s->cond, &s->lock);
+                continue;
+            }
+            if (r <= 0) {
+                err = 1;
+                break;
+            }
+            done += (size_t)r;
+        } else if (st == ON_DISK) {
+            uint32_t sum = s->sums[idx];
+            pthread_mutex_unlock(&s->lock);
+            int ok = verify_chunk(s, idx, sum);
+            pthread_mutex_lock(&s->lock);
+            if (s->state[idx] == ON_DISK) s->state[idx] = ok ? READY : ABSENT;
+            if (!ok) pthread_cond_broadcast(&s->cond);
+        } else if (s->failed || s->stop) {
+            err = 1;
+            break;
+        } else {
+            pthread_cond_wait(&s->cond, &s->lock);
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    return err && !done ? -1 : (ssize_t)done;
+}
+
+void ox_stream_stats(struct ox_stream *s, struct ox_stream_stats *out)
+{
+    if (s->local) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    *out = s->stats;
+    pthread_mutex_unlock(&s->lock);
+}
@@ -0,0 +1,45 @@
+// stream.h - random-access byte source for local files and http(s) URLs
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Remote streams are fetched in OX_STREAM_CHUNK pieces by a worker thread with
+ * HTTP range requests, OX_STREAM_READAHEAD chunks ahead of the last read, and
+ * kept in a sparse per-URL file in the cache directory. Reads of cached
+ * chunks (this session or an earlier one) never touch the network; a seek
+ * outside the cached ranges moves the prefetch window there. Servers that
+ * ignore Range are read sequentially. libcurl is loaded on first use.
+ */
+#define OX_STREAM_CHUNK (256u * 1024)
+#define OX_STREAM_READAHEAD 4
+#define OX_STREAM_CACHE_MAX (1ull << 30)
+
+/* Cache directory: whole streams are evicted, least recently opened first,
+ * once the files in it take more than max_bytes of disk (0: the default). */
+struct ox_stream_cache;
+char *ox_stream_default_dir(void); /* "<XDG cache>/streams", created; malloc'd */
+struct ox_stream_cache *ox_stream_cache_create(const char *dir, uint64_t max_bytes);
+/* No stream of the cache may still be open. */
+void ox_stream_cache_destroy(struct ox_stream_cache *c);
+
+struct ox_stream;
+
+/* A path, file:// URI or http(s) URL. For URLs, waits until the first chunk
+ * is available (or cached) and the size is known; cache may be NULL (chunks
+ * then go to an unlinked temporary file). NULL on failure. */
+struct ox_stream *ox_stream_open(struct ox_stream_cache *cache, const char *uri);
+void ox_stream_close(struct ox_stream *s);
+/* Total size in bytes, -1 while unknown (a server that sends no length). */
+int64_t ox_stream_size(struct ox_stream *s);
+/* pread semantics: blocks until the bytes are there; returns the count read
+ * (short only at the end), 0 at end of stream, -1 if the fetch failed. */
+ssize_t ox_stream_read(struct ox_stream *s, uint64_t off, void *dst, size_t n);
+
+struct ox_stream_stats {
+    uint64_t net_bytes;     /* body bytes received */
+    unsigned requests;      /* HTTP requests made */
+    unsigned cached_chunks; /* chunks that were on disk at open */
+};
+void ox_stream_stats(struct ox_stream *s, struct ox_stream_stats *out);
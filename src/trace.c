@@ -0,0 +1,250 @@
+// trace.c - per-thread event rings and the Chrome trace exporter
+// - one ring per thread, written only by its thread: each slot is a seqlock
+//   (sequence made odd, release fence, four relaxed stores, sequence made
+//   even with a release store), then the ring's count is release-stored; no
+//   lock, no syscall beyond the vDSO clock_gettime
+// - the exporter copies a ring while it is being written: a slot whose
+//   sequence was odd or moved during the copy is torn and dropped, and after
+//   re-reading the count whatever the writer lapped meanwhile is dropped too.
+//   Slot sequences only grow, also across ring reuse, so they cannot repeat
+// - CLOCK_MONOTONIC rather than the TSC: no calibration, comparable across
+//   cores, and ~20 ns a read is well under the cost of anything traced here
+// - rings are never freed: a thread's ring outlives it, so its last events
+//   stay exportable; only past OX_TRACE_THREADS rings does a new thread take
+//   over (and clear) the ring of one that has exited
+
+#define _POSIX_C_SOURCE 200809L
+#include "trace.h"
+#include "util.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Slots are read while their thread may be overwriting them, hence relaxed
+ * atomics (plain moves on the usual targets) rather than plain fields. seq is
+ * odd while the fields are being written. */
+struct slot {
+    _Atomic uint32_t seq;
+    _Atomic uint64_t ns;
+    _Atomic(const char *) name;
+    _Atomic int64_t value;
+    atomic_char phase;
+};
+
+struct event {
+    uint64_t index; /* in the ring's sequence of events */
+    uint64_t ns;
+    const char *name;
+    int64_t value;
+    char phase;
+};
+
+struct ring {
+    _Atomic uint64_t count;        /* events ever written; slot = count % N */
+    atomic_int owned;              /* a live thread writes here */
+    _Atomic(const char *) name;
+    int tid;                       /* small, stable id for the export */
+    struct ring *next;
+    struct slot ev[OX_TRACE_EVENTS];
+};
+
+static _Atomic(struct ring *) rings;
+static atomic_int nrings;
+static atomic_int state = -1;      /* -1: $OXXY_TRACE not read yet */
+static const char *env_path;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static pthread_key_t exit_key;
+static _Thread_local struct ring *mine;
+
+static void release_ring(void *p)
+{
+    struct ring *r = p;
+    atomic_store_explicit(&r->owned, 0, memory_order_release);
+}
+
+static void init_once(void)
+{
+    pthread_key_create(&exit_key, release_ring);
+    const char *env = getenv("OXXY_TRACE");
+    if (env && *env && strcmp(env, "0") != 0 && strcmp(env, "1") != 0) env_path = env;
+    int expected = -1;
+    atomic_compare_exchange_strong(&state, &expected, !(env && strcmp(env, "0") == 0));
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* First event of a thread: a new ring, or past the cap one whose thread has
+ * exited. */
+static struct ring *claim(void)
+{
+    pthread_once(&once, init_once);
+    struct ring *r = NULL;
+    if (atomic_load(&nrings) >= OX_TRACE_THREADS)
+        r = atomic_load_explicit(&rings, memory_order_acquire);
+    for (; r; r = r->next) {
+        int expected = 0;
+        if (atomic_load_explicit(&r->owned, memory_order_relaxed) == 0 &&
+            atomic_compare_exchange_strong(&r->owned, &expected, 1)) {
+            atomic_store_explicit(&r->name, NULL, memory_order_relaxed);
+            atomic_store_explicit(&r->count, 0, memory_order_release);
+            break;
+        }
+    }
+    if (!r) {
+        r = calloc(1, sizeof(*r));
+        if (!r) return NULL;
+        atomic_init(&r->owned, 1);
+        r->tid = atomic_fetch_add(&nrings, 1) + 1;
+        struct ring *head = atomic_load_explicit(&rings, memory_order_relaxed);
+        do {
+            r->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&rings, &head, r, memory_order_release, memory_order_relaxed));
+    }
+    pthread_setspecific(exit_key, r);
+    mine = r;
+    return r;
+}
+
+void ox_trace_event_(char phase, const char *name, int64_t value)
+{
+    int on = atomic_load_explicit(&state, memory_order_relaxed);
+    if (on < 0) {
+        pthread_once(&once, init_once);
+        on = atomic_load_explicit(&state, memory_order_relaxed);
+    }
+    if (!on) return;
+    struct ring *r = mine;
+    if (!r && !(r = claim())) return;
+    uint64_t n = atomic_load_explicit(&r->count, memory_order_relaxed);
+    struct slot *e = &r->ev[n % OX_TRACE_EVENTS];
+    uint32_t seq = atomic_load_explicit(&e->seq, memory_order_relaxed);
+    atomic_store_explicit(&e->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); /* odd before any field */
+    atomic_store_explicit(&e->ns, now_ns(), memory_order_relaxed);
+    atomic_store_explicit(&e->name, name, memory_order_relaxed);
+    atomic_store_explicit(&e->value, value, memory_order_relaxed);
+    atomic_store_explicit(&e->phase, phase, memory_order_relaxed);
+    atomic_store_explicit(&e->seq, seq + 2, memory_order_release);
+    atomic_store_explicit(&r->count, n + 1, memory_order_release);
+}
+
+void ox_trace_thread_name(const char *name)
+{
+    struct ring *r = mine;
+    if (!r && !(r = claim())) return;
+    atomic_store_explicit(&r->name, name, memory_order_release);
+}
+
+void ox_trace_enable(int on)
+{
+    pthread_once(&once, init_once);
+    atomic_store(&state, on ? 1 : 0);
+}
+
+int ox_trace_enabled(void)
+{
+    pthread_once(&once, init_once);
+    return atomic_load(&state) > 0;
+}
+
+const char *ox_trace_path(void)
+{
+    pthread_once(&once, init_once);
+    return env_path;
+}
+
+static void put_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+/* The events of r that are certainly intact, oldest first, into out. */
+static size_t snapshot(struct ring *r, struct event *out)
+{
+    uint64_t before = atomic_load_explicit(&r->count, memory_order_acquire);
+    uint64_t lo = before > OX_TRACE_EVENTS ? before - OX_TRACE_EVENTS : 0;
+    size_t n = 0;
+    for (uint64_t i = lo; i < before; ++i) {
+        const struct slot *e = &r->ev[i % OX_TRACE_EVENTS];
+        struct event *o = &out[n];
+        uint32_t seq = atomic_load_explicit(&e->seq, memory_order_acquire);
+        o->index = i;
+        o->ns = atomic_load_explicit(&e->ns, memory_order_relaxed);
+        o->name = atomic_load_explicit(&e->name, memory_order_relaxed);
+        o->value = atomic_load_explicit(&e->value, memory_order_relaxed);
+        o->phase = atomic_load_explicit(&e->phase, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (!(seq & 1) && atomic_load_explicit(&e->seq, memory_order_relaxed) == seq) n++;
+    }
+    uint64_t after = atomic_load_explicit(&r->count, memory_order_relaxed);
+    if (after < before) return 0; /* handed to a new thread meanwhile */
+    /* intact but possibly a later lap: only indices the writer cannot have
+     * reached yet are the events we meant to read */
+    uint64_t safe = after + 1 > OX_TRACE_EVENTS ? after + 1 - OX_TRACE_EVENTS : 0;
+    size_t skip = 0;
+    while (skip < n && out[skip].index < safe) skip++;
+    memmove(out, out + skip, (n - skip) * sizeof(*out));
+    return n - skip;
+}
+
+int ox_trace_write_file(FILE *f)
+{
+    pthread_once(&once, init_once);
+    struct event *buf = malloc(sizeof(struct event) * OX_TRACE_EVENTS);
+    if (!buf) return -1;
+    long pid = (long)getpid();
+    uint64_t t0 = UINT64_MAX;
+    /* timestamps are printed relative to the oldest event kept anywhere */
+    for (struct ring *r = atomic_load_explicit(&rings, memory_order_acquire); r; r = r->next) {
+        uint64_t n = atomic_load_explicit(&r->count, memory_order_acquire);
+        if (n == 0) continue;
+        uint64_t ns = atomic_load_explicit(&r->ev[n > OX_TRACE_EVENTS ? n % OX_TRACE_EVENTS : 0].ns, memory_order_relaxed);
+        if (ns < t0) t0 = ns;
+    }
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(f, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%ld,\"tid\":0,\"args\":{\"name\":\"oxxy\"}}", pid);
+    for (struct ring *r = atomic_load_explicit(&rings, memory_order_acquire); r; r = r->next) {
+        const char *name = atomic_load_explicit(&r->name, memory_order_acquire);
+        size_t n = snapshot(r, buf);
+        fprintf(f, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%ld,\"tid\":%d,\"args\":{\"name\":", pid, r->tid);
+        if (name) put_string(f, name);
+        else fprintf(f, "\"thread %d\"", r->tid);
+        fprintf(f, "}}");
+        for (size_t i = 0; i < n; ++i) {
+            const struct event *e = &buf[i];
+            double us = e->ns >= t0 ? (e->ns - t0) / 1e3 : 0.0;
+            fprintf(f, ",\n{\"ph\":\"%c\",\"name\":", e->phase);
+            put_string(f, e->name);
+            fprintf(f, ",\"pid\":%ld,\"tid\":%d,\"ts\":%.3f", pid, r->tid, us);
+            if (e->phase == 'C') fprintf(f, ",\"args\":{\"value\":%lld}", (long long)e->value);
+            else if (e->phase == 'i') fprintf(f, ",\"s\":\"t\"");
+            fputc('}', f);
+        }
+    }
+    fprintf(f, "\n]}\n");
+    free(buf);
+    return ferror(f) ? -1 : 0;
+}
+
+int ox_trace_write(const char *path)
+{
+    struct ox_atomic a;
+    if (!path || ox_atomic_begin(&a, path, 0644, 0) != 0) return -1;
+    FILE *f = ox_atomic_stdio(&a);
+    return ox_atomic_finish(&a, path, f ? ox_trace_write_file(f) : -1);
+}
@@ -0,0 +1,60 @@
+// trace.h - cross-thread event tracing, exported as Chrome trace JSON
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A flight recorder for "what was every thread doing when the audio dropped
+ * out": each thread appends spans, counters and instants to its own ring of
+ * the last OX_TRACE_EVENTS events, with no locks and no allocation after the
+ * thread's first event. ox_trace_write snapshots every ring, from any thread,
+ * while recording goes on, into a file chrome://tracing and Perfetto open.
+ *
+ * Recording is on unless $OXXY_TRACE is "0"; any other value is the path
+ * ox_trace_path returns (the UIs write there on F4 and at exit). Building with
+ * -DOX_TRACE=0 compiles the macros out entirely.
+ *
+ * Names are string literals: they are kept, not copied.
+ */
+#ifndef OX_TRACE
+#define OX_TRACE 1
+#endif
+
+#define OX_TRACE_EVENTS 8192 /* per thread */
+#define OX_TRACE_THREADS 64  /* rings kept before those of exited threads are reused */
+
+void ox_trace_event_(char phase, const char *name, int64_t value);
+
+/* Name the calling thread in the export ("decoder", "ui", ...). */
+void ox_trace_thread_name(const char *name);
+/* Runtime switch; while off an event costs one relaxed load. */
+void ox_trace_enable(int on);
+int ox_trace_enabled(void);
+/* $OXXY_TRACE when it names a file, else NULL. */
+const char *ox_trace_path(void);
+/* Write everything still in the rings as {"traceEvents": [...]}. The file is
+ * replaced atomically. 0 or -1. */
+int ox_trace_write(const char *path);
+int ox_trace_write_file(FILE *f);
+
+#if OX_TRACE
+#define OX_TRACE_BEGIN(name) ox_trace_event_('B', (name), 0)
+#define OX_TRACE_END(name) ox_trace_event_('E', (name), 0)
+#define OX_TRACE_INSTANT(name) ox_trace_event_('i', (name), 0)
+#define OX_TRACE_COUNTER(name, v) ox_trace_event_('C', (name), (int64_t)(v))
+#define OX_TRACE_THREAD(name) ox_trace_thread_name(name)
+#else
+#define OX_TRACE_BEGIN(name) ((void)0)
+#define OX_TRACE_END(name) ((void)0)
+#define OX_TRACE_INSTANT(name) ((void)0)
+#define OX_TRACE_COUNTER(name, v) ((void)sizeof(v))
+#define OX_TRACE_THREAD(name) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,8 +1,13 @@
 #define _POSIX_C_SOURCE 200809L
 #include "ui_bridge.h"
+#include "engine_ipc.h"
 #include "profiles.h"
 #include "vk.h"
+#include "meta.h"
+#include "trace.h"
+#include <pthread.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -11,6 +16,29 @@
 static _Atomic size_t ui_head = 0;
 static _Atomic size_t ui_tail = 0;
 static float ui_data[UI_RING_SIZE];
+static void (*_Atomic ui_wakeup)(void);
+static atomic_bool ui_woken;
+
+/* Attached to an engine daemon: peaks and state come from its shared memory,
+ * requests go to its control socket. Only the UI thread uses the client; the
+ * watcher thread only blocks on the engine's publish counter. */
+static struct ox_engine_client *engine;
+static uint64_t engine_cursor;
+static pthread_t engine_watcher;
+static atomic_int engine_stop;
+static char engine_uri[OX_ENGINE_URI_MAX];
+
+void ox_ui_set_wakeup(void (*wake)(void))
+{
+    atomic_store(&ui_wakeup, wake);
+    atomic_store(&ui_woken, false);
+}
+
+void ox_ui_wake(void)
+{
+    void (*wake)(void) = atomic_load(&ui_wakeup);
+    if (wake) wake();
+}
 
 void ox_ui_push_peak(float peak)
 {
@@ -21,14 +49,20 @@ void ox_ui_push_peak(float peak)
     size_t idx = head % UI_RING_SIZE;
     ui_data[idx] = peak;
     atomic_store_explicit(&ui_head, head + 1, memory_order_release);
+    OX_TRACE_COUNTER("peaks_queued", head + 1 - tail);
+    /* one wakeup per UI frame, not per peak */
+    if (!atomic_exchange(&ui_woken, true)) ox_ui_wake();
 }
 
 size_t ox_ui_get_waveform_copy(float *dest, size_t max_samples)
 {
+    atomic_store(&ui_woken, false); /* before reading head: a later push wakes again */
+    if (engine) return ox_engine_read_peaks(engine, &engine_cursor, dest, max_samples);
     size_t head = atomic_load_explicit(&ui_head, memory_order_acquire);
     size_t tail = atomic_load_explicit(&ui_tail, memory_order_relaxed);
     size_t avail = head - tail;
     if (avail == 0) return 0;
+    OX_TRACE_BEGIN("waveform-copy");
     size_t to_copy = avail < max_samples ? avail : max_samples;
     size_t idx = tail % UI_RING_SIZE;
     size_t first = UI_RING_SIZE - idx;
@@ -38,21 +72,177 @@ size_t ox_ui_get_waveform_copy(float *dest, size_t max_samples)
         for (size_t i = 0; i < to_copy - first; ++i) dest[first + i] = ui_data[i];
     }
     atomic_store_explicit(&ui_tail, tail + to_copy, memory_order_release);
+    OX_TRACE_END("waveform-copy");
+    OX_TRACE_COUNTER("peaks_queued", avail - to_copy);
     return to_copy;
 }
 
-void ox_ui_request_seek(double seconds) { (void)seconds; }
-double ox_ui_get_current_position(void) { return 0.0; }
-double ox_ui_get_track_length(void) { return 0.0; }
+static void *watch_engine(void *arg)
+{
+    (void)arg;
+    uint32_t seen = 0;
+    while (!atomic_load(&engine_stop)) {
+        if (ox_engine_wait(engine, &seen, 100) && !atomic_exchange(&ui_woken, true)) ox_ui_wake();
+    }
+    return NULL;
+}
 
-static struct playlist *global_playlist = NULL;
+int ox_ui_attach(const char *socket_path)
+{
+    if (engine) return 0;
+    char *def = socket_path ? NULL : ox_engine_default_socket();
+    struct ox_engine_client *c = ox_engine_connect(socket_path ? socket_path : def);
+    free(def);
+    if (!c) return -1;
+    engine = c;
+    engine_cursor = 0; /* start with the history the engine still has */
+    atomic_store(&engine_stop, 0);
+    if (pthread_create(&engine_watcher, NULL, watch_engine, NULL) != 0) {
+        engine = NULL;
+        ox_engine_disconnect(c);
+        return -1;
+    }
+    ox_ui_wake();
+    return 0;
+}
 
-void ox_ui_set_playlist(struct playlist *p) { global_playlist = p; }
+void ox_ui_detach(void)
+{
+    if (!engine) return;
+    atomic_store(&engine_stop, 1);
+    pthread_join(engine_watcher, NULL);
+    ox_engine_disconnect(engine);
+    engine = NULL;
+}
 
-struct playlist *ox_ui_get_playlist(void) { return global_playlist; }
+int ox_ui_attached(void) { return engine != NULL; }
+
+static void engine_request(const char *line)
+{
+    char reply[OX_ENGINE_LINE_MAX];
+    if (ox_engine_command(engine, line, reply, sizeof(reply)) != 0)
+        fprintf(stderr, "engine: %s: %s\n", line, reply[0] ? reply : "no answer");
+}
+
+void ox_ui_request_seek(double seconds)
+{
+    char line[64];
+    snprintf(line, sizeof(line), "seek %.3f", seconds);
+    if (engine) engine_request(line);
+}
+
+void ox_ui_request_play(int playing)
+{
+    if (engine) engine_request(playing ? "play" : "pause");
+}
+
+void ox_ui_request_play_uri(const char *uri)
+{
+    if (!engine || !uri) return;
+    char line[OX_ENGINE_LINE_MAX];
+    if (snprintf(line, sizeof(line), "play %s", uri) < (int)sizeof(line)) engine_request(line);
+}
+
+double ox_ui_get_current_position(void)
+{
+    struct ox_engine_state st;
+    return engine && ox_engine_read_state(engine, &st) == 0 ? st.position : 0.0;
+}
+
+static struct ox_plshare *global_playlist = NULL;
+
+const char *ox_ui_get_current_uri(void)
+{
+    if (engine) {
+        struct ox_engine_state st;
+        if (ox_engine_read_state(engine, &st) != 0 || !st.uri[0]) return NULL;
+        memcpy(engine_uri, st.uri, sizeof(engine_uri));
+        return engine_uri; /* until the next call; UI thread only */
+    }
+    struct ox_plshare *s = global_playlist;
+    if (!s) return NULL;
+    struct ox_plread r;
+    const struct playlist *p = ox_plshare_read_begin(s, &r);
+    const char *uri = p->pos < p->count ? playlist_uri(p, p->pos) : NULL;
+    ox_plshare_read_end(s, &r);
+    return uri; /* arena strings outlive the version they were read from */
+}
+
+/* Length of the playlist's current entry. Called every frame from the UI
+ * thread: the length a playlist file gave is used as is, otherwise the file's
+ * stream headers are parsed on a worker thread and the answer is kept for
+ * that URI (0 until it arrives). Remote entries have no headers to read. */
+static pthread_mutex_t length_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *length_uri;    /* entry the answer below is for */
+static double length_value;
+static int length_pending;  /* a worker is parsing length_uri */
+
+static void *resolve_length(void *arg)
+{
+    const char *uri = arg;
+    struct ox_metadata m;
+    double len = ox_meta_parse_file(uri, &m) == 0 ? (m.duration_ms > 0 ? m.duration_ms / 1000.0 : m.duration_sec) : 0.0;
+    pthread_mutex_lock(&length_lock);
+    length_value = len; /* length_uri is uri: it is only replaced while no worker runs */
+    length_pending = 0;
+    pthread_mutex_unlock(&length_lock);
+    return NULL;
+}
+
+double ox_ui_get_track_length(void)
+{
+    if (engine) {
+        struct ox_engine_state st;
+        return ox_engine_read_state(engine, &st) == 0 ? st.length : 0.0;
+    }
+    struct ox_plshare *s = global_playlist;
+    if (!s) return 0.0;
+    struct ox_plread r;
+    const struct playlist *p = ox_plshare_read_begin(s, &r);
+    const char *uri = p->pos < p->count ? playlist_uri(p, p->pos) : NULL;
+    int32_t ms = p->pos < p->count ? p->items[p->pos].duration_ms : -1;
+    ox_plshare_read_end(s, &r);
+    if (!uri) return 0.0;
+    if (ms > 0) return ms / 1000.0;
+    if (strstr(uri, "://")) return 0.0;
+
+    double len = 0.0;
+    pthread_mutex_lock(&length_lock);
+    if (length_uri && strcmp(length_uri, uri) == 0) {
+        len = length_value;
+    } else if (!length_pending) {
+        char *copy = strdup(uri);
+        pthread_t t;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (copy && pthread_create(&t, &attr, resolve_length, copy) == 0) {
+            free(length_uri);
+            length_uri = copy;
+            length_value = 0.0;
+            length_pending = 1;
+        } else {
+            free(copy);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    pthread_mutex_unlock(&length_lock);
+    return len;
+}
+
+void ox_ui_set_playlist(struct ox_plshare *s) { global_playlist = s; }
+
+struct ox_plshare *ox_ui_get_playlist(void) { return global_playlist; }
 
 void ox_ui_add_to_playlist(const char *uri) {
-    if (global_playlist) playlist_add(global_playlist, uri);
+    if (engine && uri) {
+        char line[OX_ENGINE_LINE_MAX];
+        if (snprintf(line, sizeof(line), "add %s", uri) < (int)sizeof(line)) engine_request(line);
+    }
+    if (!global_playlist || !uri) return;
+    struct playlist *w = ox_plshare_edit(global_playlist);
+    if (playlist_add(w, uri) == 0) ox_plshare_publish(global_playlist);
+    else ox_plshare_abandon(global_playlist);
 }
 
 /* Profile management from UI */
@@ -72,18 +262,42 @@ void ox_ui_profiles_free(char *ptr) {
     free(ptr);
 }
 
-/* VK import for selected profile */
-void ox_ui_vk_import_for_profile(const char *profile_name, struct playlist *p) {
+/* VK import for selected profile: pages are fetched on the job's thread and
+ * appended as they arrive, so the render loop only starts it and polls.
+ * Responses are cached per profile, so switching back to a profile or
+ * restarting publishes its list without waiting on the API. */
+static struct ox_vk_job *vk_job;
+static struct ox_vk_cache *vk_cache;
+
+void ox_ui_vk_import_cancel(void) {
+    ox_vk_job_cancel(vk_job);
+    ox_vk_job_finish(vk_job);
+    vk_job = NULL;
+}
+
+void ox_ui_vk_import_for_profile(const char *profile_name, struct ox_plshare *s) {
+    if (!s) s = global_playlist;
+    if (!s) return;
     char *profile_json = ox_profiles_load(profile_name);
     if (!profile_json) return;
     char *token = ox_profiles_get_vk_token(profile_json);
     if (token) {
-        char *audio_json = ox_vk_get_audio(token);
-        if (audio_json) {
-            ox_vk_import_audio_to_playlist(audio_json, p);
-            free(audio_json);
-        }
+        ox_ui_vk_import_cancel();
+        if (!vk_cache) vk_cache = ox_vk_cache_open(NULL, OX_VK_CACHE_TTL);
+        vk_job = ox_vk_import_async_cached(token, vk_cache, profile_name, s);
         free(token);
     }
     free(profile_json);
 }
+
+int ox_ui_vk_import_progress(struct ox_vk_progress *out) {
+    if (!vk_job) return -1;
+    ox_vk_job_progress(vk_job, out);
+    return 0;
+}
+
+void ox_ui_vk_shutdown(void) {
+    ox_ui_vk_import_cancel();
+    ox_vk_cache_close(vk_cache);
+    vk_cache = NULL;
+}
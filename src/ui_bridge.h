@@ -1,7 +1,8 @@
 // ui_bridge.h - bridge between audio core and UI (waveform + controls + profiles)
 #pragma once
 #include <stddef.h>
-#include "playlist.h"
+#include "playlist_share.h"
+#include "vk.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -13,14 +14,37 @@ void ox_ui_push_peak(float peak);
 /* copy up to max_samples into dest, returns number of samples copied */
 size_t ox_ui_get_waveform_copy(float *dest, size_t max_samples);
 
-/* UI -> audio control requests */
+/* Called from any thread when the UI has something new to draw (e.g.
+ * glfwPostEmptyEvent), at most once until the UI next copies the waveform,
+ * so an idle UI can block on its event queue. NULL disables it. */
+void ox_ui_set_wakeup(void (*wake)(void));
+/* Wake the UI now (for producers other than the waveform). */
+void ox_ui_wake(void);
+
+/* Attach to an engine daemon (engine_ipc.h; NULL: the default socket). From
+ * then on the waveform, position, length and current entry come from the
+ * engine's shared memory, its publishes wake the UI, and the requests below
+ * and playlist additions are sent to it (additions still show in the local
+ * playlist too). 0, or -1 if no engine answers. */
+int ox_ui_attach(const char *socket_path);
+void ox_ui_detach(void);
+int ox_ui_attached(void);
+
+/* UI -> audio control requests (ignored unless attached) */
 void ox_ui_request_seek(double seconds);
+void ox_ui_request_play(int playing);
+/* Play the entry with this URI; the engine finds it in its own playlist
+ * (whose order may differ from ours) or appends it. */
+void ox_ui_request_play_uri(const char *uri);
 double ox_ui_get_current_position(void);
+/* seconds, from the current playlist entry's headers; 0 if unknown */
 double ox_ui_get_track_length(void);
+/* current playlist entry's uri (owned by the shared playlist) or NULL */
+const char *ox_ui_get_current_uri(void);
 
-/* Playlist management from UI */
-void ox_ui_set_playlist(struct playlist *p);
-struct playlist *ox_ui_get_playlist(void);
+/* Playlist management from UI; readers use ox_plshare_read_begin/end */
+void ox_ui_set_playlist(struct ox_plshare *s);
+struct ox_plshare *ox_ui_get_playlist(void);
 void ox_ui_add_to_playlist(const char *uri);
 
 /* Profile management from UI */
@@ -29,8 +53,19 @@ int ox_ui_profiles_save(const char *name, const char *json_blob);
 char *ox_ui_profiles_load(const char *name);
 void ox_ui_profiles_free(char *ptr);
 
-/* VK import for selected profile */
-void ox_ui_vk_import_for_profile(const char *profile_name, struct playlist *p);
+/* VK import for selected profile (s NULL: the UI playlist). Returns at once;
+ * a running import is cancelled first. */
+void ox_ui_vk_import_for_profile(const char *profile_name, struct ox_plshare *s);
+/* Progress of the last import; -1 if none was started. */
+int ox_ui_vk_import_progress(struct ox_vk_progress *out);
+/* Stop the import and wait for its thread (before destroying its playlist). */
+void ox_ui_vk_import_cancel(void);
+/* Cancel the import and close the response cache (before ox_vk_shutdown). */
+void ox_ui_vk_shutdown(void);
+
+/* The frontend's entry point (ui/ui_main_gl.cpp), run by the launcher once
+ * the playlist exists; returns when the window is closed. */
+int ox_ui_main(int argc, char **argv);
 
 #ifdef __cplusplus
 }
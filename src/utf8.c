@@ -0,0 +1,207 @@
+// utf8.c - text encoding helpers with SSE2 ASCII fast paths
+
+#define _POSIX_C_SOURCE 200809L
+#include "utf8.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static size_t put_cp(uint32_t cp, char *dst, size_t pos, size_t cap)
+{
+    /* returns new position, or pos unchanged if the sequence does not fit */
+    unsigned char *d = (unsigned char *)dst + pos;
+    if (cp < 0x80) {
+        if (pos + 1 >= cap) return pos;
+        d[0] = (unsigned char)cp;
+        return pos + 1;
+    }
+    if (cp < 0x800) {
+        if (pos + 2 >= cap) return pos;
+        d[0] = (unsigned char)(0xC0 | (cp >> 6));
+        d[1] = (unsigned char)(0x80 | (cp & 0x3F));
+        return pos + 2;
+    }
+    if (cp < 0x10000) {
+        if (pos + 3 >= cap) return pos;
+        d[0] = (unsigned char)(0xE0 | (cp >> 12));
+        d[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+        d[2] = (unsigned char)(0x80 | (cp & 0x3F));
+        return pos + 3;
+    }
+    if (pos + 4 >= cap) return pos;
+    d[0] = (unsigned char)(0xF0 | (cp >> 18));
+    d[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+    d[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+    d[3] = (unsigned char)(0x80 | (cp & 0x3F));
+    return pos + 4;
+}
+
+size_t ox_utf16_to_utf8(const unsigned char *src, size_t len, int big_endian, char *dst, size_t cap)
+{
+    if (!dst || cap == 0) return 0;
+    size_t o = 0, i = 0;
+    if (!src) { dst[0] = '\0'; return 0; }
+    len &= ~(size_t)1;
+#if defined(__SSE2__)
+    const __m128i hi_mask = _mm_set1_epi16((short)0xFF80);
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= len && o + 8 < cap) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        if (big_endian) v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        /* all units must be non-zero ASCII: (u & 0xFF80) == 0 and u != 0 */
+        int ascii = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, hi_mask), zero));
+        int nul = _mm_movemask_epi8(_mm_cmpeq_epi16(v, zero));
+        if (ascii != 0xFFFF || nul != 0) break;
+        _mm_storel_epi64((__m128i *)(dst + o), _mm_packus_epi16(v, v));
+        o += 8; i += 16;
+    }
+#endif
+    while (i + 2 <= len) {
+        uint32_t u = big_endian ? ((uint32_t)src[i] << 8) | src[i+1] : ((uint32_t)src[i+1] << 8) | src[i];
+        if (u == 0) break;
+        size_t step = 2;
+        if (u >= 0xD800 && u <= 0xDBFF) {
+            uint32_t lo = 0;
+            if (i + 4 <= len) lo = big_endian ? ((uint32_t)src[i+2] << 8) | src[i+3] : ((uint32_t)src[i+3] << 8) | src[i+2];
+            if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                u = 0x10000 + ((u - 0xD800) << 10) + (lo - 0xDC00);
+                step = 4;
+            } else {
+                u = 0xFFFD;
+            }
+        } else if (u >= 0xDC00 && u <= 0xDFFF) {
+            u = 0xFFFD;
+        }
+        size_t n = put_cp(u, dst, o, cap);
+        if (n == o) break;
+        o = n; i += step;
+    }
+    dst[o] = '\0';
+    return o;
+}
+
+size_t ox_latin1_to_utf8(const unsigned char *src, size_t len, char *dst, size_t cap)
+{
+    if (!dst || cap == 0) return 0;
+    size_t o = 0, i = 0;
+    if (!src) { dst[0] = '\0'; return 0; }
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= len && o + 16 < cap) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        if (_mm_movemask_epi8(v) != 0 || _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0) break;
+        _mm_storeu_si128((__m128i *)(dst + o), v);
+        o += 16; i += 16;
+    }
+#endif
+    for (; i < len && src[i]; ++i) {
+        size_t n = put_cp(src[i], dst, o, cap);
+        if (n == o) break;
+        o = n;
+    }
+    dst[o] = '\0';
+    return o;
+}
+
+size_t ox_utf8_copy(const unsigned char *src, size_t len, char *dst, size_t cap)
+{
+    if (!dst || cap == 0) return 0;
+    if (!src) { dst[0] = '\0'; return 0; }
+    const unsigned char *z = memchr(src, 0, len);
+    if (z) len = (size_t)(z - src);
+    if (len > cap - 1) {
+        len = cap - 1;
+        /* back off to the start of a code point */
+        while (len > 0 && (src[len] & 0xC0) == 0x80) len--;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+    return len;
+}
+
+/* U+00C0..U+00FF; digits stand for multi-letter expansions */
+static const char fold_latin1[] = "aaaaaa1ceeeeiiiidnooooo ouuuuy23aaaaaa1ceeeeiiiidnooooo ouuuuy2y";
+static const char *const fold_multi[] = { "ae", "th", "ss", "oe", "ij" };
+/* U+0100..U+017F */
+static const char fold_latin_ext[] =
+    "aaaaaaccccccccddddeeeeeeeeeegggggggghhhhiiiiiiiiii55jjkkkllllllllllnnnnnnnnnoooooo44rrrrrrssssssssttttttuuuuuuuuuuuuwwyyyzzzzzzs";
+
+static uint32_t next_cp(const unsigned char **sp)
+{
+    /* lenient decoder: malformed bytes come back as U+FFFD, one byte at a time */
+    const unsigned char *s = *sp;
+    uint32_t c = s[0];
+    int n = c < 0x80 ? 0 : c >= 0xF0 && c < 0xF5 ? 3 : c >= 0xE0 ? 2 : c >= 0xC2 && c < 0xE0 ? 1 : -1;
+    if (n < 0 || (c >= 0xF5)) { *sp = s + 1; return 0xFFFD; }
+    if (n == 0) { *sp = s + 1; return c; }
+    c &= 0x3F >> n;
+    for (int i = 1; i <= n; ++i) {
+        if ((s[i] & 0xC0) != 0x80) { *sp = s + 1; return 0xFFFD; }
+        c = (c << 6) | (s[i] & 0x3F);
+    }
+    *sp = s + n + 1;
+    return c;
+}
+
+uint32_t ox_utf8_next(const char **s)
+{
+    const unsigned char *p = (const unsigned char *)*s;
+    uint32_t c = next_cp(&p);
+    *s = (const char *)p;
+    return c;
+}
+
+static size_t put_str(const char *s, char *dst, size_t pos, size_t cap)
+{
+    size_t n = strlen(s);
+    if (pos + n >= cap) return pos;
+    memcpy(dst + pos, s, n);
+    return pos + n;
+}
+
+size_t ox_utf8_fold(const char *src, char *dst, size_t cap)
+{
+    if (!dst || cap == 0) return 0;
+    size_t o = 0;
+    const unsigned char *s = (const unsigned char *)(src ? src : "");
+    while (*s) {
+        uint32_t c = *s;
+        if (c < 0x80) {
+            s++;
+            if (c >= 'A' && c <= 'Z') c += 32;
+            else if (c == '\'') continue;
+            else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))) c = ' ';
+            if (o + 1 >= cap) break;
+            dst[o++] = (char)c;
+            continue;
+        }
+        c = next_cp(&s);
+        const char *rep = NULL;
+        char one[2] = { 0, 0 };
+        if (c >= 0xC0 && c <= 0xFF) {
+            one[0] = fold_latin1[c - 0xC0];
+        } else if (c >= 0x100 && c <= 0x17F) {
+            one[0] = fold_latin_ext[c - 0x100];
+        } else if (c < 0xC0 || c == 0xFFFD || (c >= 0x2000 && c <= 0x206F && c != 0x2019) || (c >= 0x3000 && c <= 0x303F)) {
+            one[0] = ' ';
+        } else if ((c >= 0x300 && c <= 0x36F) || c == 0x2019) {
+            continue;
+        } else if (c == 0x401 || c == 0x451) {
+            c = 0x435;
+        } else if (c >= 0x400 && c <= 0x40F) {
+            c += 0x50;
+        } else if (c >= 0x410 && c <= 0x42F) {
+            c += 0x20;
+        }
+        if (one[0] >= '1' && one[0] <= '5') rep = fold_multi[one[0] - '1'];
+        else if (one[0]) rep = one;
+        size_t n = rep ? put_str(rep, dst, o, cap) : put_cp(c, dst, o, cap);
+        if (n == o) break;
+        o = n;
+    }
+    dst[o] = '\0';
+    return o;
+}
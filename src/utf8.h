@@ -0,0 +1,31 @@
+// utf8.h - text encoding helpers (UTF-16 / ISO-8859-1 -> UTF-8) for tag parsers
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* All converters stop at the first NUL code unit or at len, write at most
+ * cap-1 bytes plus a terminating NUL into dst and never split a multi-byte
+ * sequence. They return the number of bytes written (excluding the NUL).
+ * ASCII runs are converted 8/16 units at a time with SSE2 when available.
+ */
+
+/* UTF-16 (big_endian != 0 for UTF-16BE) to UTF-8. Surrogate pairs are joined,
+ * lone surrogates become U+FFFD. */
+size_t ox_utf16_to_utf8(const unsigned char *src, size_t len, int big_endian, char *dst, size_t cap);
+
+/* ISO-8859-1 to UTF-8. */
+size_t ox_latin1_to_utf8(const unsigned char *src, size_t len, char *dst, size_t cap);
+
+/* Copy UTF-8, truncating on a code point boundary. */
+size_t ox_utf8_copy(const unsigned char *src, size_t len, char *dst, size_t cap);
+
+/* Search folding of NUL-terminated UTF-8: lower-cases ASCII, Latin-1,
+ * Latin Extended-A and Cyrillic, strips diacritics (é -> e, ß -> ss, ё -> е),
+ * drops apostrophes and combining marks and turns other punctuation and
+ * invalid bytes into spaces. */
+size_t ox_utf8_fold(const char *src, char *dst, size_t cap);
+
+/* Decode the code point at *s (not at its NUL) and advance past it; malformed
+ * bytes come back as U+FFFD, one byte at a time. */
+uint32_t ox_utf8_next(const char **s);
@@ -0,0 +1,47 @@
+// util.h - small helpers shared by the modules that keep files on disk
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Create dir and every missing parent (mode 0700), like mkdir -p. 0 or -1. */
+int ox_mkdir_p(const char *dir);
+
+/* 64-bit FNV-1a, the hash behind cache file names and in-memory tables. */
+uint64_t ox_fnv1a(const void *data, size_t n);
+uint64_t ox_fnv1a_str(const char *s);
+
+/* write(2) until done, retrying on EINTR. 0 or -1. */
+int ox_write_all(int fd, const void *buf, size_t n);
+
+/* Replacing a file so that readers see the old or the new one, never half:
+ * ox_atomic_begin creates a hidden ".name.XXXXXX" temporary in the target's
+ * directory, the caller writes to fd (or to the FILE from ox_atomic_stdio),
+ * and ox_atomic_finish renames it over the target, or drops it when the
+ * caller passes a failure. With durable set the data is fsync'd first, so a
+ * crash cannot leave an empty file behind the new name; caches skip that. */
+struct ox_atomic {
+    int fd;
+    char *tmp;
+    FILE *f;
+    int durable;
+};
+
+/* mode is applied to the temporary (mkstemp makes it 0600). 0 or -1. */
+int ox_atomic_begin(struct ox_atomic *a, const char *path, unsigned mode, int durable);
+/* A stdio stream on the temporary, owned by a; NULL on error. */
+FILE *ox_atomic_stdio(struct ox_atomic *a);
+/* rc != 0 discards the temporary. 0, or -1 if rc was or anything fails. */
+int ox_atomic_finish(struct ox_atomic *a, const char *path, int rc);
+
+/* The simple case: all of data in one go. */
+int ox_write_file_atomic(const char *path, const void *data, size_t len, unsigned mode, int durable);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,32 +1,43 @@
 // vk.c - minimal VK (VKontakte) integration using runtime-detected libcurl via dlopen
+// - audio lists are imported with the streaming JSON tokenizer: the curl write
+//   callback feeds each received chunk straight into it, so a multi-megabyte
+//   response is parsed in one pass and never held in memory as a whole
+// - only response.items[] members are looked at, by depth, so "title" inside a
+//   nested album object or a key-like string in a title cannot be mistaken
+//   for track fields
+// - ox_vk_import_async pages through audio.get on its own thread with the curl
+//   multi interface and publishes each page to a playlist share, so the UI
+//   thread only starts the job and polls its progress
+// - ox_vk_cache keeps API responses on disk, keyed by method, parameters and
+//   a caller-chosen scope (the profile) but never the token, and serves stale
+//   entries at once while a conditional request refreshes them
+// - libcurl is loaded on first use (or by ox_vk_init, e.g. from a startup
+//   thread), never on the path to the first frame; without it every request
+//   fails and the rest of the player is unaffected
 #define _POSIX_C_SOURCE 200809L
 #include "vk.h"
+#include "curl_load.h"
+#include "json.h"
 #include "playlist.h"
-#include <dlfcn.h>
+#include "util.h"
+#include "xdg.h"
+#include <pthread.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
-/* We attempt to find libcurl and use curl_easy_perform via function pointers.
+/* We call libcurl through the table curl_load.c fills in.
  * To keep attack surface small we do not follow redirects by default and we enforce timeouts.
  */
 
-typedef void CURL;
-typedef size_t (*curl_write_callback_t)(char *, size_t, size_t, void *);
-
-typedef CURL *(*curl_easy_init_t)(void);
-typedef int (*curl_easy_setopt_t)(CURL *, int, ...);
-typedef int (*curl_easy_perform_t)(CURL *);
-typedef void (*curl_easy_cleanup_t)(CURL *);
-typedef char *(*curl_easy_strerror_t)(int);
-
-static void *curl_lib = NULL;
-static curl_easy_init_t p_curl_easy_init = NULL;
-static curl_easy_setopt_t p_curl_easy_setopt = NULL;
-static curl_easy_perform_t p_curl_easy_perform = NULL;
-static curl_easy_cleanup_t p_curl_easy_cleanup = NULL;
-static curl_easy_strerror_t p_curl_easy_strerror = NULL;
+static char api_base[512] = "https://api.vk.com/method";
 
 struct curl_response {
     char *data;
@@ -45,29 +56,31 @@ static size_t write_callback(char *ptr, size_t size, size_t nmemb, void *userdat
     return realsize;
 }
 
+/* Loads libcurl the first time any thread asks. */
+static int curl_ready(void)
+{
+    return ox_curl_load() == 0;
+}
+
 int ox_vk_init(void)
 {
-    curl_lib = dlopen("libcurl.so", RTLD_NOW | RTLD_LOCAL);
-    if (!curl_lib) return -1;
-    p_curl_easy_init = (curl_easy_init_t)dlsym(curl_lib, "curl_easy_init");
-    p_curl_easy_setopt = (curl_easy_setopt_t)dlsym(curl_lib, "curl_easy_setopt");
-    p_curl_easy_perform = (curl_easy_perform_t)dlsym(curl_lib, "curl_easy_perform");
-    p_curl_easy_cleanup = (curl_easy_cleanup_t)dlsym(curl_lib, "curl_easy_cleanup");
-    p_curl_easy_strerror = (curl_easy_strerror_t)dlsym(curl_lib, "curl_easy_strerror");
-    if (!p_curl_easy_init || !p_curl_easy_setopt || !p_curl_easy_perform || !p_curl_easy_cleanup) {
-        dlclose(curl_lib); curl_lib = NULL; return -1;
-    }
-    return 0;
+    return curl_ready() ? 0 : -1;
 }
 
 void ox_vk_shutdown(void)
 {
-    if (curl_lib) { dlclose(curl_lib); curl_lib = NULL; }
+    /* waits for a load in progress; afterwards requests fail (no reload) */
+    ox_curl_unload();
+}
+
+void ox_vk_set_api_base(const char *url)
+{
+    snprintf(api_base, sizeof(api_base), "%s", url ? url : "https://api.vk.com/method");
 }
 
 int ox_vk_share(const char *access_token, const char *owner_id, const char *message)
 {
-    if (!curl_lib) return -1;
+    if (!curl_ready()) return -1;
     (void)access_token; (void)owner_id; (void)message;
     // For brevity, actual curl usage is omitted; returning not-implemented yet.
     return -1;
@@ -83,50 +96,938 @@ char *ox_vk_oauth(void)
     return strdup(token);
 }
 
+/* response.items[k].field sits at depth 4: {0 "response":{1 "items":[2 {3 ...4 */
+#define ITEMS_DEPTH 2
+#define TRACK_DEPTH 3
+
+enum field { F_NONE, F_URL, F_ARTIST, F_TITLE, F_DURATION };
+
+struct ox_vk_import {
+    struct playlist *pl;
+    struct ox_json_parser *parser;
+    int in_response;    /* inside the top-level "response" object */
+    int items_key;      /* last key at ITEMS_DEPTH was "items" */
+    int count_key;      /* ... or "count" */
+    long total;         /* response.count: the whole list, not this page */
+    int in_items;
+    int in_track;
+    int api_error;      /* top-level "error" member */
+    enum field field;
+    char url[PLAYLIST_URI_MAX];
+    size_t url_len;
+    char artist[256], title[256];
+    size_t artist_len, title_len;
+    int32_t duration_ms;
+    int added;
+    int failed;
+};
+
+/* copy at most cap bytes, not ending inside a UTF-8 sequence */
+static size_t copy_text(char *dst, size_t cap, const char *s, size_t len)
+{
+    if (len > cap) {
+        len = cap;
+        while (len && ((unsigned char)s[len] & 0xC0) == 0x80) --len;
+    }
+    memcpy(dst, s, len);
+    return len;
+}
+
+static int add_track(struct ox_vk_import *im)
+{
+    if (!im->url_len) return 0; /* VK blanks the URL of tracks it will not stream */
+    char title[sizeof(im->artist) + sizeof(im->title) + 3];
+    size_t n = 0;
+    if (im->artist_len) {
+        memcpy(title, im->artist, im->artist_len);
+        n = im->artist_len;
+        if (im->title_len) {
+            memcpy(title + n, " - ", 3);
+            n += 3;
+        }
+    }
+    memcpy(title + n, im->title, im->title_len);
+    n += im->title_len;
+    int r = playlist_add_unique(im->pl, im->url, im->url_len, n ? title : NULL, n, im->duration_ms);
+    if (r < 0) return -1;
+    im->added += r;
+    return 0;
+}
+
+static int on_event(void *user, enum ox_json_event ev, const char *s, size_t len, int depth)
+{
+    struct ox_vk_import *im = user;
+    switch (ev) {
+    case OX_JSON_KEY:
+        if (depth == 1) {
+            im->in_response = strcmp(s, "response") == 0;
+            im->api_error |= strcmp(s, "error") == 0;
+        } else if (depth == ITEMS_DEPTH) {
+            im->items_key = im->in_response && strcmp(s, "items") == 0;
+            im->count_key = im->in_response && strcmp(s, "count") == 0;
+        } else if (depth == TRACK_DEPTH + 1 && im->in_track) {
+            im->field = strcmp(s, "url") == 0      ? F_URL
+                      : strcmp(s, "artist") == 0   ? F_ARTIST
+                      : strcmp(s, "title") == 0    ? F_TITLE
+                      : strcmp(s, "duration") == 0 ? F_DURATION
+                                                   : F_NONE;
+        }
+        return 0;
+    case OX_JSON_ARRAY_BEGIN:
+        if (depth == ITEMS_DEPTH && im->items_key) im->in_items = 1;
+        return 0;
+    case OX_JSON_ARRAY_END:
+        if (depth == ITEMS_DEPTH) im->in_items = 0;
+        return 0;
+    case OX_JSON_OBJECT_BEGIN:
+        if (depth == TRACK_DEPTH && im->in_items) {
+            im->in_track = 1;
+            im->field = F_NONE;
+            im->url_len = im->artist_len = im->title_len = 0;
+            im->duration_ms = -1;
+        }
+        return 0;
+    case OX_JSON_OBJECT_END:
+        if (depth == TRACK_DEPTH && im->in_track) {
+            im->in_track = 0;
+            if (add_track(im) != 0) return im->failed = 1;
+        }
+        return 0;
+    case OX_JSON_STRING:
+        if (depth != TRACK_DEPTH + 1 || !im->in_track) return 0;
+        if (im->field == F_URL) {
+            /* an over-long URL cannot be played: drop the track */
+            im->url_len = len < sizeof(im->url) && !memchr(s, '\0', len) ? len : 0;
+            memcpy(im->url, s, im->url_len);
+        } else if (im->field == F_ARTIST) {
+            im->artist_len = copy_text(im->artist, sizeof(im->artist), s, len);
+        } else if (im->field == F_TITLE) {
+            im->title_len = copy_text(im->title, sizeof(im->title), s, len);
+        }
+        return 0;
+    case OX_JSON_NUMBER:
+        if (depth == ITEMS_DEPTH && im->count_key) im->total = strtol(s, NULL, 10);
+        if (depth == TRACK_DEPTH + 1 && im->in_track && im->field == F_DURATION) {
+            double sec = strtod(s, NULL);
+            im->duration_ms = sec >= 0 && sec < 2e6 ? (int32_t)(sec * 1000) : -1;
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+struct ox_vk_import *ox_vk_import_begin(struct playlist *p)
+{
+    if (!p) return NULL;
+    struct ox_vk_import *im = calloc(1, sizeof(*im));
+    if (!im) return NULL;
+    im->pl = p;
+    im->total = -1;
+    im->parser = ox_json_parser_create(on_event, im);
+    if (!im->parser) {
+        free(im);
+        return NULL;
+    }
+    return im;
+}
+
+int ox_vk_import_feed(struct ox_vk_import *im, const char *data, size_t len)
+{
+    return ox_json_feed(im->parser, data, len) == 0 ? 0 : -1;
+}
+
+int ox_vk_import_end(struct ox_vk_import *im)
+{
+    if (!im) return -1;
+    int ok = !im->failed && ox_json_finish(im->parser) == 0 && !im->api_error;
+    int added = im->added;
+    ox_json_parser_destroy(im->parser);
+    free(im);
+    return ok ? added : -1;
+}
+
+static size_t import_callback(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    size_t n = size * nmemb;
+    /* anything short of n makes curl abort the transfer */
+    return ox_vk_import_feed(userdata, ptr, n) == 0 ? n : 0;
+}
+
+/* RFC 3986 unreserved characters pass, the rest is %XX */
+static void escape_param(const char *in, char *out, size_t cap)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = 0;
+    for (; *in && n + 4 < cap; ++in) {
+        unsigned char c = (unsigned char)*in;
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || strchr("-._~", c)) {
+            out[n++] = (char)c;
+        } else {
+            out[n++] = '%';
+            out[n++] = hex[c >> 4];
+            out[n++] = hex[c & 15];
+        }
+    }
+    out[n] = '\0';
+}
+
+static void method_url(const char *base, const char *token, const char *method, const char *params, char *out,
+                       size_t cap)
+{
+    char tok[1024];
+    escape_param(token, tok, sizeof(tok));
+    snprintf(out, cap, "%s/%s?access_token=%s&%s", base, method, tok, params);
+}
+
+static int audio_get(const char *access_token, ox_curl_data_cb cb, void *data)
+{
+    CURL *curl = ox_curl.easy_init();
+    if (!curl) return -1;
+    char url[2048];
+    method_url(api_base, access_token, "audio.get", "v=5.131", url, sizeof(url));
+    ox_curl.easy_setopt(curl, 10002, url); // CURLOPT_URL
+    ox_curl.easy_setopt(curl, 20011, cb); // CURLOPT_WRITEFUNCTION
+    ox_curl.easy_setopt(curl, 10001, data); // CURLOPT_WRITEDATA
+    ox_curl.easy_setopt(curl, 81, 10L); // CURLOPT_TIMEOUT
+    int res = ox_curl.easy_perform(curl);
+    ox_curl.easy_cleanup(curl);
+    return res == 0 ? 0 : -1;
+}
+
 char *ox_vk_get_audio(const char *access_token)
 {
-    if (!curl_lib || !access_token) return NULL;
-    CURL *curl = p_curl_easy_init();
-    if (!curl) return NULL;
+    if (!curl_ready() || !access_token) return NULL;
     struct curl_response resp = {0};
-    char url[2048];
-    snprintf(url, sizeof(url), "https://api.vk.com/method/audio.get?access_token=%s&v=5.131", access_token);
-    p_curl_easy_setopt(curl, 10002, url); // CURLOPT_URL
-    p_curl_easy_setopt(curl, 20011, write_callback); // CURLOPT_WRITEFUNCTION
-    p_curl_easy_setopt(curl, 10001, &resp); // CURLOPT_WRITEDATA
-    p_curl_easy_setopt(curl, 81, 10L); // CURLOPT_TIMEOUT
-    int res = p_curl_easy_perform(curl);
-    p_curl_easy_cleanup(curl);
-    if (res != 0) {
+    if (audio_get(access_token, write_callback, &resp) != 0) {
         free(resp.data);
         return NULL;
     }
     return resp.data;
 }
 
+int ox_vk_fetch_audio_to_playlist(const char *access_token, struct playlist *p)
+{
+    if (!curl_ready() || !access_token) return -1;
+    struct ox_vk_import *im = ox_vk_import_begin(p);
+    if (!im) return -1;
+    int r = audio_get(access_token, import_callback, im);
+    int added = ox_vk_import_end(im);
+    return r == 0 ? added : -1;
+}
+
 int ox_vk_import_audio_to_playlist(const char *json, struct playlist *p)
 {
-    if (!json || !p) return -1;
-    // Simple JSON parsing: look for "url" fields
-    int count = 0;
-    const char *pos = json;
-    while ((pos = strstr(pos, "\"url\":")) != NULL) {
-        pos += 6; // skip "url":
-        if (*pos == '"') {
-            pos++; // skip "
-            const char *end = strchr(pos, '"');
-            if (end) {
-                char url[2048];
-                size_t len = end - pos;
-                if (len < sizeof(url)) {
-                    memcpy(url, pos, len);
-                    url[len] = '\0';
-                    playlist_add(p, url);
-                    count++;
-                }
-                pos = end + 1;
+    if (!json) return -1;
+    struct ox_vk_import *im = ox_vk_import_begin(p);
+    if (!im) return -1;
+    ox_vk_import_feed(im, json, strlen(json));
+    return ox_vk_import_end(im);
+}
+
+/* ---- response cache ----
+ * An entry is "<dir>/<fnv64(scope, method, params)>.vkc": a small header,
+ * the key (hash collisions read as misses), the ETag and Last-Modified
+ * validators, then the body as received. The token only goes into request
+ * URLs; it is not part of the key and is never written, so a renewed token
+ * keeps its account's entries. A fresh entry is served as is; a stale one is
+ * served too and queued for a conditional request on the cache's own thread.
+ * Error responses, HTTP or API, are never stored. */
+
+#define ENTRY_MAGIC "OXVC"
+
+struct entry_head {
+    char magic[4];
+    uint32_t key_len, etag_len, lm_len;
+    int64_t stored;         /* unix time of the last 200 or 304 */
+    uint64_t body_len;
+};
+
+struct validators {
+    char etag[256];
+    char lm[64];
+};
+
+struct entry {
+    int64_t stored;
+    struct validators v;
+    char *body;
+    size_t len;
+};
+
+struct refresh {
+    struct refresh *next;
+    char name[24];
+    char *key;
+    char *url;              /* with the token: memory only */
+};
+
+struct ox_vk_cache {
+    char *dir;
+    long ttl;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* queue changed or a refresh finished */
+    struct refresh *queue;
+    int busy, stop, has_thread;
+    pthread_t thread;
+};
+
+/* malloc'd "scope\nmethod\nparams" and its file name */
+static char *cache_key(const char *scope, const char *method, const char *params, char name[24])
+{
+    size_t n = strlen(scope ? scope : "") + strlen(method) + strlen(params) + 3;
+    char *key = malloc(n);
+    if (!key) return NULL;
+    snprintf(key, n, "%s\n%s\n%s", scope ? scope : "", method, params);
+    snprintf(name, 24, "%016llx", (unsigned long long)ox_fnv1a_str(key));
+    return key;
+}
+
+static int entry_read(struct ox_vk_cache *c, const char *name, const char *key, struct entry *e)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.vkc", c->dir, name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    struct entry_head h;
+    char *buf = NULL;
+    size_t key_len = strlen(key);
+    int ok = fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(h) && (buf = malloc((size_t)st.st_size + 1)) &&
+             read(fd, buf, (size_t)st.st_size) == (ssize_t)st.st_size;
+    close(fd);
+    if (ok) {
+        memcpy(&h, buf, sizeof(h));
+        ok = memcmp(h.magic, ENTRY_MAGIC, 4) == 0 && h.etag_len < sizeof(e->v.etag) && h.lm_len < sizeof(e->v.lm) &&
+             h.key_len == key_len &&
+             (uint64_t)st.st_size == sizeof(h) + (uint64_t)h.key_len + h.etag_len + h.lm_len + h.body_len &&
+             memcmp(buf + sizeof(h), key, key_len) == 0;
+    }
+    if (!ok) {
+        free(buf);
+        return -1;
+    }
+    const char *p = buf + sizeof(h) + key_len;
+    memset(&e->v, 0, sizeof(e->v));
+    memcpy(e->v.etag, p, h.etag_len);
+    memcpy(e->v.lm, p + h.etag_len, h.lm_len);
+    e->stored = h.stored;
+    e->len = (size_t)h.body_len;
+    /* the body moves to the front of the buffer, NUL-terminated */
+    memmove(buf, p + h.etag_len + h.lm_len, e->len);
+    buf[e->len] = '\0';
+    e->body = buf;
+    return 0;
+}
+
+/* written beside the entry and renamed over it: readers see one or the other */
+static int entry_write(struct ox_vk_cache *c, const char *name, const char *key, const struct validators *v,
+                       const char *body, size_t len)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.vkc", c->dir, name);
+    struct ox_atomic a;
+    if (ox_atomic_begin(&a, path, 0600, 0) != 0) return -1;
+    struct entry_head h = { ENTRY_MAGIC, (uint32_t)strlen(key), (uint32_t)strlen(v->etag), (uint32_t)strlen(v->lm),
+                            (int64_t)time(NULL), len };
+    struct iovec_part { const void *p; size_t n; } parts[] = {
+        { &h, sizeof(h) }, { key, h.key_len }, { v->etag, h.etag_len }, { v->lm, h.lm_len }, { body, len },
+    };
+    int rc = 0;
+    for (size_t i = 0; rc == 0 && i < sizeof(parts) / sizeof(parts[0]); ++i)
+        rc = ox_write_all(a.fd, parts[i].p, parts[i].n);
+    return ox_atomic_finish(&a, path, rc);
+}
+
+/* a 304: the entry is fresh again */
+static void entry_touch(struct ox_vk_cache *c, const char *name)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.vkc", c->dir, name);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    int64_t now = (int64_t)time(NULL);
+    if (pwrite(fd, &now, sizeof(now), offsetof(struct entry_head, stored)) != (ssize_t)sizeof(now)) unlink(path);
+    close(fd);
+}
+
+static size_t validator_header(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    struct validators *v = userdata;
+    size_t n = size * nmemb, skip;
+    char *dst = NULL;
+    size_t cap = 0;
+    if (n >= 5 && memcmp(ptr, "HTTP/", 5) == 0) {
+        memset(v, 0, sizeof(*v)); /* each response of a redirect chain */
+    } else if (n > 5 && strncasecmp(ptr, "etag:", 5) == 0) {
+        dst = v->etag, cap = sizeof(v->etag), skip = 5;
+    } else if (n > 14 && strncasecmp(ptr, "last-modified:", 14) == 0) {
+        dst = v->lm, cap = sizeof(v->lm), skip = 14;
+    }
+    if (dst) {
+        const char *p = ptr + skip, *end = ptr + n;
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        while (end > p && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' ')) --end;
+        /* a validator that does not fit is not sent back at all */
+        size_t len = (size_t)(end - p) < cap ? (size_t)(end - p) : 0;
+        memcpy(dst, p, len);
+        dst[len] = '\0';
+    }
+    return n;
+}
+
+static int api_event(void *user, enum ox_json_event ev, const char *s, size_t len, int depth)
+{
+    int *state = user;
+    (void)len;
+    if (ev == OX_JSON_KEY && depth == 1) {
+        if (strcmp(s, "error") == 0) *state = -1;
+        else if (strcmp(s, "response") == 0 && *state == 0) *state = 1;
+    }
+    return 0;
+}
+
+/* a VK answer worth keeping: valid JSON with "response" and no "error" */
+static int api_ok(const char *body, size_t len)
+{
+    int state = 0;
+    struct ox_json_parser *p = ox_json_parser_create(api_event, &state);
+    if (!p) return 0;
+    int ok = ox_json_feed(p, body, len) == 0 && ox_json_finish(p) == 0;
+    ox_json_parser_destroy(p);
+    return ok && state == 1;
+}
+
+/* one request; old adds the conditional headers. HTTP status or -1 */
+static long fetch(const char *url, const struct validators *old, struct curl_response *body, struct validators *v)
+{
+    CURL *h = ox_curl.easy_init();
+    if (!h) return -1;
+    void *headers = NULL;
+    char line[320];
+    if (old && old->etag[0]) {
+        snprintf(line, sizeof(line), "If-None-Match: %s", old->etag);
+        headers = ox_curl.slist_append(headers, line);
+    }
+    if (old && old->lm[0]) {
+        snprintf(line, sizeof(line), "If-Modified-Since: %s", old->lm);
+        void *more = ox_curl.slist_append(headers, line);
+        if (more) headers = more;
+    }
+    memset(v, 0, sizeof(*v));
+    ox_curl.easy_setopt(h, 10002, url); // CURLOPT_URL
+    ox_curl.easy_setopt(h, 20011, write_callback); // CURLOPT_WRITEFUNCTION
+    ox_curl.easy_setopt(h, 10001, body); // CURLOPT_WRITEDATA
+    ox_curl.easy_setopt(h, 20079, validator_header); // CURLOPT_HEADERFUNCTION
+    ox_curl.easy_setopt(h, 10029, v); // CURLOPT_HEADERDATA
+    ox_curl.easy_setopt(h, 10023, headers); // CURLOPT_HTTPHEADER
+    ox_curl.easy_setopt(h, 99, 1L); // CURLOPT_NOSIGNAL
+    ox_curl.easy_setopt(h, 81, 10L); // CURLOPT_TIMEOUT
+    ox_curl.easy_setopt(h, 10102, ""); // CURLOPT_ACCEPT_ENCODING
+    long status = 0;
+    int rc = ox_curl.easy_perform(h);
+    ox_curl.easy_getinfo(h, 0x200002, &status); // CURLINFO_RESPONSE_CODE
+    ox_curl.easy_cleanup(h);
+    ox_curl.slist_free_all(headers);
+    return rc == 0 ? status : -1;
+}
+
+static void refresh_free(struct refresh *r)
+{
+    free(r->key);
+    free(r->url);
+    free(r);
+}
+
+static void *refresh_main(void *arg)
+{
+    struct ox_vk_cache *c = arg;
+    pthread_mutex_lock(&c->lock);
+    while (!c->stop) {
+        struct refresh *r = c->queue;
+        if (!r) {
+            pthread_cond_wait(&c->cond, &c->lock);
+            continue;
+        }
+        c->queue = r->next;
+        c->busy = 1;
+        pthread_mutex_unlock(&c->lock);
+
+        struct entry e;
+        int have = entry_read(c, r->name, r->key, &e) == 0;
+        struct curl_response body = {0};
+        struct validators v;
+        long status = fetch(r->url, have ? &e.v : NULL, &body, &v);
+        if (status == 304 && have) entry_touch(c, r->name);
+        else if (status == 200 && api_ok(body.data, body.size))
+            entry_write(c, r->name, r->key, &v, body.data, body.size);
+        if (have) free(e.body);
+        free(body.data);
+        refresh_free(r);
+
+        pthread_mutex_lock(&c->lock);
+        c->busy = 0;
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+/* takes key; one queued refresh per entry */
+static void queue_refresh(struct ox_vk_cache *c, const char *name, char *key, const char *url)
+{
+    struct refresh *r = calloc(1, sizeof(*r)), **tail;
+    if (!r || !(r->url = strdup(url))) {
+        free(r);
+        free(key);
+        return;
+    }
+    memcpy(r->name, name, sizeof(r->name));
+    r->key = key;
+    pthread_mutex_lock(&c->lock);
+    for (tail = &c->queue; *tail; tail = &(*tail)->next)
+        if (strcmp((*tail)->name, name) == 0) break;
+    if (*tail) {
+        refresh_free(r);
+    } else {
+        *tail = r;
+        if (!c->has_thread) c->has_thread = pthread_create(&c->thread, NULL, refresh_main, c) == 0;
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+struct ox_vk_cache *ox_vk_cache_open(const char *dir, long ttl_sec)
+{
+    struct ox_vk_cache *c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    if (dir) {
+        c->dir = strdup(dir);
+    } else {
+        char *cache = ox_get_xdg_cache_home();
+        size_t n = cache ? strlen(cache) + strlen("/vk") + 1 : 0;
+        if (cache && (c->dir = malloc(n))) {
+            snprintf(c->dir, n, "%s/vk", cache);
+            ox_mkdir_p(c->dir);
+        }
+        free(cache);
+    }
+    struct stat st;
+    if (!c->dir || stat(c->dir, &st) != 0 || !S_ISDIR(st.st_mode) || pthread_mutex_init(&c->lock, NULL) != 0) {
+        free(c->dir);
+        free(c);
+        return NULL;
+    }
+    pthread_cond_init(&c->cond, NULL);
+    c->ttl = ttl_sec;
+    return c;
+}
+
+void ox_vk_cache_close(struct ox_vk_cache *c)
+{
+    if (!c) return;
+    pthread_mutex_lock(&c->lock);
+    c->stop = 1;
+    while (c->queue) {
+        struct refresh *r = c->queue;
+        c->queue = r->next;
+        refresh_free(r);
+    }
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+    if (c->has_thread) pthread_join(c->thread, NULL);
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->lock);
+    free(c->dir);
+    free(c);
+}
+
+void ox_vk_cache_flush(struct ox_vk_cache *c)
+{
+    pthread_mutex_lock(&c->lock);
+    while (c->queue || c->busy) pthread_cond_wait(&c->cond, &c->lock);
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* cache_get with the API base to refresh from */
+static char *cache_lookup(struct ox_vk_cache *c, const char *base, const char *scope, const char *token,
+                          const char *method, const char *params, size_t *len, enum ox_vk_cache_state *state)
+{
+    char name[24];
+    char *key = cache_key(scope, method, params, name);
+    struct entry e;
+    *state = OX_VK_CACHE_MISS;
+    if (!key || entry_read(c, name, key, &e) != 0) {
+        free(key);
+        return NULL;
+    }
+    int64_t age = (int64_t)time(NULL) - e.stored;
+    if (age >= 0 && age < c->ttl) {
+        *state = OX_VK_CACHE_FRESH;
+        free(key);
+    } else {
+        char url[2048];
+        *state = OX_VK_CACHE_STALE;
+        method_url(base, token, method, params, url, sizeof(url));
+        queue_refresh(c, name, key, url);
+    }
+    if (len) *len = e.len;
+    return e.body;
+}
+
+char *ox_vk_cache_get(struct ox_vk_cache *c, const char *scope, const char *access_token, const char *method,
+                      const char *params, size_t *len, enum ox_vk_cache_state *state)
+{
+    enum ox_vk_cache_state ignored;
+    if (!c || !access_token || !method || !params) return NULL;
+    return cache_lookup(c, api_base, scope, access_token, method, params, len, state ? state : &ignored);
+}
+
+char *ox_vk_call_cached(struct ox_vk_cache *c, const char *scope, const char *access_token, const char *method,
+                        const char *params, size_t *len)
+{
+    if (!curl_ready() || !c || !access_token || !method || !params) return NULL;
+    char *body = ox_vk_cache_get(c, scope, access_token, method, params, len, NULL);
+    if (body) return body;
+    char url[2048], name[24];
+    struct curl_response resp = {0};
+    struct validators v;
+    method_url(api_base, access_token, method, params, url, sizeof(url));
+    if (fetch(url, NULL, &resp, &v) != 200 || !resp.data) {
+        free(resp.data);
+        return NULL;
+    }
+    char *key = api_ok(resp.data, resp.size) ? cache_key(scope, method, params, name) : NULL;
+    if (key) entry_write(c, name, key, &v, resp.data, resp.size);
+    free(key);
+    if (len) *len = resp.size;
+    return resp.data;
+}
+
+char *ox_vk_get_audio_cached(struct ox_vk_cache *c, const char *scope, const char *access_token)
+{
+    return ox_vk_call_cached(c, scope, access_token, "audio.get", "v=5.131", NULL);
+}
+
+/* ---- paged import in the background ----
+ * One worker thread drives a curl multi handle: page 0 goes out first and
+ * the others are queued as soon as its "count" has been parsed, which is
+ * before its items arrive. Up to OX_VK_CONNECTIONS pages are in flight over
+ * reused connections; each streams into a private batch, and finished pages
+ * are published to the share in list order. A failed page (network, HTTP
+ * status, VK error such as the request-rate limit) is retried with backoff.
+ * With a cache, pages it holds are published without a request (stale ones
+ * are refreshed behind the job) and fetched pages are stored. */
+
+#define PAGE_ATTEMPTS 3
+
+struct page {
+    int index;
+    CURL *h;
+    struct playlist *batch;
+    struct ox_vk_import *im;
+    int attempts;
+    double not_before;
+    enum { PAGE_QUEUED, PAGE_ACTIVE, PAGE_READY, PAGE_PUBLISHED } state;
+    struct ox_vk_job *job;
+    struct curl_response raw;   /* the body as received, for the cache */
+    struct validators v;
+};
+
+struct ox_vk_job {
+    pthread_t thread;
+    _Atomic int cancel;
+    struct ox_plshare *dest;
+    char *token;
+    char base[sizeof(api_base)];
+    struct ox_vk_cache *cache;
+    char *scope;
+    pthread_mutex_t lock;   /* guards progress */
+    struct ox_vk_progress progress;
+    struct page **pages;
+    int npages;
+};
+
+static double monotonic(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int add_pages(struct ox_vk_job *j, long total)
+{
+    int n = total > OX_VK_PAGE_SIZE ? (int)((total + OX_VK_PAGE_SIZE - 1) / OX_VK_PAGE_SIZE) : 1;
+    if (n <= j->npages) return 0;
+    struct page **pages = realloc(j->pages, (size_t)n * sizeof(*pages));
+    if (!pages) return -1;
+    j->pages = pages;
+    for (; j->npages < n; ++j->npages) {
+        struct page *pg = calloc(1, sizeof(*pg));
+        if (!pg) return -1;
+        pg->index = j->npages;
+        pg->job = j;
+        pages[j->npages] = pg;
+    }
+    pthread_mutex_lock(&j->lock);
+    j->progress.pages_total = n;
+    j->progress.total = total;
+    pthread_mutex_unlock(&j->lock);
+    return 0;
+}
+
+static size_t page_callback(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    struct page *pg = userdata;
+    size_t n = size * nmemb;
+    if (atomic_load_explicit(&pg->job->cancel, memory_order_relaxed)) return 0;
+    if (pg->job->cache && write_callback(ptr, size, nmemb, &pg->raw) != n) return 0;
+    return ox_vk_import_feed(pg->im, ptr, n) == 0 ? n : 0;
+}
+
+static void page_params(const struct page *pg, char *out, size_t cap)
+{
+    snprintf(out, cap, "v=5.131&count=%d&offset=%ld", OX_VK_PAGE_SIZE, (long)pg->index * OX_VK_PAGE_SIZE);
+}
+
+/* a cached page goes straight to READY; 0 if the cache had none usable */
+static int page_from_cache(struct ox_vk_job *j, struct page *pg)
+{
+    char params[96];
+    size_t len;
+    enum ox_vk_cache_state state;
+    page_params(pg, params, sizeof(params));
+    char *body = cache_lookup(j->cache, j->base, j->scope, j->token, "audio.get", params, &len, &state);
+    if (!body) return 0;
+    pg->batch = playlist_create();
+    struct ox_vk_import *im = pg->batch ? ox_vk_import_begin(pg->batch) : NULL;
+    int ok = im && ox_vk_import_feed(im, body, len) == 0;
+    if (ok && pg->index == 0 && im->total >= 0) ok = add_pages(j, im->total) == 0;
+    ok = ox_vk_import_end(im) >= 0 && ok;
+    free(body);
+    if (!ok) {
+        playlist_destroy(pg->batch);
+        pg->batch = NULL;
+        return 0;
+    }
+    pg->state = PAGE_READY;
+    return 1;
+}
+
+/* 1 if the page was served from the cache, 0 if its request is running */
+static int page_start(struct ox_vk_job *j, CURLM *multi, struct page *pg)
+{
+    char params[96], url[2048];
+    if (j->cache && page_from_cache(j, pg)) return 1;
+    page_params(pg, params, sizeof(params));
+    method_url(j->base, j->token, "audio.get", params, url, sizeof(url));
+    pg->batch = playlist_create();
+    pg->im = pg->batch ? ox_vk_import_begin(pg->batch) : NULL;
+    pg->h = pg->im ? ox_curl.easy_init() : NULL;
+    if (!pg->h) return -1;
+    ox_curl.easy_setopt(pg->h, 10002, url); // CURLOPT_URL
+    ox_curl.easy_setopt(pg->h, 20011, page_callback); // CURLOPT_WRITEFUNCTION
+    ox_curl.easy_setopt(pg->h, 10001, pg); // CURLOPT_WRITEDATA
+    ox_curl.easy_setopt(pg->h, 10103, (char *)pg); // CURLOPT_PRIVATE
+    ox_curl.easy_setopt(pg->h, 99, 1L); // CURLOPT_NOSIGNAL: we are not the main thread
+    ox_curl.easy_setopt(pg->h, 78, 10L); // CURLOPT_CONNECTTIMEOUT
+    ox_curl.easy_setopt(pg->h, 19, 1L); // CURLOPT_LOW_SPEED_LIMIT: bytes/s ...
+    ox_curl.easy_setopt(pg->h, 20, 15L); // CURLOPT_LOW_SPEED_TIME: ... for this long aborts
+    ox_curl.easy_setopt(pg->h, 10102, ""); // CURLOPT_ACCEPT_ENCODING: any curl can decode
+    ox_curl.easy_setopt(pg->h, 237, 1L); // CURLOPT_PIPEWAIT: prefer multiplexing over a new connection
+    if (j->cache) {
+        ox_curl.easy_setopt(pg->h, 20079, validator_header); // CURLOPT_HEADERFUNCTION
+        ox_curl.easy_setopt(pg->h, 10029, &pg->v); // CURLOPT_HEADERDATA
+    }
+    if (ox_curl.multi_add_handle(multi, pg->h) != 0) return -1;
+    pg->state = PAGE_ACTIVE;
+    return 0;
+}
+
+/* undo page_start; keeps batch when the page succeeded */
+static void page_stop(CURLM *multi, struct page *pg, int keep)
+{
+    if (pg->h) {
+        ox_curl.multi_remove_handle(multi, pg->h);
+        ox_curl.easy_cleanup(pg->h);
+        pg->h = NULL;
+    }
+    if (pg->im) ox_vk_import_end(pg->im);
+    pg->im = NULL;
+    free(pg->raw.data);
+    pg->raw.data = NULL;
+    pg->raw.size = 0;
+    if (!keep) {
+        playlist_destroy(pg->batch);
+        pg->batch = NULL;
+    }
+}
+
+static void finish_page(struct ox_vk_job *j, CURLM *multi, struct page *pg, int result)
+{
+    long status = 0;
+    ox_curl.easy_getinfo(pg->h, 0x200002, &status); // CURLINFO_RESPONSE_CODE
+    if (pg->index == 0 && pg->im->total >= 0) add_pages(j, pg->im->total);
+    CURL *h = pg->h;
+    ox_curl.multi_remove_handle(multi, h);
+    ox_curl.easy_cleanup(h);
+    pg->h = NULL;
+    int added = ox_vk_import_end(pg->im);
+    pg->im = NULL;
+    if (result == 0 && status == 200 && added >= 0) {
+        if (j->cache && pg->raw.data) {
+            char params[96], name[24];
+            page_params(pg, params, sizeof(params));
+            char *key = cache_key(j->scope, "audio.get", params, name);
+            if (key) entry_write(j->cache, name, key, &pg->v, pg->raw.data, pg->raw.size);
+            free(key);
+        }
+        page_stop(multi, pg, 1);
+        pg->state = PAGE_READY;
+        return;
+    }
+    page_stop(multi, pg, 0);
+    pg->state = PAGE_QUEUED;
+    pg->not_before = monotonic() + 0.5 * (1 << pg->attempts);
+    if (++pg->attempts >= PAGE_ATTEMPTS) {
+        pthread_mutex_lock(&j->lock);
+        j->progress.state = OX_VK_JOB_FAILED;
+        pthread_mutex_unlock(&j->lock);
+    }
+}
+
+static void *job_main(void *arg)
+{
+    struct ox_vk_job *j = arg;
+    CURLM *multi = ox_curl.multi_init();
+    int state = multi && add_pages(j, 0) == 0 ? OX_VK_JOB_RUNNING : OX_VK_JOB_FAILED;
+    if (multi) {
+        ox_curl.multi_setopt(multi, 3, 2L); // CURLMOPT_PIPELINING: CURLPIPE_MULTIPLEX (HTTP/2)
+        ox_curl.multi_setopt(multi, 7, (long)OX_VK_CONNECTIONS); // CURLMOPT_MAX_HOST_CONNECTIONS
+    }
+    int next = 0; /* first page not yet published */
+    while (state == OX_VK_JOB_RUNNING) {
+        if (atomic_load(&j->cancel)) {
+            state = OX_VK_JOB_CANCELLED;
+            break;
+        }
+        int active = 0;
+        double now = monotonic();
+        for (int i = next; i < j->npages; ++i) active += j->pages[i]->state == PAGE_ACTIVE;
+        for (int i = next; i < j->npages && active < OX_VK_CONNECTIONS; ++i) {
+            struct page *pg = j->pages[i];
+            if (pg->state != PAGE_QUEUED || pg->not_before > now) continue;
+            int r = page_start(j, multi, pg);
+            if (r < 0) {
+                page_stop(multi, pg, 0);
+                state = OX_VK_JOB_FAILED;
+                break;
             }
+            active += r == 0;
+        }
+        int running = 0, left;
+        ox_curl.multi_perform(multi, &running);
+        /* the first page's count arrives long before its items */
+        struct page *first = j->pages[0];
+        if (first->state == PAGE_ACTIVE && first->im->total >= 0 && add_pages(j, first->im->total) != 0)
+            state = OX_VK_JOB_FAILED;
+        struct ox_curl_msg *m;
+        while ((m = ox_curl.multi_info_read(multi, &left))) {
+            if (m->msg != 1) continue; // CURLMSG_DONE
+            char *priv = NULL;
+            ox_curl.easy_getinfo(m->easy_handle, 0x100015, &priv); // CURLINFO_PRIVATE
+            finish_page(j, multi, (struct page *)priv, m->data.result);
         }
+        while (next < j->npages && j->pages[next]->state == PAGE_READY) {
+            struct page *pg = j->pages[next];
+            if (pg->batch->count && ox_plshare_append(j->dest, pg->batch) != 0) state = OX_VK_JOB_FAILED;
+            pthread_mutex_lock(&j->lock);
+            j->progress.pages_done++;
+            j->progress.tracks += (int)pg->batch->count;
+            pthread_mutex_unlock(&j->lock);
+            playlist_destroy(pg->batch);
+            pg->batch = NULL;
+            pg->state = PAGE_PUBLISHED;
+            next++;
+        }
+        pthread_mutex_lock(&j->lock);
+        if (j->progress.state == OX_VK_JOB_FAILED) state = OX_VK_JOB_FAILED;
+        pthread_mutex_unlock(&j->lock);
+        if (state == OX_VK_JOB_RUNNING && next == j->npages) state = OX_VK_JOB_DONE;
+        if (state != OX_VK_JOB_RUNNING) break;
+        /* bounded so cancellation and retry backoff are noticed; curl
+         * returns at once when it has nothing to wait on */
+        int ready = 0, fds;
+        for (int i = next; i < j->npages && !ready; ++i)
+            ready = j->pages[i]->state == PAGE_QUEUED && j->pages[i]->not_before <= monotonic();
+        if (running) ox_curl.multi_wait(multi, NULL, 0, 50, &fds);
+        else if (!ready) nanosleep(&(struct timespec){ 0, 20000000 }, NULL);
     }
-    return count;
+    for (int i = 0; i < j->npages; ++i) page_stop(multi, j->pages[i], 0);
+    if (multi) ox_curl.multi_cleanup(multi);
+    pthread_mutex_lock(&j->lock);
+    j->progress.state = state;
+    pthread_mutex_unlock(&j->lock);
+    return NULL;
+}
+
+struct ox_vk_job *ox_vk_import_async(const char *access_token, struct ox_plshare *dest)
+{
+    return ox_vk_import_async_cached(access_token, NULL, NULL, dest);
+}
+
+struct ox_vk_job *ox_vk_import_async_cached(const char *access_token, struct ox_vk_cache *cache, const char *scope,
+                                            struct ox_plshare *dest)
+{
+    if (!curl_ready() || !access_token || !dest) return NULL;
+    struct ox_vk_job *j = calloc(1, sizeof(*j));
+    if (!j) return NULL;
+    j->dest = dest;
+    j->cache = cache;
+    j->scope = scope ? strdup(scope) : NULL;
+    j->token = strdup(access_token);
+    memcpy(j->base, api_base, sizeof(api_base));
+    j->progress.state = OX_VK_JOB_RUNNING;
+    j->progress.total = -1;
+    atomic_init(&j->cancel, 0);
+    if (!j->token || (scope && !j->scope) || pthread_mutex_init(&j->lock, NULL) != 0) {
+        free(j->token);
+        free(j->scope);
+        free(j);
+        return NULL;
+    }
+    if (pthread_create(&j->thread, NULL, job_main, j) != 0) {
+        pthread_mutex_destroy(&j->lock);
+        free(j->token);
+        free(j->scope);
+        free(j);
+        return NULL;
+    }
+    return j;
+}
+
+void ox_vk_job_progress(struct ox_vk_job *j, struct ox_vk_progress *out)
+{
+    pthread_mutex_lock(&j->lock);
+    *out = j->progress;
+    pthread_mutex_unlock(&j->lock);
+}
+
+void ox_vk_job_cancel(struct ox_vk_job *j)
+{
+    if (j) atomic_store(&j->cancel, 1);
+}
+
+int ox_vk_job_finish(struct ox_vk_job *j)
+{
+    if (!j) return -1;
+    pthread_join(j->thread, NULL);
+    int tracks = j->progress.state == OX_VK_JOB_DONE ? j->progress.tracks : -1;
+    for (int i = 0; i < j->npages; ++i) free(j->pages[i]);
+    free(j->pages);
+    pthread_mutex_destroy(&j->lock);
+    free(j->token);
+    free(j->scope);
+    free(j);
+    return tracks;
 }
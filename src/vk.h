@@ -1,15 +1,23 @@
 #pragma once
 #include <stddef.h>
 #include "playlist.h"
+#include "playlist_share.h"
 
 /* Minimal VK integration API for OXXY.
  * This module will attempt to detect libcurl at runtime and perform requests to VK API.
  * If libcurl is not available, functions will return an error code.
  */
 
+/* libcurl is loaded on first use; ox_vk_init only does it now (e.g. on a
+ * background thread at startup) and reports whether it is available.
+ * ox_vk_shutdown unloads it once no request is running. */
 int ox_vk_init(void);
 void ox_vk_shutdown(void);
 
+/* API endpoint, "https://api.vk.com/method" by default (NULL restores it).
+ * Set it before starting requests; tests point it at a local server. */
+void ox_vk_set_api_base(const char *url);
+
 /* Share a message (e.g., current track) to VK wall using provided access_token and owner_id.
  * Returns 0 on success, -1 on failure.
  */
@@ -25,7 +33,85 @@ char *ox_vk_oauth(void);
  */
 char *ox_vk_get_audio(const char *access_token);
 
-/* Parse audio JSON and add URLs to playlist.
+/* Fetch the audio list and add its tracks to p while the response arrives
+ * (nothing is buffered beyond the current token).
  * Returns number of tracks added or -1 on failure.
  */
+int ox_vk_fetch_audio_to_playlist(const char *access_token, struct playlist *p);
+
+/* Parse audio JSON and add response.items[] to playlist with "artist - title"
+ * and duration; URLs already in p are skipped.
+ * Returns number of tracks added or -1 on failure (bad JSON or an API error).
+ */
 int ox_vk_import_audio_to_playlist(const char *json, struct playlist *p);
+
+/* The same import, incrementally: feed the response in chunks of any size.
+ * feed returns -1 once the input is not valid JSON; end frees im and returns
+ * the number of tracks added, or -1. Tracks seen before an error stay in p.
+ */
+struct ox_vk_import;
+struct ox_vk_import *ox_vk_import_begin(struct playlist *p);
+int ox_vk_import_feed(struct ox_vk_import *im, const char *data, size_t len);
+int ox_vk_import_end(struct ox_vk_import *im);
+
+/* Background import: audio.get is fetched OX_VK_PAGE_SIZE tracks at a time,
+ * up to OX_VK_CONNECTIONS pages in flight, and every page is appended to dest
+ * as its own version, in list order, as soon as it and the pages before it
+ * have arrived. Returns NULL if curl is unavailable.
+ */
+#define OX_VK_PAGE_SIZE 1000
+#define OX_VK_CONNECTIONS 4
+
+enum ox_vk_job_state { OX_VK_JOB_RUNNING, OX_VK_JOB_DONE, OX_VK_JOB_FAILED, OX_VK_JOB_CANCELLED };
+
+struct ox_vk_progress {
+    enum ox_vk_job_state state;
+    int pages_done;
+    int pages_total;    /* 1 until the first page reports the list size */
+    int tracks;         /* appended to dest so far */
+    long total;         /* list size reported by VK, -1 until known */
+};
+
+struct ox_vk_cache;
+struct ox_vk_job;
+struct ox_vk_job *ox_vk_import_async(const char *access_token, struct ox_plshare *dest);
+/* The same with a response cache: pages it holds are published without
+ * waiting on the network (stale ones are refreshed in the background) and
+ * fetched pages are stored under scope. The cache must outlive the job. */
+struct ox_vk_job *ox_vk_import_async_cached(const char *access_token, struct ox_vk_cache *cache, const char *scope,
+                                            struct ox_plshare *dest);
+/* Never blocks on the network; safe to call every frame. */
+void ox_vk_job_progress(struct ox_vk_job *j, struct ox_vk_progress *out);
+/* Ask the job to stop; pages already appended stay in dest. */
+void ox_vk_job_cancel(struct ox_vk_job *j);
+/* Wait for the job to end and free it. Returns tracks appended, or -1 if it
+ * failed or was cancelled. */
+int ox_vk_job_finish(struct ox_vk_job *j);
+
+/* Response cache for API calls. Entries are keyed by method, parameters and
+ * scope (one per account, e.g. the profile name); the token is used for
+ * requests only and never stored. An entry younger than ttl_sec is served
+ * as is. An older one is still served at once, and a conditional request
+ * (If-None-Match / If-Modified-Since) refreshes it on the cache's thread.
+ * Error responses are not cached.
+ */
+#define OX_VK_CACHE_TTL 3600
+
+enum ox_vk_cache_state { OX_VK_CACHE_MISS, OX_VK_CACHE_FRESH, OX_VK_CACHE_STALE };
+
+/* dir NULL: "<XDG cache>/vk", created. NULL on failure. */
+struct ox_vk_cache *ox_vk_cache_open(const char *dir, long ttl_sec);
+/* Waits for a refresh in flight; queued ones are dropped. */
+void ox_vk_cache_close(struct ox_vk_cache *c);
+/* Wait until every queued refresh is done. */
+void ox_vk_cache_flush(struct ox_vk_cache *c);
+
+/* Cached body of method?params (params form-encoded, without the token),
+ * or NULL on a miss; never touches the network itself. malloc'd, with len. */
+char *ox_vk_cache_get(struct ox_vk_cache *c, const char *scope, const char *access_token, const char *method,
+                      const char *params, size_t *len, enum ox_vk_cache_state *state);
+/* ox_vk_cache_get, fetching and storing the response on a miss. */
+char *ox_vk_call_cached(struct ox_vk_cache *c, const char *scope, const char *access_token, const char *method,
+                        const char *params, size_t *len);
+/* ox_vk_get_audio through the cache. */
+char *ox_vk_get_audio_cached(struct ox_vk_cache *c, const char *scope, const char *access_token);
@@ -0,0 +1,100 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/meta.h"
+#include "../src/meta_id3.h"
+#include "fuzz/gen_tags.h"
+
+/* Metadata parser throughput over a generated corpus of realistic file prefixes
+ * (see fuzz/gen_tags.h). Usage: bench_meta [files_per_kind] [seconds_per_case] */
+
+static const char *const kind_names[GEN_KINDS] = {
+    "id3v2.3+mp3", "id3v2.4+mp3", "id3v2.2+mp3", "flac", "ogg vorbis", "ogg opus", "mp4", "id3v2.3 only",
+};
+
+struct corpus {
+    unsigned char **buf;
+    size_t *len;
+    size_t n, bytes;
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int add_kind(struct corpus *c, unsigned kind, size_t count)
+{
+    static unsigned char tmp[GEN_TAG_MAX];
+    for (size_t i = 0; i < count; ++i) {
+        size_t n = gen_tag(tmp, kind, (uint32_t)i);
+        unsigned char *copy = malloc(n);
+        unsigned char **nb = realloc(c->buf, (c->n + 1) * sizeof(*nb));
+        size_t *nl = realloc(c->len, (c->n + 1) * sizeof(*nl));
+        if (nb) c->buf = nb;
+        if (nl) c->len = nl;
+        if (!copy || !nb || !nl) { free(copy); return -1; }
+        memcpy(copy, tmp, n);
+        c->buf[c->n] = copy;
+        c->len[c->n++] = n;
+        c->bytes += n;
+    }
+    return 0;
+}
+
+static void free_corpus(struct corpus *c)
+{
+    for (size_t i = 0; i < c->n; ++i) free(c->buf[i]);
+    free(c->buf);
+    free(c->len);
+    memset(c, 0, sizeof(*c));
+}
+
+/* id3_only: the bare ID3v2 parser instead of the sniffing layer */
+static int run(const char *name, const struct corpus *c, int id3_only, double seconds)
+{
+    size_t files = 0, bytes = 0, ok = 0;
+    double t0 = now(), t;
+    struct ox_metadata m;
+    do {
+        for (size_t i = 0; i < c->n; ++i) {
+            int rc = id3_only ? ox_meta_id3_parse(c->buf[i], c->len[i], &m) : ox_meta_parse(c->buf[i], c->len[i], &m);
+            ok += rc == 0 && m.title[0];
+        }
+        files += c->n;
+        bytes += c->bytes;
+        t = now() - t0;
+    } while (t < seconds);
+    if (ok != files) {
+        fprintf(stderr, "%s: %zu of %zu inputs did not parse\n", name, files - ok, files);
+        return 1;
+    }
+    printf("%-16s %9.0f files/s %9.1f MB/s  (avg %zu bytes)\n", name, files / t, bytes / t / 1e6, c->bytes / c->n);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t per_kind = argc > 1 ? (size_t)atol(argv[1]) : 256;
+    double seconds = argc > 2 ? atof(argv[2]) : 0.3;
+    if (per_kind == 0) per_kind = 1;
+    int rc = 0;
+
+    struct corpus all = { 0 }, id3 = { 0 };
+    for (unsigned k = 0; k < GEN_KINDS; ++k) {
+        struct corpus one = { 0 };
+        if (add_kind(&one, k, per_kind) != 0 || add_kind(&all, k, per_kind) != 0) return 1;
+        if ((k <= 2 || k == 7) && add_kind(&id3, k, per_kind) != 0) return 1;
+        rc |= run(kind_names[k], &one, 0, seconds);
+        free_corpus(&one);
+    }
+    rc |= run("id3 parser only", &id3, 1, seconds);
+    rc |= run("all formats", &all, 0, seconds);
+    free_corpus(&id3);
+    free_corpus(&all);
+    return rc;
+}
@@ -0,0 +1,217 @@
+// fuzz_meta.c - fuzz target for every metadata parser (ID3v2, FLAC, Ogg, MP4, MPEG)
+// - libFuzzer: clang -fsanitize=fuzzer,address,undefined (make fuzz), entry point
+//   LLVMFuzzerTestOneInput; AFL++ can build the same file with afl-clang-fast
+// - without libFuzzer (-DOX_FUZZ_STANDALONE, make fuzz-replay) main() replays
+//   files/directories given as arguments, which is how the seed corpus and
+//   crash reproducers run under gcc sanitizers, and `-mutate N` runs a small
+//   built-in mutator for machines without clang
+// - each input is parsed twice: fully in memory, and through a memfd where only
+//   a short prefix is "already read" so the pread fallbacks are exercised too
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../../src/meta.h"
+#include "../../src/meta_id3.h"
+#include "gen_tags.h"
+
+static void run_src(const struct ox_meta_src *src)
+{
+    struct ox_metadata m;
+    enum ox_meta_format fmt;
+    struct ox_meta_picture pic;
+    ox_meta_read(src, &m, &fmt);
+    ox_meta_flac_picture(src, 0, &pic);
+    ox_meta_mp4_picture(src, 0, &pic);
+    ox_meta_mpeg_read(src, 0, &m);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    struct ox_metadata m;
+    ox_meta_id3_parse(data, size, &m);
+
+    struct ox_id3_tag tag;
+    if (ox_meta_id3_scan(data, size, &tag) == 0) {
+        char text[64];
+        const struct ox_id3_span *spans[] = { &tag.title, &tag.artist, &tag.album, &tag.comment };
+        for (size_t i = 0; i < sizeof(spans) / sizeof(spans[0]); ++i) ox_meta_id3_text(&tag, spans[i], text, sizeof(text));
+        if (tag.picture.len) {
+            volatile unsigned char sink = ox_meta_id3_span_ptr(&tag, &tag.picture)[tag.picture.len - 1];
+            (void)sink;
+        }
+        ox_meta_id3_release(&tag);
+    }
+
+    struct ox_meta_src mem = { data, size, -1, size };
+    run_src(&mem);
+
+    static int fd = -2;
+    if (fd == -2) fd = memfd_create("fuzz_meta", MFD_CLOEXEC);
+    if (fd >= 0 && ftruncate(fd, 0) == 0 && pwrite(fd, data, size, 0) == (ssize_t)size) {
+        struct ox_meta_src file = { data, size < 64 ? size : 64, fd, size };
+        run_src(&file);
+    }
+    return 0;
+}
+
+#ifdef OX_FUZZ_STANDALONE
+
+static unsigned char *read_all(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    unsigned char *buf = NULL;
+    size_t cap = 0, n = 0, r;
+    do {
+        if (n == cap) {
+            cap = cap ? cap * 2 : 65536;
+            unsigned char *nb = realloc(buf, cap);
+            if (!nb) { free(buf); fclose(f); return NULL; }
+            buf = nb;
+        }
+        r = fread(buf + n, 1, cap - n, f);
+        n += r;
+    } while (r > 0);
+    fclose(f);
+    *len = n;
+    return buf;
+}
+
+/* bit flips, interesting bytes, length-field smashing, truncation, chunk duplication */
+static size_t mutate(unsigned char *buf, size_t n, size_t cap, uint32_t *rng)
+{
+    static const unsigned char interesting[] = { 0x00, 0x01, 0x7F, 0x80, 0xFF, 0xFE };
+    int edits = 1 + (int)((*rng = *rng * 1664525u + 1013904223u) >> 28);
+    for (int e = 0; e < edits && n; ++e) {
+        uint32_t r = (*rng = *rng * 1664525u + 1013904223u) >> 8;
+        size_t at = r % n;
+        switch ((r >> 20) % 6) {
+        case 0: buf[at] ^= (unsigned char)(1u << (r & 7)); break;
+        case 1: buf[at] = interesting[r % sizeof(interesting)]; break;
+        case 2: if (at + 4 <= n) memset(buf + at, (r & 1) ? 0xFF : 0x00, 4); break;
+        case 3: n = at + 1; break;
+        case 4: if (at + 4 <= n) { buf[at] = 0x7F; buf[at + 1] = 0x7F; } break;
+        default: {
+            size_t len = 1 + r % 64, to = (r >> 6) % n;
+            unsigned char chunk[64];
+            if (at + len <= n && n + len <= cap) {
+                memcpy(chunk, buf + at, len);
+                memmove(buf + to + len, buf + to, n - to);
+                memcpy(buf + to, chunk, len);
+                n += len;
+            }
+        }
+        }
+    }
+    return n;
+}
+
+static size_t run_path(const char *path, unsigned char ***seeds, size_t **lens, size_t *nseeds)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    if (S_ISDIR(st.st_mode)) {
+        DIR *d = opendir(path);
+        struct dirent *e;
+        size_t n = 0;
+        while (d && (e = readdir(d))) {
+            if (e->d_name[0] == '.') continue;
+            char sub[4096];
+            snprintf(sub, sizeof(sub), "%s/%s", path, e->d_name);
+            n += run_path(sub, seeds, lens, nseeds);
+        }
+        if (d) closedir(d);
+        return n;
+    }
+    size_t len = 0;
+    unsigned char *buf = read_all(path, &len);
+    if (!buf) return 0;
+    LLVMFuzzerTestOneInput(buf, len);
+    unsigned char **ns = realloc(*seeds, (*nseeds + 1) * sizeof(**seeds));
+    size_t *nl = realloc(*lens, (*nseeds + 1) * sizeof(**lens));
+    if (ns) *seeds = ns;
+    if (nl) *lens = nl;
+    if (ns && nl) {
+        ns[*nseeds] = buf;
+        nl[(*nseeds)++] = len;
+    } else {
+        free(buf);
+    }
+    return 1;
+}
+
+static int make_corpus(const char *dir)
+{
+    static unsigned char buf[GEN_TAG_MAX];
+    mkdir(dir, 0755);
+    for (unsigned kind = 0; kind < GEN_KINDS; ++kind) {
+        for (uint32_t seed = 0; seed < 4; ++seed) {
+            size_t n = gen_tag(buf, kind, seed);
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/gen-%u-%u", dir, kind, (unsigned)seed);
+            FILE *f = fopen(path, "wb");
+            if (!f || fwrite(buf, 1, n, f) != n) { if (f) fclose(f); return 1; }
+            fclose(f);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 && strcmp(argv[1], "--make-corpus") == 0) return make_corpus(argv[2]);
+    long iterations = 0;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-mutate") == 0) {
+        iterations = atol(argv[2]);
+        first = 3;
+    }
+    unsigned char **seeds = NULL;
+    size_t *lens = NULL, nseeds = 0, ran = 0;
+    for (int i = first; i < argc; ++i) ran += run_path(argv[i], &seeds, &lens, &nseeds);
+    /* the generated seeds are always part of the set, so a bare run still covers every format */
+    static unsigned char gen[GEN_TAG_MAX];
+    for (unsigned kind = 0; kind < GEN_KINDS; ++kind) {
+        size_t n = gen_tag(gen, kind, kind);
+        LLVMFuzzerTestOneInput(gen, n);
+        unsigned char *copy = malloc(n);
+        unsigned char **ns = realloc(seeds, (nseeds + 1) * sizeof(*seeds));
+        size_t *nl = realloc(lens, (nseeds + 1) * sizeof(*lens));
+        if (ns) seeds = ns;
+        if (nl) lens = nl;
+        if (!copy || !ns || !nl) { free(copy); continue; }
+        memcpy(copy, gen, n);
+        seeds[nseeds] = copy;
+        lens[nseeds++] = n;
+        ran++;
+    }
+    printf("fuzz_meta: replayed %zu inputs\n", ran);
+
+    static unsigned char work[GEN_TAG_MAX * 2];
+    uint32_t rng = 0x9E3779B9u;
+    for (long it = 0; it < iterations && nseeds; ++it) {
+        size_t s = (size_t)it % nseeds, n = lens[s] < sizeof(work) / 2 ? lens[s] : sizeof(work) / 2;
+        memcpy(work, seeds[s], n);
+        n = mutate(work, n, sizeof(work), &rng);
+        /* exact-size heap copy so ASan catches reads one past the end */
+        unsigned char *exact = malloc(n ? n : 1);
+        if (!exact) break;
+        memcpy(exact, work, n);
+        LLVMFuzzerTestOneInput(exact, n);
+        free(exact);
+    }
+    if (iterations) printf("fuzz_meta: %ld mutated inputs OK\n", iterations);
+    for (size_t i = 0; i < nseeds; ++i) free(seeds[i]);
+    free(seeds);
+    free(lens);
+    return 0;
+}
+
+#endif
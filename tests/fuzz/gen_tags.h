@@ -0,0 +1,338 @@
+// gen_tags.h - deterministic generator of realistic tagged file prefixes
+// Shared by the seed corpus writer (fuzz_meta --make-corpus) and bench_meta.
+// Each kind mimics what common taggers/encoders emit: ID3v2.2/2.3/2.4 with the
+// usual text frames, comments, ReplayGain TXXX, padding and sometimes a cover;
+// FLAC, Ogg Vorbis/Opus and MP4 with their stream headers and comment blocks;
+// and MPEG audio frames after the tag. Buffers must hold GEN_TAG_MAX bytes.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define GEN_TAG_MAX (64 * 1024)
+#define GEN_KINDS 8
+
+static const char *const gen_words[] = {
+    "Love", "Night", "Blue", "Dancing", "Road", "Heart", "Fire", "Dream", "Город", "Ёлка",
+    "Beyoncé", "Sigur Rós", "Daft Punk", "Кино", "Motörhead", "Queen", "Homework", "Jazz",
+    "Straße", "Café", "遠い空", "Live", "Remastered", "Part II",
+};
+#define GEN_NWORDS (sizeof(gen_words) / sizeof(gen_words[0]))
+
+struct gen {
+    unsigned char *p;
+    size_t n;
+    uint32_t rng;
+};
+
+static uint32_t gen_rand(struct gen *g)
+{
+    g->rng = g->rng * 1664525u + 1013904223u;
+    return g->rng >> 8;
+}
+
+static void gen_bytes(struct gen *g, const void *d, size_t n)
+{
+    if (g->n + n > GEN_TAG_MAX) n = GEN_TAG_MAX - g->n;
+    memcpy(g->p + g->n, d, n);
+    g->n += n;
+}
+
+static void gen_fill(struct gen *g, int c, size_t n)
+{
+    if (g->n + n > GEN_TAG_MAX) n = GEN_TAG_MAX - g->n;
+    memset(g->p + g->n, c, n);
+    g->n += n;
+}
+
+static void gen_u8(struct gen *g, unsigned v) { unsigned char b = (unsigned char)v; gen_bytes(g, &b, 1); }
+static void gen_be32(struct gen *g, uint32_t v) { for (int i = 3; i >= 0; --i) gen_u8(g, v >> (8 * i)); }
+static void gen_le32(struct gen *g, uint32_t v) { for (int i = 0; i < 4; ++i) gen_u8(g, v >> (8 * i)); }
+static void gen_str(struct gen *g, const char *s) { gen_bytes(g, s, strlen(s)); }
+
+static void gen_set_be32(struct gen *g, size_t at, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) g->p[at + i] = (unsigned char)(v >> (24 - 8 * i));
+}
+
+/* "Word Word Word" (1-4 words) into out */
+static const char *gen_phrase(struct gen *g, char *out, size_t cap)
+{
+    int words = 1 + (int)(gen_rand(g) % 4);
+    out[0] = '\0';
+    for (int i = 0; i < words; ++i) {
+        size_t l = strlen(out);
+        snprintf(out + l, cap - l, "%s%s", i ? " " : "", gen_words[gen_rand(g) % GEN_NWORDS]);
+    }
+    return out;
+}
+
+/* ---- ID3v2 ---- */
+
+static void id3_frame_begin(struct gen *g, int version, const char *id, size_t *at)
+{
+    gen_bytes(g, id, version == 2 ? 3 : 4);
+    *at = g->n;
+    gen_fill(g, 0, version == 2 ? 3 : 6);
+}
+
+static void id3_frame_end(struct gen *g, int version, size_t at)
+{
+    size_t hdr = version == 2 ? 3 : 6;
+    uint32_t n = (uint32_t)(g->n - at - hdr);
+    if (version == 2) {
+        g->p[at] = (unsigned char)(n >> 16); g->p[at + 1] = (unsigned char)(n >> 8); g->p[at + 2] = (unsigned char)n;
+    } else if (version == 4) {
+        g->p[at] = (n >> 21) & 0x7F; g->p[at + 1] = (n >> 14) & 0x7F; g->p[at + 2] = (n >> 7) & 0x7F; g->p[at + 3] = n & 0x7F;
+    } else {
+        gen_set_be32(g, at, n);
+    }
+}
+
+/* Text frame: ISO-8859-1 when ASCII, else UTF-8 (v2.4) or UTF-16 with BOM. */
+static void id3_text(struct gen *g, int version, const char *id, const char *text)
+{
+    size_t at;
+    int ascii = 1;
+    for (const char *s = text; *s; ++s) ascii &= (unsigned char)*s < 0x80;
+    id3_frame_begin(g, version, id, &at);
+    if (ascii) {
+        gen_u8(g, 0);
+        gen_str(g, text);
+    } else if (version == 4) {
+        gen_u8(g, 3);
+        gen_str(g, text);
+    } else {
+        gen_u8(g, 1);
+        gen_u8(g, 0xFF); gen_u8(g, 0xFE);
+        const unsigned char *s = (const unsigned char *)text;
+        while (*s) { /* UTF-8 -> UTF-16LE, BMP only (all gen_words are) */
+            uint32_t c = *s++;
+            if (c >= 0xE0) { c = ((c & 0x0F) << 12) | ((s[0] & 0x3Fu) << 6) | (s[1] & 0x3Fu); s += 2; }
+            else if (c >= 0xC0) { c = ((c & 0x1F) << 6) | (s[0] & 0x3Fu); s += 1; }
+            gen_u8(g, c); gen_u8(g, c >> 8);
+        }
+    }
+    id3_frame_end(g, version, at);
+}
+
+static void gen_id3(struct gen *g, int version, int with_picture)
+{
+    static const char *const v2[] = { "TT2", "TP1", "TAL", "TRK", "TYE", "TCO", "COM", "TXX", "PIC" };
+    static const char *const v3[] = { "TIT2", "TPE1", "TALB", "TRCK", "TYER", "TCON", "COMM", "TXXX", "APIC" };
+    static const char *const v4[] = { "TIT2", "TPE1", "TALB", "TRCK", "TDRC", "TCON", "COMM", "TXXX", "APIC" };
+    const char *const *ids = version == 2 ? v2 : version == 3 ? v3 : v4;
+    char buf[256];
+    size_t start = g->n, at;
+    gen_str(g, "ID3");
+    gen_u8(g, (unsigned)version); gen_u8(g, 0); gen_u8(g, 0);
+    gen_fill(g, 0, 4);
+    id3_text(g, version, ids[0], gen_phrase(g, buf, sizeof(buf)));
+    id3_text(g, version, ids[1], gen_phrase(g, buf, sizeof(buf)));
+    id3_text(g, version, ids[2], gen_phrase(g, buf, sizeof(buf)));
+    snprintf(buf, sizeof(buf), "%u/%u", 1 + gen_rand(g) % 12, 12u);
+    id3_text(g, version, ids[3], buf);
+    snprintf(buf, sizeof(buf), version == 4 ? "%u-05-01" : "%u", 1960 + gen_rand(g) % 65);
+    id3_text(g, version, ids[4], buf);
+    id3_text(g, version, ids[5], gen_rand(g) & 1 ? "(17)Rock" : "Electronic");
+    id3_frame_begin(g, version, ids[6], &at);
+    gen_u8(g, 0); gen_str(g, "eng"); gen_u8(g, 0);
+    gen_fill(g, 'c', 20 + gen_rand(g) % 200);
+    id3_frame_end(g, version, at);
+    id3_frame_begin(g, version, ids[7], &at);
+    gen_u8(g, 0); gen_str(g, "REPLAYGAIN_TRACK_GAIN"); gen_u8(g, 0);
+    snprintf(buf, sizeof(buf), "-%u.%02u dB", gen_rand(g) % 12, gen_rand(g) % 100);
+    gen_str(g, buf);
+    id3_frame_end(g, version, at);
+    if (with_picture) {
+        id3_frame_begin(g, version, ids[8], &at);
+        gen_u8(g, 0);
+        if (version == 2) gen_str(g, "JPG");
+        else { gen_str(g, "image/jpeg"); gen_u8(g, 0); }
+        gen_u8(g, 3); gen_u8(g, 0);
+        gen_bytes(g, "\xFF\xD8\xFF\xE0", 4);
+        size_t len = 4096 + gen_rand(g) % 16384;
+        for (size_t i = 0; i < len; ++i) gen_u8(g, gen_rand(g));
+        id3_frame_end(g, version, at);
+    }
+    gen_fill(g, 0, gen_rand(g) % 1024); /* padding */
+    uint32_t body = (uint32_t)(g->n - start - 10);
+    g->p[start + 6] = (body >> 21) & 0x7F; g->p[start + 7] = (body >> 14) & 0x7F;
+    g->p[start + 8] = (body >> 7) & 0x7F; g->p[start + 9] = body & 0x7F;
+}
+
+/* MPEG-1 Layer III 44.1 kHz 128 kbps frames */
+static void gen_mp3_frames(struct gen *g, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        int pad = i % 3 == 0;
+        gen_u8(g, 0xFF); gen_u8(g, 0xFB); gen_u8(g, 0x90 | (pad << 1)); gen_u8(g, 0x64);
+        gen_fill(g, 0x55, 413 + (size_t)pad);
+    }
+}
+
+/* ---- Vorbis comments ---- */
+
+static void gen_vc_entry(struct gen *g, const char *name, const char *value)
+{
+    gen_le32(g, (uint32_t)(strlen(name) + 1 + strlen(value)));
+    gen_str(g, name); gen_u8(g, '='); gen_str(g, value);
+}
+
+static void gen_vorbis_comment(struct gen *g)
+{
+    char buf[256], num[16];
+    gen_le32(g, 13); gen_str(g, "reference lib");
+    gen_le32(g, 7);
+    gen_vc_entry(g, "TITLE", gen_phrase(g, buf, sizeof(buf)));
+    gen_vc_entry(g, "ARTIST", gen_phrase(g, buf, sizeof(buf)));
+    gen_vc_entry(g, "ALBUM", gen_phrase(g, buf, sizeof(buf)));
+    snprintf(num, sizeof(num), "%u", 1 + gen_rand(g) % 20);
+    gen_vc_entry(g, "TRACKNUMBER", num);
+    snprintf(num, sizeof(num), "%u", 1960 + gen_rand(g) % 65);
+    gen_vc_entry(g, "DATE", num);
+    gen_vc_entry(g, "GENRE", "Rock");
+    gen_vc_entry(g, "REPLAYGAIN_TRACK_GAIN", "-7.25 dB");
+}
+
+static void gen_flac(struct gen *g)
+{
+    gen_str(g, "fLaC");
+    gen_u8(g, 0); gen_u8(g, 0); gen_u8(g, 0); gen_u8(g, 34);
+    gen_fill(g, 0, 10);
+    /* 44100 Hz, 2 channels, 16 bit, 10 s */
+    gen_bytes(g, "\x0A\xC4\x42\xF0\x00\x06\xBA\xA8", 8);
+    gen_fill(g, 0, 16);
+    gen_u8(g, 4);
+    size_t at = g->n;
+    gen_fill(g, 0, 3);
+    gen_vorbis_comment(g);
+    uint32_t n = (uint32_t)(g->n - at - 3);
+    g->p[at] = (unsigned char)(n >> 16); g->p[at + 1] = (unsigned char)(n >> 8); g->p[at + 2] = (unsigned char)n;
+    gen_u8(g, 0x81); gen_u8(g, 0); gen_u8(g, 0x10); gen_u8(g, 0); /* 4 KiB padding */
+    gen_fill(g, 0, 4096);
+    gen_u8(g, 0xFF); gen_u8(g, 0xF8);
+    gen_fill(g, 0x11, 2048);
+}
+
+/* ---- Ogg ---- */
+
+static void gen_ogg_page(struct gen *g, int flags, uint64_t granule, const unsigned char *data, size_t n)
+{
+    size_t nseg = n / 255 + 1;
+    gen_str(g, "OggS"); gen_u8(g, 0); gen_u8(g, (unsigned)flags);
+    for (int i = 0; i < 8; ++i) gen_u8(g, (unsigned)(granule >> (8 * i)));
+    gen_le32(g, 0x2A); gen_le32(g, 0); gen_le32(g, 0);
+    gen_u8(g, (unsigned)nseg);
+    for (size_t i = 0; i < nseg; ++i) gen_u8(g, i + 1 < nseg ? 255 : (unsigned)(n % 255));
+    gen_bytes(g, data, n);
+}
+
+static void gen_ogg(struct gen *g, int opus)
+{
+    unsigned char pkt[4096];
+    struct gen c = { pkt, 0, g->rng };
+    if (opus) {
+        gen_ogg_page(g, 0x02, 0, (const unsigned char *)"OpusHead\x01\x02\x38\x01\x44\xAC\0\0\0\0\0\0\0", 19);
+        gen_str(&c, "OpusTags");
+    } else {
+        gen_ogg_page(g, 0x02, 0,
+                     (const unsigned char *)"\x01vorbis\0\0\0\0\x02\x44\xAC\0\0\0\0\0\0\0\xEE\x02\0\0\0\0\0\0\xB8\x01", 30);
+        gen_str(&c, "\x03vorbis");
+    }
+    gen_vorbis_comment(&c);
+    if (!opus) gen_u8(&c, 1);
+    g->rng = c.rng;
+    gen_ogg_page(g, 0, 0, pkt, c.n);
+    gen_ogg_page(g, 0x04, opus ? 312 + 48000ull * 180 : 44100ull * 180, (const unsigned char *)"audio", 5);
+}
+
+/* ---- MP4 ---- */
+
+static size_t mp4_begin(struct gen *g, const char *type)
+{
+    size_t at = g->n;
+    gen_be32(g, 0);
+    gen_str(g, type);
+    return at;
+}
+
+static void mp4_end(struct gen *g, size_t at) { gen_set_be32(g, at, (uint32_t)(g->n - at)); }
+
+static void mp4_item(struct gen *g, const char *type, int kind, const void *v, size_t n)
+{
+    size_t item = mp4_begin(g, type), data = mp4_begin(g, "data");
+    gen_be32(g, (uint32_t)kind); gen_be32(g, 0);
+    gen_bytes(g, v, n);
+    mp4_end(g, data);
+    mp4_end(g, item);
+}
+
+static void gen_mp4(struct gen *g)
+{
+    char buf[256];
+    size_t b = mp4_begin(g, "ftyp");
+    gen_str(g, "M4A "); gen_be32(g, 0); gen_str(g, "isomM4A ");
+    mp4_end(g, b);
+    size_t moov = mp4_begin(g, "moov");
+    b = mp4_begin(g, "mvhd");
+    gen_fill(g, 0, 12); gen_be32(g, 1000); gen_be32(g, 215000); gen_fill(g, 0, 80);
+    mp4_end(g, b);
+    size_t trak = mp4_begin(g, "trak"), mdia = mp4_begin(g, "mdia");
+    b = mp4_begin(g, "mdhd");
+    gen_fill(g, 0, 12); gen_be32(g, 44100); gen_be32(g, 44100u * 215); gen_fill(g, 0, 4);
+    mp4_end(g, b);
+    b = mp4_begin(g, "hdlr");
+    gen_fill(g, 0, 8); gen_str(g, "soun"); gen_fill(g, 0, 13);
+    mp4_end(g, b);
+    size_t minf = mp4_begin(g, "minf"), stbl = mp4_begin(g, "stbl"), stsd = mp4_begin(g, "stsd");
+    gen_be32(g, 0); gen_be32(g, 1);
+    b = mp4_begin(g, "mp4a");
+    gen_fill(g, 0, 16); gen_u8(g, 0); gen_u8(g, 2); gen_u8(g, 0); gen_u8(g, 16);
+    gen_fill(g, 0, 4); gen_u8(g, 0xAC); gen_u8(g, 0x44); gen_u8(g, 0); gen_u8(g, 0);
+    mp4_end(g, b);
+    mp4_end(g, stsd); mp4_end(g, stbl); mp4_end(g, minf); mp4_end(g, mdia); mp4_end(g, trak);
+    size_t udta = mp4_begin(g, "udta"), meta = mp4_begin(g, "meta");
+    gen_be32(g, 0);
+    b = mp4_begin(g, "hdlr");
+    gen_fill(g, 0, 8); gen_str(g, "mdirappl"); gen_fill(g, 0, 9);
+    mp4_end(g, b);
+    size_t ilst = mp4_begin(g, "ilst");
+    gen_phrase(g, buf, sizeof(buf)); mp4_item(g, "\xA9nam", 1, buf, strlen(buf));
+    gen_phrase(g, buf, sizeof(buf)); mp4_item(g, "\xA9" "ART", 1, buf, strlen(buf));
+    gen_phrase(g, buf, sizeof(buf)); mp4_item(g, "\xA9" "alb", 1, buf, strlen(buf));
+    mp4_item(g, "trkn", 0, "\0\0\0\x03\0\x0C\0\0", 8);
+    mp4_item(g, "\xA9" "day", 1, "2011", 4);
+    if (gen_rand(g) & 1) {
+        size_t len = 2048 + gen_rand(g) % 8192;
+        size_t item = mp4_begin(g, "covr"), data = mp4_begin(g, "data");
+        gen_be32(g, 13); gen_be32(g, 0);
+        gen_bytes(g, "\xFF\xD8\xFF\xE0", 4);
+        for (size_t i = 0; i < len; ++i) gen_u8(g, gen_rand(g));
+        mp4_end(g, data); mp4_end(g, item);
+    }
+    mp4_end(g, ilst); mp4_end(g, meta); mp4_end(g, udta); mp4_end(g, moov);
+    b = mp4_begin(g, "mdat");
+    gen_fill(g, 0x21, 4096);
+    mp4_end(g, b);
+}
+
+/* Fill buf with file prefix number `seed` of the given kind (0..GEN_KINDS-1); returns its length. */
+static size_t gen_tag(unsigned char *buf, unsigned kind, uint32_t seed)
+{
+    struct gen g = { buf, 0, seed * 2654435761u + kind };
+    switch (kind % GEN_KINDS) {
+    case 0: gen_id3(&g, 3, (seed & 3) == 0); gen_mp3_frames(&g, 8); break;
+    case 1: gen_id3(&g, 4, (seed & 3) == 1); gen_mp3_frames(&g, 8); break;
+    case 2: gen_id3(&g, 2, 0); gen_mp3_frames(&g, 4); break;
+    case 3: gen_flac(&g); break;
+    case 4: gen_ogg(&g, 0); break;
+    case 5: gen_ogg(&g, 1); break;
+    case 6: gen_mp4(&g); break;
+    default: gen_id3(&g, 3, 0); break; /* tag only: parse without audio */
+    }
+    return g.n;
+}
@@ -0,0 +1,91 @@
+// http_stub.c - loopback HTTP/1.1 server for the tests (see http_stub.h)
+#define _POSIX_C_SOURCE 200809L
+#include "http_stub.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct conn {
+    struct http_stub *stub;
+    int fd;
+};
+
+int http_stub_send_all(int fd, const void *p, size_t n)
+{
+    const char *c = p;
+    while (n) {
+        ssize_t w = send(fd, c, n, MSG_NOSIGNAL);
+        if (w <= 0) return -1;
+        c += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static void *serve_conn(void *arg)
+{
+    struct conn c = *(struct conn *)arg;
+    free(arg);
+    char req[4096];
+    size_t have = 0;
+    for (;;) {
+        ssize_t r = recv(c.fd, req + have, sizeof(req) - 1 - have, 0);
+        if (r <= 0) break;
+        have += (size_t)r;
+        req[have] = '\0';
+        char *end = strstr(req, "\r\n\r\n");
+        if (!end) {
+            if (have == sizeof(req) - 1) break;
+            continue;
+        }
+        atomic_fetch_add(&c.stub->requests, 1);
+        if (c.stub->handler(c.fd, req, c.stub->user) != 0) break;
+        size_t used = (size_t)(end + 4 - req);
+        memmove(req, req + used, have - used);
+        have -= used;
+    }
+    close(c.fd);
+    return NULL;
+}
+
+static void *serve(void *arg)
+{
+    struct http_stub *stub = arg;
+    for (;;) {
+        int fd = accept(stub->fd, NULL, NULL);
+        if (fd < 0) break;
+        atomic_fetch_add(&stub->connections, 1);
+        struct conn *c = malloc(sizeof(*c));
+        pthread_t t;
+        if (c) *c = (struct conn){ stub, fd };
+        if (c && pthread_create(&t, NULL, serve_conn, c) == 0) {
+            pthread_detach(t);
+        } else {
+            free(c);
+            close(fd);
+        }
+    }
+    return NULL;
+}
+
+int http_stub_start(struct http_stub *stub, http_stub_handler handler, void *user)
+{
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(a);
+    stub->handler = handler;
+    stub->user = user;
+    stub->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (stub->fd < 0 || bind(stub->fd, (struct sockaddr *)&a, sizeof(a)) != 0 || listen(stub->fd, 16) != 0 ||
+        getsockname(stub->fd, (struct sockaddr *)&a, &len) != 0)
+        return -1;
+    stub->port = ntohs(a.sin_port);
+    pthread_t t;
+    if (pthread_create(&t, NULL, serve, stub) != 0) return -1;
+    pthread_detach(t);
+    return 0;
+}
@@ -0,0 +1,26 @@
+// http_stub.h - loopback HTTP/1.1 server for the tests that talk to one
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/* Answer one request. req is its head (request line and headers,
+ * NUL-terminated); write the whole response to fd. Return 0 to keep the
+ * connection for the next request, anything else to close it. */
+typedef int (*http_stub_handler)(int fd, const char *req, void *user);
+
+/* Listens on 127.0.0.1 at an ephemeral port, one thread per connection,
+ * keep-alive. The counters may be reset by the test between cases. */
+struct http_stub {
+    int fd;
+    int port;
+    http_stub_handler handler;
+    void *user;
+    _Atomic int connections;
+    _Atomic int requests;
+};
+
+/* 0, or -1 if the socket or the accept thread could not be set up. */
+int http_stub_start(struct http_stub *stub, http_stub_handler handler, void *user);
+/* send(2) until done; 0 or -1. */
+int http_stub_send_all(int fd, const void *p, size_t n);
@@ -0,0 +1,267 @@
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../src/art.h"
+#include "../src/meta.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+#define IMG_W 300
+#define IMG_H 200
+
+static void put_be32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >> 24); p[1] = (unsigned char)(v >> 16); p[2] = (unsigned char)(v >> 8); p[3] = (unsigned char)v;
+}
+
+static uint32_t crc32(const unsigned char *p, size_t n)
+{
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < n; ++i) {
+        c ^= p[i];
+        for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+    }
+    return ~c;
+}
+
+static size_t put_chunk(unsigned char *buf, size_t pos, const char *type, const unsigned char *data, size_t n)
+{
+    put_be32(buf + pos, (uint32_t)n);
+    memcpy(buf + pos + 4, type, 4);
+    if (n) memcpy(buf + pos + 8, data, n);
+    put_be32(buf + pos + 8 + n, crc32(buf + pos + 4, n + 4));
+    return pos + 12 + n;
+}
+
+/* RGBA PNG, left half red, right half blue; zlib "stored" blocks keep it dependency-free. */
+static unsigned char *make_png(size_t *len)
+{
+    size_t raw_len = (size_t)IMG_H * (1 + IMG_W * 4);
+    unsigned char *raw = malloc(raw_len);
+    for (int y = 0; y < IMG_H; ++y) {
+        unsigned char *row = raw + (size_t)y * (1 + IMG_W * 4);
+        row[0] = 0;
+        for (int x = 0; x < IMG_W; ++x) {
+            unsigned char *px = row + 1 + x * 4;
+            px[0] = x < IMG_W / 2 ? 255 : 0; px[1] = 0; px[2] = x < IMG_W / 2 ? 0 : 255; px[3] = 255;
+        }
+    }
+    size_t zcap = raw_len + raw_len / 65535 * 5 + 16;
+    unsigned char *z = malloc(zcap);
+    size_t zl = 0;
+    z[zl++] = 0x78; z[zl++] = 0x01;
+    for (size_t off = 0; off < raw_len;) {
+        size_t n = raw_len - off > 65535 ? 65535 : raw_len - off;
+        z[zl++] = off + n == raw_len;
+        z[zl++] = (unsigned char)n; z[zl++] = (unsigned char)(n >> 8);
+        z[zl++] = (unsigned char)~n; z[zl++] = (unsigned char)(~n >> 8);
+        memcpy(z + zl, raw + off, n); zl += n; off += n;
+    }
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < raw_len; ++i) { a = (a + raw[i]) % 65521; b = (b + a) % 65521; }
+    put_be32(z + zl, (b << 16) | a); zl += 4;
+
+    unsigned char *png = malloc(zl + 64);
+    memcpy(png, "\x89PNG\r\n\x1a\n", 8);
+    unsigned char ihdr[13] = { 0 };
+    put_be32(ihdr, IMG_W); put_be32(ihdr + 4, IMG_H); ihdr[8] = 8; ihdr[9] = 6; /* 8-bit RGBA */
+    size_t pos = put_chunk(png, 8, "IHDR", ihdr, 13);
+    pos = put_chunk(png, pos, "IDAT", z, zl);
+    pos = put_chunk(png, pos, "IEND", NULL, 0);
+    free(raw); free(z);
+    *len = pos;
+    return png;
+}
+
+static int write_file(const char *path, const unsigned char *a, size_t an, const unsigned char *b, size_t bn)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    fwrite(a, 1, an, f);
+    if (bn) fwrite(b, 1, bn, f);
+    return fclose(f);
+}
+
+/* fLaC + STREAMINFO + PICTURE (front cover) + a little "audio" */
+static int write_flac(const char *path, const unsigned char *png, size_t n)
+{
+    unsigned char hdr[4 + 4 + 34 + 4 + 64] = { 0 };
+    size_t pos = 4;
+    memcpy(hdr, "fLaC", 4);
+    hdr[pos] = 0; hdr[pos + 3] = 34; pos += 4 + 34;
+    size_t body = 4 + 4 + 9 + 4 + 16 + 4 + n;
+    hdr[pos] = 0x80 | 6; hdr[pos + 1] = (unsigned char)(body >> 16); hdr[pos + 2] = (unsigned char)(body >> 8); hdr[pos + 3] = (unsigned char)body; pos += 4;
+    put_be32(hdr + pos, 3); pos += 4;
+    put_be32(hdr + pos, 9); memcpy(hdr + pos + 4, "image/png", 9); pos += 13;
+    put_be32(hdr + pos, 0); pos += 4;
+    put_be32(hdr + pos, IMG_W); put_be32(hdr + pos + 4, IMG_H); put_be32(hdr + pos + 8, 32); put_be32(hdr + pos + 12, 0); pos += 16;
+    put_be32(hdr + pos, (uint32_t)n); pos += 4;
+    unsigned char *all = malloc(pos + n + 100);
+    memcpy(all, hdr, pos); memcpy(all + pos, png, n); memset(all + pos + n, 0, 100);
+    int rc = write_file(path, all, pos + n + 100, NULL, 0);
+    free(all);
+    return rc;
+}
+
+/* ID3v2.3 with an APIC frame */
+static int write_mp3(const char *path, const unsigned char *png, size_t n)
+{
+    static const unsigned char apic[] = "\0image/png\0\3\0"; /* encoding, mime, type, empty description */
+    size_t fl = sizeof(apic) - 1 + n, body = 10 + fl;
+    unsigned char *buf = malloc(10 + body);
+    memcpy(buf, "ID3\3\0\0", 6);
+    buf[6] = (body >> 21) & 0x7F; buf[7] = (body >> 14) & 0x7F; buf[8] = (body >> 7) & 0x7F; buf[9] = body & 0x7F;
+    memcpy(buf + 10, "APIC", 4); put_be32(buf + 14, (uint32_t)fl); buf[18] = buf[19] = 0;
+    memcpy(buf + 20, apic, sizeof(apic) - 1);
+    memcpy(buf + 20 + sizeof(apic) - 1, png, n);
+    int rc = write_file(path, buf, 10 + body, NULL, 0);
+    free(buf);
+    return rc;
+}
+
+static size_t box(unsigned char *buf, size_t start, const char *type, size_t len)
+{
+    put_be32(buf + start, (uint32_t)len);
+    memcpy(buf + start + 4, type, 4);
+    return start + 8;
+}
+
+/* ftyp + moov/udta/meta/ilst/covr/data (type 14 = PNG) */
+static int write_m4a(const char *path, const unsigned char *png, size_t n)
+{
+    size_t data = 16 + n, covr = 8 + data, ilst = 8 + covr, meta = 12 + ilst, udta = 8 + meta, moov = 8 + udta;
+    unsigned char *buf = calloc(1, 16 + moov);
+    size_t pos = box(buf, 0, "ftyp", 16);
+    memcpy(buf + pos, "M4A \0\0\0\0", 8);
+    pos = box(buf, 16, "moov", moov);
+    pos = box(buf, pos, "udta", udta);
+    pos = box(buf, pos, "meta", meta) + 4;
+    pos = box(buf, pos, "ilst", ilst);
+    pos = box(buf, pos, "covr", covr);
+    pos = box(buf, pos, "data", data);
+    buf[pos + 3] = 14; pos += 8;
+    memcpy(buf + pos, png, n);
+    int rc = write_file(path, buf, 16 + moov, NULL, 0);
+    free(buf);
+    return rc;
+}
+
+static int same_bytes(const char *path, const unsigned char *png, size_t n)
+{
+    size_t len = 0;
+    unsigned char *got = ox_meta_picture_file(path, &len);
+    int ok = got && len == n && memcmp(got, png, n) == 0;
+    free(got);
+    return ok;
+}
+
+static int is_red(const unsigned char *p) { return p[0] == 255 && p[1] == 0 && p[2] == 0 && p[3] == 255; }
+static int is_blue(const unsigned char *p) { return p[0] == 0 && p[1] == 0 && p[2] == 255 && p[3] == 255; }
+
+static size_t count_thumbs(const char *dir)
+{
+    size_t n = 0;
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    while (d && (e = readdir(d))) n += strstr(e->d_name, ".thumb") != NULL;
+    if (d) closedir(d);
+    return n;
+}
+
+int main(void)
+{
+    char root[] = "/tmp/oxxy_art_XXXXXX";
+    if (!mkdtemp(root)) return 1;
+    char flac[512], mp3[512], m4a[512], bare[512], cover[512], cache[512], album[512];
+    snprintf(flac, sizeof(flac), "%s/a.flac", root);
+    snprintf(mp3, sizeof(mp3), "%s/b.mp3", root);
+    snprintf(m4a, sizeof(m4a), "%s/c.m4a", root);
+    snprintf(album, sizeof(album), "%s/album", root); mkdir(album, 0700);
+    snprintf(bare, sizeof(bare), "%s/album/d.mp3", root);
+    snprintf(cover, sizeof(cover), "%s/album/Cover.PNG", root);
+    snprintf(cache, sizeof(cache), "%s/cache", root); mkdir(cache, 0700);
+
+    size_t n;
+    unsigned char *png = make_png(&n);
+    CHECK(write_flac(flac, png, n) == 0 && write_mp3(mp3, png, n) == 0 && write_m4a(m4a, png, n) == 0);
+    CHECK(write_file(bare, (const unsigned char *)"ID3\3\0\0\0\0\0\0", 10, NULL, 0) == 0);
+    CHECK(write_file(cover, png, n, NULL, 0) == 0);
+
+    /* extraction */
+    CHECK(same_bytes(flac, png, n));
+    CHECK(same_bytes(mp3, png, n));
+    CHECK(same_bytes(m4a, png, n));
+    size_t len = 0;
+    unsigned char *folder = ox_art_source(bare, &len);
+    CHECK(folder && len == n && memcmp(folder, png, n) == 0);
+    free(folder);
+
+    if (!ox_image_can_decode(png, n)) {
+        printf("test_art: libpng16 not available, skipping decode checks\n");
+        free(png);
+        return 0;
+    }
+
+    /* decode + square thumbnail of the centred crop */
+    struct ox_image img, th;
+    CHECK(ox_image_decode(png, n, 0, &img) == 0 && img.w == IMG_W && img.h == IMG_H);
+    CHECK(ox_image_thumbnail(&img, 64, &th) == 0 && th.w == 64 && th.h == 64);
+    CHECK(is_red(th.rgba) && is_blue(th.rgba + 63 * 4) && is_red(th.rgba + (63 * 64) * 4));
+    ox_image_free(&th);
+    ox_image_free(&img);
+
+    /* one decode fills every size; all four tracks share the same content-hashed entries */
+    CHECK(ox_art_load(cache, flac, 100, &th) == 0 && th.w == 128);
+    ox_image_free(&th);
+    CHECK(count_thumbs(cache) == OX_ART_NUM_SIZES);
+    CHECK(ox_art_load(cache, m4a, 64, &th) == 0 && th.w == 64 && is_red(th.rgba));
+    ox_image_free(&th);
+    CHECK(ox_art_load(cache, bare, 256, &th) == 0 && th.w == 256);
+    ox_image_free(&th);
+    CHECK(count_thumbs(cache) == OX_ART_NUM_SIZES);
+
+    /* async path: duplicates collapse, tracks without art report rgba == NULL */
+    char none[512];
+    snprintf(none, sizeof(none), "%s/none.ogg", root);
+    CHECK(write_file(none, (const unsigned char *)"OggS", 4, NULL, 0) == 0);
+    struct ox_art_cache *c = ox_art_cache_create(cache, 2);
+    CHECK(c);
+    CHECK(ox_art_request(c, mp3, 64, NULL) == 0 && ox_art_request(c, mp3, 64, NULL) == 0);
+    CHECK(ox_art_request(c, none, 64, (void *)1) == 0);
+    struct ox_art_thumb got[4];
+    size_t ngot = 0;
+    for (int i = 0; i < 2000 && ngot < 2; ++i) {
+        ngot += ox_art_poll(c, got + ngot, 4 - ngot);
+        if (ngot < 2) nanosleep(&(struct timespec){ 0, 1000000 }, NULL);
+    }
+    CHECK(ngot == 2 && ox_art_pending(c) == 0 && ox_art_poll(c, got + 2, 2) == 0);
+    for (size_t i = 0; i < ngot; ++i) {
+        if (got[i].user) CHECK(strcmp(got[i].path, none) == 0 && !got[i].img.rgba);
+        else CHECK(strcmp(got[i].path, mp3) == 0 && got[i].img.w == 64 && is_blue(got[i].img.rgba + 63 * 4));
+        ox_art_thumb_free(&got[i]);
+    }
+    ox_art_cache_destroy(c);
+
+    /* thumbnail throughput from cold (decode) and warm (cache file) */
+    char cold[512];
+    snprintf(cold, sizeof(cold), "%s/cold", root); mkdir(cold, 0700);
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    CHECK(ox_art_load(cold, flac, 256, &th) == 0);
+    ox_image_free(&th);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int i = 0; i < 100; ++i) { CHECK(ox_art_load(cold, flac, 256, &th) == 0); ox_image_free(&th); }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    printf("art: cold decode %.2f ms, cached %.3f ms\n",
+           ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e6,
+           ((t2.tv_sec - t1.tv_sec) * 1e9 + (t2.tv_nsec - t1.tv_nsec)) / 1e6 / 100);
+
+    free(png);
+    printf("test_art OK\n");
+    return 0;
+}
@@ -0,0 +1,175 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/engine_ipc.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+static char last_cmd[64], last_arg[OX_ENGINE_URI_MAX];
+
+static int on_command(void *user, const char *cmd, const char *arg, char *reply, size_t reply_len)
+{
+    int *count = user;
+    ++*count;
+    snprintf(last_cmd, sizeof(last_cmd), "%s", cmd);
+    snprintf(last_arg, sizeof(last_arg), "%s", arg);
+    if (strcmp(cmd, "ping") == 0) {
+        snprintf(reply, reply_len, "pong %s", arg);
+        return 0;
+    }
+    if (strcmp(cmd, "play") == 0) return 0;
+    if (strcmp(cmd, "seek") == 0) { /* like the engine, for a 300 s track */
+        double v;
+        if (ox_engine_parse_number(arg, 300.0, &v) != 0) {
+            snprintf(reply, reply_len, "seek needs a number");
+            return -1;
+        }
+        snprintf(reply, reply_len, "%.1f", v);
+        return 0;
+    }
+    snprintf(reply, reply_len, "unknown command");
+    return -1;
+}
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+static void *publish_later(void *arg)
+{
+    struct ox_engine_server *s = arg;
+    sleep_ms(50);
+    float p = 0.5f;
+    ox_engine_publish_peaks(s, &p, 1);
+    return NULL;
+}
+
+int main(void)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/oxxy_test_engine_%ld.sock", (long)getpid());
+    int commands = 0;
+
+    CHECK(ox_engine_connect(path) == NULL);
+    struct ox_engine_server *s = ox_engine_server_create(path, on_command, &commands);
+    CHECK(s);
+    /* one engine per socket */
+    CHECK(ox_engine_server_create(path, on_command, &commands) == NULL);
+
+    struct ox_engine_client *a = ox_engine_connect(path), *b = ox_engine_connect(path);
+    CHECK(a && b);
+
+    /* commands */
+    char reply[OX_ENGINE_LINE_MAX];
+    CHECK(ox_engine_command(a, "ping hello world", reply, sizeof(reply)) == 0);
+    CHECK(strcmp(reply, "pong hello world") == 0);
+    CHECK(strcmp(last_cmd, "ping") == 0 && strcmp(last_arg, "hello world") == 0);
+    CHECK(ox_engine_command(b, "play", reply, sizeof(reply)) == 0 && reply[0] == '\0');
+    CHECK(strcmp(last_arg, "") == 0);
+    CHECK(ox_engine_command(a, "dance", reply, sizeof(reply)) == -1);
+    CHECK(strcmp(reply, "unknown command") == 0);
+    CHECK(ox_engine_command(a, "two\nlines", NULL, 0) == -1);
+    CHECK(commands == 3);
+
+    /* numbers: finite and non-negative, clamped to the limit */
+    CHECK(ox_engine_command(a, "seek 12.5", reply, sizeof(reply)) == 0 && strcmp(reply, "12.5") == 0);
+    CHECK(ox_engine_command(a, "seek 1e300", reply, sizeof(reply)) == 0 && strcmp(reply, "300.0") == 0);
+    CHECK(ox_engine_command(a, "seek nan", reply, sizeof(reply)) == -1);
+    CHECK(strcmp(reply, "seek needs a number") == 0);
+    const char *bad[] = { "", "inf", "-inf", "-1", "1e999", "3x", "nan(1)", "abc" };
+    double v = -1.0;
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) CHECK(ox_engine_parse_number(bad[i], 1.0, &v) == -1);
+    CHECK(v == -1.0);
+    CHECK(ox_engine_parse_number("0.25 ", 1.0, &v) == 0 && v == 0.25);
+    CHECK(ox_engine_parse_number("7", 1.0, &v) == 0 && v == 1.0);
+    CHECK(ox_engine_server_clients(s) == 2);
+
+    /* nothing published yet */
+    struct ox_engine_state st;
+    float bands[OX_ENGINE_BANDS];
+    CHECK(ox_engine_read_state(a, &st) == -1);
+    CHECK(ox_engine_read_spectrum(a, bands) == -1);
+    uint64_t ca = 0, cb = 0;
+    float out[OX_ENGINE_PEAKS];
+    CHECK(ox_engine_read_peaks(a, &ca, out, OX_ENGINE_PEAKS) == 0);
+
+    /* every reader sees every peak, each at its own pace */
+    float in[1000];
+    for (int i = 0; i < 1000; ++i) in[i] = (float)i / 1000.0f;
+    ox_engine_publish_peaks(s, in, 1000);
+    CHECK(ox_engine_read_peaks(a, &ca, out, 600) == 600 && ca == 600);
+    CHECK(out[0] == in[0] && out[599] == in[599]);
+    CHECK(ox_engine_read_peaks(a, &ca, out, 600) == 400 && ca == 1000 && out[399] == in[999]);
+    CHECK(ox_engine_read_peaks(b, &cb, out, OX_ENGINE_PEAKS) == 1000 && cb == 1000);
+    CHECK(memcmp(out, in, sizeof(in)) == 0);
+
+    /* a reader that fell a whole ring behind skips to the oldest peak kept */
+    for (int k = 0; k < OX_ENGINE_PEAKS / 1000 + 2; ++k) ox_engine_publish_peaks(s, in, 1000);
+    size_t n = ox_engine_read_peaks(b, &cb, out, OX_ENGINE_PEAKS);
+    CHECK(n == OX_ENGINE_PEAKS && out[n - 1] == in[999]);
+    CHECK(ox_engine_read_peaks(b, &cb, out, OX_ENGINE_PEAKS) == 0);
+
+    /* snapshots */
+    memset(&st, 0, sizeof(st));
+    st.position = 12.5;
+    st.playing = 1;
+    st.count = 3;
+    snprintf(st.uri, sizeof(st.uri), "/music/a.flac");
+    ox_engine_publish_state(s, &st);
+    for (int i = 0; i < OX_ENGINE_BANDS; ++i) bands[i] = (float)i;
+    ox_engine_publish_spectrum(s, bands);
+    struct ox_engine_state got;
+    float got_bands[OX_ENGINE_BANDS];
+    CHECK(ox_engine_read_state(b, &got) == 0);
+    CHECK(got.position == 12.5 && got.playing == 1 && got.count == 3 && strcmp(got.uri, "/music/a.flac") == 0);
+    CHECK(ox_engine_read_spectrum(a, got_bands) == 0 && memcmp(got_bands, bands, sizeof(bands)) == 0);
+
+    /* waiting: returns at once for anything unseen, else sleeps until a publish */
+    uint32_t seen = 0;
+    CHECK(ox_engine_wait(a, &seen, 0) == 1);
+    CHECK(ox_engine_wait(a, &seen, 20) == 0);
+    pthread_t t;
+    CHECK(pthread_create(&t, NULL, publish_later, s) == 0);
+    CHECK(ox_engine_wait(a, &seen, 5000) == 1);
+    pthread_join(t, NULL);
+
+    /* frontends come and go */
+    ox_engine_disconnect(a);
+    for (int i = 0; i < 100 && ox_engine_server_clients(s) != 1; ++i) sleep_ms(5);
+    CHECK(ox_engine_server_clients(s) == 1);
+    a = ox_engine_connect(path);
+    CHECK(a);
+    ca = 0;
+    CHECK(ox_engine_read_peaks(a, &ca, out, OX_ENGINE_PEAKS) == OX_ENGINE_PEAKS);
+    CHECK(ox_engine_command(a, "play", NULL, 0) == 0);
+
+    /* a client of a stopped engine fails commands but keeps its last data */
+    ox_engine_server_destroy(s);
+    CHECK(ox_engine_command(a, "play", NULL, 0) == -1);
+    CHECK(ox_engine_read_state(a, &got) == 0 && got.position == 12.5);
+    CHECK(access(path, F_OK) != 0);
+    ox_engine_disconnect(a);
+    ox_engine_disconnect(b);
+
+    /* a stale socket file (an engine that crashed) does not block a new one */
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(stale >= 0 && bind(stale, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    close(stale);
+    CHECK(access(path, F_OK) == 0);
+    s = ox_engine_server_create(path, on_command, &commands);
+    CHECK(s);
+    ox_engine_server_destroy(s);
+
+    printf("engine ipc tests passed\n");
+    return 0;
+}
@@ -0,0 +1,70 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/font.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+static long ink(const struct ox_glyph *g)
+{
+    long sum = 0;
+    for (int y = 0; y < g->h; ++y)
+        for (int x = 0; x < g->w; ++x) sum += g->coverage[y * g->pitch + x];
+    return sum;
+}
+
+int main(void)
+{
+    CHECK(ox_font_open(NULL, 16) == NULL);
+    CHECK(ox_font_open("/nonexistent/font.ttf", 16) == NULL);
+    char junk[] = "/tmp/oxxy_font_XXXXXX";
+    int fd = mkstemp(junk);
+    CHECK(fd >= 0 && write(fd, "not a font at all", 17) == 17);
+    close(fd);
+    CHECK(ox_font_open(junk, 16) == NULL);
+    unlink(junk);
+
+    char *path = ox_font_default_path();
+    struct ox_font *f = path ? ox_font_open(path, 16) : NULL;
+    if (!f) {
+        printf("font tests skipped (no FreeType or no font; set OXXY_FONT)\n");
+        free(path);
+        return 0;
+    }
+    CHECK(ox_font_open(path, 0) == NULL);
+
+    struct ox_font_metrics m;
+    ox_font_metrics(f, &m);
+    CHECK(m.ascent > 8 && m.ascent <= 24 && m.descent >= 1 && m.descent < 12);
+    CHECK(m.line_height >= m.ascent + m.descent && m.line_height <= 32);
+
+    struct ox_glyph g;
+    CHECK(ox_font_glyph(f, 'A', &g) == 0);
+    CHECK(g.w > 0 && g.h > 0 && g.pitch >= g.w && g.advance > 0 && g.top > 0 && g.top <= m.ascent + 1);
+    long a_ink = ink(&g);
+    CHECK(a_ink > 255 * 4);
+    /* descender below the baseline */
+    CHECK(ox_font_glyph(f, 'g', &g) == 0 && g.h > g.top);
+    /* blank glyph: nothing to draw, but it advances */
+    CHECK(ox_font_glyph(f, ' ', &g) == 0 && ink(&g) == 0 && g.advance > 0);
+    /* unmapped code point (plane 16 private use) */
+    CHECK(ox_font_glyph(f, 0x10FFFD, &g) == -1);
+
+    /* bigger size, bigger glyph */
+    struct ox_font *big = ox_font_open(path, 48);
+    CHECK(big);
+    struct ox_glyph gb;
+    CHECK(ox_font_glyph(big, 'A', &gb) == 0 && ink(&gb) > a_ink * 4 && gb.advance > 2 * g.advance);
+    ox_font_close(big);
+    ox_font_close(f);
+
+    setenv("OXXY_FONT", "/some/where.ttf", 1);
+    char *p = ox_font_default_path();
+    CHECK(p && strcmp(p, "/some/where.ttf") == 0);
+    free(p);
+    free(path);
+    printf("font tests passed\n");
+    return 0;
+}
@@ -0,0 +1,214 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/json.h"
+#include "../src/playlist.h"
+#include "../src/profiles.h"
+#include "../src/vk.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* events as text: one "<depth><tag>[value]" per event, '|' separated */
+struct trace {
+    char text[4096];
+    size_t len;
+    int stop_after;
+};
+
+static int record(void *user, enum ox_json_event ev, const char *s, size_t len, int depth)
+{
+    static const char tags[] = "{}[]ksntfz";
+    struct trace *t = user;
+    int n = snprintf(t->text + t->len, sizeof(t->text) - t->len, "%d%c", depth, tags[ev]);
+    t->len += (size_t)n;
+    if (s && t->len + len < sizeof(t->text)) {
+        memcpy(t->text + t->len, s, len);
+        t->len += len;
+    }
+    t->text[t->len++] = '|';
+    t->text[t->len] = '\0';
+    return t->stop_after && --t->stop_after == 0;
+}
+
+/* 0 and the trace, or -1; step 0 feeds everything at once */
+static int run(const char *doc, size_t step, struct trace *t)
+{
+    memset(t, 0, sizeof(*t));
+    struct ox_json_parser *p = ox_json_parser_create(record, t);
+    if (!p) return -1;
+    size_t n = strlen(doc), i = 0;
+    int r = 0;
+    while (r == 0 && i < n) {
+        size_t k = step && n - i > step ? step : n - i;
+        r = ox_json_feed(p, doc + i, k);
+        i += k;
+    }
+    if (r == 0) r = ox_json_finish(p);
+    ox_json_parser_destroy(p);
+    return r;
+}
+
+static int test_tokenizer(void)
+{
+    struct trace a, b;
+    /* whitespace everywhere, escapes, a key-like string, all value kinds */
+    const char *doc = " {\n\t\"name\" : \"a \\\"url\\\": b\\\\\\/\" , \"n\":[ -0.5e+3 ,0,12 , true,false,null,[],{} ],\r\n"
+                      "\"u\":\"\\u00e9\\u20AC\\ud83c\\udfb5\\ud800x\",\"long\":\"0123456789abcdef0123456789abcdef\\n\"} ";
+    CHECK(run(doc, 0, &a) == 0);
+    CHECK(strcmp(a.text, "0{|1kname|1sa \"url\": b\\/|1kn|1[|2n-0.5e+3|2n0|2n12|2t|2f|2z|2[|2]|2{|2}|1]|"
+                         "1ku|1s\xC3\xA9\xE2\x82\xAC\xF0\x9F\x8E\xB5\xEF\xBF\xBDx|"
+                         "1klong|1s0123456789abcdef0123456789abcdef\n|0}|") == 0);
+    /* any split of the input gives the same events */
+    for (size_t step = 1; step <= 17; ++step) {
+        CHECK(run(doc, step, &b) == 0);
+        CHECK(strcmp(a.text, b.text) == 0);
+    }
+
+    /* bare top-level values */
+    CHECK(run("42", 1, &a) == 0 && strcmp(a.text, "0n42|") == 0);
+    CHECK(run("\"x\" ", 0, &a) == 0 && strcmp(a.text, "0sx|") == 0);
+
+    const char *bad[] = { "", "{", "[1,]", "{\"a\":1,}", "{\"a\" 1}", "{1:2}", "[01]", "[1.]", "[-]", "[1e]",
+                          "\"tab\there\"", "\"\\x\"", "\"\\u12g4\"", "[tru]", "nul", "{} {}", "[1 2]", "]",
+                          "{\"a\":1]" };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        CHECK(run(bad[i], 0, &a) == -1);
+        CHECK(run(bad[i], 1, &a) == -1);
+    }
+
+    /* the callback can stop the parse */
+    memset(&a, 0, sizeof(a));
+    a.stop_after = 2;
+    struct ox_json_parser *p = ox_json_parser_create(record, &a);
+    CHECK(ox_json_feed(p, "[1,2,3]", 7) == 1 && ox_json_offset(p) == 2);
+    ox_json_parser_destroy(p);
+
+    /* nesting is bounded */
+    char deep[OX_JSON_MAX_DEPTH + 2];
+    memset(deep, '[', sizeof(deep) - 1);
+    deep[sizeof(deep) - 1] = '\0';
+    CHECK(run(deep, 0, &a) == -1);
+    return 0;
+}
+
+static int test_dom(void)
+{
+    const char *text = "{ \"name\": \"bob\", \"volume\": 0.75, \"muted\": false, \"tags\": [\"a\", null],\n"
+                       "  \"name\": \"robert\" }";
+    struct ox_json *root = ox_json_parse(text, strlen(text));
+    CHECK(root && root->type == OX_JSON_T_OBJECT);
+    CHECK(strcmp(ox_json_string(ox_json_get(root, "name")), "robert") == 0);
+    CHECK(ox_json_number(ox_json_get(root, "volume"), -1) == 0.75);
+    CHECK(ox_json_number(ox_json_get(root, "name"), -1) == -1);
+    const struct ox_json *tags = ox_json_get(root, "tags");
+    CHECK(tags && tags->type == OX_JSON_T_ARRAY && tags->child && !tags->child->key);
+    CHECK(tags->child->next && tags->child->next->type == OX_JSON_T_NULL && !tags->child->next->next);
+    CHECK(!ox_json_get(root, "missing") && !ox_json_get(tags, "a"));
+
+    CHECK(ox_json_set_string(root, "volume", "loud\n\"x\"\x01") == 0);
+    CHECK(ox_json_set_string(root, "new", "") == 0);
+    CHECK(ox_json_set_string((struct ox_json *)tags, "k", "v") == -1);
+    size_t len;
+    char *out = ox_json_write(root, &len);
+    const char *want = "{\"name\":\"bob\",\"volume\":\"loud\\n\\\"x\\\"\\u0001\",\"muted\":false,\"tags\":[\"a\",null],"
+                       "\"name\":\"robert\",\"new\":\"\"}";
+    CHECK(out && strcmp(out, want) == 0 && len == strlen(want));
+    /* the writer's output reads back the same */
+    struct ox_json *again = ox_json_parse(out, len);
+    CHECK(again && strcmp(ox_json_string(ox_json_get(again, "volume")), "loud\n\"x\"\x01") == 0);
+    ox_json_free(again);
+    free(out);
+    ox_json_free(root);
+
+    CHECK(!ox_json_parse("{\"a\":", 5));
+    CHECK(!ox_json_parse(NULL, 0));
+    return 0;
+}
+
+static int test_profile_token(void)
+{
+    char *t = ox_profiles_get_vk_token("{ \"note\": \"\\\"vk_token\\\": \\\"fake\\\"\",\n  \"vk_token\" : \"abc\\/123\" }");
+    CHECK(t && strcmp(t, "abc/123") == 0);
+    free(t);
+    CHECK(!ox_profiles_get_vk_token("{\"vk_token\":42}"));
+    CHECK(!ox_profiles_get_vk_token("{\"other\":{\"vk_token\":\"nested\"}}"));
+    CHECK(!ox_profiles_get_vk_token("{\"vk_token\":\"abc\""));
+
+    char *s = ox_profiles_set_vk_token("{ \"name\": \"a,b}\", \"vk_token\": \"old\", \"v\": 1 }", "new\"tok");
+    CHECK(s && strcmp(s, "{\"name\":\"a,b}\",\"vk_token\":\"new\\\"tok\",\"v\":1}") == 0);
+    t = ox_profiles_get_vk_token(s);
+    CHECK(t && strcmp(t, "new\"tok") == 0);
+    free(t);
+    free(s);
+    s = ox_profiles_set_vk_token("{}", "t");
+    CHECK(s && strcmp(s, "{\"vk_token\":\"t\"}") == 0);
+    free(s);
+    CHECK(!ox_profiles_set_vk_token("[]", "t") && !ox_profiles_set_vk_token("{", "t"));
+    return 0;
+}
+
+static int test_vk_import(void)
+{
+    struct playlist *p = playlist_create();
+    CHECK(p);
+    const char *json = "{\"response\":{\"count\":3,\"items\":[\n"
+                       " {\"artist\":\"Caf\\u00e9\",\"title\":\"One \\\"url\\\": x\",\"duration\":215,"
+                       "  \"album\":{\"title\":\"Not this\",\"thumb\":{\"url\":\"http://img/x.jpg\"}},"
+                       "  \"url\":\"https:\\/\\/cs1.vk.me\\/a.mp3?extra=1\"},\n"
+                       " {\"title\":\"Blocked\",\"url\":\"\"},\n"
+                       " {\"title\":\"Two\",\"url\":\"https://cs1.vk.me/b.mp3\"},\n"
+                       " {\"title\":\"Again\",\"url\":\"https://cs1.vk.me/b.mp3\"}]}}";
+    CHECK(ox_vk_import_audio_to_playlist(json, p) == 2);
+    CHECK(p->count == 2);
+    CHECK(strcmp(playlist_uri(p, 0), "https://cs1.vk.me/a.mp3?extra=1") == 0);
+    CHECK(p->items[0].title_len == strlen("Caf\xC3\xA9 - One \"url\": x"));
+    CHECK(memcmp(playlist_title(p, 0), "Caf\xC3\xA9 - One \"url\": x", p->items[0].title_len) == 0);
+    CHECK(p->items[0].duration_ms == 215000);
+    CHECK(strcmp(playlist_uri(p, 1), "https://cs1.vk.me/b.mp3") == 0 && p->items[1].duration_ms == -1);
+    CHECK(ox_vk_import_audio_to_playlist("{\"error\":{\"error_code\":5,\"url\":\"x\"}}", p) == -1);
+    CHECK(ox_vk_import_audio_to_playlist("{\"response\":{\"items\":[{\"url\":\"u\"}", p) == -1);
+    playlist_destroy(p);
+
+    /* a large response fed in network-sized pieces */
+    enum { TRACKS = 50000 };
+    size_t cap = (size_t)TRACKS * 200 + 64, len = 0;
+    char *big = malloc(cap);
+    CHECK(big);
+    len += (size_t)sprintf(big, "{\"response\":{\"count\":%d,\"items\":[", TRACKS);
+    for (int i = 0; i < TRACKS; ++i)
+        len += (size_t)sprintf(big + len, "%s{\"id\":%d,\"artist\":\"Artist %d\",\"title\":\"Song \\u2116%d\",\"duration\":%d,"
+                               "\"url\":\"https:\\/\\/cs%d.vk.me\\/s\\/%d.mp3?extra=abcdefghijklmnop\"}",
+                               i ? "," : "", i, i % 97, i, 60 + i % 300, i % 9, i);
+    len += (size_t)sprintf(big + len, "]}}");
+    p = playlist_create();
+    struct ox_vk_import *im = ox_vk_import_begin(p);
+    CHECK(im);
+    double t0 = now();
+    for (size_t off = 0; off < len; off += 1371)
+        CHECK(ox_vk_import_feed(im, big + off, len - off < 1371 ? len - off : 1371) == 0);
+    CHECK(ox_vk_import_end(im) == TRACKS);
+    double t1 = now();
+    CHECK(p->count == TRACKS);
+    CHECK(strcmp(playlist_uri(p, TRACKS - 1), "https://cs4.vk.me/s/49999.mp3?extra=abcdefghijklmnop") == 0);
+    printf("json: %.1f MB VK response streamed into %d tracks at %.0f MB/s\n", len / 1e6, TRACKS,
+           len / 1e6 / (t1 - t0));
+    playlist_destroy(p);
+    free(big);
+    return 0;
+}
+
+int main(void)
+{
+    if (test_tokenizer() || test_dom() || test_profile_token() || test_vk_import()) return 1;
+    printf("json tests passed\n");
+    return 0;
+}
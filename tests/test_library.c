@@ -0,0 +1,70 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../src/library.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+static void write_mp3(const char *path, const char *artist, const char *title)
+{
+    unsigned char buf[128]; memset(buf, 0, sizeof(buf));
+    size_t pos = 10, al = strlen(artist), tl = strlen(title);
+    memcpy(buf + pos, "TPE1", 4); buf[pos+7] = (unsigned char)(1 + al); pos += 11; memcpy(buf + pos, artist, al); pos += al;
+    memcpy(buf + pos, "TIT2", 4); buf[pos+7] = (unsigned char)(1 + tl); pos += 11; memcpy(buf + pos, title, tl); pos += tl;
+    memcpy(buf, "ID3\x03", 4); buf[9] = (unsigned char)(pos - 10);
+    FILE *f = fopen(path, "wb");
+    if (!f) return;
+    fwrite(buf, 1, sizeof(buf), f);
+    fclose(f);
+}
+
+int main(void)
+{
+    char root[] = "/tmp/oxxy_lib_XXXXXX";
+    if (!mkdtemp(root)) return 1;
+    char path[512], idx[512];
+    snprintf(idx, sizeof(idx), "%s/library.idx", root);
+    snprintf(path, sizeof(path), "%s/music", root); mkdir(path, 0700);
+    const char *artists[] = { "Zed", "alpha", "Mid" };
+    for (int i = 0; i < 9; ++i) {
+        char title[32]; snprintf(title, sizeof(title), "Track %d", i);
+        snprintf(path, sizeof(path), "%s/music/%d.mp3", root, i);
+        write_mp3(path, artists[i % 3], title);
+    }
+    char music[512]; snprintf(music, sizeof(music), "%s/music", root);
+    const char *roots[] = { music };
+    struct ox_scan_opts o = {0}; o.threads = 2;
+    struct ox_library_rescan_stats st;
+
+    CHECK(ox_library_rescan(idx, roots, 1, &o, &st) == 0);
+    printf("initial: kept=%lu updated=%lu removed=%lu\n", (unsigned long)st.kept, (unsigned long)st.updated, (unsigned long)st.removed);
+    CHECK(st.kept == 0 && st.updated == 9);
+
+    CHECK(ox_library_rescan(idx, roots, 1, &o, &st) == 0);
+    CHECK(st.kept == 9 && st.updated == 0 && st.removed == 0);
+
+    snprintf(path, sizeof(path), "%s/music/0.mp3", root); unlink(path);
+    snprintf(path, sizeof(path), "%s/music/1.mp3", root);
+    sleep(1); // coarse mtime filesystems
+    write_mp3(path, "alpha", "Retitled, longer");
+    CHECK(ox_library_rescan(idx, roots, 1, &o, &st) == 0);
+    printf("incremental: kept=%lu updated=%lu removed=%lu\n", (unsigned long)st.kept, (unsigned long)st.updated, (unsigned long)st.removed);
+    CHECK(st.kept == 7 && st.updated == 1 && st.removed == 1);
+
+    struct ox_library *lib = ox_library_open(idx);
+    CHECK(lib && ox_library_count(lib) == 8);
+    long i = ox_library_find_path(lib, path);
+    CHECK(i >= 0 && strcmp(ox_library_str(lib, ox_library_track(lib, (size_t)i)->title), "Retitled, longer") == 0);
+    const uint32_t *by_artist = ox_library_order(lib, OX_LIB_BY_ARTIST);
+    CHECK(strcmp(ox_library_str(lib, ox_library_track(lib, by_artist[0])->artist), "alpha") == 0);
+    CHECK(strcmp(ox_library_str(lib, ox_library_track(lib, by_artist[7])->artist), "Zed") == 0);
+    ox_library_close(lib);
+
+    for (int k = 0; k < 9; ++k) { snprintf(path, sizeof(path), "%s/music/%d.mp3", root, k); unlink(path); }
+    unlink(idx); rmdir(music); rmdir(root);
+    printf("library tests passed\n");
+    return 0;
+}
@@ -2,33 +2,310 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../src/meta_id3.h"
+#include "../src/meta.h"
 
-int main(void)
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+static size_t put_frame(unsigned char *buf, size_t pos, int version, const char *id, const unsigned char *data, size_t n)
+{
+    if (version == 2) {
+        memcpy(buf + pos, id, 3); pos += 3;
+        buf[pos++] = (unsigned char)(n >> 16); buf[pos++] = (unsigned char)(n >> 8); buf[pos++] = (unsigned char)n;
+    } else {
+        memcpy(buf + pos, id, 4); pos += 4;
+        if (version == 4) {
+            buf[pos++] = (n >> 21) & 0x7F; buf[pos++] = (n >> 14) & 0x7F; buf[pos++] = (n >> 7) & 0x7F; buf[pos++] = n & 0x7F;
+        } else {
+            buf[pos++] = (unsigned char)(n >> 24); buf[pos++] = (unsigned char)(n >> 16); buf[pos++] = (unsigned char)(n >> 8); buf[pos++] = (unsigned char)n;
+        }
+        buf[pos++] = 0; buf[pos++] = 0; // flags
+    }
+    memcpy(buf + pos, data, n);
+    return pos + n;
+}
+
+static void put_header(unsigned char *buf, int version, size_t body)
 {
-    // Create a fake ID3v2 tag with TIT2 and TPE1 frames for testing
-    unsigned char buf[512]; memset(buf, 0, sizeof(buf));
     memcpy(buf, "ID3", 3);
-    buf[3] = 3; buf[4] = 0; // v2.3.0
-    // syncsafe size: 0x00 00 00 2E (46) -> fits
-    buf[6] = 0x00; buf[7] = 0x00; buf[8] = 0x00; buf[9] = 0x2E;
+    buf[3] = (unsigned char)version; buf[4] = 0; buf[5] = 0;
+    buf[6] = (body >> 21) & 0x7F; buf[7] = (body >> 14) & 0x7F; buf[8] = (body >> 7) & 0x7F; buf[9] = body & 0x7F;
+}
+
+static int test_v23_basic(void)
+{
+    // Fake ID3v2.3 tag with TIT2, TPE1, TRCK and TYER frames
+    unsigned char buf[512]; memset(buf, 0, sizeof(buf));
     size_t pos = 10;
-    // TIT2 frame (title)
-    memcpy(buf + pos, "TIT2", 4); pos += 4;
-    // size 0x00000005
-    buf[pos++] = 0x00; buf[pos++] = 0x00; buf[pos++] = 0x00; buf[pos++] = 0x05;
-    buf[pos++] = 0; buf[pos++] = 0; // flags
-    // payload: encoding 0 + "Hey"
-    buf[pos++] = 0; memcpy(buf + pos, "Hey", 3); pos += 3;
-    // TPE1 frame (artist)
-    memcpy(buf + pos, "TPE1", 4); pos += 4;
-    buf[pos++] = 0x00; buf[pos++] = 0x00; buf[pos++] = 0x00; buf[pos++] = 0x06;
-    buf[pos++] = 0; buf[pos++] = 0;
-    buf[pos++] = 0; memcpy(buf + pos, "Me", 2); pos += 2;
+    pos = put_frame(buf, pos, 3, "TIT2", (const unsigned char *)"\0Hey", 4);
+    pos = put_frame(buf, pos, 3, "TPE1", (const unsigned char *)"\0Me", 3);
+    pos = put_frame(buf, pos, 3, "TRCK", (const unsigned char *)"\0" "3/12", 5);
+    pos = put_frame(buf, pos, 3, "TYER", (const unsigned char *)"\0" "1999", 5);
+    put_header(buf, 3, pos - 10 + 32); // trailing padding
+
+    struct ox_metadata m;
+    CHECK(ox_meta_id3_parse(buf, sizeof(buf), &m) == 0);
+    printf("title='%s' artist='%s' track=%d year=%d\n", m.title, m.artist, m.track, m.year);
+    CHECK(strcmp(m.title, "Hey") == 0);
+    CHECK(strcmp(m.artist, "Me") == 0);
+    CHECK(m.track == 3 && m.year == 1999);
+    return 0;
+}
+
+static int test_v24_utf16_syncsafe(void)
+{
+    // 200-byte comment forces a syncsafe size that differs from plain big-endian
+    unsigned char buf[1024]; memset(buf, 0, sizeof(buf));
+    unsigned char title[] = { 1, 0xFF, 0xFE, 'C', 0, 0xE9, 0, 0x3D, 0xD8, 0x35, 0xDE, 0, 0 }; // "Cé😵"
+    unsigned char comm[200]; memset(comm, 'x', sizeof(comm));
+    comm[0] = 0; memcpy(comm + 1, "eng", 3); comm[4] = 0; comm[sizeof(comm) - 1] = 0;
+    unsigned char rg[] = "\0REPLAYGAIN_TRACK_GAIN\0-6.50 dB";
+    size_t pos = 10;
+    pos = put_frame(buf, pos, 4, "COMM", comm, sizeof(comm));
+    pos = put_frame(buf, pos, 4, "TIT2", title, sizeof(title));
+    pos = put_frame(buf, pos, 4, "TXXX", rg, sizeof(rg) - 1);
+    pos = put_frame(buf, pos, 4, "TDRC", (const unsigned char *)"\x03" "2004-05-01", 11);
+    put_header(buf, 4, pos - 10);
+
+    struct ox_metadata m;
+    CHECK(ox_meta_id3_parse(buf, sizeof(buf), &m) == 0);
+    printf("title='%s' year=%d gain=%.2f comment_len=%zu\n", m.title, m.year, m.rg_track_gain, strlen(m.comment));
+    CHECK(strcmp(m.title, "C\xC3\xA9\xF0\x9F\x98\xB5") == 0);
+    CHECK(m.year == 2004);
+    CHECK(m.rg_track_gain < -6.49f && m.rg_track_gain > -6.51f);
+    CHECK(strlen(m.comment) == sizeof(comm) - 6);
+    return 0;
+}
+
+static int test_v22_and_picture(void)
+{
+    unsigned char buf[256]; memset(buf, 0, sizeof(buf));
+    unsigned char pic[] = { 0, 'P', 'N', 'G', 3, 0, 0x89, 'P', 'N', 'G' };
+    size_t pos = 10;
+    pos = put_frame(buf, pos, 2, "TT2", (const unsigned char *)"\0Old", 4);
+    pos = put_frame(buf, pos, 2, "PIC", pic, sizeof(pic));
+    put_header(buf, 2, pos - 10);
+
+    struct ox_id3_tag tag;
+    CHECK(ox_meta_id3_scan(buf, sizeof(buf), &tag) == 0);
+    char title[16];
+    ox_meta_id3_text(&tag, &tag.title, title, sizeof(title));
+    CHECK(strcmp(title, "Old") == 0);
+    CHECK(tag.picture_type == 3 && tag.picture.len == 4);
+    CHECK(memcmp(ox_meta_id3_span_ptr(&tag, &tag.picture), "\x89PNG", 4) == 0);
+    ox_meta_id3_release(&tag);
+    return 0;
+}
+
+static int test_malformed(void)
+{
+    unsigned char buf[64]; memset(buf, 0, sizeof(buf));
+    size_t pos = put_frame(buf, 10, 3, "TIT2", (const unsigned char *)"\0abc", 4);
+    buf[17] = 0x7F; // frame size now points far past the tag
+    put_header(buf, 3, pos - 10);
+    struct ox_metadata m;
+    CHECK(ox_meta_id3_parse(buf, sizeof(buf), &m) == 0);
+    CHECK(m.title[0] == '\0');
+    CHECK(ox_meta_id3_parse((const unsigned char *)"ID3", 3, &m) == -1);
+    return 0;
+}
+
+static size_t put_le32(unsigned char *buf, size_t pos, unsigned int v)
+{
+    buf[pos++] = v & 0xFF; buf[pos++] = (v >> 8) & 0xFF; buf[pos++] = (v >> 16) & 0xFF; buf[pos++] = (v >> 24) & 0xFF;
+    return pos;
+}
+
+static size_t put_comment(unsigned char *buf, size_t pos, const char *c)
+{
+    pos = put_le32(buf, pos, (unsigned int)strlen(c));
+    memcpy(buf + pos, c, strlen(c));
+    return pos + strlen(c);
+}
+
+static int test_flac(void)
+{
+    unsigned char buf[256]; memset(buf, 0, sizeof(buf));
+    size_t pos = 0;
+    memcpy(buf, "fLaC", 4); pos = 4;
+    buf[pos++] = 0; buf[pos++] = 0; buf[pos++] = 0; buf[pos++] = 34; // STREAMINFO
+    // 44100 Hz (20 bits), 2 channels, 16 bits/sample, 441000 samples (36 bits)
+    buf[pos+10] = 0x0A; buf[pos+11] = 0xC4; buf[pos+12] = 0x42; buf[pos+13] = 0xF0;
+    buf[pos+14] = 0x00; buf[pos+15] = 0x06; buf[pos+16] = 0xBA; buf[pos+17] = 0xA8;
+    pos += 34;
+    size_t blk = pos; pos += 4;
+    pos = put_comment(buf, pos, "test");
+    pos = put_le32(buf, pos, 2);
+    pos = put_comment(buf, pos, "title=Flac Song");
+    pos = put_comment(buf, pos, "TRACKNUMBER=7");
+    size_t len = pos - blk - 4;
+    buf[blk] = 0x80 | 4; buf[blk+1] = 0; buf[blk+2] = 0; buf[blk+3] = (unsigned char)len;
 
     struct ox_metadata m;
-    if (ox_meta_id3_parse(buf, sizeof(buf), &m) != 0) {
-        fprintf(stderr, "parse failed\n"); return 1;
+    struct ox_meta_src src = { buf, pos, -1, pos };
+    enum ox_meta_format fmt;
+    CHECK(ox_meta_read(&src, &m, &fmt) == 0);
+    CHECK(fmt == OX_META_FLAC);
+    CHECK(strcmp(m.title, "Flac Song") == 0 && m.track == 7);
+    CHECK(m.sample_rate == 44100 && m.channels == 2 && m.duration_ms == 10000 && m.duration_sec == 10);
+    return 0;
+}
+
+static size_t put_ogg_page(unsigned char *buf, size_t pos, int flags, const unsigned char *data, size_t n, int ends)
+{
+    memcpy(buf + pos, "OggS", 4); buf[pos+4] = 0; buf[pos+5] = (unsigned char)flags;
+    memset(buf + pos + 6, 0, 20); buf[pos+14] = 0x2A; // serial
+    size_t nseg = n / 255 + (ends ? 1 : 0);
+    buf[pos+26] = (unsigned char)nseg;
+    for (size_t i = 0; i < nseg; ++i) buf[pos+27+i] = i < n / 255 ? 255 : (unsigned char)(n % 255);
+    pos += 27 + nseg;
+    memcpy(buf + pos, data, n);
+    return pos + n;
+}
+
+static int test_opus_multipage(void)
+{
+    static unsigned char buf[2048], pkt[1024];
+    unsigned char head[19] = "OpusHead\x01\x02\x38\x01\x44\xAC"; // pre-skip 312, 44.1 kHz input
+    size_t pos = put_ogg_page(buf, 0, 0x02, head, sizeof(head), 1);
+    size_t n = 0;
+    memcpy(pkt, "OpusTags", 8); n = 8;
+    n = put_comment(pkt, n, "libopus");
+    n = put_le32(pkt, n, 2);
+    char big[301]; memset(big, 'A', 300); big[300] = '\0'; memcpy(big, "METADATA_BLOCK_PICTURE=", 23);
+    n = put_comment(pkt, n, big);
+    n = put_comment(pkt, n, "ARTIST=Opus Artist");
+    // first 255 bytes on page 2, the rest continues on page 3
+    pos = put_ogg_page(buf, pos, 0, pkt, 255, 0);
+    pos = put_ogg_page(buf, pos, 0x01, pkt + 255, n - 255, 1);
+    size_t last = pos;
+    pos = put_ogg_page(buf, pos, 0x04, (const unsigned char *)"audio", 5, 1);
+    unsigned long long granule = 312 + 48000ull * 3 / 2; // 1.5 s after pre-skip
+    for (int i = 0; i < 8; ++i) buf[last + 6 + i] = (unsigned char)(granule >> (8 * i));
+
+    struct ox_metadata m;
+    struct ox_meta_src src = { buf, pos, -1, pos };
+    enum ox_meta_format fmt;
+    CHECK(ox_meta_read(&src, &m, &fmt) == 0);
+    CHECK(fmt == OX_META_OPUS);
+    CHECK(strcmp(m.artist, "Opus Artist") == 0);
+    CHECK(m.channels == 2 && m.sample_rate == 44100 && m.duration_ms == 1500);
+    return 0;
+}
+
+static size_t box_begin(unsigned char *buf, size_t pos, const char *type)
+{
+    memcpy(buf + pos + 4, type, 4);
+    return pos + 8;
+}
+
+static size_t box_end(unsigned char *buf, size_t start, size_t pos)
+{
+    size_t n = pos - start;
+    buf[start] = (unsigned char)(n >> 24); buf[start+1] = (unsigned char)(n >> 16); buf[start+2] = (unsigned char)(n >> 8); buf[start+3] = (unsigned char)n;
+    return pos;
+}
+
+static size_t put_data_item(unsigned char *buf, size_t pos, const char *type, const unsigned char *v, size_t n)
+{
+    size_t item = pos; pos = box_begin(buf, pos, type);
+    size_t data = pos; pos = box_begin(buf, pos, "data");
+    memset(buf + pos, 0, 8); buf[pos+3] = 1; pos += 8; // UTF-8 type, locale
+    memcpy(buf + pos, v, n); pos += n;
+    box_end(buf, data, pos);
+    return box_end(buf, item, pos);
+}
+
+static int test_mp4(void)
+{
+    static unsigned char buf[1024]; memset(buf, 0, sizeof(buf));
+    size_t pos = 0, b;
+    b = pos; pos = box_begin(buf, pos, "ftyp"); memcpy(buf + pos, "M4A \0\0\0\0", 8); pos = box_end(buf, b, pos + 8);
+    b = pos; pos = box_begin(buf, pos, "mdat"); pos = box_end(buf, b, pos + 200); // media before moov
+    size_t moov = pos; pos = box_begin(buf, pos, "moov");
+    size_t trak = pos; pos = box_begin(buf, pos, "trak");
+    size_t mdia = pos; pos = box_begin(buf, pos, "mdia");
+    b = pos; pos = box_begin(buf, pos, "mdhd"); // v0: 44100 Hz timescale, 4.5 s
+    memcpy(buf + pos + 12, "\0\0\xAC\x44\0\x03\x07\x32", 8); pos = box_end(buf, b, pos + 24);
+    b = pos; pos = box_begin(buf, pos, "hdlr"); memcpy(buf + pos + 8, "soun", 4); pos = box_end(buf, b, pos + 25);
+    size_t minf = pos; pos = box_begin(buf, pos, "minf");
+    size_t stbl = pos; pos = box_begin(buf, pos, "stbl");
+    size_t stsd = pos; pos = box_begin(buf, pos, "stsd"); buf[pos+7] = 1; pos += 8;
+    b = pos; pos = box_begin(buf, pos, "mp4a");
+    buf[pos+17] = 1; buf[pos+19] = 16; buf[pos+24] = 0xAC; buf[pos+25] = 0x44; // mono, 16 bit, 44100.0
+    pos = box_end(buf, b, pos + 28);
+    box_end(buf, stsd, pos); box_end(buf, stbl, pos); box_end(buf, minf, pos); box_end(buf, mdia, pos); box_end(buf, trak, pos);
+    size_t udta = pos; pos = box_begin(buf, pos, "udta");
+    size_t meta = pos; pos = box_begin(buf, pos, "meta"); pos += 4; // full box
+    b = pos; pos = box_begin(buf, pos, "hdlr"); pos = box_end(buf, b, pos + 25);
+    size_t ilst = pos; pos = box_begin(buf, pos, "ilst");
+    pos = put_data_item(buf, pos, "\xA9nam", (const unsigned char *)"MP4 Title", 9);
+    pos = put_data_item(buf, pos, "trkn", (const unsigned char *)"\0\0\0\x05\0\x0A\0\0", 8);
+    box_end(buf, ilst, pos); box_end(buf, meta, pos); box_end(buf, udta, pos); box_end(buf, moov, pos);
+
+    struct ox_metadata m;
+    CHECK(ox_meta_parse(buf, pos, &m) == 0);
+    CHECK(strcmp(m.title, "MP4 Title") == 0 && m.track == 5);
+    CHECK(m.duration_ms == 4500 && m.channels == 1 && m.sample_rate == 44100);
+    return 0;
+}
+
+/* MPEG-1 Layer III, 44.1 kHz, joint stereo, 128 kbps: 417 bytes per frame (418 padded) */
+static size_t put_mp3_frames(unsigned char *buf, size_t pos, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        int pad = i % 3 == 0;
+        buf[pos] = 0xFF; buf[pos+1] = 0xFB; buf[pos+2] = (unsigned char)(0x90 | (pad << 1)); buf[pos+3] = 0x64;
+        memset(buf + pos + 4, 0x55, 413 + (size_t)pad);
+        pos += 417 + (size_t)pad;
+    }
+    return pos;
+}
+
+static int test_mp3_duration(void)
+{
+    static unsigned char buf[400 * 418 + 512];
+    // tagged CBR stream: sampled frame scan
+    size_t pos = put_frame(buf, 10, 3, "TIT2", (const unsigned char *)"\0Cbr", 4);
+    put_header(buf, 3, pos - 10);
+    pos = put_mp3_frames(buf, pos, 383); // 383 * 1152 / 44100 = 10.005 s
+    struct ox_metadata m;
+    CHECK(ox_meta_parse(buf, pos, &m) == 0);
+    printf("cbr: %d ms %d kbps\n", m.duration_ms, m.bitrate_kbps);
+    CHECK(strcmp(m.title, "Cbr") == 0);
+    CHECK(m.duration_ms > 9950 && m.duration_ms < 10060 && m.bitrate_kbps == 128);
+    CHECK(m.sample_rate == 44100 && m.channels == 2 && m.duration_sec == 10);
+
+    // untagged stream whose first frame carries a Xing header claiming 1000 frames
+    pos = put_mp3_frames(buf, 0, 20);
+    memcpy(buf + 4 + 32, "Xing\0\0\0\x01\0\0\x03\xE8", 12);
+    CHECK(ox_meta_parse(buf, pos, &m) == 0);
+    CHECK(m.duration_ms == 26122); // 1000 * 1152 / 44100
+
+    // junk only: no duration, tag-less MPEG sniffing still fails gracefully
+    memset(buf, 0, 4096);
+    buf[0] = 0xFF; buf[1] = 0xFB;
+    CHECK(ox_meta_parse(buf, 4096, &m) == 0 && m.duration_ms == 0);
+
+    // a tag that cannot be parsed (v2.2 with the compression flag) in front of
+    // good frames: no tags, but the stream's duration and bitrate
+    put_header(buf, 2, 32);
+    buf[5] = 0x40;
+    memset(buf + 10, 0, 32);
+    pos = put_mp3_frames(buf, 42, 383);
+    CHECK(ox_meta_parse(buf, pos, &m) == 0);
+    CHECK(m.title[0] == '\0' && m.duration_ms > 9950 && m.duration_ms < 10060 && m.bitrate_kbps == 128);
+    // ... and in front of nothing playable it is still an error
+    memset(buf + 42, 0, 4096);
+    CHECK(ox_meta_parse(buf, 42 + 4096, &m) == -1);
+    return 0;
+}
+
+int main(void)
+{
+    if (test_v23_basic() || test_v24_utf16_syncsafe() || test_v22_and_picture() || test_malformed() ||
+        test_flac() || test_opus_multipage() || test_mp4() || test_mp3_duration()) {
+        fprintf(stderr, "meta tests failed\n"); return 1;
     }
-    printf("title='%s' artist='%s'\n", m.title, m.artist);
+    printf("meta tests passed\n");
     return 0;
 }
@@ -1,15 +1,447 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
 #include "../src/playlist.h"
+#include "../src/playlist_share.h"
 
-int main(void)
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int test_roundtrip(void)
 {
     struct playlist *p = playlist_create();
-    if (!p) return 1;
-    playlist_add(p, "/tmp/song1.mp3");
-    playlist_add(p, "/tmp/song2.mp3");
-    playlist_save_m3u(p, "/tmp/test.m3u");
+    CHECK(p);
+    CHECK(playlist_add(p, "/tmp/song1.mp3") == 0);
+    CHECK(playlist_add(p, "/tmp/song2.mp3") == 0);
+    CHECK(playlist_save_m3u(p, "/tmp/test.m3u") == 0);
     playlist_destroy(p);
+
+    /* BOM, CRLF, comments, blank lines, no newline at the end */
+    const char *m3u = "\xEF\xBB\xBF#EXTM3U\r\n#EXTINF:123,Artist - Title\r\n/music/a b.flac\r\n\r\n"
+                      "http://radio.example/stream?x=1\n# comment\n/music/last.mp3";
+    FILE *f = fopen("/tmp/test_in.m3u", "wb");
+    CHECK(f && fwrite(m3u, 1, strlen(m3u), f) == strlen(m3u));
+    fclose(f);
+    p = playlist_create();
+    CHECK(playlist_load_m3u(p, "/tmp/test_in.m3u") == 0);
+    CHECK(p->count == 3);
+    CHECK(strcmp(playlist_uri(p, 0), "/music/a b.flac") == 0);
+    CHECK(strcmp(playlist_uri(p, 1), "http://radio.example/stream?x=1") == 0);
+    CHECK(strcmp(playlist_uri(p, 2), "/music/last.mp3") == 0 && p->items[2].len == 15);
+    CHECK(playlist_load_m3u(p, "/tmp/test.m3u") == 0); /* appends */
+    CHECK(p->count == 5 && strcmp(playlist_uri(p, 4), "/tmp/song2.mp3") == 0);
+    CHECK(playlist_load_m3u(p, "/tmp/test.m3u") == 0); /* bulk loads keep duplicates */
+    CHECK(p->count == 7);
+    CHECK(playlist_load_with(p, "/tmp/test.m3u", PLAYLIST_LOAD_M3U | PLAYLIST_LOAD_DEDUP) == 0 && p->count == 7);
+    playlist_destroy(p);
+    unlink("/tmp/test_in.m3u");
     printf("playlist test wrote /tmp/test.m3u\n");
     return 0;
 }
+
+static int write_text(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    size_t n = strlen(text);
+    int rc = fwrite(text, 1, n, f) == n ? 0 : -1;
+    return fclose(f) == 0 ? rc : -1;
+}
+
+static int entry_is(const struct playlist *p, size_t i, const char *uri, const char *title, int32_t ms)
+{
+    return i < p->count && strcmp(playlist_uri(p, i), uri) == 0 && strcmp(playlist_title(p, i), title) == 0 &&
+           p->items[i].duration_ms == ms;
+}
+
+static int test_formats(void)
+{
+    char dir[] = "/tmp/oxxy_fmt_XXXXXX", path[512], out[256];
+    CHECK(mkdtemp(dir));
+
+    /* EXTM3U: attributes before the title, relative and file:// paths, duplicates */
+    snprintf(path, sizeof(path), "%s/list.m3u8", dir);
+    CHECK(write_text(path, "#EXTM3U\n"
+                           "#EXTINF:215 tvg-name=\"a,b\",Artist - Song, Part 2\n"
+                           "music/../music/one.flac\n"
+                           "#EXTINF:-1,Radio\n"
+                           "HTTP://Radio.Example/live?Q=1\n"
+                           "file:///abs/with%20space.mp3\n"
+                           "#EXTINF:12,dup\n"
+                           "./music//one.flac\n"
+                           "http://radio.example/live?Q=1\n"
+                           "/abs/with space.mp3\n") == 0);
+    struct playlist *p = playlist_create();
+    CHECK(playlist_load(p, path) == 3 && p->count == 3);
+    snprintf(out, sizeof(out), "%s/music/one.flac", dir);
+    CHECK(entry_is(p, 0, out, "Artist - Song, Part 2", 215000));
+    CHECK(entry_is(p, 1, "HTTP://Radio.Example/live?Q=1", "Radio", -1));
+    CHECK(entry_is(p, 2, "/abs/with space.mp3", "", -1));
+    CHECK(playlist_load(p, path) == 0 && p->count == 3); /* importing twice adds nothing */
+    CHECK(playlist_add(p, "/abs/plain.ogg") == 0); /* plain adds are indexed lazily */
+    CHECK(playlist_add_unique(p, "/abs//plain.ogg", 15, NULL, 0, -1) == 0);
+    CHECK(playlist_add_unique(p, "http://radio.example/Live?Q=1", 29, NULL, 0, -1) == 1); /* path case matters */
+    /* lookup by URI goes through the same normalization */
+    CHECK(playlist_find(p, "file:///abs/with%20space.mp3", 28) == 2);
+    CHECK(playlist_find(p, "/abs//plain.ogg", 15) == 3);
+    CHECK(playlist_find(p, "http://radio.example/Live?Q=1", 29) == 4);
+    CHECK(playlist_find(p, "/abs/missing.ogg", 16) == PLAYLIST_END);
+    playlist_destroy(p);
+
+    /* PLS: keys in any order and case, entries come out by index */
+    snprintf(path, sizeof(path), "%s/list.pls", dir);
+    CHECK(write_text(path, "[playlist]\r\nTitle2=Second\r\nfile2=/b.mp3\r\nFile1=/a.mp3\r\nLength1=61\r\n"
+                           "File3=/a.mp3\r\nLength2=-1\r\nNumberOfEntries=3\r\nVersion=2\r\n") == 0);
+    p = playlist_create();
+    CHECK(playlist_load(p, path) == 2);
+    CHECK(entry_is(p, 0, "/a.mp3", "", 61000) && entry_is(p, 1, "/b.mp3", "Second", -1));
+    playlist_destroy(p);
+
+    /* XSPF: entities, CDATA, creator + title, milliseconds, percent-encoded file URIs */
+    snprintf(path, sizeof(path), "%s/list.xspf", dir);
+    CHECK(write_text(path, "<?xml version=\"1.0\"?>\n<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n"
+                           "<trackList>\n<track>\n  <location>file:///m/Caf%C3%A9%20%26%20Co.ogg</location>\n"
+                           "  <creator>Tom &amp; Jerry</creator><title><![CDATA[<Live>]]></title>\n"
+                           "  <duration>187500</duration>\n</track>\n"
+                           "<track><location>rel/x.mp3</location><title>caf&#xE9; &#233;</title></track>\n"
+                           "<track><title>no location</title></track>\n"
+                           "</trackList></playlist>\n") == 0);
+    p = playlist_create();
+    CHECK(playlist_load(p, path) == 2);
+    CHECK(entry_is(p, 0, "/m/Caf\xC3\xA9 & Co.ogg", "Tom & Jerry - <Live>", 187500));
+    snprintf(out, sizeof(out), "%s/rel/x.mp3", dir);
+    CHECK(entry_is(p, 1, out, "caf\xC3\xA9 \xC3\xA9", -1));
+
+    /* every format round-trips what it can express; saves leave no temporaries */
+    CHECK(playlist_add_info(p, "http://host/s?a=1&b=<2>", 23, "multi\nline", 10, 3000) == 0);
+    static const char *const names[] = { "out.m3u", "out.pls", "out.xspf" };
+    for (int f = 0; f < 3; ++f) {
+        snprintf(out, sizeof(out), "%s/%s", dir, names[f]);
+        enum playlist_format fmt = playlist_format_for_path(out);
+        CHECK((int)fmt == f);
+        CHECK(playlist_save(p, out, fmt) == 0 && playlist_save(p, out, fmt) == 0);
+        struct playlist *q = playlist_create();
+        CHECK(playlist_load(q, out) == 3);
+        int32_t ms0 = f == PLAYLIST_FORMAT_XSPF ? 187500 : 188000; /* whole seconds outside XSPF */
+        CHECK(entry_is(q, 0, playlist_uri(p, 0), "Tom & Jerry - <Live>", ms0));
+        CHECK(entry_is(q, 1, playlist_uri(p, 1), "caf\xC3\xA9 \xC3\xA9", -1));
+        CHECK(entry_is(q, 2, "http://host/s?a=1&b=<2>", f == PLAYLIST_FORMAT_XSPF ? "multi\nline" : "multi line", 3000));
+        playlist_destroy(q);
+    }
+    snprintf(out, sizeof(out), "%s/missing/out.m3u", dir);
+    CHECK(playlist_save(p, out, PLAYLIST_FORMAT_M3U) == -1);
+    playlist_destroy(p);
+
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    int files = 0;
+    while (d && (e = readdir(d))) {
+        if (e->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        unlink(path);
+        files++;
+    }
+    if (d) closedir(d);
+    CHECK(files == 6); /* the three inputs and three outputs, no temporaries */
+    rmdir(dir);
+    return 0;
+}
+
+/* 1M entries: build, save, destroy, load; the loaded copy must match */
+static int bench_million(void)
+{
+    const size_t n = 1000000;
+    char path[] = "/tmp/oxxy_pl_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+
+    char uri[160];
+    double t0 = now();
+    struct playlist *p = playlist_create();
+    for (size_t i = 0; i < n; ++i) {
+        int len = snprintf(uri, sizeof(uri), "/srv/radio/archive/%04zu/%02zu/show-%07zu - Some Artist - Some Title.mp3",
+                           1990 + i % 35, i % 12 + 1, i);
+        CHECK(playlist_add_n(p, uri, (size_t)len) == 0);
+    }
+    double t1 = now();
+    CHECK(playlist_save_m3u(p, path) == 0);
+    double t2 = now();
+    struct playlist *q = playlist_create();
+    CHECK(playlist_load_m3u(q, path) == 0);
+    double t3 = now();
+    CHECK(q->count == n);
+    for (size_t i = 0; i < n; i += 9973)
+        CHECK(q->items[i].len == p->items[i].len && strcmp(playlist_uri(q, i), playlist_uri(p, i)) == 0);
+    CHECK(strcmp(playlist_uri(q, n - 1), playlist_uri(p, n - 1)) == 0);
+    size_t chunks = q->nchunks;
+    playlist_destroy(p);
+    double t4 = now();
+    playlist_destroy(q);
+    double t5 = now();
+    q = playlist_create();
+    CHECK(playlist_load_with(q, path, PLAYLIST_LOAD_DEDUP) == (int)n);
+    double t6 = now();
+    playlist_destroy(q);
+    printf("playlist 1M: add %.0f ms, save %.0f ms, load %.0f ms (deduplicating %.0f ms), destroy %.1f ms, loaded into %zu arena chunk(s)\n",
+           (t1 - t0) * 1e3, (t2 - t1) * 1e3, (t3 - t2) * 1e3, (t6 - t5) * 1e3, ((t4 - t3) + (t5 - t4)) / 2 * 1e3, chunks);
+    unlink(path);
+    return 0;
+}
+
+static struct playlist *numbered(size_t n)
+{
+    struct playlist *p = playlist_create();
+    char uri[32];
+    for (size_t i = 0; p && i < n; ++i) {
+        snprintf(uri, sizeof(uri), "/m/%zu", i);
+        if (playlist_add(p, uri) != 0) { playlist_destroy(p); return NULL; }
+    }
+    return p;
+}
+
+/* one shuffled cycle visits every entry exactly once */
+static int check_cycle(struct playlist *p, unsigned char *seen)
+{
+    memset(seen, 0, p->count);
+    seen[p->pos] = 1;
+    for (size_t i = 1; i < p->count; ++i) {
+        size_t k = playlist_next(p);
+        CHECK(k < p->count && !seen[k]);
+        seen[k] = 1;
+    }
+    return 0;
+}
+
+static int test_order(void)
+{
+    static const size_t sizes[] = { 1, 2, 3, 5, 16, 17, 1000, 65537 };
+    unsigned char *seen = malloc(1000000);
+    CHECK(seen);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        struct playlist *p = numbered(sizes[s]);
+        CHECK(p);
+        playlist_set_shuffle(p, 1, 42 + s);
+        CHECK(check_cycle(p, seen) == 0);
+        CHECK(playlist_next(p) == PLAYLIST_END); /* repeat-none */
+        playlist_destroy(p);
+    }
+
+    /* sequential order, repeat modes */
+    struct playlist *p = numbered(3);
+    CHECK(playlist_next(p) == 1 && playlist_next(p) == 2 && playlist_next(p) == PLAYLIST_END && p->pos == 2);
+    CHECK(playlist_prev(p) == 1 && playlist_prev(p) == 0 && playlist_prev(p) == PLAYLIST_END);
+    playlist_set_repeat(p, PLAYLIST_REPEAT_ALL);
+    CHECK(playlist_prev(p) == 2 && playlist_next(p) == 0);
+    playlist_set_repeat(p, PLAYLIST_REPEAT_ONE);
+    CHECK(playlist_next(p) == 0 && playlist_peek_next(p) == 0 && playlist_skip(p) == 1);
+    CHECK(playlist_jump(p, 2) == 0 && playlist_skip(p) == 0 && playlist_jump(p, 3) == -1);
+    playlist_destroy(p);
+
+    /* shuffle: entries stay put, same seed replays, prev undoes next, repeat-all reshuffles */
+    p = numbered(1000);
+    size_t a[2000], b[2000];
+    playlist_set_repeat(p, PLAYLIST_REPEAT_ALL);
+    playlist_set_shuffle(p, 1, 7);
+    for (size_t i = 0; i < 2000; ++i) {
+        size_t peek = playlist_peek_next(p);
+        a[i] = playlist_next(p);
+        CHECK(a[i] == peek);
+    }
+    CHECK(memcmp(a, a + 1000, sizeof(size_t) * 1000) != 0);
+    for (size_t i = 1999; i > 0; --i) CHECK(playlist_prev(p) == a[i - 1]);
+    CHECK(playlist_prev(p) == 0); /* back where shuffle was turned on */
+    for (size_t i = 0; i < 1000; ++i) CHECK((size_t)atol(playlist_uri(p, i) + 3) == i);
+    playlist_set_shuffle(p, 1, 7);
+    for (size_t i = 0; i < 2000; ++i) b[i] = playlist_next(p);
+    CHECK(memcmp(a, b, sizeof(a)) == 0);
+
+    /* jump keeps the current cycle going from the chosen entry; off resumes in list order */
+    CHECK(playlist_jump(p, 500) == 0 && p->pos == 500);
+    playlist_set_repeat(p, PLAYLIST_REPEAT_NONE);
+    CHECK(check_cycle(p, seen) == 0);
+    playlist_set_shuffle(p, 0, 0);
+    size_t at = p->pos;
+    CHECK(at == 999 || playlist_next(p) == at + 1);
+
+    /* adding entries re-anchors at the current one */
+    playlist_set_shuffle(p, 1, 9);
+    playlist_next(p);
+    CHECK(playlist_add(p, "/m/1000") == 0);
+    CHECK(check_cycle(p, seen) == 0);
+    playlist_destroy(p);
+
+    /* toggling on a 1M playlist is O(1) */
+    p = numbered(1000000);
+    CHECK(p && playlist_jump(p, 123456) == 0);
+    double t0 = now();
+    playlist_shuffle(p);
+    double t1 = now();
+    CHECK(p->pos == 123456 && check_cycle(p, seen) == 0);
+    double t2 = now();
+    printf("shuffle 1M: toggle %.3f ms, full cycle %.0f ms\n", (t1 - t0) * 1e3, (t2 - t1) * 1e3);
+    CHECK(t1 - t0 < 0.001);
+    playlist_destroy(p);
+    free(seen);
+    return 0;
+}
+
+struct share_reader {
+    struct ox_plshare *s;
+    atomic_int *stop;
+    size_t reads, max_count;
+    double worst;
+    int bad;
+};
+
+/* every entry of a version reads back as "/m/<index>", counts only grow */
+static void *share_reader_main(void *arg)
+{
+    struct share_reader *r = arg;
+    while (!atomic_load(r->stop)) {
+        struct ox_plread rd;
+        double t0 = now();
+        const struct playlist *p = ox_plshare_read_begin(r->s, &rd);
+        size_t n = p->count;
+        if (n < r->max_count) r->bad = 1;
+        for (size_t i = n > 64 ? n - 64 : 0; i < n; ++i)
+            if ((size_t)atol(playlist_uri(p, i) + 3) != i) r->bad = 1;
+        ox_plshare_read_end(r->s, &rd);
+        double t = now() - t0;
+        if (t > r->worst) r->worst = t;
+        r->max_count = n;
+        r->reads++;
+    }
+    return NULL;
+}
+
+static int test_share(void)
+{
+    enum { READERS = 3, BATCHES = 200, BATCH = 1000 };
+    struct ox_plshare *s = ox_plshare_create(NULL);
+    CHECK(s);
+    atomic_int stop = 0;
+    struct share_reader rd[READERS];
+    pthread_t th[READERS];
+    for (int i = 0; i < READERS; ++i) {
+        rd[i] = (struct share_reader){ s, &stop, 0, 0, 0, 0 };
+        CHECK(pthread_create(&th[i], NULL, share_reader_main, &rd[i]) == 0);
+    }
+
+    /* a URI pinned from an old version must survive later publishes */
+    struct ox_plread r;
+    struct playlist *w = ox_plshare_edit(s);
+    CHECK(playlist_add(w, "/m/0") == 0 && ox_plshare_publish(s) == 0);
+    const struct playlist *first = ox_plshare_read_begin(s, &r);
+    CHECK(first->count == 1);
+    const char *uri0 = playlist_uri(first, 0);
+    ox_plshare_read_end(s, &r);
+
+    char uri[32];
+    size_t next = 1;
+    double t0 = now();
+    for (int b = 0; b < BATCHES; ++b) {
+        struct playlist *batch = playlist_create();
+        for (int i = 0; i < BATCH; ++i, ++next) {
+            snprintf(uri, sizeof(uri), "/m/%zu", next);
+            CHECK(playlist_add(batch, uri) == 0);
+        }
+        CHECK(ox_plshare_append(s, batch) == 0);
+        playlist_destroy(batch);
+        w = ox_plshare_edit(s); /* small edits batch into one version too */
+        snprintf(uri, sizeof(uri), "/m/%zu", next++);
+        CHECK(playlist_add(w, uri) == 0);
+        playlist_next(w);
+        CHECK(ox_plshare_publish(s) == 0);
+    }
+    double t1 = now();
+    atomic_store(&stop, 1);
+    size_t reads = 0;
+    double worst = 0;
+    for (int i = 0; i < READERS; ++i) {
+        pthread_join(th[i], NULL);
+        CHECK(!rd[i].bad);
+        reads += rd[i].reads;
+        if (rd[i].worst > worst) worst = rd[i].worst;
+    }
+    const struct playlist *last = ox_plshare_read_begin(s, &r);
+    CHECK(last->count == next && last->pos == BATCHES && strcmp(uri0, "/m/0") == 0);
+    ox_plshare_read_end(s, &r);
+    CHECK(ox_plshare_version(s) == 2 + 2 * BATCHES);
+    printf("plshare: %d versions up to %zu entries in %.0f ms, %zu reads, slowest read section %.3f ms\n",
+           2 * BATCHES, next, (t1 - t0) * 1e3, reads, worst * 1e3);
+    ox_plshare_destroy(s);
+    return 0;
+}
+
+/* publishing shares the entry arrays: its cost does not grow with the playlist */
+static int test_share_publish(void)
+{
+    enum { N = 1000000, EDITS = 100 };
+    struct ox_plshare *s = ox_plshare_create(NULL);
+    CHECK(s);
+    char uri[32];
+    struct playlist *w = ox_plshare_edit(s);
+    for (size_t i = 0; i < N; ++i) {
+        snprintf(uri, sizeof(uri), "/m/%zu", i);
+        CHECK(playlist_add(w, uri) == 0);
+    }
+    CHECK(ox_plshare_publish(s) == 0);
+
+    /* pinned across edits that outgrow the entry array */
+    struct ox_plread r;
+    const struct playlist *old = ox_plshare_read_begin(s, &r);
+    double worst = 0, total = 0;
+    size_t next = N;
+    for (int e = 0; e < EDITS; ++e) {
+        w = ox_plshare_edit(s);
+        snprintf(uri, sizeof(uri), "/m/%zu", next++);
+        CHECK(playlist_add(w, uri) == 0);
+        double t0 = now();
+        CHECK(ox_plshare_publish(s) == 0);
+        double t = now() - t0;
+        total += t;
+        if (t > worst) worst = t;
+    }
+    w = ox_plshare_edit(s);
+    size_t cap = w->capacity;
+    while (w->capacity == cap) {
+        snprintf(uri, sizeof(uri), "/m/%zu", next++);
+        CHECK(playlist_add(w, uri) == 0);
+    }
+    CHECK(ox_plshare_publish(s) == 0);
+    CHECK(old->count == N && strcmp(playlist_uri(old, N - 1), "/m/999999") == 0);
+    ox_plshare_read_end(s, &r);
+
+    const struct playlist *last = ox_plshare_read_begin(s, &r);
+    snprintf(uri, sizeof(uri), "/m/%zu", next - 1);
+    CHECK(last->count == next && strcmp(playlist_uri(last, next - 1), uri) == 0);
+    CHECK(strcmp(playlist_uri(last, 0), "/m/0") == 0);
+    ox_plshare_read_end(s, &r);
+    printf("plshare publish at 1M entries: avg %.4f ms, slowest %.4f ms\n", total / EDITS * 1e3, worst * 1e3);
+    CHECK(total / EDITS < 0.0001);
+    ox_plshare_destroy(s);
+    return 0;
+}
+
+int main(void)
+{
+    if (test_roundtrip() || test_formats() || test_order() || test_share() || test_share_publish() || bench_million()) {
+        fprintf(stderr, "playlist tests failed\n");
+        return 1;
+    }
+    printf("playlist tests passed\n");
+    return 0;
+}
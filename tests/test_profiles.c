@@ -0,0 +1,168 @@
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/json.h"
+#include "../src/profiles.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+static char cfg[512];
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int write_text(const char *name, const char *text, int via_rename)
+{
+    char path[600], tmp[600];
+    snprintf(path, sizeof(path), "%s/%s", cfg, name);
+    snprintf(tmp, sizeof(tmp), "%s/.tmp-%s", cfg, name);
+    FILE *f = fopen(via_rename ? tmp : path, "w");
+    if (!f) return -1;
+    fputs(text, f);
+    if (fclose(f) != 0) return -1;
+    return via_rename ? rename(tmp, path) : 0;
+}
+
+static char *file_text(const char *name)
+{
+    char path[600];
+    snprintf(path, sizeof(path), "%s/%s", cfg, name);
+    FILE *f = fopen(path, "r");
+    if (!f) return NULL;
+    static char buf[4096];
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    buf[n] = '\0';
+    fclose(f);
+    return buf;
+}
+
+/* the watcher applies external edits asynchronously */
+static int wait_for(const char *name, const char *want)
+{
+    for (int i = 0; i < 400; ++i) {
+        char *got = ox_profiles_load(name);
+        int match = want ? got && strcmp(got, want) == 0 : got == NULL;
+        free(got);
+        if (match) return 1;
+        nanosleep(&(struct timespec){ 0, 5000000 }, NULL);
+    }
+    return 0;
+}
+
+static int count_files(void)
+{
+    DIR *d = opendir(cfg);
+    struct dirent *e;
+    int n = 0;
+    while (d && (e = readdir(d))) n += strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0;
+    if (d) closedir(d);
+    return n;
+}
+
+int main(void)
+{
+    char root[] = "/tmp/oxxy_prof_XXXXXX";
+    CHECK(mkdtemp(root));
+    char xdg[256], path[600];
+    snprintf(xdg, sizeof(xdg), "%s/config", root);
+    setenv("XDG_CONFIG_HOME", xdg, 1);
+    snprintf(cfg, sizeof(cfg), "%s/oxxy", xdg);
+
+    /* existing profiles are picked up at init */
+    CHECK(mkdir(xdg, 0700) == 0 && mkdir(cfg, 0700) == 0);
+    CHECK(write_text("alice.json", "{\"name\":\"alice\"}", 0) == 0);
+    CHECK(ox_profiles_init() == 0 && ox_profiles_init() == 0);
+    char *s = ox_profiles_load("alice");
+    CHECK(s && strcmp(s, "{\"name\":\"alice\"}") == 0);
+    free(s);
+    CHECK(!ox_profiles_load("nobody"));
+    CHECK(ox_profiles_save("../evil", "{}") == -1 && ox_profiles_save(".hidden", "{}") == -1 && ox_profiles_save("", "{}") == -1);
+
+    /* a burst of saves is visible at once and written once, atomically */
+    int in = inotify_init1(IN_NONBLOCK);
+    CHECK(in >= 0 && inotify_add_watch(in, cfg, IN_MOVED_TO | IN_CLOSE_WRITE) >= 0);
+    char blob[64];
+    for (int i = 0; i < 50; ++i) {
+        snprintf(blob, sizeof(blob), "{\"name\":\"bob\",\"rev\":%d}", i);
+        CHECK(ox_profiles_save("bob", blob) == 0);
+        s = ox_profiles_load("bob");
+        CHECK(s && strcmp(s, blob) == 0);
+        free(s);
+    }
+    CHECK(ox_profiles_flush() == 0);
+    CHECK(file_text("bob.json") && strcmp(file_text("bob.json"), blob) == 0);
+    _Alignas(struct inotify_event) char ev[4096];
+    ssize_t n = read(in, ev, sizeof(ev));
+    int renames = 0;
+    for (char *e = ev; n > 0 && e < ev + n; e += sizeof(struct inotify_event) + ((struct inotify_event *)e)->len) {
+        const struct inotify_event *ie = (const struct inotify_event *)e;
+        if ((ie->mask & IN_MOVED_TO) && strcmp(ie->name, "bob.json") == 0) renames++;
+    }
+    close(in);
+    CHECK(renames == 1);
+    CHECK(count_files() == 2); /* no temporaries left behind */
+    s = ox_profiles_list_json();
+    CHECK(s && strstr(s, "\"alice.json\"") && strstr(s, "\"bob.json\""));
+    free(s);
+
+    /* external edits: in-place rewrite, rename into place, delete */
+    CHECK(write_text("alice.json", "{\"name\":\"alice\",\"v\":2}", 0) == 0);
+    CHECK(wait_for("alice", "{\"name\":\"alice\",\"v\":2}"));
+    CHECK(write_text("carol.json", "{\"name\":\"carol\"}", 1) == 0);
+    CHECK(wait_for("carol", "{\"name\":\"carol\"}"));
+    snprintf(path, sizeof(path), "%s/alice.json", cfg);
+    CHECK(unlink(path) == 0);
+    CHECK(wait_for("alice", NULL));
+    s = ox_profiles_list_json();
+    CHECK(s && !strstr(s, "alice") && strstr(s, "\"carol.json\""));
+    free(s);
+
+    /* the list stays valid JSON whatever the names hold */
+    CHECK(ox_profiles_save("say \"hi\" \\o/", "{}") != 0); /* no '/' */
+    CHECK(ox_profiles_save("say \"hi\" \\o", "{}") == 0);
+    s = ox_profiles_list_json();
+    struct ox_json *list = s ? ox_json_parse(s, strlen(s)) : NULL;
+    CHECK(list && list->type == OX_JSON_T_ARRAY);
+    int found = 0;
+    for (const struct ox_json *e = list->child; e; e = e->next)
+        if (e->str && strcmp(e->str, "say \"hi\" \\o.json") == 0) found++;
+    CHECK(found == 1);
+    ox_json_free(list);
+    free(s);
+
+    /* switching profiles is memory only */
+    double t0 = now();
+    for (int i = 0; i < 100000; ++i) free(ox_profiles_load(i & 1 ? "bob" : "carol"));
+    double t1 = now();
+    printf("profiles: load %.0f ns/call from memory\n", (t1 - t0) / 100000 * 1e9);
+
+    /* shutdown writes what is pending; a new store sees it */
+    CHECK(ox_profiles_save("dave", "{\"name\":\"dave\"}") == 0);
+    ox_profiles_shutdown();
+    CHECK(file_text("dave.json") && strcmp(file_text("dave.json"), "{\"name\":\"dave\"}") == 0);
+    s = ox_profiles_load("dave"); /* initialises on demand */
+    CHECK(s && strcmp(s, "{\"name\":\"dave\"}") == 0);
+    free(s);
+    ox_profiles_shutdown();
+
+    const char *names[] = { "bob.json", "carol.json", "dave.json", "say \"hi\" \\o.json" };
+    for (int i = 0; i < 4; ++i) {
+        snprintf(path, sizeof(path), "%s/%s", cfg, names[i]);
+        unlink(path);
+    }
+    rmdir(cfg);
+    rmdir(xdg);
+    rmdir(root);
+    printf("profiles tests passed\n");
+    return 0;
+}
@@ -0,0 +1,90 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../src/scanner.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+struct tally { int results; int tagged; int finished; };
+
+static void on_result(const struct ox_scan_result *r, void *user)
+{
+    struct tally *t = user;
+    t->results++;
+    if (strncmp(r->meta.title, "Song ", 5) == 0) t->tagged++;
+}
+
+static void on_progress(const struct ox_scan_progress *p, void *user)
+{
+    struct tally *t = user;
+    if (p->finished) t->finished = 1;
+}
+
+static void write_mp3(const char *path, int n)
+{
+    unsigned char buf[64]; memset(buf, 0, sizeof(buf));
+    char title[16]; int tl = snprintf(title, sizeof(title), "Song %d", n);
+    memcpy(buf, "ID3\x03\0\0\0\0\0", 9); buf[9] = (unsigned char)(10 + 1 + tl);
+    memcpy(buf + 10, "TIT2", 4); buf[17] = (unsigned char)(1 + tl);
+    memcpy(buf + 21, title, (size_t)tl);
+    FILE *f = fopen(path, "wb");
+    if (!f) return;
+    fwrite(buf, 1, sizeof(buf), f);
+    fclose(f);
+}
+
+static int run(const char *root, int no_uring)
+{
+    struct tally t = {0};
+    struct ox_scan_opts o = {0};
+    o.threads = 4; o.batch = 4; o.no_io_uring = no_uring;
+    o.on_result = on_result; o.on_progress = on_progress; o.user = &t;
+    const char *roots[] = { root };
+    struct ox_scanner *s = ox_scanner_start(roots, 1, &o);
+    CHECK(s != NULL);
+    CHECK(ox_scanner_wait(s) == 0);
+    printf("scan (%s): results=%d tagged=%d\n", no_uring ? "pread" : "default", t.results, t.tagged);
+    CHECK(t.results == 31 && t.tagged == 31 && t.finished);
+    return 0;
+}
+
+int main(void)
+{
+    char root[] = "/tmp/oxxy_scan_XXXXXX";
+    if (!mkdtemp(root)) return 1;
+    char path[512];
+    for (int d = 0; d < 5; ++d) {
+        snprintf(path, sizeof(path), "%s/artist%d", root, d); mkdir(path, 0700);
+        snprintf(path, sizeof(path), "%s/artist%d/album", root, d); mkdir(path, 0700);
+        for (int i = 0; i < 6; ++i) {
+            snprintf(path, sizeof(path), "%s/artist%d/album/%02d.mp3", root, d, i);
+            write_mp3(path, d * 10 + i);
+        }
+        snprintf(path, sizeof(path), "%s/artist%d/cover.jpg", root, d);
+        FILE *f = fopen(path, "wb"); if (f) fclose(f);
+    }
+    /* a symlinked file is read, a symlinked directory (here a loop) is not */
+    char link[512];
+    snprintf(path, sizeof(path), "%s/artist0/album/00.mp3", root);
+    snprintf(link, sizeof(link), "%s/artist1/linked.mp3", root);
+    int rc = symlink(path, link);
+    snprintf(link, sizeof(link), "%s/artist2/loop", root);
+    rc = rc || symlink(root, link);
+    rc = rc || run(root, 0) || run(root, 1);
+    unlink(link);
+    snprintf(link, sizeof(link), "%s/artist1/linked.mp3", root);
+    unlink(link);
+    for (int d = 0; d < 5; ++d) {
+        for (int i = 0; i < 6; ++i) { snprintf(path, sizeof(path), "%s/artist%d/album/%02d.mp3", root, d, i); unlink(path); }
+        snprintf(path, sizeof(path), "%s/artist%d/cover.jpg", root, d); unlink(path);
+        snprintf(path, sizeof(path), "%s/artist%d/album", root, d); rmdir(path);
+        snprintf(path, sizeof(path), "%s/artist%d", root, d); rmdir(path);
+    }
+    rmdir(root);
+    if (rc) { fprintf(stderr, "scanner tests failed\n"); return 1; }
+    printf("scanner tests passed\n");
+    return 0;
+}
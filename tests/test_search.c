@@ -0,0 +1,269 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/search.h"
+#include "../src/utf8.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+static const struct ox_search_doc docs[] = {
+    { "Crazy in Love", "Beyoncé", "Dangerously in Love" },
+    { "Lovely", "Billie Eilish", "Lovely" },
+    { "Love Will Tear Us Apart", "Joy Division", "Substance" },
+    { "Around the World", "Daft Punk", "Homework" },
+    { "Ёлка", "Кино", "Звезда по имени Солнце" },
+    { "Don't Stop Me Now", "Queen", "Jazz" },
+    { "Love Love Love", "Various", "Love" },
+    { "Straße", NULL, NULL },
+};
+#define NDOCS (sizeof(docs) / sizeof(docs[0]))
+
+static int test_fold(void)
+{
+    char out[128];
+    ox_utf8_fold("Beyoncé – Crazy", out, sizeof(out));
+    CHECK(strcmp(out, "beyonce   crazy") == 0);
+    ox_utf8_fold("ËLKA Straße Ærø", out, sizeof(out));
+    CHECK(strcmp(out, "elka strasse aero") == 0);
+    ox_utf8_fold("Ёлка, КИНО", out, sizeof(out));
+    CHECK(strcmp(out, "елка  кино") == 0);
+    ox_utf8_fold("Don't", out, sizeof(out));
+    CHECK(strcmp(out, "dont") == 0);
+    /* truncation never splits a sequence */
+    CHECK(ox_utf8_fold("ЖЖЖ", out, 4) == 2 && strcmp(out, "ж") == 0);
+    /* decoding: one code point per call, bad bytes one at a time */
+    const char *p = "aЖ\xe2\x80\xa6\xf0\x9f\x8e\xb5\xff\xc3";
+    CHECK(ox_utf8_next(&p) == 'a' && ox_utf8_next(&p) == 0x416 && ox_utf8_next(&p) == 0x2026);
+    CHECK(ox_utf8_next(&p) == 0x1F3B5 && ox_utf8_next(&p) == 0xFFFD && ox_utf8_next(&p) == 0xFFFD && *p == '\0');
+    return 0;
+}
+
+static int has(const struct ox_search_hit *h, size_t n, uint32_t doc)
+{
+    for (size_t i = 0; i < n; ++i) if (h[i].doc == doc) return 1;
+    return 0;
+}
+
+static int check_queries(const struct ox_search *s)
+{
+    struct ox_search_hit h[16];
+    size_t n = ox_search_query(s, "beyonce", h, 16);
+    CHECK(n == 1 && h[0].doc == 0);
+    n = ox_search_query(s, "BEYON", h, 16);
+    CHECK(n == 1 && h[0].doc == 0);
+    n = ox_search_query(s, "елка", h, 16);
+    CHECK(n == 1 && h[0].doc == 4);
+    n = ox_search_query(s, "кино ёл", h, 16);
+    CHECK(n == 1 && h[0].doc == 4);
+    n = ox_search_query(s, "daft wor", h, 16);
+    CHECK(n == 1 && h[0].doc == 3);
+    n = ox_search_query(s, "dont stop", h, 16);
+    CHECK(n == 1 && h[0].doc == 5);
+    n = ox_search_query(s, "strasse", h, 16);
+    CHECK(n == 1 && h[0].doc == 7);
+    n = ox_search_query(s, "zzz", h, 16);
+    CHECK(n == 0);
+    n = ox_search_query(s, "daft zzz", h, 16);
+    CHECK(n == 0);
+    /* exact title word beats title prefix, which beats an album-only match */
+    n = ox_search_query(s, "love", h, 16);
+    CHECK(n == 4 && has(h, n, 0) && has(h, n, 2) && has(h, n, 6));
+    CHECK(h[3].doc == 1 && h[0].score > h[3].score);
+    n = ox_search_query(s, "love", h, 2);
+    CHECK(n == 2 && h[0].doc == 0 && h[1].doc == 2);
+    return 0;
+}
+
+static int test_build_and_persist(void)
+{
+    struct ox_search *s = ox_search_build(docs, NDOCS, 2);
+    CHECK(s != NULL && ox_search_count(s) == NDOCS);
+    if (check_queries(s)) return 1;
+
+    char path[] = "/tmp/oxxy_search_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    CHECK(ox_search_save(s, path) == 0);
+    ox_search_close(s);
+    s = ox_search_open(path);
+    unlink(path);
+    CHECK(s != NULL && ox_search_count(s) == NDOCS);
+    if (check_queries(s)) return 1;
+    ox_search_close(s);
+
+    s = ox_search_build(NULL, 0, 0);
+    CHECK(s != NULL);
+    struct ox_search_hit h[4];
+    CHECK(ox_search_query(s, "love", h, 4) == 0);
+    ox_search_close(s);
+    return 0;
+}
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Reference ranking for test_large's ASCII docs: every word at a word start
+ * of some field, best field weight per word, +5 for a whole word. */
+static unsigned ref_word(const struct ox_search_doc *d, const char *w)
+{
+    const char *fields[3] = { d->title, d->artist, d->album };
+    static const unsigned weight[3] = { 30, 20, 10 };
+    size_t len = strlen(w);
+    unsigned best = 0;
+    for (int f = 0; f < 3; ++f) {
+        for (const char *p = fields[f]; *p; ) {
+            while (*p == ' ') p++;
+            const char *e = p;
+            while (*e && *e != ' ') e++;
+            if ((size_t)(e - p) >= len && strncasecmp(p, w, len) == 0) {
+                unsigned sc = weight[f] + ((size_t)(e - p) == len ? 5 : 0);
+                if (sc > best) best = sc;
+            }
+            p = e;
+        }
+    }
+    return best;
+}
+
+static int ref_check(const struct ox_search_doc *d, size_t n, const char *query, const struct ox_search_hit *h, size_t nh)
+{
+    char q[64], *words[8];
+    size_t nw = 0;
+    snprintf(q, sizeof(q), "%s", query);
+    for (char *t = strtok(q, " "); t && nw < 8; t = strtok(NULL, " ")) words[nw++] = t;
+    struct ox_search_hit want[50];
+    size_t nwant = 0;
+    for (size_t i = 0; i < n; ++i) {
+        unsigned sc = 0;
+        for (size_t w = 0; w < nw; ++w) {
+            unsigned ws = ref_word(&d[i], words[w]);
+            if (!ws) { sc = 0; break; }
+            sc += ws;
+        }
+        if (!sc) continue;
+        /* insertion into a sorted top 50: score down, doc up */
+        size_t at = nwant;
+        while (at > 0 && want[at - 1].score < sc) at--;
+        if (at == 50) continue;
+        if (nwant < 50) nwant++;
+        memmove(&want[at + 1], &want[at], (nwant - 1 - at) * sizeof(*want));
+        want[at] = (struct ox_search_hit){ (uint32_t)i, sc };
+    }
+    CHECK(nh == nwant);
+    for (size_t i = 0; i < nh; ++i) CHECK(h[i].doc == want[i].doc && h[i].score == want[i].score);
+    return 0;
+}
+
+/* "1" and "12" span more than a few hundred number terms: the index keeps
+ * their merged postings, saved and mapped with the rest */
+static int test_wide_prefix(void)
+{
+    enum { N = 3000 };
+    struct ox_search_doc *d = malloc(N * sizeof(*d));
+    char *text = malloc((size_t)N * 64);
+    CHECK(d && text);
+    for (size_t i = 0; i < N; ++i) {
+        char *t = text + i * 64;
+        snprintf(t, 24, "Track %zu", i);
+        snprintf(t + 24, 20, "Band %zu", i % 97);
+        snprintf(t + 44, 20, "Album %zu", (i * 7) % 1500);
+        d[i].title = t; d[i].artist = t + 24; d[i].album = t + 44;
+    }
+    static const char *queries[] = { "1", "12", "1 b", "track 1", "band 12", "12 1", "alb 14" };
+    char path[] = "/tmp/oxxy_search_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    struct ox_search *s = ox_search_build(d, N, 2);
+    CHECK(s && ox_search_save(s, path) == 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); ++q) {
+            struct ox_search_hit h[50];
+            size_t n = ox_search_query(s, queries[q], h, 50);
+            if (ref_check(d, N, queries[q], h, n)) return 1;
+        }
+        ox_search_close(s);
+        s = pass == 0 ? ox_search_open(path) : NULL;
+        CHECK(pass == 1 || s);
+    }
+    unlink(path);
+    free(text);
+    free(d);
+    return 0;
+}
+
+static int test_large(void)
+{
+    enum { N = 1000000 };
+    static const char *words[] = { "love", "night", "dance", "heart", "fire", "rain", "summer", "blue",
+                                   "dream", "light", "road", "home", "star", "river", "gold", "shadow" };
+    struct ox_search_doc *d = malloc(N * sizeof(*d));
+    char *text = malloc((size_t)N * 96);
+    CHECK(d && text);
+    unsigned x = 12345;
+    for (size_t i = 0; i < N; ++i) {
+        char *t = text + i * 96;
+        x = x * 1103515245u + 12345u; unsigned a = x >> 16;
+        x = x * 1103515245u + 12345u; unsigned b = x >> 16;
+        snprintf(t, 48, "%s %s %u", words[a % 16], words[b % 16], (unsigned)i);
+        snprintf(t + 48, 24, "Artist %u", a % 5000);
+        snprintf(t + 72, 24, "Album %u", b % 20000);
+        d[i].title = t; d[i].artist = t + 48; d[i].album = t + 72;
+    }
+    double t0 = now_ms();
+    struct ox_search *s = ox_search_build(d, N, 0);
+    double t1 = now_ms();
+    CHECK(s != NULL);
+    /* short prefixes of several words match a large share of the docs:
+     * each keystroke must still answer at interactive latency */
+    static const char *queries[] = { "l", "lo", "love", "love ni", "artist 42", "199999", "gold sha",
+                                     "album 1", "s s s", "l a", "artist 4", "a a", "1 2", "a l b 1",
+                                     "1", "al 1", "s 1 2 3" };
+    static const char *checked[] = { "album 1", "s s s", "l a", "artist 4", "love ni" };
+    struct ox_search_hit h[50];
+    size_t n = 0;
+    double worst = 0;
+    const char *slowest = "";
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); ++q) {
+        double best = 1e9;
+        for (int r = 0; r < 3; ++r) { /* best of three: scheduling noise is not the query */
+            double a = now_ms();
+            n = ox_search_query(s, queries[q], h, 50);
+            double b = now_ms();
+            if (b - a < best) best = b - a;
+        }
+        if (best > worst) { worst = best; slowest = queries[q]; }
+        CHECK(n > 0);
+    }
+    for (size_t q = 0; q < sizeof(checked) / sizeof(checked[0]); ++q) {
+        n = ox_search_query(s, checked[q], h, 50);
+        if (ref_check(d, N, checked[q], h, n)) return 1;
+    }
+    n = ox_search_query(s, "199999", h, 50);
+    CHECK(n == 1 && h[0].doc == 199999);
+    printf("search: %d docs built in %.1f ms, slowest query %.3f ms (\"%s\")\n", N, t1 - t0, worst, slowest);
+    CHECK(worst < 1.0);
+    ox_search_close(s);
+    free(text);
+    free(d);
+    return 0;
+}
+
+int main(void)
+{
+    if (test_fold() || test_build_and_persist() || test_wide_prefix() || test_large()) {
+        fprintf(stderr, "search tests failed\n");
+        return 1;
+    }
+    printf("search tests passed\n");
+    return 0;
+}
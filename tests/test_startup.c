@@ -0,0 +1,73 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/startup.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+static void *mark_from_thread(void *arg)
+{
+    (void)arg;
+    ox_startup_mark("background");
+    return NULL;
+}
+
+int main(void)
+{
+    CHECK(ox_startup_ms("profiles") < 0.0);
+    ox_startup_begin();
+    sleep_ms(20);
+    ox_startup_mark("profiles");
+    double profiles = ox_startup_ms("profiles");
+    CHECK(profiles >= 15.0 && profiles < 5000.0);
+
+    /* only the first mark of a phase counts; names compare by content */
+    sleep_ms(10);
+    char again[16];
+    snprintf(again, sizeof(again), "%s", "profiles");
+    ox_startup_mark(again);
+    CHECK(ox_startup_ms("profiles") == profiles);
+    /* a second begin does not move the origin */
+    ox_startup_begin();
+    CHECK(ox_startup_ms("profiles") == profiles);
+
+    pthread_t t;
+    CHECK(pthread_create(&t, NULL, mark_from_thread, NULL) == 0);
+    pthread_join(t, NULL);
+    ox_startup_mark("first-frame");
+    CHECK(ox_startup_ms("background") >= profiles);
+    CHECK(ox_startup_ms("first-frame") >= ox_startup_ms("background"));
+    CHECK(ox_startup_ms("never") < 0.0);
+    CHECK(ox_startup_ms(NULL) < 0.0);
+    ox_startup_mark(NULL);
+
+    /* the report lists phases in the order they were reached */
+    char buf[512] = {0};
+    FILE *f = fmemopen(buf, sizeof(buf) - 1, "w");
+    CHECK(f);
+    ox_startup_report(f);
+    fclose(f);
+    char *p = strstr(buf, " profiles\n"), *b = strstr(buf, " background\n"), *ff = strstr(buf, " first-frame\n");
+    CHECK(p && b && ff && p < b && b < ff);
+    CHECK(!strstr(p + 1, " profiles\n"));
+
+    /* the table is bounded */
+    static char names[OX_STARTUP_MAX_PHASES + 8][8];
+    for (int i = 0; i < OX_STARTUP_MAX_PHASES + 8; ++i) {
+        snprintf(names[i], sizeof(names[i]), "p%d", i);
+        ox_startup_mark(names[i]);
+    }
+    CHECK(ox_startup_ms(names[OX_STARTUP_MAX_PHASES + 7]) < 0.0);
+
+    printf("startup tests passed\n");
+    return 0;
+}
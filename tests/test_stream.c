@@ -0,0 +1,240 @@
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/stream.h"
+#include "http_stub.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+#define SIZE (12 * OX_STREAM_CHUNK + 12345)
+
+/* a file server: /file honours Range, /plain ignores it, /nolen ignores it
+ * and sends no length; anything else is a 404 */
+static struct http_stub stub;
+static struct {
+    _Atomic int delay_ms;     /* per 64 KiB sent */
+} srv;
+
+static unsigned char byte_at(uint64_t i)
+{
+    return (unsigned char)((i * 2654435761u) >> 13 ^ i);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleep_ms(int ms)
+{
+    nanosleep(&(struct timespec){ ms / 1000, (ms % 1000) * 1000000L }, NULL);
+}
+
+static int send_body(int fd, uint64_t from, uint64_t to)
+{
+    static _Thread_local unsigned char buf[65536];
+    while (from < to) {
+        size_t n = to - from < sizeof(buf) ? (size_t)(to - from) : sizeof(buf);
+        for (size_t i = 0; i < n; ++i) buf[i] = byte_at(from + i);
+        if (srv.delay_ms) sleep_ms(srv.delay_ms);
+        if (http_stub_send_all(fd, buf, n) != 0) return -1;
+        from += n;
+    }
+    return 0;
+}
+
+static int on_request(int fd, const char *req, void *user)
+{
+    (void)user;
+    char head[256];
+    int rc, keep = 1;
+    const char *range = strstr(req, "Range: bytes=");
+    unsigned long long a = 0, b = SIZE - 1;
+    if (strncmp(req, "GET /file", 9) == 0 && range && sscanf(range + 13, "%llu-%llu", &a, &b) >= 1) {
+        if (b >= SIZE) b = SIZE - 1;
+        int n = snprintf(head, sizeof(head),
+                         "HTTP/1.1 206 Partial\r\nContent-Range: bytes %llu-%llu/%u\r\nContent-Length: %llu\r\n\r\n",
+                         a, b, SIZE, b - a + 1);
+        rc = http_stub_send_all(fd, head, (size_t)n) == 0 ? send_body(fd, a, b + 1) : -1;
+    } else if (strncmp(req, "GET /file", 9) == 0 || strncmp(req, "GET /plain", 10) == 0) {
+        int n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Length: %u\r\n\r\n", SIZE);
+        rc = http_stub_send_all(fd, head, (size_t)n) == 0 ? send_body(fd, 0, SIZE) : -1;
+    } else if (strncmp(req, "GET /nolen", 10) == 0) {
+        const char *h = "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n";
+        rc = http_stub_send_all(fd, h, strlen(h)) == 0 ? send_body(fd, 0, SIZE) : -1;
+        keep = 0;
+    } else {
+        const char *h = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        rc = http_stub_send_all(fd, h, strlen(h));
+    }
+    return rc == 0 && keep ? 0 : -1;
+}
+
+/* [off, off + n) of the stream holds the server's pattern */
+static int matches(const unsigned char *p, uint64_t off, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        if (p[i] != byte_at(off + i)) return 0;
+    return 1;
+}
+
+/* reads the whole stream in odd-sized pieces */
+static int read_all(struct ox_stream *s)
+{
+    static unsigned char buf[100000];
+    uint64_t off = 0;
+    ssize_t r;
+    while ((r = ox_stream_read(s, off, buf, sizeof(buf))) > 0) {
+        if (!matches(buf, off, (size_t)r)) return 0;
+        off += (uint64_t)r;
+    }
+    return r == 0 && off == SIZE;
+}
+
+static int count_files(const char *dir, char *first, size_t cap)
+{
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    int n = 0;
+    while (d && (e = readdir(d))) {
+        if (!strstr(e->d_name, ".oxs") || e->d_name[0] == '.') continue;
+        if (n++ == 0 && first) snprintf(first, cap, "%s/%s", dir, e->d_name);
+    }
+    if (d) closedir(d);
+    return n;
+}
+
+static void remove_dir(const char *dir)
+{
+    char path[512];
+    while (count_files(dir, path, sizeof(path)) > 0) unlink(path);
+    rmdir(dir);
+}
+
+int main(void)
+{
+    char url[128], dir[] = "/tmp/oxs-test-XXXXXX", path[512];
+    unsigned char buf[4096];
+    struct ox_stream_stats st;
+
+    /* local files go straight to pread */
+    char local[] = "/tmp/oxs-local-XXXXXX";
+    int lfd = mkstemp(local);
+    CHECK(lfd >= 0 && write(lfd, "hello stream", 12) == 12);
+    close(lfd);
+    struct ox_stream *s = ox_stream_open(NULL, local);
+    CHECK(s && ox_stream_size(s) == 12 && ox_stream_read(s, 6, buf, 100) == 6 && memcmp(buf, "stream", 6) == 0);
+    CHECK(ox_stream_read(s, 12, buf, 1) == 0);
+    ox_stream_close(s);
+    snprintf(url, sizeof(url), "file://%s", local);
+    s = ox_stream_open(NULL, url);
+    CHECK(s && ox_stream_read(s, 0, buf, 5) == 5 && memcmp(buf, "hello", 5) == 0);
+    ox_stream_close(s);
+    unlink(local);
+
+    CHECK(http_stub_start(&stub, on_request, NULL) == 0);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/file", stub.port);
+    s = ox_stream_open(NULL, url);
+    if (!s) {
+        printf("stream tests skipped (no libcurl)\n");
+        return 0;
+    }
+    ox_stream_close(s);
+    CHECK(mkdtemp(dir));
+    struct ox_stream_cache *c = ox_stream_cache_create(dir, 0);
+    CHECK(c);
+
+    /* open returns with the first chunk, long before the whole file */
+    srv.delay_ms = 10;
+    double t0 = now();
+    s = ox_stream_open(c, url);
+    double t1 = now();
+    CHECK(s && ox_stream_size(s) == SIZE);
+    ox_stream_stats(s, &st);
+    CHECK(st.net_bytes < SIZE / 2);
+    printf("stream: open after %.0f ms with %llu of %u bytes\n", (t1 - t0) * 1e3, (unsigned long long)st.net_bytes,
+           SIZE);
+
+    /* a seek near the end is served without downloading what lies between */
+    CHECK(ox_stream_read(s, SIZE - 1000, buf, sizeof(buf)) == 1000 && matches(buf, SIZE - 1000, 1000));
+    ox_stream_stats(s, &st);
+    CHECK(st.net_bytes < SIZE / 2);
+    CHECK(ox_stream_read(s, SIZE, buf, 1) == 0);
+
+    /* reading it all fills the gaps */
+    srv.delay_ms = 0;
+    CHECK(read_all(s));
+    ox_stream_stats(s, &st);
+    CHECK(st.net_bytes < SIZE + 2 * OX_STREAM_CHUNK);
+    ox_stream_close(s);
+
+    /* a second open is served from the cache file alone */
+    atomic_store(&stub.requests, 0);
+    s = ox_stream_open(c, url);
+    CHECK(s && read_all(s));
+    ox_stream_stats(s, &st);
+    CHECK(st.requests == 0 && st.net_bytes == 0 && st.cached_chunks == 13);
+    ox_stream_close(s);
+    CHECK(atomic_load(&stub.requests) == 0);
+
+    /* a damaged chunk is detected and fetched again */
+    CHECK(count_files(dir, path, sizeof(path)) == 1);
+    int fd = open(path, O_RDWR);
+    off_t at = lseek(fd, 0, SEEK_END) - SIZE + 5 * OX_STREAM_CHUNK + 77;
+    CHECK(fd >= 0 && pwrite(fd, "\xff\x00", 2, at) == 2);
+    close(fd);
+    s = ox_stream_open(c, url);
+    CHECK(s && read_all(s));
+    ox_stream_stats(s, &st);
+    CHECK(st.requests == 1 && st.net_bytes == OX_STREAM_CHUNK);
+    ox_stream_close(s);
+
+    /* a server without Range support is read front to back */
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/plain", stub.port);
+    s = ox_stream_open(c, url);
+    CHECK(s && ox_stream_size(s) == SIZE);
+    CHECK(ox_stream_read(s, SIZE / 2, buf, sizeof(buf)) == sizeof(buf) && matches(buf, SIZE / 2, sizeof(buf)));
+    CHECK(read_all(s));
+    ox_stream_stats(s, &st);
+    CHECK(st.requests == 1);
+    ox_stream_close(s);
+
+    /* ... and without a length the size is known at the end */
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/nolen", stub.port);
+    s = ox_stream_open(c, url);
+    CHECK(s && read_all(s) && ox_stream_size(s) == SIZE);
+    ox_stream_close(s);
+
+    /* failures */
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/missing", stub.port);
+    CHECK(!ox_stream_open(c, url));
+    CHECK(!ox_stream_open(c, "/nonexistent/file.mp3"));
+    ox_stream_cache_destroy(c);
+
+    /* the least recently used file goes once the cache is over its cap */
+    c = ox_stream_cache_create(dir, 2 * OX_STREAM_CHUNK);
+    CHECK(c && count_files(dir, NULL, 0) <= 1);
+    remove_dir(dir);
+    CHECK(mkdir(dir, 0700) == 0);
+    for (int i = 0; i < 3; ++i) {
+        snprintf(url, sizeof(url), "http://127.0.0.1:%d/file?copy=%d", stub.port, i);
+        s = ox_stream_open(c, url);
+        CHECK(s && read_all(s));
+        ox_stream_close(s);
+        CHECK(count_files(dir, NULL, 0) == 1);
+    }
+    ox_stream_cache_destroy(c);
+    remove_dir(dir);
+
+    printf("stream tests passed\n");
+    return 0;
+}
@@ -0,0 +1,180 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/json.h"
+#include "../src/trace.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+#define SPANS 1000
+#define WRITERS 3
+
+static void *writer(void *arg)
+{
+    (void)arg;
+    OX_TRACE_THREAD("writer");
+    for (int i = 0; i < SPANS; ++i) {
+        OX_TRACE_BEGIN("work");
+        OX_TRACE_COUNTER("i", i);
+        OX_TRACE_END("work");
+    }
+    return NULL;
+}
+
+static void *brief(void *arg)
+{
+    (void)arg;
+    OX_TRACE_THREAD("brief");
+    OX_TRACE_INSTANT("hello");
+    return NULL;
+}
+
+/* laps its ring while the main thread exports */
+static void *flood(void *arg)
+{
+    (void)arg;
+    OX_TRACE_THREAD("flood");
+    for (int i = 0; i < OX_TRACE_EVENTS * 8; ++i) OX_TRACE_INSTANT("tick");
+    return NULL;
+}
+
+/* counters whose name tells the parity of their value: a torn record
+ * pairs the name of one event with the value of another */
+static void *parity(void *arg)
+{
+    (void)arg;
+    OX_TRACE_THREAD("parity");
+    for (int i = 0; i < OX_TRACE_EVENTS * 8; ++i) OX_TRACE_COUNTER(i & 1 ? "odd" : "even", i);
+    return NULL;
+}
+
+struct counts {
+    int begin, end, counter, instant, threads, torn;
+    int named_main, writers, briefs;
+};
+
+static void tally(const struct ox_json *doc, struct counts *c)
+{
+    memset(c, 0, sizeof(*c));
+    const struct ox_json *events = ox_json_get(doc, "traceEvents");
+    for (const struct ox_json *e = events ? events->child : NULL; e; e = e->next) {
+        const struct ox_json *ph = ox_json_get(e, "ph"), *name = ox_json_get(e, "name");
+        if (!ph || !name || !ph->str || !name->str) continue;
+        if (strcmp(ph->str, "B") == 0) c->begin++;
+        else if (strcmp(ph->str, "E") == 0) c->end++;
+        else if (strcmp(ph->str, "C") == 0) {
+            c->counter++;
+            const struct ox_json *args = ox_json_get(e, "args");
+            const struct ox_json *v = args ? ox_json_get(args, "value") : NULL;
+            int odd = strcmp(name->str, "odd") == 0;
+            if ((odd || strcmp(name->str, "even") == 0) && (!v || !v->str || (atoll(v->str) & 1) != odd)) c->torn++;
+        }
+        else if (strcmp(ph->str, "i") == 0) c->instant++;
+        else if (strcmp(ph->str, "M") == 0 && strcmp(name->str, "thread_name") == 0) {
+            c->threads++;
+            const struct ox_json *args = ox_json_get(e, "args");
+            const struct ox_json *n = args ? ox_json_get(args, "name") : NULL;
+            if (n && n->str && strcmp(n->str, "main \"quoted\"") == 0) c->named_main++;
+            if (n && n->str && strcmp(n->str, "writer") == 0) c->writers++;
+            if (n && n->str && strcmp(n->str, "brief") == 0) c->briefs++;
+        }
+    }
+}
+
+static struct ox_json *read_doc(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    rewind(f);
+    char *buf = len > 0 ? malloc((size_t)len) : NULL;
+    size_t n = buf ? fread(buf, 1, (size_t)len, f) : 0;
+    fclose(f);
+    struct ox_json *doc = buf ? ox_json_parse(buf, n) : NULL;
+    free(buf);
+    return doc;
+}
+
+int main(void)
+{
+    const char *path = "/tmp/oxxy_test_trace.json";
+    CHECK(ox_trace_enabled());
+
+    OX_TRACE_THREAD("main \"quoted\"");
+    OX_TRACE_INSTANT("start");
+
+    pthread_t t[WRITERS];
+    for (int i = 0; i < WRITERS; ++i) CHECK(pthread_create(&t[i], NULL, writer, NULL) == 0);
+    for (int i = 0; i < WRITERS; ++i) pthread_join(t[i], NULL);
+
+    CHECK(ox_trace_write(path) == 0);
+    struct ox_json *doc = read_doc(path);
+    CHECK(doc);
+    struct counts c;
+    tally(doc, &c);
+    ox_json_free(doc);
+    CHECK(c.begin == WRITERS * SPANS && c.end == WRITERS * SPANS);
+    CHECK(c.counter == WRITERS * SPANS);
+    CHECK(c.instant == 1);
+    CHECK(c.named_main == 1);
+    CHECK(c.writers == WRITERS);
+
+    /* past the ring cap, exited threads' rings are taken over */
+    for (int i = 0; i < OX_TRACE_THREADS; ++i) {
+        CHECK(pthread_create(&t[0], NULL, brief, NULL) == 0);
+        pthread_join(t[0], NULL);
+    }
+    CHECK(ox_trace_write(path) == 0);
+    doc = read_doc(path);
+    CHECK(doc);
+    tally(doc, &c);
+    ox_json_free(doc);
+    CHECK(c.threads == OX_TRACE_THREADS);
+    CHECK(c.briefs + c.writers == OX_TRACE_THREADS - 1 && c.named_main == 1);
+    CHECK(c.instant == 1 + c.briefs);
+
+    /* exporting while threads lap their rings yields valid JSON, at most one
+     * ring's worth of a thread's events and no torn ones */
+    pthread_t fl, par;
+    CHECK(pthread_create(&fl, NULL, flood, NULL) == 0);
+    CHECK(pthread_create(&par, NULL, parity, NULL) == 0);
+    for (int k = 0; k < 5; ++k) {
+        CHECK(ox_trace_write(path) == 0);
+        doc = read_doc(path);
+        CHECK(doc);
+        tally(doc, &c);
+        ox_json_free(doc);
+        CHECK(c.instant <= OX_TRACE_EVENTS + OX_TRACE_THREADS);
+        CHECK(c.torn == 0);
+    }
+    pthread_join(fl, NULL);
+    pthread_join(par, NULL);
+
+    /* switched off, nothing is recorded */
+    CHECK(ox_trace_write(path) == 0);
+    doc = read_doc(path);
+    CHECK(doc);
+    struct counts before;
+    tally(doc, &before);
+    ox_json_free(doc);
+    ox_trace_enable(0);
+    CHECK(!ox_trace_enabled());
+    OX_TRACE_INSTANT("hidden");
+    CHECK(ox_trace_write(path) == 0);
+    doc = read_doc(path);
+    CHECK(doc);
+    tally(doc, &c);
+    ox_json_free(doc);
+    CHECK(c.instant == before.instant);
+    ox_trace_enable(1);
+
+    CHECK(ox_trace_write("/nonexistent-dir/trace.json") == -1);
+    CHECK(ox_trace_write(NULL) == -1);
+    remove(path);
+
+    printf("trace tests passed\n");
+    return 0;
+}
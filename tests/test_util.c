@@ -0,0 +1,89 @@
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/util.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+static size_t read_back(const char *path, char *buf, size_t cap)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    size_t n = fread(buf, 1, cap, f);
+    fclose(f);
+    return n;
+}
+
+/* entries other than . and .. */
+static int entries(const char *dir)
+{
+    DIR *d = opendir(dir);
+    int n = 0;
+    struct dirent *e;
+    while (d && (e = readdir(d)))
+        if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) n++;
+    if (d) closedir(d);
+    return n;
+}
+
+int main(void)
+{
+    char root[64], dir[128], path[160], buf[64];
+    snprintf(root, sizeof(root), "/tmp/oxxy_test_util_%ld", (long)getpid());
+    snprintf(dir, sizeof(dir), "%s/a/b/c", root);
+
+    /* every missing level; existing ones are fine */
+    struct stat st;
+    CHECK(ox_mkdir_p(dir) == 0);
+    CHECK(stat(dir, &st) == 0 && S_ISDIR(st.st_mode));
+    CHECK(ox_mkdir_p(dir) == 0);
+    CHECK(ox_mkdir_p("") == -1);
+
+    /* reference values of 64-bit FNV-1a */
+    CHECK(ox_fnv1a("", 0) == 0xcbf29ce484222325ull);
+    CHECK(ox_fnv1a("a", 1) == 0xaf63dc4c8601ec8cull);
+    CHECK(ox_fnv1a_str("foobar") == 0x85944171f73967e8ull);
+    CHECK(ox_fnv1a("foobar", 6) == ox_fnv1a_str("foobar"));
+
+    /* whole-file replacement, with the requested mode */
+    snprintf(path, sizeof(path), "%s/file.txt", dir);
+    CHECK(ox_write_file_atomic(path, "first", 5, 0644, 1) == 0);
+    CHECK(read_back(path, buf, sizeof(buf)) == 5 && memcmp(buf, "first", 5) == 0);
+    CHECK(stat(path, &st) == 0 && (st.st_mode & 0777) == 0644);
+    CHECK(ox_write_file_atomic(path, "second!", 7, 0600, 0) == 0);
+    CHECK(read_back(path, buf, sizeof(buf)) == 7 && memcmp(buf, "second!", 7) == 0);
+
+    /* a failed write leaves the old file and no temporary */
+    struct ox_atomic a;
+    CHECK(ox_atomic_begin(&a, path, 0600, 1) == 0);
+    CHECK(ox_write_all(a.fd, "torn", 4) == 0);
+    CHECK(entries(dir) == 2);
+    CHECK(ox_atomic_finish(&a, path, -1) == -1);
+    CHECK(read_back(path, buf, sizeof(buf)) == 7 && memcmp(buf, "second!", 7) == 0);
+    CHECK(entries(dir) == 1);
+
+    /* through stdio */
+    CHECK(ox_atomic_begin(&a, path, 0600, 1) == 0);
+    FILE *f = ox_atomic_stdio(&a);
+    CHECK(f);
+    fprintf(f, "n=%d", 42);
+    CHECK(ox_atomic_finish(&a, path, 0) == 0);
+    CHECK(read_back(path, buf, sizeof(buf)) == 4 && memcmp(buf, "n=42", 4) == 0);
+    CHECK(entries(dir) == 1);
+
+    CHECK(ox_write_file_atomic("/nonexistent-dir/x", "x", 1, 0600, 0) == -1);
+
+    remove(path);
+    for (int i = 0; i < 3; ++i) {
+        rmdir(dir);
+        *strrchr(dir, '/') = '\0';
+    }
+    rmdir(root);
+
+    printf("util tests passed\n");
+    return 0;
+}
@@ -0,0 +1,345 @@
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/playlist_share.h"
+#include "../src/vk.h"
+#include "http_stub.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+/* a stand-in for api.vk.com: audio.get pages of a synthetic list of `total`
+ * tracks */
+static struct http_stub stub;
+static struct {
+    _Atomic long total;
+    _Atomic int delay_ms;
+    _Atomic int fail_500;     /* next N requests for offset 1000 get a 500 */
+    _Atomic int fail_vk;      /* next N requests for offset 2000 get a VK error */
+    _Atomic int always_fail;
+    _Atomic int conditional;  /* requests with If-None-Match */
+    _Atomic int not_modified; /* ... answered 304 */
+} srv;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleep_ms(int ms)
+{
+    nanosleep(&(struct timespec){ ms / 1000, (ms % 1000) * 1000000L }, NULL);
+}
+
+static long param(const char *req, const char *name)
+{
+    const char *q = strstr(req, name);
+    return q ? strtol(q + strlen(name), NULL, 10) : 0;
+}
+
+static int respond(int fd, int status, const char *extra, const char *body, size_t len)
+{
+    char head[256];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d X\r\nContent-Type: application/json\r\n%sContent-Length: %zu\r\n\r\n", status,
+                     extra, len);
+    return http_stub_send_all(fd, head, (size_t)n) == 0 && http_stub_send_all(fd, body, len) == 0 ? 0 : -1;
+}
+
+static char *page_body(long offset, long count, size_t *len)
+{
+    size_t cap = (size_t)count * 160 + 128, n = 0;
+    char *b = malloc(cap);
+    if (!b) return NULL;
+    n += (size_t)sprintf(b, "{\"response\":{\"count\":%ld,\"items\":[", (long)srv.total);
+    for (long i = offset; i < offset + count && i < srv.total; ++i)
+        n += (size_t)sprintf(b + n, "%s{\"id\":%ld,\"artist\":\"A\",\"title\":\"T%ld\",\"duration\":%ld,"
+                                    "\"url\":\"https:\\/\\/cs.vk.me\\/%ld.mp3\"}",
+                             i > offset ? "," : "", i, i, 100 + i % 50, i);
+    n += (size_t)sprintf(b + n, "]}}");
+    *len = n;
+    return b;
+}
+
+static int on_request(int fd, const char *req, void *user)
+{
+    (void)user;
+    if (srv.delay_ms) sleep_ms(srv.delay_ms);
+    long offset = param(req, "offset="), count = param(req, "count=");
+    int ok = strncmp(req, "GET /method/audio.get?access_token=t%2Bk&", 41) == 0;
+    size_t len;
+    char *body, etag[96], tag[64];
+    int rc;
+    /* the pages only depend on the list size */
+    snprintf(tag, sizeof(tag), "\"n%ld\"", (long)srv.total);
+    snprintf(etag, sizeof(etag), "ETag: %s\r\n", tag);
+    const char *inm = strstr(req, "If-None-Match: ");
+    if (inm) atomic_fetch_add(&srv.conditional, 1);
+    if (!ok || atomic_load(&srv.always_fail) ||
+        (offset == 1000 && atomic_fetch_sub(&srv.fail_500, 1) > 0)) {
+        rc = respond(fd, 500, "", "{}", 2);
+    } else if (inm && strncmp(inm + 15, tag, strlen(tag)) == 0) {
+        atomic_fetch_add(&srv.not_modified, 1);
+        rc = respond(fd, 304, etag, "", 0);
+    } else if (offset == 2000 && atomic_fetch_sub(&srv.fail_vk, 1) > 0) {
+        const char *e = "{\"error\":{\"error_code\":6,\"error_msg\":\"Too many requests per second\"}}";
+        rc = respond(fd, 200, "", e, strlen(e));
+    } else if ((body = page_body(offset, count, &len))) {
+        rc = respond(fd, 200, etag, body, len);
+        free(body);
+    } else {
+        rc = -1;
+    }
+    return rc;
+}
+
+static void reset(long total, int delay_ms)
+{
+    srv.total = total;
+    srv.delay_ms = delay_ms;
+    atomic_store(&stub.connections, 0);
+    atomic_store(&stub.requests, 0);
+    atomic_store(&srv.fail_500, 0);
+    atomic_store(&srv.fail_vk, 0);
+    atomic_store(&srv.always_fail, 0);
+    atomic_store(&srv.conditional, 0);
+    atomic_store(&srv.not_modified, 0);
+}
+
+static size_t share_count(struct ox_plshare *s)
+{
+    struct ox_plread r;
+    size_t n = ox_plshare_read_begin(s, &r)->count;
+    ox_plshare_read_end(s, &r);
+    return n;
+}
+
+/* entries are the list in order: i.mp3 at index i */
+static int in_order(struct ox_plshare *s, size_t n)
+{
+    struct ox_plread r;
+    const struct playlist *p = ox_plshare_read_begin(s, &r);
+    int ok = p->count == n;
+    char want[64];
+    for (size_t i = 0; ok && i < n; ++i) {
+        snprintf(want, sizeof(want), "https://cs.vk.me/%zu.mp3", i);
+        ok = strcmp(playlist_uri(p, i), want) == 0;
+    }
+    ox_plshare_read_end(s, &r);
+    return ok;
+}
+
+static int contains(const char *p, size_t n, const char *s)
+{
+    size_t k = strlen(s);
+    for (size_t i = 0; i + k <= n; ++i)
+        if (memcmp(p + i, s, k) == 0) return 1;
+    return 0;
+}
+
+/* no cache file holds the token, raw or escaped */
+static int no_token_on_disk(const char *dir)
+{
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    char path[512], buf[65536];
+    int ok = d != NULL, files = 0;
+    while (ok && (e = readdir(d))) {
+        if (e->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        FILE *f = fopen(path, "rb");
+        size_t n = f ? fread(buf, 1, sizeof(buf) - 1, f) : 0;
+        if (f) fclose(f);
+        buf[n] = '\0';
+        ok = f && !contains(buf, n, "t+k") && !contains(buf, n, "t%2Bk");
+        files++;
+    }
+    if (d) closedir(d);
+    return ok && files > 0;
+}
+
+static void remove_dir(const char *dir)
+{
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    char path[512];
+    while (d && (e = readdir(d))) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        unlink(path);
+    }
+    if (d) closedir(d);
+    rmdir(dir);
+}
+
+int main(void)
+{
+    if (ox_vk_init() != 0) {
+        printf("vk tests skipped (no libcurl)\n");
+        return 0;
+    }
+    CHECK(http_stub_start(&stub, on_request, NULL) == 0);
+    char base[64];
+    snprintf(base, sizeof(base), "http://127.0.0.1:%d/method", stub.port);
+    ox_vk_set_api_base(base);
+    struct ox_vk_progress pr;
+
+    /* many pages over a few reused connections, published in list order */
+    reset(9500, 0);
+    struct ox_plshare *s = ox_plshare_create(NULL);
+    CHECK(s);
+    double t0 = now();
+    struct ox_vk_job *j = ox_vk_import_async("t+k", s);
+    CHECK(j);
+    CHECK(ox_vk_job_finish(j) == 9500);
+    double t1 = now();
+    CHECK(in_order(s, 9500));
+    CHECK(atomic_load(&stub.requests) == 10);
+    CHECK(atomic_load(&stub.connections) <= OX_VK_CONNECTIONS);
+    printf("vk: 9500 tracks in 10 pages over %d connections in %.0f ms\n", atomic_load(&stub.connections),
+           (t1 - t0) * 1e3);
+    ox_plshare_destroy(s);
+
+    /* an HTTP error and a VK rate-limit error are retried */
+    reset(3000, 0);
+    atomic_store(&srv.fail_500, 1);
+    atomic_store(&srv.fail_vk, 1);
+    s = ox_plshare_create(NULL);
+    j = ox_vk_import_async("t+k", s);
+    CHECK(ox_vk_job_finish(j) == 3000 && in_order(s, 3000));
+    CHECK(atomic_load(&stub.requests) == 5);
+    ox_plshare_destroy(s);
+
+    /* a page that keeps failing fails the job after the pages before it */
+    reset(3000, 0);
+    atomic_store(&srv.fail_500, 1000);
+    s = ox_plshare_create(NULL);
+    j = ox_vk_import_async("t+k", s);
+    CHECK(ox_vk_job_finish(j) == -1);
+    CHECK(in_order(s, 1000));
+    ox_plshare_destroy(s);
+
+    /* the caller never waits on the network; progress and cancel while slow */
+    reset(20000, 150);
+    s = ox_plshare_create(NULL);
+    t0 = now();
+    j = ox_vk_import_async("t+k", s);
+    ox_vk_job_progress(j, &pr);
+    t1 = now();
+    CHECK(j && (t1 - t0) < 0.05 && pr.state == OX_VK_JOB_RUNNING);
+    for (int i = 0; i < 400 && share_count(s) == 0; ++i) sleep_ms(5);
+    ox_vk_job_progress(j, &pr);
+    CHECK(pr.total == 20000 && pr.pages_total == 20 && pr.pages_done >= 1 && pr.tracks >= 1000);
+    ox_vk_job_cancel(j);
+    t0 = now();
+    CHECK(ox_vk_job_finish(j) == -1);
+    CHECK(now() - t0 < 0.5);
+    size_t partial = share_count(s);
+    CHECK(partial >= 1000 && partial < 20000 && partial % 1000 == 0 && in_order(s, partial));
+    ox_plshare_destroy(s);
+
+    /* every request fails: the job gives up instead of retrying forever */
+    reset(0, 0);
+    atomic_store(&srv.always_fail, 1);
+    s = ox_plshare_create(NULL);
+    j = ox_vk_import_async("t+k", s);
+    CHECK(ox_vk_job_finish(j) == -1 && share_count(s) == 0);
+    ox_plshare_destroy(s);
+
+    /* the synchronous call escapes the token like the jobs do */
+    reset(10, 0);
+    char *sync = ox_vk_get_audio("t+k");
+    CHECK(sync && strstr(sync, "\"response\"") && atomic_load(&stub.requests) == 1);
+    free(sync);
+
+    /* importing the same list again into one share (a profile switched back
+     * to) adds no entries and publishes no version */
+    reset(3000, 0);
+    s = ox_plshare_create(NULL);
+    j = ox_vk_import_async("t+k", s);
+    CHECK(ox_vk_job_finish(j) == 3000);
+    uint64_t version = ox_plshare_version(s);
+    j = ox_vk_import_async("t+k", s);
+    CHECK(ox_vk_job_finish(j) == 3000);
+    CHECK(share_count(s) == 3000 && in_order(s, 3000) && ox_plshare_version(s) == version);
+    ox_plshare_destroy(s);
+
+    /* response cache: keyed without the token, fresh entries cost nothing */
+    char dir[] = "/tmp/oxvk-test-XXXXXX";
+    CHECK(mkdtemp(dir));
+    struct ox_vk_cache *c = ox_vk_cache_open(dir, 3600);
+    CHECK(c);
+    const char *page0 = "v=5.131&count=1000&offset=0";
+    reset(1500, 0);
+    size_t len, len2;
+    enum ox_vk_cache_state st;
+    char *body = ox_vk_call_cached(c, "alice", "t+k", "audio.get", page0, &len);
+    CHECK(body && strstr(body, "\"count\":1500") && atomic_load(&stub.requests) == 1);
+    char *again = ox_vk_cache_get(c, "alice", "t+k", "audio.get", page0, &len2, &st);
+    CHECK(again && st == OX_VK_CACHE_FRESH && len2 == len && memcmp(body, again, len) == 0);
+    free(again);
+    CHECK(!ox_vk_cache_get(c, "bob", "t+k", "audio.get", page0, &len2, &st) && st == OX_VK_CACHE_MISS);
+    CHECK(!ox_vk_cache_get(c, "alice", "t+k", "audio.get", "v=5.131&count=1000&offset=1000", &len2, &st));
+    CHECK(atomic_load(&stub.requests) == 1);
+    CHECK(no_token_on_disk(dir));
+
+    /* stale: served at once, then revalidated without a body */
+    struct ox_vk_cache *stale = ox_vk_cache_open(dir, 0);
+    CHECK(stale);
+    again = ox_vk_cache_get(stale, "alice", "t+k", "audio.get", page0, &len2, &st);
+    CHECK(again && st == OX_VK_CACHE_STALE && len2 == len);
+    free(again);
+    ox_vk_cache_flush(stale);
+    CHECK(atomic_load(&srv.conditional) == 1 && atomic_load(&srv.not_modified) == 1);
+
+    /* ... and replaced when the list changed */
+    srv.total = 1600;
+    again = ox_vk_cache_get(stale, "alice", "t+k", "audio.get", page0, &len2, &st);
+    CHECK(again && strstr(again, "\"count\":1500"));
+    free(again);
+    ox_vk_cache_flush(stale);
+    CHECK(atomic_load(&srv.conditional) == 2 && atomic_load(&srv.not_modified) == 1);
+    again = ox_vk_cache_get(c, "alice", "t+k", "audio.get", page0, &len2, &st);
+    CHECK(again && st == OX_VK_CACHE_FRESH && strstr(again, "\"count\":1600"));
+    free(again);
+    free(body);
+    ox_vk_cache_close(stale);
+
+    /* errors are not cached */
+    reset(1500, 0);
+    atomic_store(&srv.always_fail, 1);
+    CHECK(!ox_vk_call_cached(c, "carol", "t+k", "audio.get", page0, &len));
+    atomic_store(&srv.always_fail, 0);
+    CHECK(!ox_vk_cache_get(c, "carol", "t+k", "audio.get", page0, &len, &st));
+
+    /* a cached import publishes the whole list without a request */
+    reset(9500, 0);
+    s = ox_plshare_create(NULL);
+    j = ox_vk_import_async_cached("t+k", c, "dave", s);
+    CHECK(ox_vk_job_finish(j) == 9500 && in_order(s, 9500) && atomic_load(&stub.requests) == 10);
+    ox_plshare_destroy(s);
+    reset(9500, 1000);
+    s = ox_plshare_create(NULL);
+    t0 = now();
+    j = ox_vk_import_async_cached("t+k", c, "dave", s);
+    CHECK(ox_vk_job_finish(j) == 9500 && in_order(s, 9500));
+    t1 = now();
+    CHECK(atomic_load(&stub.requests) == 0 && t1 - t0 < 0.9);
+    printf("vk: cached import of 9500 tracks in %.1f ms\n", (t1 - t0) * 1e3);
+    ox_plshare_destroy(s);
+    CHECK(no_token_on_disk(dir));
+    ox_vk_cache_close(c);
+    remove_dir(dir);
+
+    ox_vk_set_api_base(NULL);
+    ox_vk_shutdown();
+    printf("vk tests passed\n");
+    return 0;
+}
@@ -0,0 +1,144 @@
+// ui/art_upload.cpp
+// PBO ring texture streaming for cover thumbnails (see art_upload.h).
+
+#include "art_upload.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "gl_loader.h"
+
+static const size_t RING = 3;
+
+void ArtUploader::init(size_t max_textures)
+{
+    max_textures_ = max_textures ? max_textures : 1;
+    pbo_ok_ = gl_load_buffers();
+    if (!pbo_ok_) return;
+    ring_.resize(RING);
+    for (Slot &s : ring_) p_glGenBuffers(1, &s.pbo);
+}
+
+void ArtUploader::shutdown()
+{
+    for (Pending &p : pending_) free(p.rgba);
+    pending_.clear();
+    for (Slot &s : ring_) {
+        if (s.fence) p_glDeleteSync(static_cast<GLsync>(s.fence));
+        p_glDeleteBuffers(1, &s.pbo);
+    }
+    ring_.clear();
+    for (auto &kv : textures_) glDeleteTextures(1, &kv.second.tex);
+    textures_.clear();
+    lru_.clear();
+}
+
+void ArtUploader::submit(const std::string &key, unsigned char *rgba, int w, int h)
+{
+    for (Pending &p : pending_) {
+        if (p.key == key) {
+            free(p.rgba);
+            p.rgba = rgba; p.w = w; p.h = h;
+            return;
+        }
+    }
+    pending_.push_back(Pending{key, rgba, w, h});
+}
+
+// pixels: client memory, or an offset into the bound GL_PIXEL_UNPACK_BUFFER
+static GLuint new_texture(int w, int h, const void *pixels)
+{
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    return tex;
+}
+
+GLuint ArtUploader::upload_now(const Pending &p)
+{
+    size_t bytes = (size_t)p.w * p.h * 4;
+    GLuint tex;
+    if (!pbo_ok_) {
+        tex = new_texture(p.w, p.h, p.rgba);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return tex;
+    }
+    Slot &s = ring_[next_];
+    if (s.fence) {
+        // the GPU has not finished copying out of this buffer yet: try next frame
+        if (p_glClientWaitSync(static_cast<GLsync>(s.fence), 0, 0) == GL_TIMEOUT_EXPIRED) return 0;
+        p_glDeleteSync(static_cast<GLsync>(s.fence));
+        s.fence = nullptr;
+    }
+    p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo);
+    if (s.cap < bytes) {
+        p_glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)bytes, nullptr, GL_STREAM_DRAW);
+        s.cap = bytes;
+    }
+    void *dst = p_glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)bytes,
+                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!dst) {
+        p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return 0;
+    }
+    memcpy(dst, p.rgba, bytes);
+    p_glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    tex = new_texture(p.w, p.h, nullptr); // allocated and filled from the PBO in one copy
+    glBindTexture(GL_TEXTURE_2D, 0);
+    p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    s.fence = p_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next_ = (next_ + 1) % ring_.size();
+    return tex;
+}
+
+void ArtUploader::insert(const std::string &key, GLuint tex)
+{
+    auto it = textures_.find(key);
+    if (it != textures_.end()) {
+        glDeleteTextures(1, &it->second.tex);
+        lru_.erase(it->second.lru);
+        textures_.erase(it);
+    }
+    while (textures_.size() >= max_textures_ && !lru_.empty()) {
+        auto old = textures_.find(lru_.back());
+        glDeleteTextures(1, &old->second.tex);
+        textures_.erase(old);
+        lru_.pop_back();
+    }
+    lru_.push_front(key);
+    textures_[key] = Entry{tex, lru_.begin()};
+}
+
+int ArtUploader::pump(size_t byte_budget)
+{
+    int done = 0;
+    size_t spent = 0, i = 0;
+    while (i < pending_.size()) {
+        const Pending &p = pending_[i];
+        size_t bytes = (size_t)p.w * p.h * 4;
+        // always allow one upload per frame, or a large image would never go
+        if (done > 0 && spent + bytes > byte_budget) break;
+        GLuint tex = upload_now(p);
+        if (!tex) break;
+        insert(p.key, tex);
+        free(p.rgba);
+        spent += bytes;
+        ++done;
+        ++i;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + (std::ptrdiff_t)i);
+    return done;
+}
+
+GLuint ArtUploader::get(const std::string &key)
+{
+    auto it = textures_.find(key);
+    if (it == textures_.end()) return 0;
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    return it->second.tex;
+}
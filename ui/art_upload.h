@@ -0,0 +1,63 @@
+// ui/art_upload.h
+// Streams decoded cover thumbnails into GL textures without stalling the frame:
+// pixels go through a ring of pixel-unpack buffers (PBOs) guarded by fences, so
+// glTexSubImage2D is an asynchronous GPU-side copy, and each frame uploads at
+// most a fixed number of bytes. Textures are kept in a small LRU keyed by name.
+
+#pragma once
+
+#include <GL/gl.h>
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ArtUploader {
+public:
+    // Call with the context current. Falls back to plain glTexImage2D when the
+    // PBO/sync entry points (GL 3.2 / ARB_sync) are unavailable.
+    void init(size_t max_textures = 64);
+    void shutdown();
+
+    // Queue pixels for upload; takes ownership of the malloc'd rgba buffer.
+    void submit(const std::string &key, unsigned char *rgba, int w, int h);
+
+    // Upload queued images until byte_budget is spent or the PBO ring is busy.
+    // Returns the number of textures that became available.
+    int pump(size_t byte_budget);
+
+    // Texture for key, or 0 if it is not resident (yet). Marks it recently used.
+    GLuint get(const std::string &key);
+
+    bool async() const { return pbo_ok_; }
+    // Images submitted but not uploaded yet (the caller keeps pumping).
+    size_t queued() const { return pending_.size(); }
+
+private:
+    struct Pending {
+        std::string key;
+        unsigned char *rgba;
+        int w, h;
+    };
+    struct Entry {
+        GLuint tex;
+        std::list<std::string>::iterator lru;
+    };
+    struct Slot {
+        GLuint pbo = 0;
+        size_t cap = 0;
+        void *fence = nullptr; // GLsync of the last copy out of this buffer
+    };
+
+    GLuint upload_now(const Pending &p);
+    void insert(const std::string &key, GLuint tex);
+
+    bool pbo_ok_ = false;
+    size_t max_textures_ = 64;
+    std::vector<Pending> pending_;
+    std::vector<Slot> ring_;
+    size_t next_ = 0;
+    std::list<std::string> lru_;
+    std::unordered_map<std::string, Entry> textures_;
+};
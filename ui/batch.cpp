@@ -0,0 +1,336 @@
+// ui/batch.cpp
+// Streaming quad batch renderer (see batch.h).
+
+#include "batch.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "gl_loader.h"
+
+static PFNGLBUFFERSUBDATAPROC p_glBufferSubData;
+static PFNGLBUFFERSTORAGEPROC p_glBufferStorage;
+static PFNGLVERTEXATTRIBPOINTERPROC p_glVertexAttribPointer;
+static PFNGLENABLEVERTEXATTRIBARRAYPROC p_glEnableVertexAttribArray;
+static PFNGLDRAWELEMENTSBASEVERTEXPROC p_glDrawElementsBaseVertex;
+static PFNGLGETSTRINGIPROC p_glGetStringi;
+
+static const char *vertex_src =
+    "#version 330 core\n"
+    "layout(location = 0) in vec4 a_pos_uv;\n"
+    "layout(location = 1) in vec4 a_color;\n"
+    "layout(location = 2) in float a_slot;\n"
+    "uniform vec2 u_scale;\n"
+    "out vec2 v_uv;\n"
+    "out vec4 v_color;\n"
+    "flat out int v_slot;\n"
+    "void main() {\n"
+    "    gl_Position = vec4(a_pos_uv.xy * u_scale + vec2(-1.0, 1.0), 0.0, 1.0);\n"
+    "    v_uv = a_pos_uv.zw;\n"
+    "    v_color = a_color;\n"
+    "    v_slot = int(a_slot);\n"
+    "}\n";
+
+// explicit LOD: the branches are not uniform, and the textures have no mipmaps
+static const char *fragment_src =
+    "#version 330 core\n"
+    "in vec2 v_uv;\n"
+    "in vec4 v_color;\n"
+    "flat in int v_slot;\n"
+    "uniform sampler2D u_tex[4];\n"
+    "out vec4 o_color;\n"
+    "void main() {\n"
+    "    vec4 t = vec4(1.0);\n"
+    "    if (v_slot == 1) t = textureLod(u_tex[0], v_uv, 0.0);\n"
+    "    else if (v_slot == 2) t = textureLod(u_tex[1], v_uv, 0.0);\n"
+    "    else if (v_slot == 3) t = textureLod(u_tex[2], v_uv, 0.0);\n"
+    "    else if (v_slot == 4) t = textureLod(u_tex[3], v_uv, 0.0);\n"
+    "    o_color = v_color * t;\n"
+    "}\n";
+
+static GLuint compile(GLenum type, const char *src)
+{
+    GLuint s = p_glCreateShader(type);
+    p_glShaderSource(s, 1, &src, nullptr);
+    p_glCompileShader(s);
+    GLint ok = 0;
+    p_glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[512];
+        p_glGetShaderInfoLog(s, sizeof(log), nullptr, log);
+        fprintf(stderr, "batch: shader: %s\n", log);
+        p_glDeleteShader(s);
+        return 0;
+    }
+    return s;
+}
+
+static bool has_buffer_storage()
+{
+    GLint major = 0, minor = 0, n = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 4)) return true;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+    for (GLint i = 0; i < n; ++i) {
+        const char *e = reinterpret_cast<const char *>(p_glGetStringi(GL_EXTENSIONS, (GLuint)i));
+        if (e && strcmp(e, "GL_ARB_buffer_storage") == 0) return true;
+    }
+    return false;
+}
+
+bool Batch::init()
+{
+    ok_ = gl_load_buffers() && gl_load_programs() && gl_load(p_glBufferSubData, "glBufferSubData") &&
+          gl_load(p_glVertexAttribPointer, "glVertexAttribPointer") &&
+          gl_load(p_glEnableVertexAttribArray, "glEnableVertexAttribArray") &&
+          gl_load(p_glDrawElementsBaseVertex, "glDrawElementsBaseVertex") && gl_load(p_glGetStringi, "glGetStringi");
+    if (!ok_) return false;
+
+    GLuint vs = compile(GL_VERTEX_SHADER, vertex_src), fs = compile(GL_FRAGMENT_SHADER, fragment_src);
+    if (vs && fs) {
+        program_ = p_glCreateProgram();
+        p_glAttachShader(program_, vs);
+        p_glAttachShader(program_, fs);
+        p_glLinkProgram(program_);
+        GLint linked = 0;
+        p_glGetProgramiv(program_, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            char log[512];
+            p_glGetProgramInfoLog(program_, sizeof(log), nullptr, log);
+            fprintf(stderr, "batch: link: %s\n", log);
+            p_glDeleteProgram(program_);
+            program_ = 0;
+        }
+    }
+    if (vs) p_glDeleteShader(vs);
+    if (fs) p_glDeleteShader(fs);
+    if (!program_) return ok_ = false;
+    static const GLint units[MAX_TEXTURES] = {0, 1, 2, 3};
+    p_glUseProgram(program_);
+    p_glUniform1iv(p_glGetUniformLocation(program_, "u_tex"), MAX_TEXTURES, units);
+    p_glUseProgram(0);
+    scale_loc_ = p_glGetUniformLocation(program_, "u_scale");
+
+    // every quad is (0 1 2) (2 3 0) of its four vertices
+    std::vector<GLuint> idx(SEGMENT_QUADS * 6);
+    for (size_t q = 0; q < SEGMENT_QUADS; ++q) {
+        GLuint b = (GLuint)(q * 4);
+        GLuint quad[6] = {b, b + 1, b + 2, b + 2, b + 3, b};
+        memcpy(&idx[q * 6], quad, sizeof(quad));
+    }
+    p_glGenVertexArrays(1, &vao_);
+    p_glBindVertexArray(vao_);
+    p_glGenBuffers(1, &ibo_);
+    p_glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+    p_glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(idx.size() * sizeof(GLuint)), idx.data(), GL_STATIC_DRAW);
+
+    const GLsizeiptr bytes = (GLsizeiptr)(SEGMENTS * SEGMENT_QUADS * 4 * sizeof(Vertex));
+    p_glGenBuffers(1, &vbo_);
+    p_glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    persistent_ = has_buffer_storage() && gl_load(p_glBufferStorage, "glBufferStorage");
+    if (persistent_) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        p_glBufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+        mapped_ = static_cast<Vertex *>(p_glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags));
+        persistent_ = mapped_ != nullptr;
+    }
+    if (!persistent_) {
+        // a buffer_storage buffer cannot be respecified: start over
+        p_glDeleteBuffers(1, &vbo_);
+        p_glGenBuffers(1, &vbo_);
+        p_glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+        p_glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        staging_.resize(SEGMENT_QUADS * 4);
+    }
+    p_glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, x));
+    p_glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void *)offsetof(Vertex, color));
+    p_glVertexAttribPointer(2, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, slot));
+    for (GLuint i = 0; i < 3; ++i) p_glEnableVertexAttribArray(i);
+    p_glBindVertexArray(0);
+    p_glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void Batch::shutdown()
+{
+    if (!ok_) return;
+    for (void *&f : fences_) {
+        if (f) p_glDeleteSync(static_cast<GLsync>(f));
+        f = nullptr;
+    }
+    if (mapped_) {
+        p_glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+        p_glUnmapBuffer(GL_ARRAY_BUFFER);
+        p_glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mapped_ = nullptr;
+    }
+    p_glDeleteBuffers(1, &vbo_);
+    p_glDeleteBuffers(1, &ibo_);
+    p_glDeleteVertexArrays(1, &vao_);
+    p_glDeleteProgram(program_);
+    staging_.clear();
+    ok_ = false;
+}
+
+uint32_t Batch::rgba(float r, float g, float b, float a)
+{
+    auto byte = [](float v) -> uint32_t { return v <= 0.0f ? 0 : v >= 1.0f ? 255 : (uint32_t)(v * 255.0f + 0.5f); };
+    // bytes r, g, b, a in memory order on little-endian hosts
+    return byte(r) | byte(g) << 8 | byte(b) << 16 | byte(a) << 24;
+}
+
+void Batch::advance()
+{
+    if (fences_[segment_]) p_glDeleteSync(static_cast<GLsync>(fences_[segment_]));
+    fences_[segment_] = p_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segment_ = (segment_ + 1) % SEGMENTS;
+    first_ = count_ = 0;
+    if (void *f = fences_[segment_]) {
+        // SEGMENTS frames behind: normally long signalled
+        p_glClientWaitSync(static_cast<GLsync>(f), GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        p_glDeleteSync(static_cast<GLsync>(f));
+        fences_[segment_] = nullptr;
+    }
+}
+
+void Batch::begin(int w, int h)
+{
+    last_draws_ = draws_;
+    last_quads_ = quads_;
+    draws_ = 0;
+    quads_ = 0;
+    fb_h_ = h;
+    if (!ok_) return;
+    advance();
+    p_glUseProgram(program_);
+    p_glUniform2f(scale_loc_, 2.0f / (float)(w > 0 ? w : 1), -2.0f / (float)(h > 0 ? h : 1));
+    p_glUseProgram(0);
+}
+
+void Batch::flush()
+{
+    if (ok_ && count_ > first_) {
+        size_t n = count_ - first_;
+        size_t base = segment_ * SEGMENT_QUADS * 4 + first_ * 4;
+        if (!persistent_) {
+            p_glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+            p_glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(base * sizeof(Vertex)), (GLsizeiptr)(n * 4 * sizeof(Vertex)),
+                              &staging_[first_ * 4]);
+            p_glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        p_glUseProgram(program_);
+        for (int i = 0; i < nbound_; ++i) {
+            p_glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, bound_[i]);
+        }
+        p_glBindVertexArray(vao_);
+        p_glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)(n * 6), GL_UNSIGNED_INT, nullptr, (GLint)base);
+        p_glBindVertexArray(0);
+        for (int i = nbound_ - 1; i >= 0; --i) {
+            p_glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        p_glUseProgram(0);
+        ++draws_;
+        quads_ += n;
+        first_ = count_;
+    }
+    nbound_ = 0;
+}
+
+Batch::Vertex *Batch::reserve()
+{
+    if (count_ == SEGMENT_QUADS) {
+        flush();
+        advance();
+    }
+    Vertex *v = persistent_ ? mapped_ + (segment_ * SEGMENT_QUADS + count_) * 4 : &staging_[count_ * 4];
+    ++count_;
+    return v;
+}
+
+int Batch::slot_for(GLuint tex)
+{
+    for (int i = 0; i < nbound_; ++i)
+        if (bound_[i] == tex) return i + 1;
+    if (nbound_ == MAX_TEXTURES) flush();
+    bound_[nbound_++] = tex;
+    return nbound_;
+}
+
+void Batch::put(Vertex *p, float x, float y, float u, float v, uint32_t color, int slot)
+{
+    p->x = x;
+    p->y = y;
+    p->u = u;
+    p->v = v;
+    memcpy(p->color, &color, 4);
+    p->slot[0] = (uint8_t)slot;
+}
+
+void Batch::rect(float x, float y, float w, float h, uint32_t color)
+{
+    if (!ok_ || w <= 0.0f || h <= 0.0f) return;
+    Vertex *v = reserve();
+    put(v + 0, x, y, 0, 0, color, 0);
+    put(v + 1, x + w, y, 0, 0, color, 0);
+    put(v + 2, x + w, y + h, 0, 0, color, 0);
+    put(v + 3, x, y + h, 0, 0, color, 0);
+}
+
+void Batch::line(float x0, float y0, float x1, float y1, float width, uint32_t color)
+{
+    float dx = x1 - x0, dy = y1 - y0, len = std::sqrt(dx * dx + dy * dy);
+    if (!ok_ || len <= 0.0f) return;
+    float nx = -dy / len * width * 0.5f, ny = dx / len * width * 0.5f;
+    Vertex *v = reserve();
+    put(v + 0, x0 + nx, y0 + ny, 0, 0, color, 0);
+    put(v + 1, x1 + nx, y1 + ny, 0, 0, color, 0);
+    put(v + 2, x1 - nx, y1 - ny, 0, 0, color, 0);
+    put(v + 3, x0 - nx, y0 - ny, 0, 0, color, 0);
+}
+
+void Batch::polyline(float x0, float dx, const float *ys, size_t n, float width, uint32_t color)
+{
+    for (size_t i = 1; i < n; ++i) line(x0 + (float)(i - 1) * dx, ys[i - 1], x0 + (float)i * dx, ys[i], width, color);
+}
+
+void Batch::texture(GLuint tex, float x, float y, float w, float h, uint32_t tint)
+{
+    texture(tex, x, y, w, h, 0.0f, 0.0f, 1.0f, 1.0f, tint);
+}
+
+void Batch::texture(GLuint tex, float x, float y, float w, float h, float u0, float v0, float u1, float v1,
+                    uint32_t tint)
+{
+    if (!ok_ || !tex) return;
+    if (count_ == SEGMENT_QUADS) {
+        flush();
+        advance();
+    }
+    int slot = slot_for(tex);
+    Vertex *v = reserve();
+    put(v + 0, x, y, u0, v0, tint, slot);
+    put(v + 1, x + w, y, u1, v0, tint, slot);
+    put(v + 2, x + w, y + h, u1, v1, tint, slot);
+    put(v + 3, x, y + h, u0, v1, tint, slot);
+}
+
+void Batch::clip(float x, float y, float w, float h)
+{
+    flush();
+    int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+    int x1 = (int)std::ceil(x + w), y1 = (int)std::ceil(y + h);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x0, fb_h_ - y1, x1 > x0 ? x1 - x0 : 0, y1 > y0 ? y1 - y0 : 0);
+}
+
+void Batch::clip_off()
+{
+    flush();
+    glDisable(GL_SCISSOR_TEST);
+}
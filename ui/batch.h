@@ -0,0 +1,83 @@
+// ui/batch.h
+// Core-profile 2D batch renderer: rects, lines, polylines and textured quads
+// are written straight into a persistently mapped streaming vertex buffer and
+// drawn with one glDrawElements per flush. Every primitive is a quad (a line
+// is a thin rotated one) in window pixels, so all of them share one shader and
+// one static index buffer, and painter's order is the submission order.
+// Textured quads name their texture per vertex: up to MAX_TEXTURES distinct
+// textures are bound to units at once, and only a new one beyond that splits
+// the batch. The buffer is a ring of SEGMENTS frame-sized regions guarded by
+// fences, so the CPU never writes vertices the GPU is still reading.
+
+#pragma once
+
+#include <GL/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Batch {
+public:
+    static const int MAX_TEXTURES = 4;
+    static const size_t SEGMENT_QUADS = 16384;
+    static const size_t SEGMENTS = 3;
+
+    // Call with a GL 3.3 core (or compatible) context current. Returns false
+    // if an entry point or the shaders are unavailable. Without
+    // ARB_buffer_storage (GL 4.4) vertices are staged and uploaded per flush.
+    bool init();
+    void shutdown();
+
+    // Start a frame for a framebuffer of w x h pixels; coordinates passed to
+    // the primitives are window pixels, origin top left.
+    void begin(int w, int h);
+    // Draw everything queued since the last flush; call before swapping.
+    void flush();
+
+    void rect(float x, float y, float w, float h, uint32_t color);
+    void line(float x0, float y0, float x1, float y1, float width, uint32_t color);
+    // n points (x0 + i * dx, ys[i]) joined by width-pixel segments
+    void polyline(float x0, float dx, const float *ys, size_t n, float width, uint32_t color);
+    void texture(GLuint tex, float x, float y, float w, float h, uint32_t tint);
+    // the (u0, v0)-(u1, v1) part of tex, e.g. a glyph in an atlas
+    void texture(GLuint tex, float x, float y, float w, float h, float u0, float v0, float u1, float v1,
+                 uint32_t tint);
+
+    // Restrict what follows to a window-pixel rect until clip_off (flushes:
+    // a clipped region costs one draw call of its own).
+    void clip(float x, float y, float w, float h);
+    void clip_off();
+
+    // Draw calls and quads in the last flushed frame.
+    unsigned draws() const { return last_draws_; }
+    size_t quads() const { return last_quads_; }
+
+    static uint32_t rgba(float r, float g, float b, float a);
+
+private:
+    struct Vertex {
+        float x, y, u, v;
+        uint8_t color[4];
+        uint8_t slot[4]; // [0]: texture unit + 1, 0 for plain color
+    };
+
+    static void put(Vertex *p, float x, float y, float u, float v, uint32_t color, int slot);
+    Vertex *reserve();  // room for one quad, flushing if the segment is full
+    int slot_for(GLuint tex);
+    void advance();     // move to the next ring segment
+
+    bool ok_ = false;
+    bool persistent_ = false;
+    GLuint program_ = 0, vao_ = 0, vbo_ = 0, ibo_ = 0;
+    GLint scale_loc_ = -1;
+    Vertex *mapped_ = nullptr;          // the whole ring when persistent
+    std::vector<Vertex> staging_;       // one segment otherwise
+    void *fences_[SEGMENTS] = {};
+    size_t segment_ = 0;
+    size_t first_ = 0, count_ = 0;      // quads of this segment: drawn, queued
+    GLuint bound_[MAX_TEXTURES] = {};
+    int nbound_ = 0;
+    int fb_h_ = 0;
+    unsigned draws_ = 0, last_draws_ = 0;
+    size_t quads_ = 0, last_quads_ = 0;
+};
@@ -0,0 +1,58 @@
+// ui/gl_loader.cpp
+// Shared GL entry point tables (see gl_loader.h).
+
+#include "gl_loader.h"
+
+PFNGLGENBUFFERSPROC p_glGenBuffers;
+PFNGLDELETEBUFFERSPROC p_glDeleteBuffers;
+PFNGLBINDBUFFERPROC p_glBindBuffer;
+PFNGLBUFFERDATAPROC p_glBufferData;
+PFNGLMAPBUFFERRANGEPROC p_glMapBufferRange;
+PFNGLUNMAPBUFFERPROC p_glUnmapBuffer;
+PFNGLFENCESYNCPROC p_glFenceSync;
+PFNGLCLIENTWAITSYNCPROC p_glClientWaitSync;
+PFNGLDELETESYNCPROC p_glDeleteSync;
+
+PFNGLGENVERTEXARRAYSPROC p_glGenVertexArrays;
+PFNGLBINDVERTEXARRAYPROC p_glBindVertexArray;
+PFNGLDELETEVERTEXARRAYSPROC p_glDeleteVertexArrays;
+PFNGLCREATESHADERPROC p_glCreateShader;
+PFNGLSHADERSOURCEPROC p_glShaderSource;
+PFNGLCOMPILESHADERPROC p_glCompileShader;
+PFNGLGETSHADERIVPROC p_glGetShaderiv;
+PFNGLGETSHADERINFOLOGPROC p_glGetShaderInfoLog;
+PFNGLDELETESHADERPROC p_glDeleteShader;
+PFNGLCREATEPROGRAMPROC p_glCreateProgram;
+PFNGLATTACHSHADERPROC p_glAttachShader;
+PFNGLLINKPROGRAMPROC p_glLinkProgram;
+PFNGLGETPROGRAMIVPROC p_glGetProgramiv;
+PFNGLGETPROGRAMINFOLOGPROC p_glGetProgramInfoLog;
+PFNGLDELETEPROGRAMPROC p_glDeleteProgram;
+PFNGLUSEPROGRAMPROC p_glUseProgram;
+PFNGLGETUNIFORMLOCATIONPROC p_glGetUniformLocation;
+PFNGLUNIFORM1IVPROC p_glUniform1iv;
+PFNGLUNIFORM2FPROC p_glUniform2f;
+PFNGLACTIVETEXTUREPROC p_glActiveTexture;
+
+bool gl_load_buffers()
+{
+    return gl_load(p_glGenBuffers, "glGenBuffers") && gl_load(p_glDeleteBuffers, "glDeleteBuffers") &&
+           gl_load(p_glBindBuffer, "glBindBuffer") && gl_load(p_glBufferData, "glBufferData") &&
+           gl_load(p_glMapBufferRange, "glMapBufferRange") && gl_load(p_glUnmapBuffer, "glUnmapBuffer") &&
+           gl_load(p_glFenceSync, "glFenceSync") && gl_load(p_glClientWaitSync, "glClientWaitSync") &&
+           gl_load(p_glDeleteSync, "glDeleteSync");
+}
+
+bool gl_load_programs()
+{
+    return gl_load(p_glGenVertexArrays, "glGenVertexArrays") && gl_load(p_glBindVertexArray, "glBindVertexArray") &&
+           gl_load(p_glDeleteVertexArrays, "glDeleteVertexArrays") && gl_load(p_glCreateShader, "glCreateShader") &&
+           gl_load(p_glShaderSource, "glShaderSource") && gl_load(p_glCompileShader, "glCompileShader") &&
+           gl_load(p_glGetShaderiv, "glGetShaderiv") && gl_load(p_glGetShaderInfoLog, "glGetShaderInfoLog") &&
+           gl_load(p_glDeleteShader, "glDeleteShader") && gl_load(p_glCreateProgram, "glCreateProgram") &&
+           gl_load(p_glAttachShader, "glAttachShader") && gl_load(p_glLinkProgram, "glLinkProgram") &&
+           gl_load(p_glGetProgramiv, "glGetProgramiv") && gl_load(p_glGetProgramInfoLog, "glGetProgramInfoLog") &&
+           gl_load(p_glDeleteProgram, "glDeleteProgram") && gl_load(p_glUseProgram, "glUseProgram") &&
+           gl_load(p_glGetUniformLocation, "glGetUniformLocation") && gl_load(p_glUniform1iv, "glUniform1iv") &&
+           gl_load(p_glUniform2f, "glUniform2f") && gl_load(p_glActiveTexture, "glActiveTexture");
+}
@@ -0,0 +1,53 @@
+// ui/gl_loader.h
+// GL entry points past 1.1 shared by the renderers. They are fetched from the
+// current context through GLFW: gl_load_buffers() and gl_load_programs() fill
+// the pointers below for every renderer that uses them, and a renderer fetches
+// the few only it needs itself with gl_load().
+
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <GL/glext.h>
+
+// buffer objects and fences (gl_load_buffers)
+extern PFNGLGENBUFFERSPROC p_glGenBuffers;
+extern PFNGLDELETEBUFFERSPROC p_glDeleteBuffers;
+extern PFNGLBINDBUFFERPROC p_glBindBuffer;
+extern PFNGLBUFFERDATAPROC p_glBufferData;
+extern PFNGLMAPBUFFERRANGEPROC p_glMapBufferRange;
+extern PFNGLUNMAPBUFFERPROC p_glUnmapBuffer;
+extern PFNGLFENCESYNCPROC p_glFenceSync;
+extern PFNGLCLIENTWAITSYNCPROC p_glClientWaitSync;
+extern PFNGLDELETESYNCPROC p_glDeleteSync;
+
+// vertex arrays, shaders, programs and their uniforms (gl_load_programs)
+extern PFNGLGENVERTEXARRAYSPROC p_glGenVertexArrays;
+extern PFNGLBINDVERTEXARRAYPROC p_glBindVertexArray;
+extern PFNGLDELETEVERTEXARRAYSPROC p_glDeleteVertexArrays;
+extern PFNGLCREATESHADERPROC p_glCreateShader;
+extern PFNGLSHADERSOURCEPROC p_glShaderSource;
+extern PFNGLCOMPILESHADERPROC p_glCompileShader;
+extern PFNGLGETSHADERIVPROC p_glGetShaderiv;
+extern PFNGLGETSHADERINFOLOGPROC p_glGetShaderInfoLog;
+extern PFNGLDELETESHADERPROC p_glDeleteShader;
+extern PFNGLCREATEPROGRAMPROC p_glCreateProgram;
+extern PFNGLATTACHSHADERPROC p_glAttachShader;
+extern PFNGLLINKPROGRAMPROC p_glLinkProgram;
+extern PFNGLGETPROGRAMIVPROC p_glGetProgramiv;
+extern PFNGLGETPROGRAMINFOLOGPROC p_glGetProgramInfoLog;
+extern PFNGLDELETEPROGRAMPROC p_glDeleteProgram;
+extern PFNGLUSEPROGRAMPROC p_glUseProgram;
+extern PFNGLGETUNIFORMLOCATIONPROC p_glGetUniformLocation;
+extern PFNGLUNIFORM1IVPROC p_glUniform1iv;
+extern PFNGLUNIFORM2FPROC p_glUniform2f;
+extern PFNGLACTIVETEXTUREPROC p_glActiveTexture;
+
+// Call with the context current; false if the context lacks one of the group.
+bool gl_load_buffers();
+bool gl_load_programs();
+
+template <typename T> bool gl_load(T &fn, const char *name)
+{
+    fn = reinterpret_cast<T>(glfwGetProcAddress(name));
+    return fn != nullptr;
+}
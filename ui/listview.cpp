@@ -0,0 +1,141 @@
+// ui/listview.cpp
+// Virtualized list (see listview.h).
+
+#include "listview.h"
+
+#include <GLFW/glfw3.h>
+#include <cmath>
+
+#include "batch.h"
+#include "text.h"
+
+static const float PAD = 8.0f;
+static const float BAR_W = 6.0f;
+static const float MIN_THUMB = 20.0f;
+
+void ListView::set_count(size_t n)
+{
+    count_ = n;
+    if (selected_ != NONE && selected_ >= n) selected_ = n ? n - 1 : NONE;
+    clamp();
+}
+
+void ListView::set_row_height(float h)
+{
+    if (h < 1.0f) h = 1.0f;
+    // keep the top row where it is
+    offset_ = offset_ / row_h_ * h;
+    row_h_ = h;
+    clamp();
+}
+
+void ListView::clamp()
+{
+    double max = (double)count_ * row_h_ - h_;
+    if (offset_ > max) offset_ = max;
+    if (offset_ < 0.0) offset_ = 0.0;
+}
+
+size_t ListView::page_rows() const
+{
+    size_t n = (size_t)(h_ / row_h_);
+    return n > 1 ? n - 1 : 1;
+}
+
+bool ListView::scroll(double rows)
+{
+    double before = offset_;
+    offset_ += rows * row_h_;
+    clamp();
+    return offset_ != before;
+}
+
+void ListView::select(size_t i)
+{
+    selected_ = i < count_ ? i : NONE;
+}
+
+void ListView::ensure_visible(size_t i)
+{
+    if (i >= count_) return;
+    double top = (double)i * row_h_;
+    if (top < offset_) offset_ = top;
+    else if (top + row_h_ > offset_ + h_) offset_ = top + row_h_ - h_;
+    clamp();
+}
+
+bool ListView::key(int key)
+{
+    if (count_ == 0) return false;
+    size_t s = selected_ == NONE ? (size_t)(offset_ / row_h_) : selected_;
+    size_t page = page_rows();
+    switch (key) {
+    case GLFW_KEY_UP: s = s > 0 ? s - 1 : 0; break;
+    case GLFW_KEY_DOWN: s = s + 1 < count_ ? s + 1 : count_ - 1; break;
+    case GLFW_KEY_PAGE_UP: s = s > page ? s - page : 0; break;
+    case GLFW_KEY_PAGE_DOWN: s = count_ - s > page ? s + page : count_ - 1; break;
+    case GLFW_KEY_HOME: s = 0; break;
+    case GLFW_KEY_END: s = count_ - 1; break;
+    default: return false;
+    }
+    selected_ = s;
+    ensure_visible(s);
+    return true;
+}
+
+bool ListView::contains(double x, double y) const
+{
+    return x >= x_ && x < x_ + w_ && y >= y_ && y < y_ + h_;
+}
+
+size_t ListView::click(double x, double y)
+{
+    if (!contains(x, y)) return NONE;
+    double row = (offset_ + (y - y_)) / row_h_;
+    if (row < 0.0 || row >= (double)count_) return NONE;
+    selected_ = (size_t)row;
+    return selected_;
+}
+
+void ListView::draw(Batch &b, TextRenderer &text, float x, float y, float w, float h, const RowText &row_text,
+                    size_t current, const Colors &c)
+{
+    bool resized = h != h_;
+    x_ = x;
+    y_ = y;
+    w_ = w;
+    h_ = h;
+    if (resized) clamp();
+    b.rect(x, y, w, h, c.background);
+    if (count_ == 0) return;
+
+    double content = (double)count_ * row_h_;
+    bool bar = content > h;
+    float text_w = w - 2 * PAD - (bar ? BAR_W + PAD : 0.0f);
+    float text_dy = std::floor((row_h_ - text.line_height()) * 0.5f);
+
+    b.clip(x, y, w, h);
+    size_t first = (size_t)(offset_ / row_h_);
+    float ry = y - (float)(offset_ - (double)first * row_h_);
+    for (size_t i = first; i < count_ && ry < y + h; ++i, ry += row_h_) {
+        if (i == current) b.rect(x, ry, w, row_h_, c.current);
+        if (i == selected_) b.rect(x, ry, w, row_h_, c.selected);
+        left_.clear();
+        right_.clear();
+        row_text(i, left_, right_);
+        float rw = 0.0f;
+        if (!right_.empty()) {
+            rw = text.measure(right_.c_str());
+            text.draw(b, right_.c_str(), x + PAD + text_w - rw, ry + text_dy, 0.0f, c.detail);
+            rw += PAD;
+        }
+        text.draw(b, left_.c_str(), x + PAD, ry + text_dy, text_w - rw, c.text);
+    }
+    if (bar) {
+        float thumb = (float)(h * (h / content));
+        if (thumb < MIN_THUMB) thumb = MIN_THUMB;
+        float ty = y + (float)(offset_ / (content - h)) * (h - thumb);
+        b.rect(x + w - BAR_W - 2, ty, BAR_W, thumb, c.scrollbar);
+    }
+    b.clip_off();
+}
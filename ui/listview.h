@@ -0,0 +1,59 @@
+// ui/listview.h
+// Virtualized list: only the rows inside the view are asked for their text
+// and drawn, so a frame costs the same for ten entries or ten million, and
+// nothing is kept per row. The scroll position is a pixel offset (double, so
+// it stays exact far down a huge list); selection follows the keyboard and
+// the view follows the selection.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+class Batch;
+class TextRenderer;
+
+class ListView {
+public:
+    static const size_t NONE = (size_t)-1;
+
+    struct Colors {
+        uint32_t background, text, detail, current, selected, scrollbar;
+    };
+    // Text of row i: left is cut to fit, right (e.g. a duration) is drawn
+    // in full against the right edge. The strings are reused between rows.
+    using RowText = std::function<void(size_t i, std::string &left, std::string &right)>;
+
+    void set_count(size_t n);
+    size_t count() const { return count_; }
+    void set_row_height(float h);
+
+    // Move by rows (the wheel: negative is up). Returns true if the view moved.
+    bool scroll(double rows);
+    // Arrows, Page Up/Down, Home, End (GLFW key codes). True if handled.
+    bool key(int key);
+    // Row under (x, y) of the last draw, or NONE; selects it.
+    size_t click(double x, double y);
+    bool contains(double x, double y) const;
+
+    void select(size_t i);
+    size_t selected() const { return selected_; }
+    void ensure_visible(size_t i);
+
+    // Draw into the rect; row current (NONE for none) is highlighted.
+    void draw(Batch &b, TextRenderer &text, float x, float y, float w, float h, const RowText &row_text,
+              size_t current, const Colors &c);
+
+private:
+    void clamp();
+    size_t page_rows() const;
+
+    size_t count_ = 0;
+    size_t selected_ = NONE;
+    double offset_ = 0.0; // pixels above the top of the view
+    float row_h_ = 24.0f;
+    float x_ = 0.0f, y_ = 0.0f, w_ = 0.0f, h_ = 0.0f; // last draw
+    std::string left_, right_;
+};
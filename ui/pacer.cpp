@@ -0,0 +1,38 @@
+// ui/pacer.cpp
+// Frame pacing on top of the GLFW event queue (see pacer.h).
+
+#include "pacer.h"
+
+#include <GLFW/glfw3.h>
+
+void FramePacer::init(double period)
+{
+    if (period <= 0.0) {
+        GLFWmonitor *m = glfwGetPrimaryMonitor();
+        const GLFWvidmode *mode = m ? glfwGetVideoMode(m) : nullptr;
+        period = mode && mode->refreshRate > 0 ? 1.0 / mode->refreshRate : 1.0 / 60.0;
+    }
+    period_ = period;
+    next_ = 0.0;
+}
+
+void FramePacer::wait(bool animating, bool dirty)
+{
+    if (!animating) {
+        if (dirty) glfwPollEvents();
+        else glfwWaitEvents();
+        return;
+    }
+    // the timeout can return early on any event; keep handling them until due
+    for (double left = next_ - glfwGetTime(); left > 0.0; left = next_ - glfwGetTime())
+        glfwWaitEventsTimeout(left);
+    glfwPollEvents();
+}
+
+void FramePacer::frame_done()
+{
+    double now = glfwGetTime();
+    next_ += period_;
+    if (next_ < now - period_) next_ = now + period_; // first frame after idling
+    else if (next_ < now) next_ = now;                // late: no catching up
+}
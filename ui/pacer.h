@@ -0,0 +1,32 @@
+// ui/pacer.h
+// Event-driven frame pacing for the GLFW loops. An idle window blocks in
+// glfwWaitEvents until input, a resize or a wakeup from another thread
+// (glfwPostEmptyEvent, see ox_ui_set_wakeup) arrives, so it costs no CPU.
+// While something animates, frames are due one refresh period apart: the
+// wait sleeps in glfwWaitEventsTimeout until the next slot, still handling
+// events, so the frame time stays steady even where SwapBuffers does not
+// block (no vsync, hidden or minimised windows). A late frame moves the next
+// slot instead of bunching frames up to catch up.
+
+#pragma once
+
+class FramePacer {
+public:
+    // period: seconds per animated frame; 0 takes the primary monitor's
+    // refresh rate (60 Hz if unknown). Call after glfwInit.
+    void init(double period = 0.0);
+
+    // Dispatch events, blocking until there is a reason to draw: forever if
+    // nothing animates and nothing is dirty, else until the next frame slot
+    // (at once if dirty and idle, so input is answered without a frame of lag).
+    void wait(bool animating, bool dirty);
+
+    // Call once a frame has been submitted (after glfwSwapBuffers).
+    void frame_done();
+
+    double period() const { return period_; }
+
+private:
+    double period_ = 1.0 / 60.0;
+    double next_ = 0.0; // glfwGetTime() at which the next animated frame is due
+};
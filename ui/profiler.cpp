@@ -0,0 +1,284 @@
+// ui/profiler.cpp
+// Scoped CPU timers, GL_TIME_ELAPSED queries and their overlay (see profiler.h).
+// Frames and sections are also trace spans (src/trace.h), whether or not the
+// profiler itself is on.
+
+#include "profiler.h"
+
+#include <cstring>
+
+#include "batch.h"
+#include "gl_loader.h"
+#include "text.h"
+#include "trace.h"
+#include "util.h"
+
+static PFNGLGENQUERIESPROC p_glGenQueries;
+static PFNGLDELETEQUERIESPROC p_glDeleteQueries;
+static PFNGLBEGINQUERYPROC p_glBeginQuery;
+static PFNGLENDQUERYPROC p_glEndQuery;
+static PFNGLGETQUERYOBJECTIVPROC p_glGetQueryObjectiv;
+static PFNGLGETQUERYOBJECTUI64VPROC p_glGetQueryObjectui64v;
+
+static const double BUCKET_MS = 0.5;
+
+void FrameProfiler::init(double period)
+{
+    if (period > 0.0) period_ms_ = period * 1000.0;
+    // timer queries are core in 3.3 (ARB_timer_query before)
+    gpu_ok_ = gl_load(p_glGenQueries, "glGenQueries") && gl_load(p_glDeleteQueries, "glDeleteQueries") &&
+              gl_load(p_glBeginQuery, "glBeginQuery") && gl_load(p_glEndQuery, "glEndQuery") &&
+              gl_load(p_glGetQueryObjectiv, "glGetQueryObjectiv") &&
+              gl_load(p_glGetQueryObjectui64v, "glGetQueryObjectui64v");
+    if (gpu_ok_) {
+        while (glGetError() != GL_NO_ERROR) {}
+        for (QuerySet &s : queries_) p_glGenQueries(MAX_SECTIONS, s.q);
+        gpu_ok_ = glGetError() == GL_NO_ERROR;
+    }
+}
+
+void FrameProfiler::shutdown()
+{
+    if (gpu_ok_) {
+        if (gpu_open_ >= 0) p_glEndQuery(GL_TIME_ELAPSED);
+        for (QuerySet &s : queries_) p_glDeleteQueries(MAX_SECTIONS, s.q);
+    }
+    gpu_ok_ = false;
+    gpu_open_ = -1;
+    enabled_ = false;
+}
+
+int FrameProfiler::section(const char *name)
+{
+    for (int i = 0; i < nsections_; ++i)
+        if (names_[i] == name || strcmp(names_[i], name) == 0) return i;
+    if (nsections_ == MAX_SECTIONS) return -1;
+    names_[nsections_] = name;
+    return nsections_++;
+}
+
+void FrameProfiler::begin_frame()
+{
+    OX_TRACE_BEGIN("frame");
+    if (!enabled_) return;
+    collect();
+    cur_.ms = 0.0f;
+    for (int i = 0; i < MAX_SECTIONS; ++i) {
+        cur_.cpu[i] = 0.0f;
+        cur_.gpu[i] = -1.0f;
+    }
+    // a set still waiting for the GPU is not reused: this frame goes untimed there
+    QuerySet &s = queries_[frames_ % QUERY_FRAMES];
+    frame_start_ = clock::now();
+    if (!s.pending) {
+        memset(s.used, 0, sizeof(s.used));
+        s.start = frame_start_;
+    }
+    in_frame_ = true;
+}
+
+void FrameProfiler::begin(int id, bool gpu)
+{
+    if (id < 0) return;
+    OX_TRACE_BEGIN(names_[id]);
+    if (!in_frame_) return;
+    started_[id] = clock::now();
+    QuerySet &s = queries_[frames_ % QUERY_FRAMES];
+    if (gpu && gpu_ok_ && gpu_open_ < 0 && !s.pending && !s.used[id]) {
+        p_glBeginQuery(GL_TIME_ELAPSED, s.q[id]);
+        s.used[id] = true;
+        gpu_open_ = id;
+    }
+}
+
+void FrameProfiler::end(int id)
+{
+    if (id < 0) return;
+    OX_TRACE_END(names_[id]);
+    if (!in_frame_) return;
+    cur_.cpu[id] += std::chrono::duration<float, std::milli>(clock::now() - started_[id]).count();
+    if (gpu_open_ == id) {
+        p_glEndQuery(GL_TIME_ELAPSED);
+        gpu_open_ = -1;
+    }
+}
+
+void FrameProfiler::end_frame(bool animating)
+{
+    if (in_frame_ && gpu_open_ >= 0) end(gpu_open_);
+    OX_TRACE_END("frame");
+    if (!in_frame_) return;
+    in_frame_ = false;
+    clock::time_point now = clock::now();
+    // steady animation is judged swap to swap; a frame after idling by its work
+    double ms = std::chrono::duration<double, std::milli>(now - frame_start_).count();
+    if (animating && have_last_) {
+        ms = std::chrono::duration<double, std::milli>(now - last_end_).count();
+        if (ms > 1.5 * period_ms_) dropped_ += (uint64_t)(ms / period_ms_ + 0.5) - 1;
+    }
+    have_last_ = animating;
+    last_end_ = now;
+
+    cur_.ms = (float)ms;
+    history_[frames_ % HISTORY] = cur_;
+    frame_total_.add(ms);
+    int bucket = (int)(ms / BUCKET_MS);
+    ++hist_[bucket < BUCKETS ? bucket : BUCKETS - 1];
+    for (int i = 0; i < nsections_; ++i)
+        if (cur_.cpu[i] > 0.0f) cpu_total_[i].add(cur_.cpu[i]);
+
+    QuerySet &s = queries_[frames_ % QUERY_FRAMES];
+    if (!s.pending) {
+        s.frame = frames_;
+        for (int i = 0; i < MAX_SECTIONS; ++i) s.pending |= s.used[i];
+    }
+    ++frames_;
+}
+
+void FrameProfiler::skip_frame()
+{
+    if (in_frame_ && gpu_open_ >= 0) {
+        p_glEndQuery(GL_TIME_ELAPSED);
+        gpu_open_ = -1;
+    }
+    OX_TRACE_END("frame");
+    in_frame_ = false;
+}
+
+void FrameProfiler::collect()
+{
+    if (!gpu_ok_) return;
+    for (QuerySet &s : queries_) {
+        if (!s.pending) continue;
+        bool ready = true;
+        for (int i = 0; i < MAX_SECTIONS && ready; ++i) {
+            GLint available = 0;
+            if (s.used[i]) p_glGetQueryObjectiv(s.q[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            ready = !s.used[i] || available;
+        }
+        if (!ready) continue;
+        Frame *f = frames_ - s.frame <= HISTORY ? &history_[s.frame % HISTORY] : nullptr;
+        // some drivers return garbage for the first query of a context
+        double limit = std::chrono::duration<double, std::milli>(clock::now() - s.start).count();
+        for (int i = 0; i < MAX_SECTIONS; ++i) {
+            if (!s.used[i]) continue;
+            GLuint64 ns = 0;
+            p_glGetQueryObjectui64v(s.q[i], GL_QUERY_RESULT, &ns);
+            double ms = ns / 1e6;
+            s.used[i] = false;
+            if (ms > limit) continue;
+            gpu_total_[i].add(ms);
+            if (f) f->gpu[i] = (float)ms;
+        }
+        s.pending = false;
+    }
+}
+
+double FrameProfiler::percentile(double p) const
+{
+    if (frames_ == 0) return 0.0;
+    uint64_t want = (uint64_t)(p * frames_ + 0.5), seen = 0;
+    for (int i = 0; i < BUCKETS - 1; ++i) {
+        seen += hist_[i];
+        if (seen >= want && seen > 0) return (i + 1) * BUCKET_MS;
+    }
+    return frame_total_.max;
+}
+
+void FrameProfiler::draw(Batch &b, TextRenderer &text, float right, float top)
+{
+    const float w = (float)HISTORY + 60.0f, graph_h = 60.0f;
+    const float lh = (float)text.line_height();
+    const uint32_t ink = Batch::rgba(0.85f, 0.92f, 1.0f, 1.0f);
+    const uint32_t dim = Batch::rgba(0.5f, 0.6f, 0.7f, 1.0f);
+    int n = frames_ < (uint64_t)HISTORY ? (int)frames_ : HISTORY;
+    float x = right - w, y = top;
+    float h = graph_h + 20.0f + (text.ok() ? lh * (3 + nsections_) : 0.0f);
+    b.rect(x, y, w, h, Batch::rgba(0.0f, 0.0f, 0.0f, 0.75f));
+
+    // frame times, newest on the right; the full height is two periods
+    float gx = x + 10.0f, gy = y + 10.0f;
+    float scale = graph_h / (float)(2.0 * period_ms_);
+    for (int i = 0; i < n; ++i) {
+        const Frame &f = history_[(frames_ - n + i) % HISTORY];
+        float bh = f.ms * scale;
+        if (bh > graph_h) bh = graph_h;
+        bool late = f.ms > period_ms_ * 1.5;
+        b.rect(gx + (HISTORY - n + i), gy + graph_h - bh, 1.0f, bh,
+               late ? Batch::rgba(1.0f, 0.3f, 0.2f, 1.0f) : Batch::rgba(0.2f, 0.9f, 0.5f, 1.0f));
+    }
+    b.rect(gx, gy + graph_h * 0.5f, (float)HISTORY, 1.0f, Batch::rgba(1.0f, 1.0f, 1.0f, 0.4f)); // budget
+    if (!text.ok()) return;
+
+    // averages over the graph's frames
+    char line[128];
+    float ty = gy + graph_h + 6.0f;
+    double sum = 0.0, mx = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double ms = history_[(frames_ - n + i) % HISTORY].ms;
+        sum += ms;
+        if (ms > mx) mx = ms;
+    }
+    snprintf(line, sizeof(line), "frame %.2f avg, %.2f max ms", n ? sum / n : 0.0, mx);
+    text.draw(b, line, gx, ty, w - 20.0f, ink);
+    ty += lh;
+    snprintf(line, sizeof(line), "p99 %.1f of %.1f ms, %llu dropped", percentile(0.99), period_ms_,
+             (unsigned long long)dropped_);
+    text.draw(b, line, gx, ty, w - 20.0f, dim);
+    ty += lh;
+    text.draw(b, "section", gx, ty, 0, dim);
+    text.draw(b, "cpu ms", gx + 110.0f, ty, 0, dim);
+    text.draw(b, "gpu ms", gx + 180.0f, ty, 0, dim);
+    ty += lh;
+    for (int s = 0; s < nsections_; ++s) {
+        double cpu = 0.0, gpu = 0.0;
+        int ngpu = 0;
+        for (int i = 0; i < n; ++i) {
+            const Frame &f = history_[(frames_ - n + i) % HISTORY];
+            cpu += f.cpu[s];
+            if (f.gpu[s] >= 0.0f) {
+                gpu += f.gpu[s];
+                ++ngpu;
+            }
+        }
+        text.draw(b, names_[s], gx, ty, 100.0f, ink);
+        snprintf(line, sizeof(line), "%.2f", n ? cpu / n : 0.0);
+        text.draw(b, line, gx + 110.0f, ty, 0, ink);
+        if (ngpu) {
+            snprintf(line, sizeof(line), "%.2f", gpu / ngpu);
+            text.draw(b, line, gx + 180.0f, ty, 0, ink);
+        }
+        ty += lh;
+    }
+}
+
+void FrameProfiler::write_json(FILE *f) const
+{
+    fprintf(f, "{\n  \"frames\": %llu,\n  \"dropped\": %llu,\n  \"period_ms\": %.3f,\n",
+            (unsigned long long)frames_, (unsigned long long)dropped_, period_ms_);
+    fprintf(f, "  \"frame_ms\": {\"avg\": %.3f, \"p50\": %.1f, \"p95\": %.1f, \"p99\": %.1f, \"max\": %.3f},\n",
+            frame_total_.n ? frame_total_.sum / frame_total_.n : 0.0, percentile(0.5), percentile(0.95),
+            percentile(0.99), frame_total_.max);
+    fprintf(f, "  \"histogram\": {\"bucket_ms\": %.1f, \"counts\": [", BUCKET_MS);
+    for (int i = 0; i < BUCKETS; ++i) fprintf(f, "%s%llu", i ? ", " : "", (unsigned long long)hist_[i]);
+    fprintf(f, "]},\n  \"sections\": [");
+    for (int i = 0; i < nsections_; ++i) {
+        const Totals &c = cpu_total_[i], &g = gpu_total_[i];
+        fprintf(f, "%s\n    {\"name\": \"%s\", \"frames\": %llu, \"cpu_avg_ms\": %.4f, \"cpu_max_ms\": %.4f", i ? "," : "",
+                names_[i], (unsigned long long)c.n, c.n ? c.sum / c.n : 0.0, c.max);
+        if (g.n)
+            fprintf(f, ", \"gpu_avg_ms\": %.4f, \"gpu_max_ms\": %.4f", g.sum / g.n, g.max);
+        fprintf(f, "}");
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+bool FrameProfiler::write_json(const char *path) const
+{
+    // temp file + rename: a reader polling the file never sees half of it
+    ox_atomic a;
+    if (ox_atomic_begin(&a, path, 0644, 0) != 0) return false;
+    FILE *f = ox_atomic_stdio(&a);
+    if (f) write_json(f);
+    return ox_atomic_finish(&a, path, f ? 0 : -1) == 0;
+}
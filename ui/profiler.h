@@ -0,0 +1,125 @@
+// ui/profiler.h
+// Frame profiler for the UI loops. Scoped timers split each frame's CPU time
+// into named sections (input, peak copy, draw submission, swap, ...); the
+// same scopes can also bracket their GL commands with GL_TIME_ELAPSED
+// queries, whose results are collected a few frames later without stalling.
+// Every frame lands in a history ring (for the overlay's graph) and in
+// session totals: a frame-time histogram, per-section averages and maxima
+// and a count of dropped frames, i.e. refresh periods missed while the UI was
+// animating. The overlay (F3) draws them with the batch and text renderers;
+// write_json exports them, which is what $OXXY_UI_PROFILE asks for headless.
+
+#pragma once
+
+#include <GL/gl.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+class Batch;
+class TextRenderer;
+
+class FrameProfiler {
+public:
+    static const int MAX_SECTIONS = 12;
+    static const int HISTORY = 240;       // frames in the graph
+    static const int BUCKETS = 100;       // histogram: 0.5 ms each, the last one open
+    static const int QUERY_FRAMES = 4;    // GPU results read this many frames late
+
+    // period: the refresh period frames should fit in (FramePacer::period).
+    // With the context current, GPU timing is set up if timer queries exist.
+    void init(double period);
+    void shutdown();
+
+    // Off, scopes cost one branch. Either the overlay or an export turns it on.
+    void set_enabled(bool on) { enabled_ = on; }
+    bool enabled() const { return enabled_; }
+
+    // Bracket a frame: begin after waiting for events, end after the swap.
+    // animating: the loop wants a frame every period, so a late one counts as
+    // dropped; frames drawn for an event after idling are timed by their work.
+    void begin_frame();
+    void end_frame(bool animating);
+    // Instead of end_frame when the loop woke but draws nothing: closes the
+    // frame's trace span and records no frame.
+    void skip_frame();
+
+    // Section id for a name (a string literal; registered on first use),
+    // -1 once MAX_SECTIONS are in use.
+    int section(const char *name);
+    void begin(int id, bool gpu);
+    void end(int id);
+
+    // Times the enclosing block; gpu also times its GL commands (GPU scopes
+    // must not nest).
+    class Scope {
+    public:
+        Scope(FrameProfiler &p, const char *name, bool gpu = false) : p_(p), id_(p.section(name))
+        {
+            p.begin(id_, gpu);
+        }
+        ~Scope()
+        {
+            if (id_ >= 0) p_.end(id_);
+        }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        FrameProfiler &p_;
+        int id_;
+    };
+
+    // Overlay panel with its top right corner at (right, top), window pixels.
+    void draw(Batch &b, TextRenderer &text, float right, float top);
+    // Session totals as JSON; false if the file cannot be written.
+    bool write_json(const char *path) const;
+    void write_json(FILE *f) const;
+
+    uint64_t frames() const { return frames_; }
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Frame {
+        float ms;                   // frame time (see end_frame)
+        float cpu[MAX_SECTIONS];
+        float gpu[MAX_SECTIONS];    // -1 until the query result is in
+    };
+    struct Totals {
+        double sum = 0.0, max = 0.0;
+        uint64_t n = 0;
+        void add(double v)
+        {
+            sum += v;
+            if (v > max) max = v;
+            ++n;
+        }
+    };
+    struct QuerySet {
+        GLuint q[MAX_SECTIONS];
+        bool used[MAX_SECTIONS];
+        uint64_t frame;             // frames_ when issued
+        clock::time_point start;    // of that frame: no result can be longer
+        bool pending;
+    };
+
+    void collect();                 // read finished GPU queries
+    double percentile(double p) const;
+
+    bool enabled_ = false;
+    bool gpu_ok_ = false;
+    double period_ms_ = 1000.0 / 60.0;
+    const char *names_[MAX_SECTIONS] = {};
+    int nsections_ = 0;
+    clock::time_point frame_start_, last_end_, started_[MAX_SECTIONS];
+    bool have_last_ = false, in_frame_ = false;
+    Frame cur_ = {};
+    Frame history_[HISTORY] = {};
+    uint64_t frames_ = 0, dropped_ = 0;
+    uint64_t hist_[BUCKETS] = {};
+    Totals frame_total_, cpu_total_[MAX_SECTIONS], gpu_total_[MAX_SECTIONS];
+    QuerySet queries_[QUERY_FRAMES] = {};
+    int gpu_open_ = -1;             // section whose query is running
+};
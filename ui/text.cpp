@@ -0,0 +1,192 @@
+// ui/text.cpp
+// Glyph atlas and cached string layout (see text.h).
+
+#include "text.h"
+
+#include <GLFW/glfw3.h>
+#include <GL/glext.h>
+#include <cmath>
+#include <cstring>
+
+extern "C" {
+#include "font.h"
+#include "utf8.h"
+}
+
+// rasterized at init: what titles, paths and the UI's own labels mostly use
+static const uint32_t repertoire[][2] = {
+    {0x0020, 0x007E}, {0x00A0, 0x00FF}, {0x0400, 0x045F}, {0x2010, 0x2027}, {0xFFFD, 0xFFFD},
+};
+
+bool TextRenderer::init(const char *font_path, int px)
+{
+    font_ = font_path ? ox_font_open(font_path, px) : nullptr;
+    if (!font_) return false;
+    struct ox_font_metrics m;
+    ox_font_metrics(font_, &m);
+    ascent_ = m.ascent;
+    line_h_ = m.line_height;
+
+    // single channel; the swizzle makes it (1, 1, 1, coverage) for Batch's tint
+    static const GLint swizzle[4] = {GL_ONE, GL_ONE, GL_ONE, GL_RED};
+    std::vector<unsigned char> blank((size_t)ATLAS_SIZE * ATLAS_SIZE);
+    glGenTextures(1, &atlas_);
+    glBindTexture(GL_TEXTURE_2D, atlas_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_SIZE, ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, blank.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    pen_x_ = pen_y_ = shelf_h_ = 0;
+    full_ = false;
+
+    Glyph g;
+    fallback_ = rasterize(0xFFFD, g) ? 0xFFFD : '?';
+    for (const auto &r : repertoire)
+        for (uint32_t cp = r[0]; cp <= r[1]; ++cp) glyph(cp);
+    return true;
+}
+
+void TextRenderer::shutdown()
+{
+    if (!font_) return;
+    glDeleteTextures(1, &atlas_);
+    ox_font_close(font_);
+    font_ = nullptr;
+    glyphs_.clear();
+    runs_.clear();
+    lru_.clear();
+}
+
+bool TextRenderer::rasterize(uint32_t cp, Glyph &g)
+{
+    struct ox_glyph og;
+    if (ox_font_glyph(font_, cp, &og) != 0) return false;
+    g = Glyph();
+    g.advance = (int16_t)og.advance;
+    if (og.w <= 0 || og.h <= 0 || og.w >= ATLAS_SIZE || og.h >= ATLAS_SIZE) return true;
+    // shelves of glyphs, one pixel apart
+    if (pen_x_ + og.w > ATLAS_SIZE) {
+        pen_y_ += shelf_h_ + 1;
+        pen_x_ = 0;
+        shelf_h_ = 0;
+    }
+    if (pen_y_ + og.h > ATLAS_SIZE) {
+        full_ = true; // drawn blank from now on; it still advances
+        return true;
+    }
+    GLint align = 4, row_length = 0;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &align);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &row_length);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, og.pitch);
+    glBindTexture(GL_TEXTURE_2D, atlas_);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, pen_x_, pen_y_, og.w, og.h, GL_RED, GL_UNSIGNED_BYTE, og.coverage);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, align);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+    g.ax = (int16_t)pen_x_;
+    g.ay = (int16_t)pen_y_;
+    g.w = (int16_t)og.w;
+    g.h = (int16_t)og.h;
+    g.left = (int16_t)og.left;
+    g.top = (int16_t)og.top;
+    pen_x_ += og.w + 1;
+    if (og.h > shelf_h_) shelf_h_ = og.h;
+    return true;
+}
+
+const TextRenderer::Glyph &TextRenderer::glyph(uint32_t cp)
+{
+    auto it = glyphs_.find(cp);
+    if (it != glyphs_.end()) return it->second;
+    Glyph g;
+    if (!rasterize(cp, g)) {
+        if (cp == fallback_ || !rasterize(fallback_, g)) g = Glyph();
+        g.missing = true;
+    }
+    return glyphs_.emplace(cp, g).first->second;
+}
+
+const TextRenderer::Run &TextRenderer::layout(const char *s, float max_w)
+{
+    int limit = max_w > 0.0f ? (int)max_w : 0;
+    key_.assign(s);
+    key_.push_back('\0');
+    key_.append(reinterpret_cast<const char *>(&limit), sizeof(limit));
+    auto it = runs_.find(key_);
+    if (it != runs_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        return it->second;
+    }
+
+    struct Item {
+        const Glyph *g;
+        int pen;
+    };
+    std::vector<Item> items;
+    int pen = 0;
+    for (const char *p = s; *p;) {
+        uint32_t cp = ox_utf8_next(&p);
+        if (cp < 0x20) continue;
+        const Glyph &g = glyph(cp);
+        items.push_back({&g, pen});
+        pen += g.advance;
+    }
+    if (limit && pen > limit) {
+        // cut on a glyph boundary so that the ellipsis fits
+        const Glyph *ell = &glyph(0x2026);
+        int nell = 1;
+        if (ell->missing) {
+            ell = &glyph('.');
+            nell = 3;
+        }
+        int room = limit - nell * ell->advance;
+        size_t n = 0;
+        while (n < items.size() && items[n].pen + items[n].g->advance <= room) ++n;
+        pen = n ? items[n - 1].pen + items[n - 1].g->advance : 0;
+        items.resize(n);
+        for (int i = 0; i < nell && pen + ell->advance <= limit; ++i) {
+            items.push_back({ell, pen});
+            pen += ell->advance;
+        }
+    }
+
+    if (runs_.size() >= CACHE_RUNS) {
+        runs_.erase(lru_.back());
+        lru_.pop_back();
+    }
+    lru_.push_front(key_);
+    Run &r = runs_[key_];
+    r.lru = lru_.begin();
+    r.width = (float)pen;
+    r.quads.reserve(items.size());
+    for (const Item &i : items) {
+        const Glyph &g = *i.g;
+        if (g.w == 0) continue;
+        r.quads.push_back({(int16_t)(i.pen + g.left), (int16_t)(ascent_ - g.top), g.w, g.h, g.ax, g.ay});
+    }
+    return r;
+}
+
+float TextRenderer::draw(Batch &b, const char *s, float x, float y, float max_w, uint32_t color)
+{
+    if (!font_ || !s || !*s) return 0.0f;
+    const Run &r = layout(s, max_w);
+    // whole pixels: the atlas is sampled 1:1 without filtering
+    x = std::floor(x + 0.5f);
+    y = std::floor(y + 0.5f);
+    const float inv = 1.0f / ATLAS_SIZE;
+    for (const Quad &q : r.quads)
+        b.texture(atlas_, x + q.x, y + q.y, q.w, q.h, q.ax * inv, q.ay * inv, (q.ax + q.w) * inv,
+                  (q.ay + q.h) * inv, color);
+    return r.width;
+}
+
+float TextRenderer::measure(const char *s, float max_w)
+{
+    if (!font_ || !s || !*s) return 0.0f;
+    return layout(s, max_w).width;
+}
@@ -0,0 +1,75 @@
+// ui/text.h
+// Text for the batch renderer. Glyphs are rasterized once (src/font.c) into
+// a single-channel atlas texture: the common repertoire (ASCII, Latin-1,
+// Cyrillic, punctuation) at init, anything else the first time it is drawn,
+// while room lasts. A string's layout (glyph quads, width, ellipsis when it
+// is cut to a width) is kept in a bounded LRU cache, so redrawing the same
+// labels and rows is a hash lookup plus one Batch quad per glyph, and memory
+// stays flat however many different strings scroll by.
+
+#pragma once
+
+#include <GL/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "batch.h"
+
+struct ox_font;
+
+class TextRenderer {
+public:
+    static const int ATLAS_SIZE = 1024;
+    static const size_t CACHE_RUNS = 4096; // layouts kept
+
+    // Call with the context current. False if the font cannot be opened
+    // (no FreeType, no file); draw and measure then do nothing.
+    bool init(const char *font_path, int px);
+    void shutdown();
+    bool ok() const { return font_ != nullptr; }
+
+    int ascent() const { return ascent_; }
+    int line_height() const { return line_h_; }
+
+    // Draw UTF-8 s with the top of its line box at (x, y), cut with an
+    // ellipsis to max_w pixels (0: no limit). Returns the width drawn.
+    float draw(Batch &b, const char *s, float x, float y, float max_w, uint32_t color);
+    float measure(const char *s, float max_w = 0.0f);
+
+    size_t cached_runs() const { return runs_.size(); }
+    size_t glyphs() const { return glyphs_.size(); }
+
+private:
+    struct Glyph {
+        int16_t ax = 0, ay = 0;        // atlas position
+        int16_t w = 0, h = 0, left = 0, top = 0, advance = 0;
+        bool missing = false;          // not in the font: a copy of the fallback
+    };
+    struct Quad {
+        int16_t x, y, w, h, ax, ay;    // x, y relative to the line box
+    };
+    struct Run {
+        std::vector<Quad> quads;
+        float width = 0.0f;
+        std::list<std::string>::iterator lru;
+    };
+
+    const Glyph &glyph(uint32_t cp);
+    bool rasterize(uint32_t cp, Glyph &g); // false if the font lacks cp
+    const Run &layout(const char *s, float max_w);
+
+    struct ox_font *font_ = nullptr;
+    GLuint atlas_ = 0;
+    int ascent_ = 0, line_h_ = 0;
+    int pen_x_ = 0, pen_y_ = 0, shelf_h_ = 0; // shelf packer
+    bool full_ = false;
+    std::unordered_map<uint32_t, Glyph> glyphs_;
+    uint32_t fallback_ = '?';
+    std::list<std::string> lru_;
+    std::unordered_map<std::string, Run> runs_;
+    std::string key_;
+};
@@ -2,9 +2,29 @@
 // Custom GLFW + OpenGL3 neon-themed UI for OXXY (no Dear ImGui dependency)
 // Features:
 // - Neon/cyberpunk color scheme
-// - Waveform visualization (synthetic waveform for demo)
-// - Album art crossfade placeholder
+// - Whole-track waveform drawn on the GPU (waveview.cpp): peaks accumulate per
+//   track; scroll zooms, drag pans, right click fits (synthetic track for demo)
+// - Album art: thumbnails decoded off-thread (src/art.c), streamed to textures
+//   (art_upload.cpp) and crossfaded on track change
 // - Simple scrubber and clickable Play/Pause button
+// - Labels and the playlist through the glyph atlas (text.cpp); the playlist
+//   is a virtualized list (listview.cpp): only visible rows are read and laid
+//   out, so a million entries scroll as smoothly as ten
+// - Drawn by the batch renderer (batch.cpp) on a core-profile context: the
+//   whole frame is one streaming vertex buffer and a draw call or two
+// - Event driven (pacer.cpp): input comes in through callbacks, and a frame is
+//   drawn only on input, new peaks from the bridge or while something animates
+// - Frame profiler (profiler.cpp): F3 shows CPU/GPU time per section, the
+//   frame-time graph and dropped frames; $OXXY_UI_PROFILE=file.json exports
+//   the totals every few seconds and at exit
+// - Startup does only what the first frame needs: the font is looked up on
+//   a thread (labels appear when it arrives) and the art cache starts with
+//   the first cover wanted; phases are timed (src/startup.c)
+// - $OXXY_ENGINE attaches to an engine daemon (src/engine_ipc.c): peaks,
+//   position and the current entry then come from its shared memory, and
+//   play/pause, seeks, additions and the entry to play (by URI) are sent to it
+// - Frames and their sections are trace spans next to the audio threads'
+//   (src/trace.c); F4 writes the trace to $OXXY_TRACE or oxxy-trace.json
 
 #include <GLFW/glfw3.h>
 #include <GL/gl.h>
@@ -13,166 +33,429 @@
 #include <cmath>
 #include <vector>
 #include <chrono>
-#include <thread>
 #include <string>
 #include <cstring>
+#include <unordered_set>
+#include <atomic>
+#include <thread>
+
+#include "art_upload.h"
+#include "batch.h"
+#include "listview.h"
+#include "pacer.h"
+#include "profiler.h"
+#include "text.h"
+#include "waveview.h"
 
 // Externs for UI bridge
 extern "C" {
 #include "ui_bridge.h"
+#include "art.h"
+#include "font.h"
+#include "startup.h"
 }
+#include "trace.h"
 
-// Minimal helper: draw colored rectangle using immediate mode via glDrawArrays
-// For simplicity we use a very small compatibility helper (works with GL3 core if VAO/VBO setup done)
+static Batch batch;
+static int win_w = 1280, win_h = 720;
 
 static void draw_rect(float x, float y, float w, float h, float r, float g, float b, float a)
 {
-    glColor4f(r, g, b, a);
-    glBegin(GL_QUADS);
-    glVertex2f(x, y);
-    glVertex2f(x + w, y);
-    glVertex2f(x + w, y + h);
-    glVertex2f(x, y + h);
-    glEnd();
+    batch.rect(x, y, w, h, Batch::rgba(r, g, b, a));
 }
 
-static void draw_line_strip(const std::vector<float> &xs, const std::vector<float> &ys, float r, float g, float b, float a)
+static void draw_texture(GLuint tex, float x, float y, float w, float h, float a)
 {
-    glColor4f(r, g, b, a);
-    glBegin(GL_LINE_STRIP);
-    for (size_t i = 0; i < xs.size(); ++i) glVertex2f(xs[i], ys[i]);
-    glEnd();
+    batch.texture(tex, x, y, w, h, Batch::rgba(1.0f, 1.0f, 1.0f, a));
 }
 
-// Simple mapping helpers for NDC coordinate drawing in window coords
-static int win_w = 1280, win_h = 720;
-static void ortho_setup()
+// Input is edge triggered: each press is queued once by the callback and
+// handled by the next frame, so a click is never missed or repeated.
+struct Click { double x, y; };
+static std::vector<Click> clicks;
+static bool mouse_down = false;  // left button held (scrubber drag, waveform pan)
+static double mouse_x, mouse_y;
+static double scroll_y = 0.0;    // wheel steps since the last frame
+static bool fit_request = false; // right click: whole track
+static bool dirty = true;        // redraw needed
+static std::vector<int> pressed; // keys pressed (or repeated) since the last frame
+static std::string typed;        // UTF-8 text typed since the last frame
+
+static void mouse_button_cb(GLFWwindow *w, int button, int action, int mods)
 {
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0.0, win_w, win_h, 0.0, -1.0, 1.0);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    (void)mods;
+    if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) fit_request = dirty = true;
+    if (button != GLFW_MOUSE_BUTTON_LEFT) return;
+    glfwGetCursorPos(w, &mouse_x, &mouse_y);
+    if (action == GLFW_PRESS) clicks.push_back({mouse_x, mouse_y});
+    mouse_down = action == GLFW_PRESS;
+    dirty = true;
+}
+
+static void cursor_pos_cb(GLFWwindow *w, double x, double y)
+{
+    (void)w;
+    mouse_x = x;
+    mouse_y = y;
+    if (mouse_down) dirty = true;
+}
+
+static void scroll_cb(GLFWwindow *w, double dx, double dy)
+{
+    (void)w; (void)dx;
+    scroll_y += dy;
+    dirty = true;
+}
+
+static void key_cb(GLFWwindow *w, int key, int scancode, int action, int mods)
+{
+    (void)w; (void)scancode; (void)mods;
+    if (action == GLFW_PRESS || action == GLFW_REPEAT) { pressed.push_back(key); dirty = true; }
+}
+
+static void char_cb(GLFWwindow *w, unsigned int cp)
+{
+    (void)w;
+    if (cp < 0x20 || cp > 0x10FFFF || (cp >= 0xD800 && cp < 0xE000)) return;
+    if (cp < 0x80) {
+        typed += (char)cp;
+    } else if (cp < 0x800) {
+        typed += (char)(0xC0 | cp >> 6);
+        typed += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        typed += (char)(0xE0 | cp >> 12);
+        typed += (char)(0x80 | ((cp >> 6) & 0x3F));
+        typed += (char)(0x80 | (cp & 0x3F));
+    } else {
+        typed += (char)(0xF0 | cp >> 18);
+        typed += (char)(0x80 | ((cp >> 12) & 0x3F));
+        typed += (char)(0x80 | ((cp >> 6) & 0x3F));
+        typed += (char)(0x80 | (cp & 0x3F));
+    }
+    dirty = true;
+}
+
+// "m:ss" (or "h:mm:ss") into buf
+static void format_time(char *buf, size_t cap, double seconds)
+{
+    long t = seconds > 0.0 ? (long)seconds : 0;
+    if (t >= 3600) snprintf(buf, cap, "%ld:%02ld:%02ld", t / 3600, t / 60 % 60, t % 60);
+    else snprintf(buf, cap, "%ld:%02ld", t / 60, t % 60);
+}
+
+static void framebuffer_size_cb(GLFWwindow *w, int width, int height)
+{
+    (void)w; (void)width; (void)height;
+    dirty = true;
+}
+
+static void refresh_cb(GLFWwindow *w)
+{
+    (void)w;
+    dirty = true;
 }
 
 int main(int argc, char **argv)
 {
     (void)argc; (void)argv;
+    ox_startup_begin();
+    OX_TRACE_THREAD("ui");
     if (!glfwInit()) { fprintf(stderr, "GLFW init failed\n"); return 1; }
 
+    // fontconfig can take a while on a cold cache: look the font up meanwhile
+    std::atomic<char *> font_path{nullptr};
+    std::atomic<bool> font_looked_up{false};
+    std::thread font_thread([&] {
+        font_path = ox_font_default_path();
+        font_looked_up = true;
+        glfwPostEmptyEvent();
+    });
+
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_ANY_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
 
     GLFWwindow *w = glfwCreateWindow(win_w, win_h, "OXXY — Neon UI", NULL, NULL);
-    if (!w) { glfwTerminate(); return 1; }
+    if (!w) {
+        font_thread.join();
+        free(font_path);
+        glfwTerminate();
+        return 1;
+    }
+    ox_startup_mark("window");
     glfwMakeContextCurrent(w);
     glfwSwapInterval(1);
+    if (!batch.init()) {
+        fprintf(stderr, "OpenGL 3.3 core renderer unavailable\n");
+        glfwDestroyWindow(w);
+        font_thread.join();
+        free(font_path);
+        glfwTerminate();
+        return 1;
+    }
+    // peaks come in as (-p, p) pairs: one texel per peak, symmetric about the axis
+    WaveView wave;
+    if (!wave.init(2)) {
+        fprintf(stderr, "OpenGL 3.3 core waveform renderer unavailable\n");
+        batch.shutdown();
+        glfwDestroyWindow(w);
+        font_thread.join();
+        free(font_path);
+        glfwTerminate();
+        return 1;
+    }
+    glfwSetMouseButtonCallback(w, mouse_button_cb);
+    glfwSetScrollCallback(w, scroll_cb);
+    glfwSetKeyCallback(w, key_cb);
+    glfwSetCharCallback(w, char_cb);
+    glfwSetCursorPosCallback(w, cursor_pos_cb);
+    glfwSetFramebufferSizeCallback(w, framebuffer_size_cb);
+    glfwSetWindowRefreshCallback(w, refresh_cb);
+    FramePacer pacer;
+    pacer.init();
+    ox_ui_set_wakeup(glfwPostEmptyEvent);
+
+    // Profiling: the overlay on F3, the export when asked for in the environment
+    FrameProfiler prof;
+    prof.init(pacer.period());
+    const char *prof_path = getenv("OXXY_UI_PROFILE");
+    if (prof_path && !*prof_path) prof_path = NULL;
+    bool show_prof = false;
+    double prof_written = glfwGetTime();
+    prof.set_enabled(prof_path != NULL);
+    const int s_peaks = prof.section("peaks"), s_art = prof.section("art"), s_input = prof.section("input");
+    const int s_draw = prof.section("draw"), s_wave = prof.section("wave"), s_controls = prof.section("controls");
+    const int s_overlay = prof.section("overlay"), s_flush = prof.section("flush"), s_swap = prof.section("swap");
+
+    // Text: set up when the lookup is done; without a font (or FreeType) the
+    // UI still works, unlabelled
+    TextRenderer text;
+
+    // An engine daemon to follow, unless the launcher already attached
+    bool own_engine = false;
+    const char *engine_env = getenv("OXXY_ENGINE");
+    if (engine_env && *engine_env && strcmp(engine_env, "0") != 0 && !ox_ui_attached()) {
+        own_engine = ox_ui_attach(NULL) == 0;
+        if (!own_engine) fprintf(stderr, "No engine to attach to, running standalone\n");
+    }
+
+    // The playlist: the launcher's, or one of our own when run standalone
+    struct ox_plshare *own_playlist = NULL;
+    if (!ox_ui_get_playlist()) {
+        own_playlist = ox_plshare_create(NULL);
+        ox_ui_set_playlist(own_playlist);
+    }
+    ListView list;
+    list.set_row_height(24.0f);
+    uint64_t list_version = 0;
 
     // UI state
     bool playing = false;
-    double progress = 0.0, length = 180.0;
+    double progress = 0.0, length = 0.0;
     float volume = 0.8f;
     bool show_login = false;
     bool show_add_music = false;
     char input_text[256] = {0};
     int input_cursor = 0;
+    double anim_t = 0.0; // animation clock: runs only while playing
+    bool scrubbing = false;
+    bool panning = false; // dragging the waveform
+    double pan_x = 0.0;
+
+    // Album art: 128px thumbnails (crisp on HiDPI) shown in the 64px slot
+    const int art_size = 128;
+    const double art_fade = 0.25;
+    const size_t art_budget = 512 * 1024; // bytes uploaded per frame
+    struct ox_art_cache *art = NULL; // started by the first cover wanted
+    ArtUploader uploader;
+    uploader.init();
+    std::unordered_set<std::string> no_art;
+    std::string art_cur, art_prev;
+    double art_since = -art_fade;
 
-    // Waveform buffer (filled from audio thread via ui_bridge)
+    // Waveform of the current track, filled from the audio thread via
+    // ui_bridge. Until peaks arrive a synthetic track is shown.
     const size_t samples = 2048;
-    std::vector<float> wave(samples);
+    {
+        const size_t demo_len = 1 << 20;
+        std::vector<float> demo(demo_len);
+        for (size_t i = 0; i < demo_len; ++i)
+            demo[i] = (float)(sin(i * 0.05) * (0.3 + 0.15 * sin(i * 0.0007)) * (0.6 + 0.4 * sin(i * 0.00002)));
+        wave.append(demo.data(), demo_len);
+    }
+    std::string wave_uri;
+    bool have_peaks = false;
+    bool streaming = false; // peaks arrived last frame: pace frames to them
 
     auto last = std::chrono::steady_clock::now();
     while (!glfwWindowShouldClose(w)) {
-        glfwPollEvents();
-        glfwGetFramebufferSize(w, &win_w, &win_h);
-        glViewport(0, 0, win_w, win_h);
-        ortho_setup();
-        glClearColor(0.03f, 0.03f, 0.05f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // Neon accent
-        float nr = 0.0f/255.0f, ng = 180.0f/255.0f, nb = 255.0f/255.0f;
+        bool fading = glfwGetTime() - art_since < art_fade;
+        bool animating = playing || streaming || fading || uploader.queued() || ox_art_pending(art);
+        pacer.wait(animating, dirty);
+        prof.begin_frame();
 
-        // Draw top bar
-        draw_rect(10, 10, win_w - 20, 80, 0.06f, 0.07f, 0.09f, 1.0f);
-        // Draw album art placeholder
-        draw_rect(30, 30, 64, 64, 0.06f, 0.07f, 0.09f, 1.0f);
-        // Draw waveform area
-        const float wfx = 110, wfy = 120; const float wfw = win_w - 140, wfh = 160;
-        draw_rect(wfx - 4, wfy - 4, wfw + 8, wfh + 8, 0.02f, 0.02f, 0.03f, 1.0f);
+        if (font_looked_up && font_thread.joinable()) {
+            font_thread.join();
+            char *path = font_path.exchange(nullptr);
+            if (text.init(path, 15)) list.set_row_height((float)text.line_height() + 8.0f);
+            else fprintf(stderr, "No usable font; drawing without text\n");
+            free(path);
+            ox_startup_mark("font");
+            dirty = true;
+        }
 
-        // Build line points
-        std::vector<float> xs, ys;
-        xs.reserve(samples); ys.reserve(samples);
-        // copy available peaks from bridge into wave (non-blocking)
+        // append available peaks from bridge to the track's waveform (non-blocking)
+        prof.begin(s_peaks, false);
         extern size_t ox_ui_get_waveform_copy(float *, size_t);
-        static float scratch[2048];
+        static float scratch[2048], pairs[2 * 2048];
         size_t copied = ox_ui_get_waveform_copy(scratch, samples);
         if (copied > 0) {
-            for (size_t i = 0; i < copied && i < samples; ++i) wave[i] = scratch[i];
+            if (!have_peaks) wave.clear();
+            for (size_t i = 0; i < copied; ++i) { pairs[2 * i] = -scratch[i]; pairs[2 * i + 1] = scratch[i]; }
+            wave.append(pairs, 2 * copied);
+            have_peaks = dirty = true;
+        }
+        streaming = copied > 0;
+        prof.end(s_peaks);
+
+        // Album art: collect finished thumbnails, upload within budget
+        prof.begin(s_art, true);
+        struct ox_art_thumb done[8];
+        size_t ndone = ox_art_poll(art, done, 8);
+        for (size_t i = 0; i < ndone; ++i) {
+            if (done[i].img.rgba) {
+                uploader.submit(done[i].path, done[i].img.rgba, done[i].img.w, done[i].img.h);
+                done[i].img.rgba = NULL;
+            } else {
+                no_art.insert(done[i].path);
+            }
+            ox_art_thumb_free(&done[i]);
+        }
+        uploader.pump(art_budget);
+        const char *uri = ox_ui_get_current_uri();
+        std::string want = uri ? uri : "";
+        if (want != wave_uri) {
+            // a new track starts a new waveform
+            wave_uri = want;
+            if (have_peaks) wave.clear();
+            dirty = true;
+        }
+        if (!want.empty() && !uploader.get(want) && !no_art.count(want)) {
+            if (!art) art = ox_art_cache_create(NULL, 2);
+            ox_art_request(art, uri, art_size, NULL);
         }
-        for (size_t i = 0; i < samples; ++i) {
-            float x = wfx + (float)i / (samples - 1) * wfw;
-            float y = wfy + wfh * 0.5f * (1.0f - wave[i]);
-            xs.push_back(x); ys.push_back(y);
+        if (want != art_cur && (want.empty() || uploader.get(want) || no_art.count(want))) {
+            art_prev = art_cur;
+            art_cur = want;
+            art_since = glfwGetTime();
+            dirty = true;
         }
-        draw_line_strip(xs, ys, nr, ng, nb, 0.9f);
+        prof.end(s_art);
 
-        // Draw EQ bars
-        for (int i = 0; i < 12; ++i) {
-            float bx = 40.0f + i * 22.0f;
-            float bh = 20.0f + 80.0f * fabs(sin((float)glfwGetTime() * (0.3f + i * 0.05f)));
-            draw_rect(bx, win_h - 140 - bh, 16, bh, nr, ng, nb, 1.0f);
+        // Advance progress and the animations if playing
+        auto now = std::chrono::steady_clock::now();
+        double dt = std::chrono::duration_cast<std::chrono::duration<double>>(now - last).count();
+        last = now;
+        length = ox_ui_get_track_length();
+        if (playing) anim_t += dt;
+        if (ox_ui_attached() && !scrubbing) progress = ox_ui_get_current_position();
+        else if (playing) progress += dt;
+        if (length > 0.0 && progress >= length) { progress = 0.0; }
+
+        struct ox_plshare *pls = ox_ui_get_playlist();
+        uint64_t version = pls ? ox_plshare_version(pls) : 0;
+        if (version != list_version) { list_version = version; dirty = true; }
+
+        if (!dirty && !animating) { // woken for nothing visible
+            prof.skip_frame();
+            continue;
         }
+        dirty = false;
 
-        // Draw top menu
-        draw_rect(10, 10, win_w - 20, 40, 0.06f, 0.07f, 0.09f, 1.0f);
-        // VK Login button
-        draw_rect(20, 15, 100, 30, nr, ng, nb, show_login ? 1.0f : 0.6f);
-        // Telegram Login button (placeholder)
-        draw_rect(130, 15, 120, 30, nr, ng, nb, 0.6f);
-        // Add Music button
-        draw_rect(260, 15, 100, 30, nr, ng, nb, show_add_music ? 1.0f : 0.6f);
+        glfwGetFramebufferSize(w, &win_w, &win_h);
 
-        // Draw playback controls
+        // Neon accent
+        float nr = 0.0f/255.0f, ng = 180.0f/255.0f, nb = 255.0f/255.0f;
+
+        // Layout
+        const float wfx = 110, wfy = 120; const float wfw = win_w - 140, wfh = 160;
         float btnw = 80, btnh = 40;
         float bx = win_w * 0.5f - 1.5f * (btnw + 10);
         float by = win_h - 80;
-        // Play/Pause
-        draw_rect(bx, by, btnw, btnh, nr, ng, nb, playing ? 1.0f : 0.6f);
-        // Next
-        draw_rect(bx + (btnw + 10), by, btnw, btnh, nr, ng, nb, 0.6f);
-        // Prev
-        draw_rect(bx + 2*(btnw + 10), by, btnw, btnh, nr, ng, nb, 0.6f);
-
-        // Scrubber
         float sbx = 50, sby = win_h - 140; float sbw = win_w - 100, sbh = 10;
-        draw_rect(sbx, sby, sbw, sbh, 0.08f, 0.09f, 0.11f, 1.0f);
-        float fill = (float)(progress / length);
-        if (fill < 0.0f) fill = 0.0f; if (fill > 1.0f) fill = 1.0f;
-        draw_rect(sbx, sby, sbw * fill, sbh, nr, ng, nb, 1.0f);
+        const float lx = win_w * 0.5f, ly = 300; const float lw = win_w * 0.5f - 30, lh = win_h - 160 - ly;
 
-        // Mouse interaction (simple)
-        double mx, my; int ml = glfwGetMouseButton(w, GLFW_MOUSE_BUTTON_LEFT);
-        glfwGetCursorPos(w, &mx, &my);
-        if (ml == GLFW_PRESS) {
+        // Keys: typing goes to the add-music field while it is open, the
+        // rest drives the playlist
+        prof.begin(s_input, false);
+        auto play_entry = [&](size_t i) {
+            if (!pls || i == ListView::NONE) return;
+            struct playlist *pw = ox_plshare_edit(pls);
+            if (playlist_jump(pw, i) == 0) {
+                std::string uri = playlist_uri(pw, i);
+                ox_plshare_publish(pls);
+                ox_ui_request_play_uri(uri.c_str());
+                playing = true;
+            } else {
+                ox_plshare_abandon(pls);
+            }
+        };
+        if (show_add_music) {
+            size_t room = sizeof(input_text) - 1 - (size_t)input_cursor;
+            if (!typed.empty() && typed.size() <= room) {
+                memcpy(input_text + input_cursor, typed.data(), typed.size());
+                input_cursor += (int)typed.size();
+                input_text[input_cursor] = '\0';
+            }
+        }
+        typed.clear();
+        for (int key : pressed) {
+            if (key == GLFW_KEY_F3) {
+                show_prof = !show_prof;
+                prof.set_enabled(show_prof || prof_path);
+            } else if (key == GLFW_KEY_F4) {
+                const char *path = ox_trace_path() ? ox_trace_path() : "oxxy-trace.json";
+                if (ox_trace_write(path) == 0) fprintf(stderr, "Trace written to %s\n", path);
+                else fprintf(stderr, "Cannot write trace to %s\n", path);
+            } else if (show_add_music) {
+                if (key == GLFW_KEY_BACKSPACE && input_cursor > 0) {
+                    // a whole code point: back over continuation bytes
+                    do --input_cursor; while (input_cursor > 0 && (input_text[input_cursor] & 0xC0) == 0x80);
+                    input_text[input_cursor] = '\0';
+                } else if (key == GLFW_KEY_ENTER && input_cursor > 0) {
+                    ox_ui_add_to_playlist(input_text);
+                    input_text[0] = '\0';
+                    input_cursor = 0;
+                } else if (key == GLFW_KEY_ESCAPE) {
+                    show_add_music = false;
+                }
+            } else if (key == GLFW_KEY_ENTER) {
+                play_entry(list.selected());
+            } else if (key == GLFW_KEY_ESCAPE) {
+                show_login = false;
+            } else {
+                list.key(key);
+            }
+        }
+        pressed.clear();
+
+        // Clicks since the last frame, once each
+        for (const Click &c : clicks) {
+            double mx = c.x, my = c.y;
             // VK Login button
             if (mx >= 20 && mx <= 120 && my >= 15 && my <= 45) {
                 show_login = !show_login;
                 show_add_music = false;
-                std::this_thread::sleep_for(std::chrono::milliseconds(150));
             }
             // Telegram Login button (placeholder)
             if (mx >= 130 && mx <= 250 && my >= 15 && my <= 45) {
                 // Placeholder for Telegram login
-                std::this_thread::sleep_for(std::chrono::milliseconds(150));
             }
             // Add Music button
             if (mx >= 260 && mx <= 360 && my >= 15 && my <= 45) {
                 show_add_music = !show_add_music;
                 show_login = false;
-                std::this_thread::sleep_for(std::chrono::milliseconds(150));
             }
             // Add button in panel
             if (show_add_music && mx >= 60 && mx <= 160 && my >= 120 && my <= 150) {
@@ -182,49 +465,227 @@ int main(int argc, char **argv)
                     input_cursor = 0;
                     show_add_music = false;
                 }
-                std::this_thread::sleep_for(std::chrono::milliseconds(150));
             }
-            // if click in scrubber area, update progress
-            if (mx >= sbx && mx <= sbx + sbw && my >= sby && my <= sby + sbh) {
-                progress = (mx - sbx) / sbw * length;
+            // scrubber
+            if (length > 0.0 && mx >= sbx && mx <= sbx + sbw && my >= sby && my <= sby + sbh) {
+                scrubbing = true;
+            }
+            // waveform: drag to pan (not through the panels over it)
+            if (!show_login && !show_add_music && mx >= wfx && mx <= wfx + wfw && my >= wfy && my <= wfy + wfh) {
+                panning = true;
+                pan_x = mx;
+            }
+            // playlist: click selects, a click on the selected row plays it
+            if (!show_login && !show_add_music && list.contains(mx, my)) {
+                size_t was = list.selected();
+                size_t i = list.click(mx, my);
+                if (i != ListView::NONE && i == was) play_entry(i);
             }
             // play/pause button
             if (mx >= bx && mx <= bx + btnw && my >= by && my <= by + btnh) {
                 playing = !playing;
-                // simple debounce
-                std::this_thread::sleep_for(std::chrono::milliseconds(150));
+                ox_ui_request_play(playing);
             }
         }
+        // scrubbing: a press on the bar follows the cursor until released
+        if (!mouse_down && scrubbing) ox_ui_request_seek(progress);
+        if (!mouse_down) scrubbing = false;
+        if (scrubbing) {
+            double f = (mouse_x - sbx) / sbw;
+            progress = (f < 0.0 ? 0.0 : f > 1.0 ? 1.0 : f) * length;
+        }
+        clicks.clear();
+        if (!mouse_down) panning = false;
+        if (panning) {
+            wave.pan((float)(mouse_x - pan_x));
+            pan_x = mouse_x;
+        }
+        if (scroll_y != 0.0 && list.contains(mouse_x, mouse_y)) {
+            list.scroll(-3.0 * scroll_y);
+            scroll_y = 0.0;
+        }
+        if (scroll_y != 0.0 && mouse_x >= wfx && mouse_x <= wfx + wfw && mouse_y >= wfy && mouse_y <= wfy + wfh)
+            wave.zoom(pow(1.25, scroll_y), (float)(mouse_x - wfx));
+        scroll_y = 0.0;
+        if (fit_request) wave.fit();
+        fit_request = false;
+        prof.end(s_input);
+
+        prof.begin(s_draw, true);
+        glViewport(0, 0, win_w, win_h);
+        batch.begin(win_w, win_h);
+        glClearColor(0.03f, 0.03f, 0.05f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // Draw top bar
+        draw_rect(10, 10, win_w - 20, 80, 0.06f, 0.07f, 0.09f, 1.0f);
+        // Album art crossfade
+        float t = (float)((glfwGetTime() - art_since) / art_fade);
+        if (t > 1.0f) t = 1.0f;
+        draw_rect(30, 30, 64, 64, 0.06f, 0.07f, 0.09f, 1.0f);
+        GLuint prev_tex = art_prev.empty() ? 0 : uploader.get(art_prev);
+        GLuint cur_tex = art_cur.empty() ? 0 : uploader.get(art_cur);
+        if (prev_tex && t < 1.0f) draw_texture(prev_tex, 30, 30, 64, 64, 1.0f - t);
+        if (cur_tex) draw_texture(cur_tex, 30, 30, 64, 64, t);
+        // Draw waveform area
+        draw_rect(wfx - 4, wfy - 4, wfw + 8, wfh + 8, 0.02f, 0.02f, 0.03f, 1.0f);
+
+        // the waveform is its own draw between the batched layers
+        batch.flush();
+        prof.end(s_draw);
+        prof.begin(s_wave, true);
+        wave.draw(wfx, wfy, wfw, wfh, win_w, win_h, Batch::rgba(nr, ng, nb, 0.9f), Batch::rgba(0.6f, 0.9f, 1.0f, 1.0f));
+        prof.end(s_wave);
+        prof.begin(s_controls, true);
+
+        // Draw EQ bars
+        for (int i = 0; i < 12; ++i) {
+            float bx = 40.0f + i * 22.0f;
+            float bh = 20.0f + 80.0f * fabs(sin((float)anim_t * (0.3f + i * 0.05f)));
+            draw_rect(bx, win_h - 140 - bh, 16, bh, nr, ng, nb, 1.0f);
+        }
+
+        // Draw top menu
+        draw_rect(10, 10, win_w - 20, 40, 0.06f, 0.07f, 0.09f, 1.0f);
+        // VK Login button
+        draw_rect(20, 15, 100, 30, nr, ng, nb, show_login ? 1.0f : 0.6f);
+        // Telegram Login button (placeholder)
+        draw_rect(130, 15, 120, 30, nr, ng, nb, 0.6f);
+        // Add Music button
+        draw_rect(260, 15, 100, 30, nr, ng, nb, show_add_music ? 1.0f : 0.6f);
+        const uint32_t label = Batch::rgba(0.02f, 0.03f, 0.05f, 1.0f);
+        const uint32_t ink = Batch::rgba(0.85f, 0.92f, 1.0f, 1.0f);
+        const uint32_t dim = Batch::rgba(0.5f, 0.6f, 0.7f, 1.0f);
+        const float ty = 30 - text.line_height() * 0.5f; // centred in the menu buttons
+        text.draw(batch, "VK", 70 - text.measure("VK") * 0.5f, ty, 0, label);
+        text.draw(batch, "Telegram", 190 - text.measure("Telegram") * 0.5f, ty, 0, label);
+        text.draw(batch, "Add music", 310 - text.measure("Add music") * 0.5f, ty, 0, label);
+
+        // Playlist, read from the published snapshot for this frame only
+        if (pls) {
+            struct ox_plread rd;
+            const struct playlist *pl = ox_plshare_read_begin(pls, &rd);
+            list.set_count(pl->count);
+            auto row_text = [pl](size_t i, std::string &left, std::string &right) {
+                const char *title = playlist_title(pl, i);
+                if (*title) {
+                    left = title;
+                } else {
+                    const char *uri = playlist_uri(pl, i);
+                    const char *slash = strrchr(uri, '/');
+                    left = slash && slash[1] ? slash + 1 : uri;
+                }
+                int32_t ms = pl->items[i].duration_ms;
+                if (ms >= 0) {
+                    char buf[32];
+                    format_time(buf, sizeof(buf), ms / 1000.0);
+                    right = buf;
+                }
+            };
+            ListView::Colors lc = {Batch::rgba(0.05f, 0.06f, 0.08f, 1.0f), ink, dim,
+                                   Batch::rgba(nr, ng, nb, 0.25f), Batch::rgba(1.0f, 1.0f, 1.0f, 0.08f),
+                                   Batch::rgba(nr, ng, nb, 0.6f)};
+            list.draw(batch, text, lx, ly, lw, lh, row_text, pl->pos < pl->count ? pl->pos : ListView::NONE, lc);
+            if (pl->count == 0)
+                text.draw(batch, "Playlist is empty: add music above", lx + 8, ly + 8, lw - 16, dim);
+            ox_plshare_read_end(pls, &rd);
+        }
+
+        // Draw playback controls
+        // Play/Pause
+        draw_rect(bx, by, btnw, btnh, nr, ng, nb, playing ? 1.0f : 0.6f);
+        // Next
+        draw_rect(bx + (btnw + 10), by, btnw, btnh, nr, ng, nb, 0.6f);
+        // Prev
+        draw_rect(bx + 2*(btnw + 10), by, btnw, btnh, nr, ng, nb, 0.6f);
+        const char *btn_labels[3] = {playing ? "Pause" : "Play", "Next", "Prev"};
+        for (int i = 0; i < 3; ++i) {
+            float cx = bx + i * (btnw + 10) + btnw * 0.5f;
+            text.draw(batch, btn_labels[i], cx - text.measure(btn_labels[i]) * 0.5f,
+                      by + (btnh - text.line_height()) * 0.5f, btnw, label);
+        }
+
+        // Scrubber (length comes from the track's headers; 0 until one is known)
+        draw_rect(sbx, sby, sbw, sbh, 0.08f, 0.09f, 0.11f, 1.0f);
+        float fill = length > 0.0 ? (float)(progress / length) : 0.0f;
+        if (fill < 0.0f) fill = 0.0f; if (fill > 1.0f) fill = 1.0f;
+        draw_rect(sbx, sby, sbw * fill, sbh, nr, ng, nb, 1.0f);
+        if (length > 0.0) {
+            char pos_s[32], len_s[32];
+            format_time(pos_s, sizeof(pos_s), progress);
+            format_time(len_s, sizeof(len_s), length);
+            text.draw(batch, pos_s, sbx, sby + sbh + 4, 0, dim);
+            text.draw(batch, len_s, sbx + sbw - text.measure(len_s), sby + sbh + 4, 0, dim);
+        }
 
         // Draw login panel if active
         if (show_login) {
             draw_rect(50, 60, 400, 200, 0.1f, 0.1f, 0.12f, 1.0f);
-            // Placeholder text
+            text.draw(batch, "VK sign-in", 60, 70, 380, ink);
+            text.draw(batch, "Not available in this window yet.", 60, 100, 380, dim);
         }
 
         // Draw add music panel if active
         if (show_add_music) {
             draw_rect(50, 60, 400, 200, 0.1f, 0.1f, 0.12f, 1.0f);
-            // Input field for file path
+            // Input field for file path; the end (and the caret) stays in view
             draw_rect(60, 80, 380, 30, 0.05f, 0.05f, 0.07f, 1.0f);
+            const float fy = 95 - text.line_height() * 0.5f;
+            if (input_cursor > 0) {
+                float tw = text.measure(input_text);
+                float scroll = tw > 366 ? tw - 366 : 0;
+                batch.clip(60, 80, 380, 30);
+                text.draw(batch, input_text, 66 - scroll, fy, 0, ink);
+                batch.clip_off();
+                draw_rect(66 - scroll + tw + 1, 85, 2, 20, nr, ng, nb, 1.0f);
+            } else {
+                text.draw(batch, "File path or URL, then Enter", 66, fy, 366, dim);
+                draw_rect(65, 85, 2, 20, nr, ng, nb, 1.0f);
+            }
             // Add button
             draw_rect(60, 120, 100, 30, nr, ng, nb, 0.6f);
+            text.draw(batch, "Add", 110 - text.measure("Add") * 0.5f, 135 - text.line_height() * 0.5f, 0, label);
         }
 
-        // Update demo waveform animation
-        for (size_t i = 0; i < samples; ++i) wave[i] = sin((double)i / samples * 20.0 + glfwGetTime() * 2.0) * (0.3 + 0.15 * sin(i * 0.03 + glfwGetTime()));
-
-        // Advance progress if playing
-        auto now = std::chrono::steady_clock::now();
-        double dt = std::chrono::duration_cast<std::chrono::duration<double>>(now - last).count();
-        last = now;
-        if (playing) progress += dt;
-        if (progress >= length) { progress = 0.0; }
+        prof.end(s_controls);
+        if (show_prof) {
+            prof.begin(s_overlay, false);
+            prof.draw(batch, text, win_w - 10.0f, 60.0f);
+            prof.end(s_overlay);
+        }
 
+        prof.begin(s_flush, true);
+        batch.flush();
+        prof.end(s_flush);
+        prof.begin(s_swap, false);
         glfwSwapBuffers(w);
-        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        prof.end(s_swap);
+        ox_startup_mark("first-frame");
+        pacer.frame_done();
+        prof.end_frame(animating);
+        if (prof_path && glfwGetTime() - prof_written >= 5.0) {
+            prof.write_json(prof_path);
+            prof_written = glfwGetTime();
+        }
     }
 
+    if (own_engine) ox_ui_detach();
+    ox_ui_set_wakeup(NULL);
+    if (prof_path && !prof.write_json(prof_path)) fprintf(stderr, "Cannot write profile to %s\n", prof_path);
+    prof.shutdown();
+    if (ox_trace_path() && ox_trace_write(ox_trace_path()) != 0)
+        fprintf(stderr, "Cannot write trace to %s\n", ox_trace_path());
+    if (own_playlist) {
+        ox_ui_set_playlist(NULL);
+        ox_plshare_destroy(own_playlist);
+    }
+    if (font_thread.joinable()) font_thread.join();
+    free(font_path.exchange(nullptr));
+    text.shutdown();
+    wave.shutdown();
+    batch.shutdown();
+    uploader.shutdown();
+    ox_art_cache_destroy(art);
     glfwDestroyWindow(w);
     glfwTerminate();
     return 0;
@@ -1,9 +1,18 @@
 // ui/ui_main_gl.cpp
-// Modern OpenGL UI for OXXY: uses a simple shader pipeline and VBO to draw waveform,
-// supports HiDPI scaling and a neon theme. This is a demo frontend; integrate with
+// Modern OpenGL UI for OXXY: draws the waveform of everything played so far
+// on the GPU (waveview.cpp; scroll zooms, drag pans, F fits), supports HiDPI
+// scaling and a neon theme. This is a demo frontend; integrate with
 // the actual audio core by linking and using ox_ui_get_waveform_copy.
+// The loop is event driven (pacer.cpp): keys act once per press from the key
+// callback, and frames are drawn only when input or new peaks arrive.
+// F3 starts the frame profiler (profiler.cpp) and, pressed again, prints its
+// totals as JSON to stderr; $OXXY_UI_PROFILE=file.json writes them at exit.
+// Its frames and sections are also trace spans (src/trace.c): F4 writes the
+// trace of every thread to $OXXY_TRACE or oxxy-trace.json.
+// Entered through ox_ui_main from the launcher (main_launcher.c), which owns
+// the playlist and the optional integrations; this file only marks the
+// window and first-frame startup phases.
 
-#include <GLFW/glfw3.h>
 #include <GLFW/glfw3.h>
 #include <GL/gl.h>
 #include <cstdio>
@@ -12,78 +21,184 @@
 #include <cstring>
 #include <cmath>
 #include <chrono>
-#include <thread>
 #include <string>
 
+#include "batch.h"
+#include "pacer.h"
+#include "profiler.h"
+#include "waveview.h"
+
 extern "C" size_t ox_ui_get_waveform_copy(float *dest, size_t max_samples);
-extern "C" int ox_profiles_init(void);
+extern "C" void ox_ui_set_wakeup(void (*wake)(void));
 extern "C" char *ox_profiles_list_json(void);
 extern "C" int ox_profiles_save(const char *name, const char *json_blob);
 extern "C" char *ox_profiles_load(const char *name);
 extern "C" void ox_ui_add_to_playlist(const char *uri);
+extern "C" double ox_ui_get_track_length(void);
+extern "C" void ox_ui_request_play(int playing);
+extern "C" {
+#include "startup.h"
+}
+#include "trace.h"
 
 static int win_w = 1280, win_h = 720;
 static char last_dropped[1024] = {0};
+static std::vector<int> pressed; // keys pressed since the last frame, once each
+static bool dragging = false;
+static double drag_x, scroll_y;   // pointer x of the drag, wheel steps since the last frame
+static float pan_px = 0.0f;      // drag distance since the last frame
+static double cursor_x;
+static bool dirty = true;
 
 static void drop_callback(GLFWwindow* window, int count, const char** paths)
 {
     (void)window;
     if (count <= 0) return;
     snprintf(last_dropped, sizeof(last_dropped), "%s", paths[0]);
+    dirty = true;
+}
+
+static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    (void)window; (void)scancode; (void)mods;
+    if (action == GLFW_PRESS) { pressed.push_back(key); dirty = true; }
+}
+
+static void mouse_callback(GLFWwindow *window, int button, int action, int mods)
+{
+    (void)mods;
+    if (button != GLFW_MOUSE_BUTTON_LEFT) return;
+    double y;
+    glfwGetCursorPos(window, &drag_x, &y);
+    dragging = action == GLFW_PRESS;
+}
+
+static void cursor_callback(GLFWwindow *window, double x, double y)
+{
+    (void)window; (void)y;
+    cursor_x = x;
+    if (!dragging) return;
+    pan_px += (float)(x - drag_x);
+    drag_x = x;
+    dirty = true;
+}
+
+static void scroll_callback(GLFWwindow *window, double dx, double dy)
+{
+    (void)window; (void)dx;
+    scroll_y += dy;
+    dirty = true;
+}
+
+static void refresh_callback(GLFWwindow *window)
+{
+    (void)window;
+    dirty = true;
 }
 
-int main(int argc, char **argv)
+static void size_callback(GLFWwindow *window, int width, int height)
+{
+    (void)window; (void)width; (void)height;
+    dirty = true;
+}
+
+extern "C" int ox_ui_main(int argc, char **argv)
 {
     (void)argc; (void)argv;
+    OX_TRACE_THREAD("ui");
     if (!glfwInit()) return 1;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
     GLFWwindow *w = glfwCreateWindow(win_w, win_h, "OXXY — GL UI", NULL, NULL);
     if (!w) { glfwTerminate(); return 1; }
+    ox_startup_mark("window");
     glfwMakeContextCurrent(w);
     glfwSwapInterval(1);
+    // peaks come in as (-p, p) pairs: one texel per peak, symmetric about the axis
+    WaveView wave;
+    if (!wave.init(2)) { fprintf(stderr, "OpenGL 3.3 core renderer unavailable\n"); glfwTerminate(); return 1; }
     glfwSetDropCallback(w, drop_callback);
+    glfwSetKeyCallback(w, key_callback);
+    glfwSetMouseButtonCallback(w, mouse_callback);
+    glfwSetCursorPosCallback(w, cursor_callback);
+    glfwSetScrollCallback(w, scroll_callback);
+    glfwSetWindowRefreshCallback(w, refresh_callback);
+    glfwSetFramebufferSizeCallback(w, size_callback);
+    FramePacer pacer;
+    pacer.init();
+    ox_ui_set_wakeup(glfwPostEmptyEvent);
+    FrameProfiler prof;
+    prof.init(pacer.period());
+    const char *prof_path = getenv("OXXY_UI_PROFILE");
+    if (prof_path && !*prof_path) prof_path = NULL;
+    prof.set_enabled(prof_path != NULL);
 
     const size_t samples = 2048;
-    std::vector<float> samples_buf(samples);
+    std::vector<float> pairs(2 * samples);
 
     auto last = std::chrono::steady_clock::now();
-    double progress = 0.0; bool playing = false; double length = 180.0;
+    double progress = 0.0; bool playing = false; double length = 0.0;
+    bool streaming = false; // peaks arrived last frame
 
-    // profiles
-    ox_profiles_init();
+    // profiles (loaded by the launcher's startup thread, or here on first use)
     char prof_name[128] = "default";
 
     while (!glfwWindowShouldClose(w)) {
-        glfwPollEvents();
-        int fbw, fbh; glfwGetFramebufferSize(w, &fbw, &fbh);
-        glViewport(0, 0, fbw, fbh);
-        glClearColor(0.02f, 0.02f, 0.03f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        // nothing here animates by itself: frames follow the peaks, paced
+        pacer.wait(streaming, dirty);
+        prof.begin_frame();
 
         // copy peaks from bridge
-        float scratch[samples];
-        size_t copied = ox_ui_get_waveform_copy(scratch, samples);
-        if (copied > 0) {
-            for (size_t i = 0; i < copied && i < samples; ++i) samples_buf[i] = scratch[i];
-        }
-
-        // draw waveform with immediate mode
-        glColor3f(0.0f, 0.7f, 1.0f);
-        glLineWidth(1.0f);
-        glBegin(GL_LINE_STRIP);
-        for (size_t i = 0; i < samples; ++i) {
-            float x = (float)i / (samples - 1) * 2.0f - 1.0f;
-            float y = samples_buf[i] * 0.8f;
-            glVertex2f(x, y);
+        {
+            FrameProfiler::Scope scope(prof, "peaks");
+            float scratch[samples];
+            size_t copied = ox_ui_get_waveform_copy(scratch, samples);
+            if (copied > 0) {
+                for (size_t i = 0; i < copied; ++i) { pairs[2 * i] = -scratch[i]; pairs[2 * i + 1] = scratch[i]; }
+                wave.append(pairs.data(), 2 * copied);
+                dirty = true;
+            }
+            streaming = copied > 0;
         }
-        glEnd();
 
         // simple controls via keyboard
-        if (glfwGetKey(w, GLFW_KEY_SPACE) == GLFW_PRESS) { playing = !playing; std::this_thread::sleep_for(std::chrono::milliseconds(150)); }
+        {
+            FrameProfiler::Scope scope(prof, "input");
+            for (int key : pressed) {
+                if (key == GLFW_KEY_SPACE) {
+                    playing = !playing;
+                    ox_ui_request_play(playing);
+                }
+                if (key == GLFW_KEY_F || key == GLFW_KEY_HOME) wave.fit();
+                if (key == GLFW_KEY_F3) {
+                    if (prof.enabled() && prof.frames()) prof.write_json(stderr);
+                    prof.set_enabled(!prof.enabled() || prof_path);
+                }
+                if (key == GLFW_KEY_F4) {
+                    const char *path = ox_trace_path() ? ox_trace_path() : "oxxy-trace.json";
+                    if (ox_trace_write(path) == 0) fprintf(stderr, "Trace written to %s\n", path);
+                    else fprintf(stderr, "Cannot write trace to %s\n", path);
+                }
+                // profile save/load demo
+                if (key == GLFW_KEY_S) {
+                    const char *blob = "{\"volume\":0.8}";
+                    ox_profiles_save(prof_name, blob);
+                }
+                if (key == GLFW_KEY_L) {
+                    char *b = ox_profiles_load(prof_name);
+                    if (b) { fprintf(stderr, "loaded profile %s: %s\n", prof_name, b); free(b); }
+                }
+            }
+            pressed.clear();
+        }
+        length = ox_ui_get_track_length();
         if (playing) {
             auto now = std::chrono::steady_clock::now();
             double dt = std::chrono::duration_cast<std::chrono::duration<double>>(now - last).count();
             progress += dt; last = now;
-            if (progress >= length) progress = 0.0;
+            if (length > 0.0 && progress >= length) progress = 0.0;
         } else last = std::chrono::steady_clock::now();
 
         if (last_dropped[0]) {
@@ -92,22 +207,47 @@ int main(int argc, char **argv)
             last_dropped[0] = '\0';
         }
 
-        // profile save/load demo
-        if (glfwGetKey(w, GLFW_KEY_S) == GLFW_PRESS) {
-            const char *blob = "{\"volume\":0.8}";
-            ox_profiles_save(prof_name, blob);
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (!dirty) {
+            prof.skip_frame();
+            continue;
         }
-        if (glfwGetKey(w, GLFW_KEY_L) == GLFW_PRESS) {
-            char *b = ox_profiles_load(prof_name);
-            if (b) { fprintf(stderr, "loaded profile %s: %s\n", prof_name, b); free(b); }
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        dirty = false;
+
+        int fbw, fbh; glfwGetFramebufferSize(w, &fbw, &fbh);
+        glViewport(0, 0, fbw, fbh);
+        glClearColor(0.02f, 0.02f, 0.03f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // zoom and pan in framebuffer pixels (HiDPI: window coordinates scaled)
+        int ww, wh; glfwGetWindowSize(w, &ww, &wh);
+        float sx = ww > 0 ? (float)fbw / ww : 1.0f;
+        if (scroll_y != 0.0) wave.zoom(pow(1.25, scroll_y), (float)cursor_x * sx);
+        if (pan_px != 0.0f) wave.pan(pan_px * sx);
+        scroll_y = 0.0;
+        pan_px = 0.0f;
+
+        // waveform across the window, +-1 filling 80% of its height
+        {
+            FrameProfiler::Scope scope(prof, "wave", true);
+            wave.draw(0.0f, fbh * 0.1f, (float)fbw, fbh * 0.8f, fbw, fbh, Batch::rgba(0.0f, 0.7f, 1.0f, 1.0f),
+                      Batch::rgba(0.6f, 0.9f, 1.0f, 1.0f));
         }
 
-        glfwSwapBuffers(w);
-        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        {
+            FrameProfiler::Scope scope(prof, "swap");
+            glfwSwapBuffers(w);
+        }
+        ox_startup_mark("first-frame");
+        pacer.frame_done();
+        prof.end_frame(streaming);
     }
 
+    ox_ui_set_wakeup(NULL);
+    if (prof_path && !prof.write_json(prof_path)) fprintf(stderr, "Cannot write profile to %s\n", prof_path);
+    prof.shutdown();
+    if (ox_trace_path() && ox_trace_write(ox_trace_path()) != 0)
+        fprintf(stderr, "Cannot write trace to %s\n", ox_trace_path());
+    wave.shutdown();
     glfwDestroyWindow(w);
     glfwTerminate();
     return 0;
@@ -0,0 +1,408 @@
+// ui/waveview.cpp
+// Min/max/RMS pyramid waveform drawn by a fragment shader (see waveview.h).
+
+#include "waveview.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "gl_loader.h"
+
+static PFNGLUNIFORM1IPROC p_glUniform1i;
+static PFNGLUNIFORM1FPROC p_glUniform1f;
+static PFNGLUNIFORM4FPROC p_glUniform4f;
+static PFNGLGENFRAMEBUFFERSPROC p_glGenFramebuffers;
+static PFNGLBINDFRAMEBUFFERPROC p_glBindFramebuffer;
+static PFNGLDELETEFRAMEBUFFERSPROC p_glDeleteFramebuffers;
+static PFNGLFRAMEBUFFERTEXTURE2DPROC p_glFramebufferTexture2D;
+static PFNGLCHECKFRAMEBUFFERSTATUSPROC p_glCheckFramebufferStatus;
+
+// the quad comes from gl_VertexID: no vertex buffer
+static const char *vertex_src =
+    "#version 330 core\n"
+    "uniform vec4 u_rect;\n"
+    "uniform vec2 u_scale;\n"
+    "out vec2 v_local;\n"
+    "void main() {\n"
+    "    vec2 c = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+    "    v_local = c * u_rect.zw;\n"
+    "    gl_Position = vec4((u_rect.xy + v_local) * u_scale + vec2(-1.0, 1.0), 0.0, 1.0);\n"
+    "}\n";
+
+// Pass 1, one fragment per column of a W x 1 target: column x covers
+// finest-level texels [b, b + u_bpp) past u_base. Level l is the coarsest
+// whose texels are no wider than that, so at most three of them overlap the
+// column; the integer base keeps deep zooms on long tracks exact.
+static const char *column_src =
+    "#version 330 core\n"
+    "in vec2 v_local;\n"
+    "uniform sampler2D u_sum;\n"
+    "uniform int u_levels;\n"
+    "uniform int u_offset[32];\n"
+    "uniform int u_len[32];\n"
+    "uniform int u_tex_w;\n"
+    "uniform int u_base;\n"
+    "uniform float u_frac;\n"
+    "uniform float u_bpp;\n"
+    "out vec4 o_col;\n"
+    "void main() {\n"
+    "    int l = clamp(int(floor(log2(max(u_bpp, 1.0)))), 0, u_levels - 1);\n"
+    "    float s = exp2(float(l));\n"
+    "    float b = float(u_base & ((1 << l) - 1)) + u_frac + floor(v_local.x) * u_bpp;\n"
+    "    int first = (u_base >> l) + int(floor(b / s));\n"
+    "    int last = max(first, (u_base >> l) + int(ceil((b + u_bpp) / s)) - 1);\n"
+    "    first = max(first, 0);\n"
+    "    last = min(last, u_len[l] - 1);\n"
+    "    float mn = 1e4, mx = -1e4, ms = 0.0;\n"
+    "    int n = 0;\n"
+    "    for (int i = first; i <= last && n < 4; ++i, ++n) {\n"
+    "        int t = u_offset[l] + i;\n"
+    "        vec3 v = texelFetch(u_sum, ivec2(t % u_tex_w, t / u_tex_w), 0).rgb;\n"
+    "        mn = min(mn, v.r);\n"
+    "        mx = max(mx, v.g);\n"
+    "        ms += v.b;\n"
+    "    }\n"
+    "    o_col = vec4(mn, mx, n > 0 ? sqrt(ms / float(n)) : 0.0, 1.0);\n"
+    "}\n";
+
+// Pass 2, the visible rect: one fetch of the column's min, max and RMS.
+static const char *band_src =
+    "#version 330 core\n"
+    "in vec2 v_local;\n"
+    "uniform vec4 u_rect;\n"
+    "uniform sampler2D u_cols;\n"
+    "uniform vec4 u_fill;\n"
+    "uniform vec4 u_core;\n"
+    "out vec4 o_color;\n"
+    "void main() {\n"
+    "    vec3 c = texelFetch(u_cols, ivec2(int(v_local.x), 0), 0).rgb;\n"
+    "    float px = 2.0 / u_rect.w;\n"
+    "    float a = 1.0 - (v_local.y + 0.5) * px;\n"
+    "    if (a < c.r - px || a > c.g + px) discard;\n"
+    "    o_color = abs(a) <= c.b ? u_core : u_fill;\n"
+    "}\n";
+
+static GLuint compile(GLenum type, const char *src)
+{
+    GLuint s = p_glCreateShader(type);
+    p_glShaderSource(s, 1, &src, nullptr);
+    p_glCompileShader(s);
+    GLint ok = 0;
+    p_glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[512];
+        p_glGetShaderInfoLog(s, sizeof(log), nullptr, log);
+        fprintf(stderr, "waveview: shader: %s\n", log);
+        p_glDeleteShader(s);
+        return 0;
+    }
+    return s;
+}
+
+static GLuint link(const char *fs_src)
+{
+    GLuint prog = 0, vs = compile(GL_VERTEX_SHADER, vertex_src), fs = compile(GL_FRAGMENT_SHADER, fs_src);
+    if (vs && fs) {
+        prog = p_glCreateProgram();
+        p_glAttachShader(prog, vs);
+        p_glAttachShader(prog, fs);
+        p_glLinkProgram(prog);
+        GLint linked = 0;
+        p_glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            char log[512];
+            p_glGetProgramInfoLog(prog, sizeof(log), nullptr, log);
+            fprintf(stderr, "waveview: link: %s\n", log);
+            p_glDeleteProgram(prog);
+            prog = 0;
+        }
+    }
+    if (vs) p_glDeleteShader(vs);
+    if (fs) p_glDeleteShader(fs);
+    return prog;
+}
+
+bool WaveView::init(size_t bin)
+{
+    ok_ = gl_load_programs() && gl_load(p_glUniform1i, "glUniform1i") && gl_load(p_glUniform1f, "glUniform1f") &&
+          gl_load(p_glUniform4f, "glUniform4f") && gl_load(p_glGenFramebuffers, "glGenFramebuffers") &&
+          gl_load(p_glBindFramebuffer, "glBindFramebuffer") && gl_load(p_glDeleteFramebuffers, "glDeleteFramebuffers") &&
+          gl_load(p_glFramebufferTexture2D, "glFramebufferTexture2D") &&
+          gl_load(p_glCheckFramebufferStatus, "glCheckFramebufferStatus");
+    if (!ok_) return false;
+
+    column_prog_ = link(column_src);
+    band_prog_ = link(band_src);
+    if (!column_prog_ || !band_prog_) {
+        if (column_prog_) p_glDeleteProgram(column_prog_);
+        if (band_prog_) p_glDeleteProgram(band_prog_);
+        column_prog_ = band_prog_ = 0;
+        return ok_ = false;
+    }
+    auto loc = [](GLuint prog, const char *name) { return p_glGetUniformLocation(prog, name); };
+    loc_col_rect_ = loc(column_prog_, "u_rect");
+    loc_col_scale_ = loc(column_prog_, "u_scale");
+    loc_levels_ = loc(column_prog_, "u_levels");
+    loc_offset_ = loc(column_prog_, "u_offset");
+    loc_len_ = loc(column_prog_, "u_len");
+    loc_tex_w_ = loc(column_prog_, "u_tex_w");
+    loc_base_ = loc(column_prog_, "u_base");
+    loc_frac_ = loc(column_prog_, "u_frac");
+    loc_bpp_ = loc(column_prog_, "u_bpp");
+    loc_rect_ = loc(band_prog_, "u_rect");
+    loc_scale_ = loc(band_prog_, "u_scale");
+    loc_fill_ = loc(band_prog_, "u_fill");
+    loc_core_ = loc(band_prog_, "u_core");
+    p_glUseProgram(column_prog_);
+    p_glUniform1i(loc(column_prog_, "u_sum"), 0);
+    p_glUseProgram(band_prog_);
+    p_glUniform1i(loc(band_prog_, "u_cols"), 0);
+    p_glUseProgram(0);
+
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    tex_w_ = std::min(4096, (int)max_size);
+    max_rows_ = (int)max_size;
+    p_glGenVertexArrays(1, &vao_);
+    glGenTextures(1, &tex_);
+    glGenTextures(1, &cols_tex_);
+    for (GLuint t : {tex_, cols_tex_}) {
+        glBindTexture(GL_TEXTURE_2D, t);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    p_glGenFramebuffers(1, &fbo_);
+    cols_w_ = 0;
+    bin_ = bin ? bin : 1;
+    clear();
+    return true;
+}
+
+void WaveView::shutdown()
+{
+    if (!ok_) return;
+    glDeleteTextures(1, &tex_);
+    glDeleteTextures(1, &cols_tex_);
+    p_glDeleteFramebuffers(1, &fbo_);
+    p_glDeleteVertexArrays(1, &vao_);
+    p_glDeleteProgram(column_prog_);
+    p_glDeleteProgram(band_prog_);
+    levels_.clear();
+    ok_ = false;
+}
+
+void WaveView::clear()
+{
+    levels_.clear();
+    total_ = 0;
+    cap0_ = 0;
+    rows_ = 0;
+    fitted_ = true;
+    start_ = 0.0;
+}
+
+void WaveView::merge(int level, size_t i)
+{
+    const std::vector<Texel> &below = levels_[level - 1];
+    const Texel &a = below[2 * i];
+    size_t per = bin_ << (level - 1); // input values per texel below
+    if (2 * i + 1 >= below.size()) {
+        levels_[level][i] = a;
+        return;
+    }
+    const Texel &b = below[2 * i + 1];
+    double wb = (double)std::min(per, total_ - (2 * i + 1) * per);
+    levels_[level][i] = {std::min(a.mn, b.mn), std::max(a.mx, b.mx),
+                         (float)((a.ms * (double)per + b.ms * wb) / ((double)per + wb))};
+}
+
+bool WaveView::layout(size_t cap0)
+{
+    size_t texels = 0;
+    for (int l = 0; l < MAX_LEVELS; ++l) {
+        offset_[l] = (GLint)texels;
+        texels += std::max(cap0 >> l, (size_t)1);
+    }
+    size_t rows = (texels + tex_w_ - 1) / tex_w_;
+    if (rows > (size_t)max_rows_) return false;
+    glBindTexture(GL_TEXTURE_2D, tex_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, tex_w_, (GLsizei)rows, 0, GL_RGB, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    cap0_ = cap0;
+    rows_ = (int)rows;
+    for (size_t l = 0; l < levels_.size(); ++l) upload((int)l, 0, levels_[l].size());
+    return true;
+}
+
+void WaveView::upload(int level, size_t lo, size_t hi)
+{
+    const std::vector<Texel> &t = levels_[level];
+    glBindTexture(GL_TEXTURE_2D, tex_);
+    while (lo < hi) {
+        size_t at = (size_t)offset_[level] + lo;
+        size_t x = at % tex_w_, n = std::min(hi - lo, (size_t)tex_w_ - x);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)x, (GLint)(at / tex_w_), (GLsizei)n, 1, GL_RGB, GL_FLOAT, &t[lo]);
+        lo += n;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void WaveView::drop_finest()
+{
+    levels_.erase(levels_.begin());
+    bin_ *= 2;
+    if (levels_.empty()) levels_.push_back({});
+}
+
+void WaveView::append(const float *v, size_t n)
+{
+    if (!ok_ || n == 0) return;
+    if (levels_.empty()) levels_.push_back({});
+    std::vector<Texel> &l0 = levels_[0];
+    size_t lo = total_ / bin_;
+    for (size_t k = 0; k < n; ++k, ++total_) {
+        float x = v[k];
+        size_t c = total_ % bin_;
+        if (c == 0) {
+            l0.push_back({x, x, x * x});
+            continue;
+        }
+        Texel &t = l0.back();
+        t.mn = std::min(t.mn, x);
+        t.mx = std::max(t.mx, x);
+        t.ms = (t.ms * (float)c + x * x) / (float)(c + 1);
+    }
+
+    // the changed texels of each level come from those of the level below
+    std::vector<size_t> dirty(1, lo);
+    for (size_t l = 1; levels_[l - 1].size() > 1; ++l) {
+        if (l == levels_.size()) levels_.push_back({});
+        size_t from = dirty[l - 1] / 2;
+        levels_[l].resize((levels_[l - 1].size() + 1) / 2);
+        for (size_t i = from; i < levels_[l].size(); ++i) merge((int)l, i);
+        dirty.push_back(from);
+    }
+
+    if (levels_[0].size() > cap0_) {
+        size_t cap = std::max(cap0_, (size_t)tex_w_);
+        while (cap < levels_[0].size()) cap *= 2;
+        while (!layout(cap)) {
+            // too long for the texture: coarser bins instead
+            drop_finest();
+            cap /= 2;
+        }
+        return;
+    }
+    for (size_t l = 0; l < levels_.size(); ++l) upload((int)l, dirty[l], levels_[l].size());
+}
+
+void WaveView::fit()
+{
+    fitted_ = true;
+    clamp_view();
+}
+
+void WaveView::zoom(double factor, float anchor_px)
+{
+    if (factor <= 0.0) return;
+    fitted_ = false;
+    double at = start_ + anchor_px * per_px_;
+    per_px_ /= factor;
+    start_ = at - anchor_px * per_px_;
+    clamp_view();
+}
+
+void WaveView::pan(float dx_px)
+{
+    fitted_ = false;
+    start_ -= dx_px * per_px_;
+    clamp_view();
+}
+
+void WaveView::clamp_view()
+{
+    if (width_ <= 0.0f) return;
+    double total = (double)std::max(total_, (size_t)1);
+    if (fitted_) {
+        start_ = 0.0;
+        per_px_ = total / width_;
+        return;
+    }
+    double min_pp = (double)bin_ / 16.0, max_pp = std::max(total / width_, min_pp);
+    per_px_ = std::min(std::max(per_px_, min_pp), max_pp);
+    start_ = std::min(std::max(start_, 0.0), std::max(0.0, total - width_ * per_px_));
+}
+
+void WaveView::draw(float x, float y, float w, float h, int fb_w, int fb_h, uint32_t fill, uint32_t core)
+{
+    if (!ok_ || total_ == 0 || w <= 0.0f || h <= 0.0f) return;
+    width_ = w;
+    clamp_view();
+    GLint prev_fbo = 0, prev_viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prev_fbo);
+    glGetIntegerv(GL_VIEWPORT, prev_viewport);
+    int cols = (int)std::ceil(w);
+    if (cols > cols_w_) {
+        glBindTexture(GL_TEXTURE_2D, cols_tex_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, cols, 1, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        p_glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+        p_glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cols_tex_, 0);
+        bool complete = p_glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        p_glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)prev_fbo);
+        if (!complete) {
+            fprintf(stderr, "waveview: float render target unsupported\n");
+            ok_ = false;
+            return;
+        }
+        cols_w_ = cols;
+    }
+
+    GLint len[MAX_LEVELS];
+    int nlevels = (int)levels_.size();
+    for (int l = 0; l < nlevels; ++l) len[l] = (GLint)levels_[l].size();
+    double start = start_ / (double)bin_, base = std::floor(start);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+
+    // pass 1: min, max and RMS of each column into a cols x 1 row
+    p_glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glViewport(0, 0, cols, 1);
+    glDisable(GL_BLEND);
+    p_glUseProgram(column_prog_);
+    p_glUniform4f(loc_col_rect_, 0.0f, 0.0f, (float)cols, 1.0f);
+    p_glUniform2f(loc_col_scale_, 2.0f / (float)cols, -2.0f);
+    p_glUniform1i(loc_levels_, nlevels);
+    p_glUniform1iv(loc_offset_, nlevels, offset_);
+    p_glUniform1iv(loc_len_, nlevels, len);
+    p_glUniform1i(loc_tex_w_, tex_w_);
+    p_glUniform1i(loc_base_, (GLint)base);
+    p_glUniform1f(loc_frac_, (float)(start - base));
+    p_glUniform1f(loc_bpp_, (float)(per_px_ / (double)bin_));
+    p_glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, tex_);
+    p_glBindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    // pass 2: the rect, one texel per pixel
+    p_glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)prev_fbo);
+    glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    auto color = [](GLint loc, uint32_t c) {
+        p_glUniform4f(loc, (c & 0xff) / 255.0f, (c >> 8 & 0xff) / 255.0f, (c >> 16 & 0xff) / 255.0f,
+                      (c >> 24) / 255.0f);
+    };
+    p_glUseProgram(band_prog_);
+    p_glUniform4f(loc_rect_, x, y, w, h);
+    p_glUniform2f(loc_scale_, 2.0f / (float)(fb_w > 0 ? fb_w : 1), -2.0f / (float)(fb_h > 0 ? fb_h : 1));
+    color(loc_fill_, fill);
+    color(loc_core_, core);
+    glBindTexture(GL_TEXTURE_2D, cols_tex_);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    p_glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    p_glUseProgram(0);
+    if (!blend) glDisable(GL_BLEND);
+}
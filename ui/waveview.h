@@ -0,0 +1,74 @@
+// ui/waveview.h
+// GPU waveform: the samples of a whole track are summarised into a pyramid of
+// (min, max, mean square) levels, each level halving the previous one, packed
+// into one float texture. Drawing is two quads: the first, one pixel tall,
+// picks per column the level where one texel is at most one column wide and
+// folds the two or three texels under it into a row of (min, max, RMS); the
+// second covers the rect and its fragment shader reads that row once per
+// pixel. A frame costs the same at any zoom and for any track length.
+// Appending samples updates only the texels whose bins changed; when the
+// texture would outgrow GL_MAX_TEXTURE_SIZE the finest level is dropped (bins
+// double) instead of failing.
+
+#pragma once
+
+#include <GL/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WaveView {
+public:
+    static const int MAX_LEVELS = 32;
+
+    // Call with a GL 3.3 core context current. bin: input values per texel of
+    // the finest level (1 for peaks, more for raw PCM). False if the shader or
+    // an entry point is unavailable.
+    bool init(size_t bin = 1);
+    void shutdown();
+
+    void clear();
+    // Add values (-1..1) at the end of the track.
+    void append(const float *v, size_t n);
+    size_t size() const { return total_; }
+
+    // View, in input values: the first one at the left edge and how many one
+    // pixel covers. Until the view is set, zoomed or panned it follows the
+    // whole track (fit).
+    void fit();
+    void zoom(double factor, float anchor_px); // > 1 zooms in around anchor_px
+    void pan(float dx_px);                     // content follows the pointer
+    bool fitted() const { return fitted_; }
+
+    // Draw into the rect (window pixels, origin top left) of a fb_w x fb_h
+    // framebuffer. Colors are packed like Batch::rgba: fill spans min..max,
+    // core the +-RMS band inside it.
+    void draw(float x, float y, float w, float h, int fb_w, int fb_h, uint32_t fill, uint32_t core);
+
+private:
+    struct Texel {
+        float mn, mx, ms;
+    };
+
+    void merge(int level, size_t i);  // recompute texel i of level from level - 1
+    bool layout(size_t cap0);         // (re)allocate the texture for cap0 finest texels
+    void upload(int level, size_t lo, size_t hi);
+    void drop_finest();
+    void clamp_view();
+
+    bool ok_ = false;
+    GLuint column_prog_ = 0, band_prog_ = 0, vao_ = 0, tex_ = 0;
+    GLuint fbo_ = 0, cols_tex_ = 0; // per-column min, max, RMS of the current view
+    int cols_w_ = 0;
+    GLint loc_col_rect_ = -1, loc_col_scale_ = -1, loc_levels_ = -1, loc_offset_ = -1, loc_len_ = -1;
+    GLint loc_tex_w_ = -1, loc_base_ = -1, loc_frac_ = -1, loc_bpp_ = -1;
+    GLint loc_rect_ = -1, loc_scale_ = -1, loc_fill_ = -1, loc_core_ = -1;
+    int tex_w_ = 0, max_rows_ = 0, rows_ = 0;
+    size_t bin_ = 1, total_ = 0;
+    std::vector<std::vector<Texel>> levels_;
+    size_t cap0_ = 0;
+    GLint offset_[MAX_LEVELS] = {};
+    double start_ = 0.0, per_px_ = 1.0; // view in input values
+    float width_ = 0.0f;                // of the last draw, for zoom and pan
+    bool fitted_ = true;
+};